@@ -38,6 +38,10 @@ extern SPI_HandleTypeDef hspi2;
 
 /* USER CODE BEGIN Private defines */
 
+extern DMA_HandleTypeDef hdma_spi1_rx;
+extern DMA_HandleTypeDef hdma_spi1_tx;
+extern DMA_HandleTypeDef hdma_spi2_tx;
+
 /* USER CODE END Private defines */
 
 void MX_SPI1_Init(void);
@@ -58,7 +58,12 @@ void SysTick_Handler(void);
 void RCC_IRQHandler(void);
 void TIM6_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void DMA1_Channel2_IRQHandler(void);
+void DMA1_Channel3_IRQHandler(void);
+void DMA1_Channel4_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
+void TIM7_IRQHandler(void);
+void USART1_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -36,12 +36,16 @@ extern TIM_HandleTypeDef htim6;
 
 /* USER CODE BEGIN Private defines */
 
+extern TIM_HandleTypeDef htim7;
+
 /* USER CODE END Private defines */
 
 void MX_TIM6_Init(void);
 
 /* USER CODE BEGIN Prototypes */
 
+void MX_TIM7_Init(void);
+
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -38,6 +38,8 @@ extern UART_HandleTypeDef huart2;
 
 /* USER CODE BEGIN Private defines */
 
+extern DMA_HandleTypeDef hdma_usart1_tx;
+
 /* USER CODE END Private defines */
 
 void MX_USART1_UART_Init(void);
@@ -106,6 +106,7 @@ int main(void)
   MX_FATFS_Init();
   MX_TIM6_Init();
   /* USER CODE BEGIN 2 */
+  MX_TIM7_Init();
 
   /* USER CODE END 2 */
 
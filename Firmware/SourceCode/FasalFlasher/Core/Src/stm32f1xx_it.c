@@ -23,6 +23,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "AppCommon.h"
+#include "Console.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -58,7 +59,11 @@
 /* External variables --------------------------------------------------------*/
 extern TIM_HandleTypeDef htim6;
 /* USER CODE BEGIN EV */
-
+extern DMA_HandleTypeDef hdma_spi1_rx;
+extern DMA_HandleTypeDef hdma_spi1_tx;
+extern DMA_HandleTypeDef hdma_spi2_tx;
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern TIM_HandleTypeDef htim7;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -230,4 +235,59 @@ void TIM6_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 channel2 global interrupt (SPI1_RX).
+  */
+void DMA1_Channel2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi1_rx);
+}
+
+/**
+  * @brief This function handles DMA1 channel3 global interrupt (SPI1_TX).
+  */
+void DMA1_Channel3_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi1_tx);
+}
+
+/**
+  * @brief This function handles DMA1 channel4 global interrupt (USART1_TX).
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+/**
+  * @brief This function handles DMA1 channel5 global interrupt, SPI2_TX or USART1_RX while console reception owns the channel.
+  */
+void DMA1_Channel5_IRQHandler(void)
+{
+  if (true == Console_IsRxDmaActive())
+  {
+    Console_cbRxDmaIRQ();
+  }
+  else
+  {
+    HAL_DMA_IRQHandler(&hdma_spi2_tx);
+  }
+}
+
+/**
+  * @brief This function handles TIM7 global interrupt.
+  */
+void TIM7_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim7);
+}
+
+/**
+  * @brief This function handles USART1 global interrupt, enabled only while console reception is captured, line idle.
+  */
+void USART1_IRQHandler(void)
+{
+  Console_cbUartIRQ();
+}
+
 /* USER CODE END 1 */
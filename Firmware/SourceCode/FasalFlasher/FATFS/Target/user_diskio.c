@@ -36,6 +36,7 @@
 #include <string.h>
 #include "ff_gen_drv.h"
 #include "user_diskio_spi.h"
+#include "AppTrace.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -118,7 +119,10 @@ DRESULT USER_read (
 )
 {
   /* USER CODE BEGIN READ */
-    return USER_SPI_read(pdrv, buff, sector, count);
+    AppTrace_Record(eAPPTRACE_EVENT_SD_READ, eAPPTRACE_PHASE_BEGIN, sector, count);
+    DRESULT res = USER_SPI_read(pdrv, buff, sector, count);
+    AppTrace_Record(eAPPTRACE_EVENT_SD_READ, eAPPTRACE_PHASE_END, sector, res);
+    return res;
   /* USER CODE END READ */
 }
 
@@ -27,6 +27,8 @@
 #include "stm32f1xx_hal.h" /* Provide the low-level HAL functions */
 #include "user_diskio_spi.h"
 #include "spi.h"
+#include "SpiLL.h"
+#include "AppTrace.h"
 
 //Make sure you set #define SD_SPI_HANDLE as some hspix in main.h
 //Make sure you set #define SD_CS_GPIO_Port as some GPIO port in main.h
@@ -39,10 +41,17 @@
 
 //(Note that the _256 is used as a mask to clear the prescalar bits as it provides binary 111 in the correct position)
 #define FCLK_SLOW() { MODIFY_REG(SD_SPI_HANDLE.Instance->CR1, SPI_BAUDRATEPRESCALER_256, SPI_BAUDRATEPRESCALER_128); }	/* Set SCLK = slow, approx 280 KBits/s*/
-#define FCLK_FAST() { MODIFY_REG(SD_SPI_HANDLE.Instance->CR1, SPI_BAUDRATEPRESCALER_256, SPI_BAUDRATEPRESCALER_8); }	/* Set SCLK = fast, approx 4.5 MBits/s */
+#define FCLK_FAST() { MODIFY_REG(SD_SPI_HANDLE.Instance->CR1, SPI_BAUDRATEPRESCALER_256, FclkTable[FclkIndex]); }	/* Set SCLK = tuned fast clock */
 
-#define CS_HIGH()	{HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_SET);}
-#define CS_LOW()	{HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_RESET);}
+#define SD_SPI_DMA_MIN_LEN		(16)	/* Shorter blocks are received with polled transfers */
+#define SD_SPI_DMA_TIMEOUT_MS	(50)
+
+#define SD_CRC16_POLY			(0x1021)	/* CRC16-CCITT protecting SD data blocks */
+#define SD_TUNE_READS			(8)		/* Blocks read at each clock step while tuning */
+#define SD_CRC_RETRIES			(3)		/* Re-reads of a block failing CRC, each one clock step slower */
+
+#define CS_HIGH()	{SpiLL_CsHigh(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin);}
+#define CS_LOW()	{SpiLL_Begin(SD_SPI_HANDLE.Instance); SpiLL_CsLow(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin);}
 
 /*--------------------------------------------------------------------------
 
@@ -71,6 +80,7 @@
 #define CMD38	(38)		/* ERASE */
 #define CMD55	(55)		/* APP_CMD */
 #define CMD58	(58)		/* READ_OCR */
+#define CMD59	(59)		/* CRC_ON_OFF */
 
 /* MMC card type flags (MMC_GET_TYPE) */
 #define CT_MMC		0x01		/* MMC ver 3 */
@@ -86,6 +96,25 @@ DSTATUS Stat = STA_NOINIT;	/* Physical drive status */
 static
 BYTE CardType;			/* Card type flags */
 
+static
+BYTE StreamOpen;		/* A READ_MULTIPLE_BLOCK is in progress, card stays selected between stream reads */
+
+static
+DWORD StreamSector;		/* LBA of the next block of the open stream */
+
+static
+BYTE CrcOn;				/* Card checks command CRC7 and data blocks carry a verified CRC16 */
+
+static
+BYTE CrcFailed;			/* Last data block failed its CRC16 check */
+
+/* Fast clock steps, slowest first. SPI1 runs from 72 MHz APB2, /4 = 18 MHz is the peripheral ceiling */
+static const
+uint32_t FclkTable[] = {SPI_BAUDRATEPRESCALER_32, SPI_BAUDRATEPRESCALER_16, SPI_BAUDRATEPRESCALER_8, SPI_BAUDRATEPRESCALER_4};
+
+static
+BYTE FclkIndex = 2;		/* Current fast clock step, 9 MHz until the card is tuned */
+
 uint32_t spiTimerTickStart;
 uint32_t spiTimerTickDelay;
 
@@ -102,46 +131,260 @@ uint8_t SPI_Timer_Status() {
 /* SPI controls (Platform dependent)                                     */
 /*-----------------------------------------------------------------------*/
 
-/* Exchange a byte */
-static
+/* Exchange a byte, polled on the registers since command bytes are too short for HAL or DMA overhead */
+static inline
 BYTE xchg_spi (
 	BYTE dat	/* Data to send */
 )
 {
-	BYTE rxDat;
-    HAL_SPI_TransmitReceive(&SD_SPI_HANDLE, &dat, &rxDat, 1, 50);
-    return rxDat;
+	return SpiLL_Transfer(SD_SPI_HANDLE.Instance, dat);
+}
+
+
+/* Move a block over DMA, a NULL side is replaced by a fixed 0xFF source or a discard sink */
+static
+int xfer_spi_dma (	/* 1:OK, 0:Timeout, -1:DMA not started, caller falls back to polled transfer */
+	const BYTE *txBuff,	/* Data to send, NULL to clock out 0xFF */
+	BYTE *rxBuff,		/* Data buffer, NULL to discard received data */
+	UINT len			/* Number of bytes */
+)
+{
+	static const BYTE dummyTx = 0xFF;
+	static BYTE dummyRx;
+	DMA_HandleTypeDef *hdmatx = SD_SPI_HANDLE.hdmatx;
+	DMA_HandleTypeDef *hdmarx = SD_SPI_HANDLE.hdmarx;
+	int res = -1;
+
+	if ((len < SD_SPI_DMA_MIN_LEN) || (NULL == hdmatx) || (NULL == hdmarx)) return -1;
+
+	/* Fixed side of the transfer does not increment its memory address */
+	__HAL_DMA_DISABLE(hdmatx);
+	__HAL_DMA_DISABLE(hdmarx);
+	if (NULL == txBuff) { txBuff = &dummyTx; CLEAR_BIT(hdmatx->Instance->CCR, DMA_CCR_MINC); }
+	if (NULL == rxBuff) { rxBuff = &dummyRx; CLEAR_BIT(hdmarx->Instance->CCR, DMA_CCR_MINC); }
+
+	if (HAL_OK == HAL_SPI_TransmitReceive_DMA(&SD_SPI_HANDLE, (uint8_t *)txBuff, rxBuff, len)) {
+		uint32_t tickStart = HAL_GetTick();
+		res = 1;
+		while (HAL_SPI_STATE_READY != HAL_SPI_GetState(&SD_SPI_HANDLE)) {
+			if ((HAL_GetTick() - tickStart) > SD_SPI_DMA_TIMEOUT_MS) {
+				HAL_SPI_Abort(&SD_SPI_HANDLE);
+				res = 0;
+				break;
+			}
+		}
+	}
+
+	__HAL_DMA_DISABLE(hdmatx);
+	__HAL_DMA_DISABLE(hdmarx);
+	SET_BIT(hdmatx->Instance->CCR, DMA_CCR_MINC);
+	SET_BIT(hdmarx->Instance->CCR, DMA_CCR_MINC);
+
+	return res;
 }
 
 
 /* Receive multiple byte */
 static
-void rcvr_spi_multi (
+int rcvr_spi_multi (	/* 1:OK, 0:Timeout */
 	BYTE *buff,		/* Pointer to data buffer */
 	UINT btr		/* Number of bytes to receive (even number) */
 )
 {
+	int res = xfer_spi_dma(NULL, buff, btr);
+	if (res >= 0) return res;
+
 	for(UINT i=0; i<btr; i++) {
 		*(buff+i) = xchg_spi(0xFF);
 	}
+	return 1;
 }
 
 
 #if _USE_WRITE
 /* Send multiple byte */
 static
-void xmit_spi_multi (
+int xmit_spi_multi (	/* 1:OK, 0:Timeout */
 	const BYTE *buff,	/* Pointer to the data */
 	UINT btx			/* Number of bytes to send (even number) */
 )
 {
+	int res = xfer_spi_dma(buff, NULL, btx);
+	if (res >= 0) return res;
+
 	for(UINT i=0; i<btx; i++) {
 		xchg_spi(*(buff+i));
 	}
+	return 1;
 }
 #endif
 
 
+/* The F1 SPI CRC is as wide as the frame, so CRC16 protected blocks are moved in 16 bit frames */
+static
+void crc16_frames_on (void)
+{
+	SPI_TypeDef *spi = SD_SPI_HANDLE.Instance;
+
+	while (spi->SR & SPI_SR_BSY) ;
+	CLEAR_BIT(spi->CR1, SPI_CR1_SPE);
+	CLEAR_BIT(spi->CR1, SPI_CR1_CRCEN);	/* Cycling CRCEN clears both CRC registers */
+	spi->CRCPR = SD_CRC16_POLY;
+	SET_BIT(spi->CR1, SPI_CR1_DFF | SPI_CR1_CRCEN);
+	SET_BIT(spi->CR1, SPI_CR1_SPE);
+}
+
+
+static
+void crc16_frames_off (void)
+{
+	SPI_TypeDef *spi = SD_SPI_HANDLE.Instance;
+
+	while (spi->SR & SPI_SR_BSY) ;
+	CLEAR_BIT(spi->CR1, SPI_CR1_SPE);
+	CLEAR_BIT(spi->CR1, SPI_CR1_DFF | SPI_CR1_CRCEN);
+	SET_BIT(spi->CR1, SPI_CR1_SPE);
+}
+
+
+/* Exchange a 16 bit frame, valid between crc16_frames_on() and crc16_frames_off() */
+static
+uint16_t xchg_spi16 (
+	uint16_t dat	/* Data to send */
+)
+{
+	SPI_TypeDef *spi = SD_SPI_HANDLE.Instance;
+
+	while (!(spi->SR & SPI_SR_TXE)) ;
+	spi->DR = dat;
+	while (!(spi->SR & SPI_SR_RXNE)) ;
+	return (uint16_t)spi->DR;
+}
+
+
+/* Receive a block and check its CRC16 in the SPI CRC unit */
+static
+int rcvr_spi_multi_crc (	/* 1:OK, 0:Timeout or CRC error */
+	BYTE *buff,		/* Pointer to data buffer */
+	UINT btr		/* Number of bytes to receive (even number) */
+)
+{
+	SPI_TypeDef *spi = SD_SPI_HANDLE.Instance;
+	DMA_HandleTypeDef *hdmarx = SD_SPI_HANDLE.hdmarx;
+	UINT frames = btr / 2;
+	int res = 1;
+
+	crc16_frames_on();
+
+	if ((NULL != hdmarx) && !((uint32_t)buff & 1)) {
+		/* Receive side on DMA so an interrupt cannot overrun it, transmit side
+		   is fed from here. Keeping TX off DMA stops the peripheral from
+		   clocking its own TX CRC onto MOSI, which the card may take for a
+		   command in the middle of a multiple block read. */
+		DMA_Channel_TypeDef *ch = hdmarx->Instance;
+		uint32_t ccr = ch->CCR;
+		uint32_t tickStart;
+
+		CLEAR_BIT(ch->CCR, DMA_CCR_EN);
+		hdmarx->DmaBaseAddress->IFCR = (DMA_ISR_GIF1 << hdmarx->ChannelIndex);
+		ch->CPAR = (uint32_t)&spi->DR;
+		ch->CMAR = (uint32_t)buff;
+		ch->CNDTR = frames;
+		ch->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_PL_1 | DMA_CCR_EN;
+		SET_BIT(spi->CR2, SPI_CR2_RXDMAEN);
+
+		for (UINT i = 0; i < frames; i++) {
+			while (!(spi->SR & SPI_SR_TXE)) ;
+			spi->DR = 0xFFFF;
+		}
+
+		tickStart = HAL_GetTick();
+		while (ch->CNDTR) {
+			if ((HAL_GetTick() - tickStart) > SD_SPI_DMA_TIMEOUT_MS) {
+				res = 0;
+				break;
+			}
+		}
+
+		CLEAR_BIT(spi->CR2, SPI_CR2_RXDMAEN);
+		ch->CCR = ccr & ~DMA_CCR_EN;
+		hdmarx->DmaBaseAddress->IFCR = (DMA_ISR_GIF1 << hdmarx->ChannelIndex);
+
+		/* Frames arrive first byte in the upper half */
+		uint16_t *p = (uint16_t *)buff;
+		for (UINT i = 0; i < frames; i++) {
+			p[i] = (uint16_t)((p[i] >> 8) | (p[i] << 8));
+		}
+	}
+	else {
+		for (UINT i = 0; i < btr; i += 2) {
+			uint16_t d = xchg_spi16(0xFFFF);
+			buff[i] = (BYTE)(d >> 8);
+			buff[i + 1] = (BYTE)d;
+		}
+	}
+
+	/* Folding the card's CRC into the running value leaves zero for an intact block */
+	xchg_spi16(0xFFFF);
+	if (spi->RXCRCR != 0) res = 0;
+
+	crc16_frames_off();
+
+	return res;
+}
+
+
+#if _USE_WRITE
+/* Send a block followed by the CRC16 computed in the SPI CRC unit */
+static
+int xmit_spi_multi_crc (	/* 1:OK */
+	const BYTE *buff,	/* Pointer to the data */
+	UINT btx			/* Number of bytes to send (even number) */
+)
+{
+	SPI_TypeDef *spi = SD_SPI_HANDLE.Instance;
+
+	crc16_frames_on();
+
+	for (UINT i = 0; i < btx; i += 2) {
+		while (!(spi->SR & SPI_SR_TXE)) ;
+		spi->DR = (uint16_t)((buff[i] << 8) | buff[i + 1]);
+	}
+	while (spi->SR & SPI_SR_BSY) ;
+	(void)spi->DR;		/* Received frames were not read, clear RXNE and OVR */
+	(void)spi->SR;
+
+	xchg_spi16((uint16_t)spi->TXCRCR);
+
+	crc16_frames_off();
+
+	return 1;
+}
+#endif
+
+
+/* CRC7 of a command packet, required for every command once CRC mode is on */
+static
+BYTE crc7 (
+	const BYTE *buff,	/* Command index and argument */
+	UINT len			/* Number of bytes */
+)
+{
+	BYTE crc = 0;
+
+	while (len--) {
+		BYTE d = *buff++;
+		for (BYTE n = 0; n < 8; n++) {
+			crc <<= 1;
+			if ((d ^ crc) & 0x80) crc ^= 0x09;
+			d <<= 1;
+		}
+	}
+	return crc & 0x7F;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Wait for card ready                                                   */
 /*-----------------------------------------------------------------------*/
@@ -213,6 +456,7 @@ int rcvr_datablock (	/* 1:OK, 0:Error */
 	BYTE token;
 
 
+	CrcFailed = 0;
 	SPI_Timer_On(200);
 	do {							/* Wait for DataStart token in timeout of 200ms */
 		token = xchg_spi(0xFF);
@@ -220,7 +464,15 @@ int rcvr_datablock (	/* 1:OK, 0:Error */
 	} while ((token == 0xFF) && SPI_Timer_Status());
 	if(token != 0xFE) return 0;		/* Function fails if invalid DataStart token or timeout */
 
-	rcvr_spi_multi(buff, btr);		/* Store trailing data to the buffer */
+	if (CrcOn && (btr == 512)) {		/* Sector data is checked, partial reads of registers are not */
+		if (!rcvr_spi_multi_crc(buff, btr)) {
+			CrcFailed = 1;
+			return 0;
+		}
+		return 1;
+	}
+
+	if (!rcvr_spi_multi(buff, btr)) return 0;	/* Store trailing data to the buffer */
 	xchg_spi(0xFF); xchg_spi(0xFF);			/* Discard CRC */
 
 	return 1;						/* Function succeeded */
@@ -246,8 +498,12 @@ int xmit_datablock (	/* 1:OK, 0:Failed */
 
 	xchg_spi(token);					/* Send token */
 	if (token != 0xFD) {				/* Send data if token is other than StopTran */
-		xmit_spi_multi(buff, 512);		/* Data */
-		xchg_spi(0xFF); xchg_spi(0xFF);	/* Dummy CRC */
+		if (CrcOn) {
+			xmit_spi_multi_crc(buff, 512);	/* Data + CRC */
+		} else {
+			if (!xmit_spi_multi(buff, 512)) return 0;	/* Data */
+			xchg_spi(0xFF); xchg_spi(0xFF);	/* Dummy CRC */
+		}
 
 		resp = xchg_spi(0xFF);				/* Receive data resp */
 		if ((resp & 0x1F) != 0x05) return 0;	/* Function fails if the data packet was not accepted */
@@ -283,15 +539,14 @@ BYTE send_cmd (		/* Return value: R1 resp (bit7==1:Failed to send) */
 	}
 
 	/* Send command packet */
-	xchg_spi(0x40 | cmd);				/* Start + command index */
-	xchg_spi((BYTE)(arg >> 24));		/* Argument[31..24] */
-	xchg_spi((BYTE)(arg >> 16));		/* Argument[23..16] */
-	xchg_spi((BYTE)(arg >> 8));			/* Argument[15..8] */
-	xchg_spi((BYTE)arg);				/* Argument[7..0] */
-	n = 0x01;							/* Dummy CRC + Stop */
-	if (cmd == CMD0) n = 0x95;			/* Valid CRC for CMD0(0) */
-	if (cmd == CMD8) n = 0x87;			/* Valid CRC for CMD8(0x1AA) */
-	xchg_spi(n);
+	BYTE pkt[6];
+	pkt[0] = 0x40 | cmd;				/* Start + command index */
+	pkt[1] = (BYTE)(arg >> 24);			/* Argument[31..24] */
+	pkt[2] = (BYTE)(arg >> 16);			/* Argument[23..16] */
+	pkt[3] = (BYTE)(arg >> 8);			/* Argument[15..8] */
+	pkt[4] = (BYTE)arg;					/* Argument[7..0] */
+	pkt[5] = (BYTE)((crc7(pkt, 5) << 1) | 0x01);	/* CRC + Stop */
+	SpiLL_Write(SD_SPI_HANDLE.Instance, pkt, sizeof(pkt));
 
 	/* Receive command resp */
 	if (cmd == CMD12) xchg_spi(0xFF);	/* Diacard following one byte when CMD12 */
@@ -304,6 +559,63 @@ BYTE send_cmd (		/* Return value: R1 resp (bit7==1:Failed to send) */
 }
 
 
+
+/*-----------------------------------------------------------------------*/
+/* Terminate an open ended multiple block read                           */
+/*-----------------------------------------------------------------------*/
+
+static
+void stop_stream (void)
+{
+	if (StreamOpen) {
+		send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+		despiselect();
+		StreamOpen = 0;
+	}
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Fast clock tuning                                                     */
+/*-----------------------------------------------------------------------*/
+
+/* Drop one clock step after a CRC failure */
+static
+void fclk_slower (void)
+{
+	if (FclkIndex) FclkIndex--;
+	FCLK_FAST();
+}
+
+
+/* Step the clock up while blocks read back with a valid CRC and settle on the last clean step */
+static
+void tune_fclk (void)
+{
+	BYTE buf[512];
+	BYTE step, n;
+
+	if (!CrcOn) {			/* Errors cannot be seen without CRC, run at the default step */
+		FCLK_FAST();
+		return;
+	}
+
+	for (step = 0; step < sizeof(FclkTable) / sizeof(FclkTable[0]); step++) {
+		FclkIndex = step;
+		FCLK_FAST();
+		for (n = SD_TUNE_READS; n; n--) {
+			if ((send_cmd(CMD17, 0) != 0) || !rcvr_datablock(buf, 512)) break;
+		}
+		despiselect();
+		if (n) break;		/* Errors at this step */
+	}
+
+	FclkIndex = step ? (step - 1) : 0;
+	FCLK_FAST();
+}
+
+
 /*--------------------------------------------------------------------------
 
    Public FatFs Functions (wrapped in user_diskio.c)
@@ -332,6 +644,8 @@ inline DSTATUS USER_SPI_initialize (
 
 	if (Stat & STA_NODISK) return Stat;	/* Is card existing in the soket? */
 
+	stop_stream();
+	CrcOn = 0;
 	FCLK_SLOW();
 	for (n = 10; n; n--) xchg_spi(0xFF);	/* Send 80 dummy clocks */
 
@@ -362,7 +676,9 @@ inline DSTATUS USER_SPI_initialize (
 	despiselect();
 
 	if (ty) {			/* OK */
-		FCLK_FAST();			/* Set fast clock */
+		CrcOn = (send_cmd(CMD59, 1) == 0);	/* CRC_ON_OFF, commands and data blocks are CRC checked from here on */
+		despiselect();
+		tune_fclk();			/* Set fastest clock the card reads cleanly at */
 		Stat &= ~STA_NOINIT;	/* Clear STA_NOINIT flag */
 	} else {			/* Failed */
 		Stat = STA_NOINIT;
@@ -402,30 +718,114 @@ inline DRESULT USER_SPI_read (
 	if (drv || !count) return RES_PARERR;		/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
 
-	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ot BA conversion (byte addressing cards) */
+	stop_stream();								/* Card must leave a streaming read before taking new commands */
 
-	if (count == 1) {	/* Single sector read */
-		if ((send_cmd(CMD17, sector) == 0)	/* READ_SINGLE_BLOCK */
-			&& rcvr_datablock(buff, 512)) {
-			count = 0;
+	for (BYTE retry = SD_CRC_RETRIES; ; retry--) {
+		DWORD addr = (CardType & CT_BLOCK) ? sector : sector * 512;	/* LBA ot BA conversion (byte addressing cards) */
+
+		if (count == 1) {	/* Single sector read */
+			if ((send_cmd(CMD17, addr) == 0)	/* READ_SINGLE_BLOCK */
+				&& rcvr_datablock(buff, 512)) {
+				count = 0;
+			}
 		}
-	}
-	else {				/* Multiple sector read */
-		if (send_cmd(CMD18, sector) == 0) {	/* READ_MULTIPLE_BLOCK */
-			do {
-				if (!rcvr_datablock(buff, 512)) break;
-				buff += 512;
-			} while (--count);
-			send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+		else {				/* Multiple sector read */
+			if (send_cmd(CMD18, addr) == 0) {	/* READ_MULTIPLE_BLOCK */
+				do {
+					if (!rcvr_datablock(buff, 512)) break;
+					buff += 512;
+					sector++;
+				} while (--count);
+				send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+			}
 		}
+		despiselect();
+
+		if (!count || !CrcFailed || !retry) break;
+		fclk_slower();		/* Re-read from the failed block one clock step lower */
 	}
-	despiselect();
 
 	return count ? RES_ERROR : RES_OK;	/* Return result */
 }
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Streaming read of a contiguous sector run                             */
+/*-----------------------------------------------------------------------*/
+
+//A single READ_MULTIPLE_BLOCK is left open across calls so a file laid out in
+//one run is read with one command instead of one CMD18/CMD12 pair per cluster.
+//Any other disk access closes the stream first.
+
+DRESULT USER_SPI_read_stream_open (
+	BYTE drv,		/* Physical drive number (0) */
+	DWORD sector	/* Start sector number (LBA) of the run */
+)
+{
+	if (drv) return RES_PARERR;					/* Check parameter */
+	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
+
+	stop_stream();
+
+	StreamSector = sector;
+	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ot BA conversion (byte addressing cards) */
+
+	if (send_cmd(CMD18, sector) != 0) {			/* READ_MULTIPLE_BLOCK, no block count so it runs until CMD12 */
+		despiselect();
+		return RES_ERROR;
+	}
+	StreamOpen = 1;
+
+	return RES_OK;
+}
+
+
+DRESULT USER_SPI_read_stream (
+	BYTE drv,		/* Physical drive number (0) */
+	BYTE *buff,		/* Pointer to the data buffer to store read data */
+	UINT count		/* Number of sectors to read from the open stream */
+)
+{
+	if (drv || !count) return RES_PARERR;		/* Check parameter */
+	if (!StreamOpen) return RES_NOTRDY;			/* Check if a stream is open */
+
+	AppTrace_Record(eAPPTRACE_EVENT_SD_READ, eAPPTRACE_PHASE_BEGIN, StreamSector, count);
+
+	DRESULT res = RES_OK;
+	BYTE retry = SD_CRC_RETRIES;
+	while (count) {
+		if (!rcvr_datablock(buff, 512)) {
+			stop_stream();
+			if (!CrcFailed || !retry--) { res = RES_ERROR; break; }
+			fclk_slower();						/* Restart the stream at the failed block one clock step lower */
+			if (USER_SPI_read_stream_open(drv, StreamSector) != RES_OK) { res = RES_ERROR; break; }
+			continue;
+		}
+		buff += 512;
+		StreamSector++;
+		count--;
+	}
+
+	AppTrace_Record(eAPPTRACE_EVENT_SD_READ, eAPPTRACE_PHASE_END, StreamSector, res);
+
+	return res;
+}
+
+
+DRESULT USER_SPI_read_stream_close (
+	BYTE drv		/* Physical drive number (0) */
+)
+{
+	if (drv) return RES_PARERR;					/* Check parameter */
+
+	stop_stream();
+
+	return RES_OK;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Write sector(s)                                                       */
 /*-----------------------------------------------------------------------*/
@@ -442,6 +842,8 @@ inline DRESULT USER_SPI_write (
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check drive status */
 	if (Stat & STA_PROTECT) return RES_WRPRT;	/* Check write protect */
 
+	stop_stream();
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ==> BA conversion (byte addressing cards) */
 
 	if (count == 1) {	/* Single sector write */
@@ -486,6 +888,8 @@ inline DRESULT USER_SPI_ioctl (
 	if (drv) return RES_PARERR;					/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
 
+	stop_stream();
+
 	res = RES_ERROR;
 
 	switch (cmd) {
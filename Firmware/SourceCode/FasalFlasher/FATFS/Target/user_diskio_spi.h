@@ -28,6 +28,9 @@
 extern DSTATUS USER_SPI_initialize (BYTE pdrv);
 extern DSTATUS USER_SPI_status (BYTE pdrv);
 extern DRESULT USER_SPI_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+DRESULT USER_SPI_read_stream_open (BYTE pdrv, DWORD sector);
+DRESULT USER_SPI_read_stream (BYTE pdrv, BYTE *buff, UINT count);
+DRESULT USER_SPI_read_stream_close (BYTE pdrv);
 #if _USE_WRITE == 1
   extern DRESULT USER_SPI_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
 #endif /* _USE_WRITE == 1 */
@@ -0,0 +1,61 @@
+/**
+ * @file SpiLL.h
+ * @author Vishal Keshava Murthy
+ * @brief Host build of the register level SPI transport. Register accesses
+ * cannot reach a device model, so the same calls go through the simulated bus,
+ * which charges each byte its time on the wire at the configured SPI clock.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPCOMMON_APPUTILITY_SPILL_H_
+#define APPCOMMON_APPUTILITY_SPILL_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint8_t HostHal_SpiExchange(SPI_TypeDef* const pSpi, uint8_t Data);
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline void SpiLL_CsLow(GPIO_TypeDef* const pPort, uint16_t Pin)
+{
+	HAL_GPIO_WritePin(pPort, Pin, GPIO_PIN_RESET);
+}
+
+static inline void SpiLL_CsHigh(GPIO_TypeDef* const pPort, uint16_t Pin)
+{
+	HAL_GPIO_WritePin(pPort, Pin, GPIO_PIN_SET);
+}
+
+static inline void SpiLL_Begin(SPI_TypeDef* const pSpi)
+{
+	pSpi->CR1 |= SPI_CR1_SPE;
+}
+
+static inline uint8_t SpiLL_Transfer(SPI_TypeDef* const pSpi, uint8_t Data)
+{
+	return HostHal_SpiExchange(pSpi, Data);
+}
+
+static inline void SpiLL_Write(SPI_TypeDef* const pSpi, const uint8_t* pData, uint32_t Length)
+{
+	while(Length > 0)
+	{
+		(void)HostHal_SpiExchange(pSpi, *pData++);
+		Length--;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* APPCOMMON_APPUTILITY_SPILL_H_ */
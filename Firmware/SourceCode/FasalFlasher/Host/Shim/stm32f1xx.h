@@ -0,0 +1,69 @@
+/**
+ * @file stm32f1xx.h
+ * @author Vishal Keshava Murthy
+ * @brief Host build wrapper of the CMSIS device header. Register layouts and
+ * bit definitions are the real ones, only the places they live move: peripheral
+ * registers go to a block of host memory, so code poking registers directly
+ * still builds and runs, and core registers the firmware reads for timing are
+ * routed to the virtual clock.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SHIM_STM32F1XX_H_
+#define HOST_SHIM_STM32F1XX_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include_next "stm32f1xx.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOST_PERIPHERAL_SPACE_SIZE	(0x24000u)	/**< APB1, APB2 and AHB up to the CRC unit */
+
+extern uint8_t gHostPeripheralSpace[HOST_PERIPHERAL_SPACE_SIZE];
+extern CoreDebug_Type gHostCoreDebug;
+
+DWT_Type* HostClock_GetDwt(void);
+void HostClock_SetIrqMask(bool IsMasked);
+uint32_t HostClock_GetIrqMask(void);
+uint32_t HostClock_GetIpsr(void);
+void HostClock_WaitForInterrupt(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Every peripheral base is derived from PERIPH_BASE when it is used, so this
+ * moves all of them. The build is not position independent, which keeps these
+ * addresses in 32 bits for code storing them in DMA address registers. */
+#undef PERIPH_BASE
+#define PERIPH_BASE				((uintptr_t)gHostPeripheralSpace)
+
+#undef DWT
+#define DWT						(HostClock_GetDwt())
+
+#undef CoreDebug
+#define CoreDebug				(&gHostCoreDebug)
+
+/* PRIMASK gates dispatch of simulated interrupts */
+#define __disable_irq()			HostClock_SetIrqMask(true)
+#define __enable_irq()			HostClock_SetIrqMask(false)
+#undef __get_PRIMASK
+#define __get_PRIMASK()			HostClock_GetIrqMask()
+#undef __get_IPSR
+#define __get_IPSR()			HostClock_GetIpsr()
+
+/* Sleeping lets time run to the next interrupt */
+#undef __WFI
+#define __WFI()					HostClock_WaitForInterrupt()
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* HOST_SHIM_STM32F1XX_H_ */
@@ -0,0 +1,400 @@
+/**
+ * @file HostClock.c
+ * @author Vishal Keshava Murthy
+ * @brief Virtual time base of the host simulation
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "HostClock.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sHostClock_t gHostClock;
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get clock instance
+ *
+ * @return sHostClock_t*
+ */
+static sHostClock_t* HostClock_GetInstance()
+{
+	return &gHostClock;
+}
+
+/**
+ * @brief Monotonic wall clock
+ *
+ * @return uint64_t nanoseconds
+ */
+static uint64_t HostClock_GetWallNs()
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+
+	return ((uint64_t)Now.tv_sec * 1000000000u) + (uint64_t)Now.tv_nsec;
+}
+
+/**
+ * @brief Check whether an event may run now
+ *
+ * @param pMe clock instance
+ * @param pEvent event
+ * @return true if its interrupt is enabled and not masked
+ */
+static bool HostClock_IsDispatchable(const sHostClock_t* const pMe, const sHostClockEvent_t* const pEvent)
+{
+	if(HOSTCLOCK_NO_IRQ == pEvent->Irq)
+	{
+		return true;
+	}
+
+	if((true == pMe->IsInHandler) || (true == pMe->IsIrqMasked) || (pEvent->Irq < 0) || (pEvent->Irq >= HOSTCLOCK_IRQ_MAX))
+	{
+		return false;
+	}
+
+	return pMe->IsIrqEnabled[pEvent->Irq];
+}
+
+/**
+ * @brief Find the earliest event due by a time
+ *
+ * @param pMe clock instance
+ * @param LimitNs latest due time considered
+ * @return sHostClockEvent_t* NULL if none is due
+ */
+static sHostClockEvent_t* HostClock_GetNextDue(sHostClock_t* const pMe, uint64_t LimitNs)
+{
+	sHostClockEvent_t* pNext = NULL;
+
+	for(uint32_t i = 0; i < eHOSTCLOCK_EVENT_MAX; i++)
+	{
+		sHostClockEvent_t* pEvent = &pMe->Events[i];
+
+		if((true == pEvent->IsArmed) && (pEvent->DueNs <= LimitNs) && (true == HostClock_IsDispatchable(pMe, pEvent)) &&
+				((NULL == pNext) || (pEvent->DueNs < pNext->DueNs)))
+		{
+			pNext = pEvent;
+		}
+	}
+
+	return pNext;
+}
+
+/**
+ * @brief Run every event due by a time, in order. Handlers run one at a time,
+ * time they take moves the clock but interrupts falling due meanwhile wait for
+ * the handler to return, as a pending interrupt waits for the running one.
+ * Device model events still run, so a handler polling a flag sees it change.
+ *
+ * @param pMe clock instance
+ * @param LimitNs latest due time considered
+ */
+static void HostClock_Dispatch(sHostClock_t* const pMe, uint64_t LimitNs)
+{
+	if(true == pMe->IsInModelEvent)
+	{
+		return;
+	}
+
+	sHostClockEvent_t* pEvent = HostClock_GetNextDue(pMe, LimitNs);
+
+	while(NULL != pEvent)
+	{
+		if(pEvent->DueNs > pMe->NowNs)
+		{
+			pMe->NowNs = pEvent->DueNs;
+		}
+
+		pEvent->IsArmed = false;
+
+		if(HOSTCLOCK_NO_IRQ == pEvent->Irq)
+		{
+			pMe->IsInModelEvent = true;
+			pEvent->pfHandler();
+			pMe->IsInModelEvent = false;
+		}
+		else
+		{
+			pMe->IsInHandler = true;
+			pMe->ActiveIrq = pEvent->Irq;
+			pEvent->pfHandler();
+			pMe->IsInHandler = false;
+		}
+
+		if(LimitNs < pMe->NowNs)
+		{
+			LimitNs = pMe->NowNs;
+		}
+
+		pEvent = HostClock_GetNextDue(pMe, LimitNs);
+	}
+}
+
+/**
+ * @brief Hold virtual time back to wall clock, so firmware timeouts run at the
+ * speed the user on the console sees them
+ *
+ * @param pMe clock instance
+ */
+static void HostClock_Pace(sHostClock_t* const pMe)
+{
+	if((false == pMe->IsRealTime) || (pMe->NowNs < pMe->NextPaceNs))
+	{
+		return;
+	}
+
+	pMe->NextPaceNs = pMe->NowNs + HOSTCLOCK_PACE_STEP_NS;
+
+	uint64_t WallNs = HostClock_GetWallNs() - pMe->WallStartNs;
+
+	if(pMe->NowNs > WallNs)
+	{
+		uint64_t AheadNs = pMe->NowNs - WallNs;
+		struct timespec Sleep = {.tv_sec = (time_t)(AheadNs / 1000000000u), .tv_nsec = (long)(AheadNs % 1000000000u)};
+
+		nanosleep(&Sleep, NULL);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Reset clock to zero with no events and every interrupt disabled
+ *
+ * @param IsRealTime true to hold virtual time back to wall clock
+ */
+void HostClock_Init(bool IsRealTime)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+
+	memset(pMe, 0, sizeof(*pMe));
+	pMe->IsRealTime = IsRealTime;
+	pMe->WallStartNs = HostClock_GetWallNs();
+}
+
+/**
+ * @brief Get virtual time
+ *
+ * @return uint64_t nanoseconds since start
+ */
+uint64_t HostClock_GetNs(void)
+{
+	return HostClock_GetInstance()->NowNs;
+}
+
+/**
+ * @brief Let time pass, running every event that falls due
+ *
+ * @param Ns time to pass
+ */
+void HostClock_Advance(uint64_t Ns)
+{
+	HostClock_AdvanceTo(HostClock_GetInstance()->NowNs + Ns);
+}
+
+/**
+ * @brief Let time pass up to an absolute time, nothing happens if it is already past
+ *
+ * @param DueNs time to reach
+ */
+void HostClock_AdvanceTo(uint64_t DueNs)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+
+	HostClock_Dispatch(pMe, DueNs);
+
+	if(pMe->NowNs < DueNs)
+	{
+		pMe->NowNs = DueNs;
+	}
+
+	HostClock_Pace(pMe);
+}
+
+/**
+ * @brief Core sleeps until an interrupt, time runs to the earliest event that
+ * can be taken. With none pending it costs a polling loop iteration, as a
+ * tick interrupt would have woken it.
+ *
+ */
+void HostClock_WaitForInterrupt(void)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+	sHostClockEvent_t* pNext = HostClock_GetNextDue(pMe, UINT64_MAX);
+
+	if((NULL != pNext) && (false == pMe->IsInHandler))
+	{
+		HostClock_AdvanceTo(pNext->DueNs);
+	}
+	else
+	{
+		HostClock_Poll();
+	}
+}
+
+/**
+ * @brief Firmware polled the time, charge it one polling loop iteration and pick up external input
+ *
+ */
+void HostClock_Poll(void)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+
+	if((NULL != pMe->pfPollHook) && (false == pMe->IsInHandler))
+	{
+		pMe->pfPollHook();
+	}
+
+	HostClock_Advance(HOSTCLOCK_POLL_QUANTUM_NS);
+}
+
+/**
+ * @brief Register hook run on every tick poll
+ *
+ * @param pfHook hook, NULL to remove
+ */
+void HostClock_SetPollHook(pfHostClockHandler_t pfHook)
+{
+	HostClock_GetInstance()->pfPollHook = pfHook;
+}
+
+/**
+ * @brief Arm an event. An event already armed keeps the earlier of both due times.
+ *
+ * @param Event event slot
+ * @param DueNs absolute time it falls due
+ * @param Irq interrupt gating the dispatch, @ref HOSTCLOCK_NO_IRQ if none
+ * @param pfHandler runs when due
+ */
+void HostClock_Schedule(eHostClockEvent_t Event, uint64_t DueNs, IRQn_Type Irq, pfHostClockHandler_t pfHandler)
+{
+	assert(Event < eHOSTCLOCK_EVENT_MAX);
+	assert(NULL != pfHandler);
+
+	sHostClockEvent_t* pEvent = &HostClock_GetInstance()->Events[Event];
+
+	if((false == pEvent->IsArmed) || (DueNs < pEvent->DueNs))
+	{
+		pEvent->DueNs = DueNs;
+	}
+
+	pEvent->Irq = Irq;
+	pEvent->pfHandler = pfHandler;
+	pEvent->IsArmed = true;
+}
+
+/**
+ * @brief Disarm an event
+ *
+ * @param Event event slot
+ */
+void HostClock_Cancel(eHostClockEvent_t Event)
+{
+	assert(Event < eHOSTCLOCK_EVENT_MAX);
+
+	HostClock_GetInstance()->Events[Event].IsArmed = false;
+}
+
+/**
+ * @brief Check whether an event is armed
+ *
+ * @param Event event slot
+ * @return true if armed
+ */
+bool HostClock_IsScheduled(eHostClockEvent_t Event)
+{
+	assert(Event < eHOSTCLOCK_EVENT_MAX);
+
+	return HostClock_GetInstance()->Events[Event].IsArmed;
+}
+
+/**
+ * @brief NVIC enable / disable, an enabled interrupt that is already pending runs right away
+ *
+ * @param Irq interrupt
+ * @param IsEnabled true to enable
+ */
+void HostClock_SetIrqEnable(IRQn_Type Irq, bool IsEnabled)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+
+	if((Irq >= 0) && (Irq < HOSTCLOCK_IRQ_MAX))
+	{
+		pMe->IsIrqEnabled[Irq] = IsEnabled;
+		HostClock_Dispatch(pMe, pMe->NowNs);
+	}
+}
+
+/**
+ * @brief PRIMASK, interrupts pending while masked run once unmasked
+ *
+ * @param IsMasked true to mask every interrupt
+ */
+void HostClock_SetIrqMask(bool IsMasked)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+
+	pMe->IsIrqMasked = IsMasked;
+	HostClock_Dispatch(pMe, pMe->NowNs);
+}
+
+/**
+ * @brief PRIMASK as __get_PRIMASK reads it
+ *
+ * @return uint32_t 1 when interrupts are masked
+ */
+uint32_t HostClock_GetIrqMask(void)
+{
+	return (true == HostClock_GetInstance()->IsIrqMasked)? 1u: 0u;
+}
+
+/**
+ * @brief IPSR as __get_IPSR reads it
+ *
+ * @return uint32_t exception number of the interrupt being handled, 0 in thread mode
+ */
+uint32_t HostClock_GetIpsr(void)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+
+	/* External interrupts start at exception number 16 */
+	return (true == pMe->IsInHandler)? (uint32_t)((int32_t)pMe->ActiveIrq + 16): 0u;
+}
+
+/**
+ * @brief DWT with its cycle counter brought up to virtual time, the shim
+ * routes every DWT access here so CYCCNT reads as on target
+ *
+ * @return DWT_Type*
+ */
+DWT_Type* HostClock_GetDwt(void)
+{
+	sHostClock_t* pMe = HostClock_GetInstance();
+	uint64_t Cycles = (pMe->NowNs * (HOSTCLOCK_SYSCLK_HZ / 1000000u)) / 1000u;
+
+	if(0 != (pMe->Dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk))
+	{
+		pMe->Dwt.CYCCNT += (uint32_t)(Cycles - pMe->DwtLastCycles);
+	}
+
+	pMe->DwtLastCycles = Cycles;
+
+	return &pMe->Dwt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,112 @@
+/**
+ * @file HostClock.h
+ * @author Vishal Keshava Murthy
+ * @brief Virtual time base of the host simulation. Time only moves when the
+ * firmware does something that takes time on target (a byte on a bus, a delay,
+ * a poll of the tick) and interrupts are dispatched as it crosses their due time,
+ * so runs are deterministic and independent of the speed of the host.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SIM_HOSTCLOCK_H_
+#define HOST_SIM_HOSTCLOCK_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f1xx_hal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTCLOCK_SYSCLK_HZ			(72000000u)		/**< HSE 8 MHz x PLL 9, as set by SystemClock_Config */
+#define HOSTCLOCK_PCLK1_HZ			(36000000u)
+#define HOSTCLOCK_PCLK2_HZ			(72000000u)
+#define HOSTCLOCK_TIMCLK1_HZ		(72000000u)		/**< APB1 timers run at twice PCLK1 while APB1 is divided */
+#define HOSTCLOCK_POLL_QUANTUM_NS	(1000u)			/**< Time charged to a poll of the tick, about one polling loop iteration on target */
+#define HOSTCLOCK_PACE_STEP_NS		(1000000u)		/**< Real time pacing is checked once per this much virtual time */
+#define HOSTCLOCK_IRQ_MAX			(64)			/**< Covers every STM32F103xE peripheral interrupt */
+#define HOSTCLOCK_NO_IRQ			((IRQn_Type)-128)	/**< Event that is not an interrupt, dispatched even while interrupts are masked */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Time driven events, one slot each like NVIC pending bits
+ *
+ */
+typedef enum
+{
+	eHOSTCLOCK_EVENT_TIM6,			/**< Soft-timer period */
+	eHOSTCLOCK_EVENT_TIM7,			/**< W25Qxx busy poll period */
+	eHOSTCLOCK_EVENT_DMA1_CH2,		/**< SPI1 RX DMA done, SD card block */
+	eHOSTCLOCK_EVENT_DMA1_CH4,		/**< Console transmit DMA done */
+	eHOSTCLOCK_EVENT_DMA1_CH5,		/**< SPI2 TX DMA done, or console receive ring half / full */
+	eHOSTCLOCK_EVENT_USART1,		/**< Console byte received or line idle */
+	eHOSTCLOCK_EVENT_UART_WIRE,		/**< Next byte from the host lands in the console receiver */
+	eHOSTCLOCK_EVENT_UART_IDLE,		/**< Console receive line stayed quiet for a frame time */
+	eHOSTCLOCK_EVENT_MAX
+}eHostClockEvent_t;
+
+typedef void (*pfHostClockHandler_t)(void);
+
+/**
+ * @brief Scheduled event
+ *
+ */
+typedef struct
+{
+	uint64_t DueNs;
+	IRQn_Type Irq;						/**< Interrupt gating the dispatch, @ref HOSTCLOCK_NO_IRQ if none */
+	pfHostClockHandler_t pfHandler;
+	bool IsArmed;
+}sHostClockEvent_t;
+
+/**
+ * @brief Virtual clock
+ *
+ */
+typedef struct
+{
+	uint64_t NowNs;
+	sHostClockEvent_t Events[eHOSTCLOCK_EVENT_MAX];
+	bool IsIrqEnabled[HOSTCLOCK_IRQ_MAX];
+	bool IsIrqMasked;					/**< PRIMASK */
+	bool IsInHandler;					/**< Handlers do not preempt each other, all firmware interrupts share a priority in practice */
+	IRQn_Type ActiveIrq;				/**< Interrupt being handled while IsInHandler is set */
+	bool IsInModelEvent;				/**< Device model events run inside handlers, as hardware carries on meanwhile, but not inside each other */
+	bool IsRealTime;					/**< Virtual time is held back to wall clock, for an interactive console */
+	uint64_t WallStartNs;
+	uint64_t NextPaceNs;
+	pfHostClockHandler_t pfPollHook;	/**< Runs on every tick poll, used to pick up console input */
+	DWT_Type Dwt;
+	uint64_t DwtLastCycles;
+}sHostClock_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void HostClock_Init(bool IsRealTime);
+uint64_t HostClock_GetNs(void);
+void HostClock_Advance(uint64_t Ns);
+void HostClock_AdvanceTo(uint64_t DueNs);
+void HostClock_Poll(void);
+void HostClock_WaitForInterrupt(void);
+void HostClock_SetPollHook(pfHostClockHandler_t pfHook);
+void HostClock_Schedule(eHostClockEvent_t Event, uint64_t DueNs, IRQn_Type Irq, pfHostClockHandler_t pfHandler);
+void HostClock_Cancel(eHostClockEvent_t Event);
+bool HostClock_IsScheduled(eHostClockEvent_t Event);
+void HostClock_SetIrqEnable(IRQn_Type Irq, bool IsEnabled);
+void HostClock_SetIrqMask(bool IsMasked);
+uint32_t HostClock_GetIrqMask(void);
+uint32_t HostClock_GetIpsr(void);
+DWT_Type* HostClock_GetDwt(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* HOST_SIM_HOSTCLOCK_H_ */
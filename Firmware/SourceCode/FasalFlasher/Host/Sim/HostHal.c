@@ -0,0 +1,975 @@
+/**
+ * @file HostHal.c
+ * @author Vishal Keshava Murthy
+ * @brief HAL of the host simulation. Peripheral registers live in host memory
+ * (see Shim/stm32f1xx.h), the calls below give them the behaviour the firmware
+ * relies on, on top of the virtual clock. CubeMX initialisation mirrors
+ * Core/Src, interrupt handlers mirror stm32f1xx_it.c.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "crc.h"
+#include "gpio.h"
+#include "spi.h"
+#include "tim.h"
+#include "usart.h"
+#include "fatfs.h"
+
+#include "Console.h"
+
+#include "HostHal.h"
+#include "HostClock.h"
+#include "HostSdCard.h"
+#include "HostUart.h"
+#include "HostW25q.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint8_t gHostPeripheralSpace[HOST_PERIPHERAL_SPACE_SIZE] __attribute__((aligned(0x400)));
+CoreDebug_Type gHostCoreDebug;
+
+uint32_t SystemCoreClock = HOSTCLOCK_SYSCLK_HZ;
+
+CRC_HandleTypeDef hcrc;
+SPI_HandleTypeDef hspi1;
+SPI_HandleTypeDef hspi2;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
+DMA_HandleTypeDef hdma_spi2_tx;
+DMA_HandleTypeDef hdma_usart1_tx;
+TIM_HandleTypeDef htim6;
+TIM_HandleTypeDef htim7;
+UART_HandleTypeDef huart1;
+UART_HandleTypeDef huart2;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sHostHalBusStatistics_t gHostHalBusStatistics[eHOSTHAL_BUS_MAX];
+
+static const char* const gcHostHalBusNames[eHOSTHAL_BUS_MAX] =
+{
+		[eHOSTHAL_BUS_SD]		= "SPI1 (SD)",
+		[eHOSTHAL_BUS_FLASH]	= "SPI2 (flash)",
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void HostHal_cbTim6(void);
+static void HostHal_cbTim7(void);
+static void HostHal_Dma1Channel2IRQHandler(void);
+static void HostHal_Dma1Channel4IRQHandler(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Bus a SPI peripheral drives
+ *
+ * @param pSpi SPI instance
+ * @return eHostHalBus_t
+ */
+static eHostHalBus_t HostHal_GetBus(const SPI_TypeDef* const pSpi)
+{
+	return (SPI1 == pSpi)? eHOSTHAL_BUS_SD: eHOSTHAL_BUS_FLASH;
+}
+
+/**
+ * @brief Time to shift a byte at the clock set in CR1, SPI1 runs from APB2 and SPI2 from APB1
+ *
+ * @param pSpi SPI instance
+ * @return uint64_t nanoseconds
+ */
+static uint64_t HostHal_GetSpiByteNs(const SPI_TypeDef* const pSpi)
+{
+	uint32_t BusClock = (SPI1 == pSpi)? HOSTCLOCK_PCLK2_HZ: HOSTCLOCK_PCLK1_HZ;
+	uint32_t Divider = 2u << ((pSpi->CR1 & SPI_CR1_BR_Msk) >> SPI_CR1_BR_Pos);
+
+	return ((uint64_t)8u * Divider * 1000000000u) / BusClock;
+}
+
+/**
+ * @brief Clock a byte through the device on a bus
+ *
+ * @param Bus bus
+ * @param Data byte on MOSI
+ * @param Ns time the byte completes
+ * @return uint8_t byte on MISO
+ */
+static uint8_t HostHal_SpiClock(eHostHalBus_t Bus, uint8_t Data, uint64_t Ns)
+{
+	gHostHalBusStatistics[Bus].Bytes++;
+
+	return (eHOSTHAL_BUS_SD == Bus)? HostSdCard_Exchange(Data, Ns): HostW25q_Exchange(Data, Ns);
+}
+
+/**
+ * @brief Blocking transfer, the caller spends the time of every byte
+ *
+ * @param hspi SPI handle
+ * @param pTxData bytes to send, NULL to send 0xFF
+ * @param pRxData received bytes, NULL to drop them
+ * @param Size number of bytes
+ */
+static void HostHal_SpiTransfer(SPI_HandleTypeDef* const hspi, const uint8_t* pTxData, uint8_t* pRxData, uint16_t Size)
+{
+	SET_BIT(hspi->Instance->CR1, SPI_CR1_SPE);
+
+	for(uint16_t i = 0; i < Size; i++)
+	{
+		uint8_t Data = HostHal_SpiExchange(hspi->Instance, (NULL != pTxData)? pTxData[i]: 0xFF);
+
+		if(NULL != pRxData)
+		{
+			pRxData[i] = Data;
+		}
+	}
+}
+
+/**
+ * @brief DMA transfer. Data moves at once with each byte stamped with the time
+ * it leaves the shift register, completion is an interrupt at the end of the
+ * last byte. The memory side honours MINC of the channel.
+ *
+ * @param hspi SPI handle
+ * @param pTxData bytes to send
+ * @param pRxData received bytes, NULL for transmit only
+ * @param Size number of bytes
+ * @param Event event signalling completion
+ * @param Irq interrupt of the completing channel
+ * @param pfHandler interrupt handler
+ */
+static void HostHal_SpiDma(SPI_HandleTypeDef* const hspi, const uint8_t* pTxData, uint8_t* pRxData, uint16_t Size,
+		eHostClockEvent_t Event, IRQn_Type Irq, pfHostClockHandler_t pfHandler)
+{
+	eHostHalBus_t Bus = HostHal_GetBus(hspi->Instance);
+	uint64_t ByteNs = HostHal_GetSpiByteNs(hspi->Instance);
+	uint64_t StartNs = HostClock_GetNs();
+	bool IsTxIncrement = (0 != (hspi->hdmatx->Instance->CCR & DMA_CCR_MINC));
+	bool IsRxIncrement = (NULL != pRxData) && (0 != (hspi->hdmarx->Instance->CCR & DMA_CCR_MINC));
+
+	SET_BIT(hspi->Instance->CR1, SPI_CR1_SPE);
+
+	for(uint16_t i = 0; i < Size; i++)
+	{
+		uint8_t Data = HostHal_SpiClock(Bus, pTxData[(true == IsTxIncrement)? i: 0u], StartNs + ((uint64_t)(i + 1u) * ByteNs));
+
+		if(NULL != pRxData)
+		{
+			pRxData[(true == IsRxIncrement)? i: 0u] = Data;
+		}
+	}
+
+	gHostHalBusStatistics[Bus].DmaBytes += Size;
+	gHostHalBusStatistics[Bus].BusyNs += (uint64_t)Size * ByteNs;
+
+	hspi->hdmatx->Instance->CNDTR = Size;
+	SET_BIT(hspi->hdmatx->Instance->CCR, DMA_CCR_EN);
+
+	HostClock_Schedule(Event, StartNs + ((uint64_t)Size * ByteNs), Irq, pfHandler);
+}
+
+/**
+ * @brief DMA of a SPI handle finished
+ *
+ * @param hspi SPI handle
+ */
+static void HostHal_SpiDmaComplete(SPI_HandleTypeDef* const hspi)
+{
+	hspi->hdmatx->Instance->CNDTR = 0;
+
+	if(NULL != hspi->hdmarx)
+	{
+		hspi->hdmarx->Instance->CNDTR = 0;
+	}
+
+	hspi->State = HAL_SPI_STATE_READY;
+}
+
+/**
+ * @brief Update event period of a basic timer
+ *
+ * @param htim timer handle
+ * @return uint64_t nanoseconds
+ */
+static uint64_t HostHal_GetTimerPeriodNs(const TIM_HandleTypeDef* const htim)
+{
+	return ((uint64_t)(htim->Instance->PSC + 1u) * (htim->Instance->ARR + 1u) * 1000000000u) / HOSTCLOCK_TIMCLK1_HZ;
+}
+
+/**
+ * @brief Update event of a basic timer, the callback may restart or stop it
+ *
+ * @param htim timer handle
+ * @param Event event of the timer
+ * @param Irq interrupt of the timer
+ * @param pfHandler handler of the event
+ */
+static void HostHal_TimerUpdate(TIM_HandleTypeDef* const htim, eHostClockEvent_t Event, IRQn_Type Irq, pfHostClockHandler_t pfHandler)
+{
+	uint64_t DueNs = HostClock_GetNs();
+
+	if((0 == (htim->Instance->CR1 & TIM_CR1_CEN)) || (0 == (htim->Instance->DIER & TIM_DIER_UIE)))
+	{
+		return;
+	}
+
+	HAL_TIM_PeriodElapsedCallback(htim);
+
+	if((0 != (htim->Instance->CR1 & TIM_CR1_CEN)) && (false == HostClock_IsScheduled(Event)))
+	{
+		uint64_t NextNs = DueNs + HostHal_GetTimerPeriodNs(htim);
+
+		HostClock_Schedule(Event, (NextNs > HostClock_GetNs())? NextNs: HostClock_GetNs(), Irq, pfHandler);
+	}
+}
+
+/**
+ * @brief TIM6 interrupt
+ *
+ */
+static void HostHal_cbTim6(void)
+{
+	HostHal_TimerUpdate(&htim6, eHOSTCLOCK_EVENT_TIM6, TIM6_IRQn, HostHal_cbTim6);
+}
+
+/**
+ * @brief TIM7 interrupt
+ *
+ */
+static void HostHal_cbTim7(void)
+{
+	HostHal_TimerUpdate(&htim7, eHOSTCLOCK_EVENT_TIM7, TIM7_IRQn, HostHal_cbTim7);
+}
+
+/**
+ * @brief DMA1 channel 2 interrupt, SPI1 RX done
+ *
+ */
+static void HostHal_Dma1Channel2IRQHandler(void)
+{
+	HostHal_SpiDmaComplete(&hspi1);
+}
+
+/**
+ * @brief Last byte of the console transmit DMA moved into DR, the flag is up
+ * whether or not the interrupt can be taken now
+ *
+ */
+static void HostHal_cbDma1Channel4(void)
+{
+	DMA1_Channel4->CNDTR = 0;
+	SET_BIT(DMA1->ISR, DMA_ISR_GIF4 | DMA_ISR_TCIF4);
+
+	if(0 != (DMA1_Channel4->CCR & DMA_CCR_TCIE))
+	{
+		HostClock_Schedule(eHOSTCLOCK_EVENT_DMA1_CH4, HostClock_GetNs(), DMA1_Channel4_IRQn, HostHal_Dma1Channel4IRQHandler);
+	}
+}
+
+/**
+ * @brief DMA1 channel 4 interrupt, as in stm32f1xx_it.c. Console transmit done.
+ *
+ */
+static void HostHal_Dma1Channel4IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+/**
+ * @brief Handle of a timer instance
+ *
+ * @param htim timer handle
+ * @param pEvent event of the timer
+ * @param pIrq interrupt of the timer
+ * @return pfHostClockHandler_t handler of the event, NULL for a timer not on the board
+ */
+static pfHostClockHandler_t HostHal_GetTimer(const TIM_HandleTypeDef* const htim, eHostClockEvent_t* pEvent, IRQn_Type* pIrq)
+{
+	if(TIM6 == htim->Instance)
+	{
+		*pEvent = eHOSTCLOCK_EVENT_TIM6;
+		*pIrq = TIM6_IRQn;
+		return HostHal_cbTim6;
+	}
+
+	if(TIM7 == htim->Instance)
+	{
+		*pEvent = eHOSTCLOCK_EVENT_TIM7;
+		*pIrq = TIM7_IRQn;
+		return HostHal_cbTim7;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief CubeMX style UART initialisation
+ *
+ * @param huart UART handle
+ * @param pInstance UART instance
+ */
+static void HostHal_UartInit(UART_HandleTypeDef* const huart, USART_TypeDef* const pInstance)
+{
+	huart->Instance = pInstance;
+	huart->Init.BaudRate = 115200;
+	huart->Init.WordLength = UART_WORDLENGTH_8B;
+	huart->Init.StopBits = UART_STOPBITS_1;
+	huart->Init.Parity = UART_PARITY_NONE;
+	huart->Init.Mode = UART_MODE_TX_RX;
+	huart->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+	huart->Init.OverSampling = UART_OVERSAMPLING_16;
+
+	pInstance->BRR = UART_BRR_SAMPLING16((USART1 == pInstance)? HOSTCLOCK_PCLK2_HZ: HOSTCLOCK_PCLK1_HZ, huart->Init.BaudRate);
+	pInstance->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+	pInstance->SR = USART_SR_TXE | USART_SR_TC;
+
+	huart->gState = HAL_UART_STATE_READY;
+	huart->RxState = HAL_UART_STATE_READY;
+}
+
+/**
+ * @brief CubeMX style SPI initialisation, 8 bit master, mode 0
+ *
+ * @param hspi SPI handle
+ * @param pInstance SPI instance
+ * @param Prescaler baud rate prescaler
+ */
+static void HostHal_SpiInit(SPI_HandleTypeDef* const hspi, SPI_TypeDef* const pInstance, uint32_t Prescaler)
+{
+	hspi->Instance = pInstance;
+	hspi->Init.Mode = SPI_MODE_MASTER;
+	hspi->Init.Direction = SPI_DIRECTION_2LINES;
+	hspi->Init.DataSize = SPI_DATASIZE_8BIT;
+	hspi->Init.CLKPolarity = SPI_POLARITY_LOW;
+	hspi->Init.CLKPhase = SPI_PHASE_1EDGE;
+	hspi->Init.NSS = SPI_NSS_SOFT;
+	hspi->Init.BaudRatePrescaler = Prescaler;
+	hspi->Init.FirstBit = SPI_FIRSTBIT_MSB;
+	hspi->Init.TIMode = SPI_TIMODE_DISABLE;
+	hspi->Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+	hspi->Init.CRCPolynomial = 10;
+
+	pInstance->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | Prescaler;
+	pInstance->SR = SPI_SR_TXE;
+
+	hspi->State = HAL_SPI_STATE_READY;
+}
+
+/**
+ * @brief CubeMX style DMA channel initialisation
+ *
+ * @param hdma DMA handle
+ * @param pInstance channel
+ * @param Direction transfer direction
+ * @param Priority channel priority
+ */
+static void HostHal_DmaInit(DMA_HandleTypeDef* const hdma, DMA_Channel_TypeDef* const pInstance, uint32_t Direction, uint32_t Priority)
+{
+	hdma->Instance = pInstance;
+	hdma->Init.Direction = Direction;
+	hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma->Init.MemInc = DMA_MINC_ENABLE;
+	hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma->Init.Mode = DMA_NORMAL;
+	hdma->Init.Priority = Priority;
+
+	(void)HAL_DMA_Init(hdma);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Bring the board up as main() does before entering the application loop
+ *
+ */
+void HostHal_Init(void)
+{
+	memset(gHostPeripheralSpace, 0, sizeof(gHostPeripheralSpace));
+	memset(&gHostCoreDebug, 0, sizeof(gHostCoreDebug));
+	memset(gHostHalBusStatistics, 0, sizeof(gHostHalBusStatistics));
+
+	HAL_Init();
+	MX_GPIO_Init();
+	MX_CRC_Init();
+	MX_SPI1_Init();
+	MX_SPI2_Init();
+	MX_USART1_UART_Init();
+	MX_USART2_UART_Init();
+	MX_FATFS_Init();
+	MX_TIM6_Init();
+	MX_TIM7_Init();
+}
+
+/**
+ * @brief Drive an input pin from outside the board, button and jumpers
+ *
+ * @param pPort GPIO port
+ * @param Pin pin mask
+ * @param State level
+ */
+void HostHal_SetInput(GPIO_TypeDef* const pPort, uint16_t Pin, GPIO_PinState State)
+{
+	if(GPIO_PIN_SET == State)
+	{
+		SET_BIT(pPort->IDR, Pin);
+	}
+	else
+	{
+		CLEAR_BIT(pPort->IDR, Pin);
+	}
+}
+
+/**
+ * @brief Shift a byte through a bus, the register level path of SpiLL.h
+ *
+ * @param pSpi SPI instance
+ * @param Data byte on MOSI
+ * @return uint8_t byte on MISO
+ */
+uint8_t HostHal_SpiExchange(SPI_TypeDef* const pSpi, uint8_t Data)
+{
+	eHostHalBus_t Bus = HostHal_GetBus(pSpi);
+	uint64_t ByteNs = HostHal_GetSpiByteNs(pSpi);
+
+	gHostHalBusStatistics[Bus].BusyNs += ByteNs;
+	HostClock_Advance(ByteNs);
+
+	return HostHal_SpiClock(Bus, Data, HostClock_GetNs());
+}
+
+/**
+ * @brief USART1 interrupt, as in stm32f1xx_it.c. The DR read of the handler clears IDLE, RXNE and ORE.
+ *
+ */
+void HostHal_Usart1IRQHandler(void)
+{
+	Console_cbUartIRQ();
+	CLEAR_BIT(USART1->SR, USART_SR_IDLE | USART_SR_RXNE | USART_SR_ORE);
+}
+
+/**
+ * @brief DMA1 channel 5 interrupt, as in stm32f1xx_it.c. Console reception or SPI2 TX done.
+ *
+ */
+void HostHal_Dma1Channel5IRQHandler(void)
+{
+	if(true == Console_IsRxDmaActive())
+	{
+		Console_cbRxDmaIRQ();
+	}
+	else
+	{
+		HostHal_SpiDmaComplete(&hspi2);
+		HAL_SPI_TxCpltCallback(&hspi2);
+	}
+}
+
+/**
+ * @brief Print SPI bus counters
+ *
+ */
+void HostHal_PrintStatistics(void)
+{
+	for(uint32_t i = 0; i < eHOSTHAL_BUS_MAX; i++)
+	{
+		printf("bus: %-12s %10llu bytes (%llu over DMA), clocking %10.3f ms\n", gcHostHalBusNames[i],
+				(unsigned long long)gHostHalBusStatistics[i].Bytes, (unsigned long long)gHostHalBusStatistics[i].DmaBytes,
+				(double)gHostHalBusStatistics[i].BusyNs / 1e6);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CubeMX initialisation, Core/Src equivalents
+///////////////////////////////////////////////////////////////////////////////
+
+void MX_GPIO_Init(void)
+{
+	HAL_GPIO_WritePin(SPI1_NSS_GPIO_Port, SPI1_NSS_Pin, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(GPIOB, SPI2_NSS_Pin | LED_G1_Pin | LED_B1_Pin | LED_R1_Pin | SENSOR_POWER_ENABLE_Pin, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(GPIOC, LED_B_Pin | LED_R_Pin | LED_G_Pin, GPIO_PIN_RESET);
+
+	/* Button released, SD card mode, profile 0 */
+	HostHal_SetInput(FLASH_BUTTON_GPIO_Port, FLASH_BUTTON_Pin, GPIO_PIN_SET);
+	HostHal_SetInput(TRANSFER_MODE_GPIO_Port, TRANSFER_MODE_Pin, GPIO_PIN_RESET);
+	HostHal_SetInput(SETTING_GPIO1_GPIO_Port, SETTING_GPIO1_Pin, GPIO_PIN_RESET);
+	HostHal_SetInput(SETTING_GPIO2_GPIO_Port, SETTING_GPIO2_Pin, GPIO_PIN_RESET);
+}
+
+void MX_CRC_Init(void)
+{
+	hcrc.Instance = CRC;
+}
+
+void MX_SPI1_Init(void)
+{
+	HostHal_SpiInit(&hspi1, SPI1, SPI_BAUDRATEPRESCALER_4);
+
+	HostHal_DmaInit(&hdma_spi1_rx, DMA1_Channel2, DMA_PERIPH_TO_MEMORY, DMA_PRIORITY_HIGH);
+	__HAL_LINKDMA(&hspi1, hdmarx, hdma_spi1_rx);
+	HostHal_DmaInit(&hdma_spi1_tx, DMA1_Channel3, DMA_MEMORY_TO_PERIPH, DMA_PRIORITY_MEDIUM);
+	__HAL_LINKDMA(&hspi1, hdmatx, hdma_spi1_tx);
+
+	HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+	HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+}
+
+void MX_SPI2_Init(void)
+{
+	HostHal_SpiInit(&hspi2, SPI2, SPI_BAUDRATEPRESCALER_2);
+
+	HostHal_DmaInit(&hdma_spi2_tx, DMA1_Channel5, DMA_MEMORY_TO_PERIPH, DMA_PRIORITY_LOW);
+	__HAL_LINKDMA(&hspi2, hdmatx, hdma_spi2_tx);
+
+	HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+}
+
+void MX_USART1_UART_Init(void)
+{
+	HostHal_UartInit(&huart1, USART1);
+
+	HostHal_DmaInit(&hdma_usart1_tx, DMA1_Channel4, DMA_MEMORY_TO_PERIPH, DMA_PRIORITY_LOW);
+	__HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
+	HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+}
+
+void MX_USART2_UART_Init(void)
+{
+	HostHal_UartInit(&huart2, USART2);
+}
+
+void MX_TIM6_Init(void)
+{
+	htim6.Instance = TIM6;
+	htim6.Init.Prescaler = 3199;
+	htim6.Init.Period = 99;
+	TIM6->PSC = htim6.Init.Prescaler;
+	TIM6->ARR = htim6.Init.Period;
+	htim6.State = HAL_TIM_STATE_READY;
+
+	HAL_NVIC_EnableIRQ(TIM6_IRQn);
+}
+
+void MX_TIM7_Init(void)
+{
+	htim7.Instance = TIM7;
+	htim7.Init.Prescaler = 71;
+	htim7.Init.Period = 99;
+	TIM7->PSC = htim7.Init.Prescaler;
+	TIM7->ARR = htim7.Init.Period;
+	htim7.State = HAL_TIM_STATE_READY;
+
+	HAL_NVIC_EnableIRQ(TIM7_IRQn);
+}
+
+void Error_Handler(void)
+{
+	fflush(stdout);
+	fprintf(stderr, "Error_Handler at %.3f ms\n", (double)HostClock_GetNs() / 1e6);
+	exit(HOSTHAL_EXIT_ERROR);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HAL
+///////////////////////////////////////////////////////////////////////////////
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+	return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	HostClock_Poll();
+
+	return (uint32_t)(HostClock_GetNs() / 1000000u);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	uint32_t tickstart = HAL_GetTick();
+	uint32_t wait = Delay;
+
+	if(wait < HAL_MAX_DELAY)
+	{
+		wait += (uint32_t)HAL_TICK_FREQ_DEFAULT;
+	}
+
+	while((HAL_GetTick() - tickstart) < wait)
+	{
+	}
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+	return HOSTCLOCK_PCLK2_HZ;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	UNUSED(IRQn);
+	UNUSED(PreemptPriority);
+	UNUSED(SubPriority);
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	HostClock_SetIrqEnable(IRQn, true);
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	HostClock_SetIrqEnable(IRQn, false);
+}
+
+void HAL_NVIC_SystemReset(void)
+{
+	fflush(stdout);
+	fprintf(stderr, "system reset at %.3f ms\n", (double)HostClock_GetNs() / 1e6);
+	exit(HOSTHAL_EXIT_RESET);
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	uint32_t Previous = GPIOx->ODR;
+	uint32_t Current = (GPIO_PIN_SET == PinState)? (Previous | GPIO_Pin): (Previous & ~(uint32_t)GPIO_Pin);
+	uint32_t Changed = Previous ^ Current;
+
+	GPIOx->ODR = Current;
+
+	if((SPI1_NSS_GPIO_Port == GPIOx) && (0 != (Changed & SPI1_NSS_Pin)))
+	{
+		HostSdCard_Select(GPIO_PIN_RESET == PinState, HostClock_GetNs());
+	}
+
+	if((SENSOR_POWER_ENABLE_GPIO_Port == GPIOx) && (0 != (Changed & SENSOR_POWER_ENABLE_Pin)))
+	{
+		HostW25q_SetPower(GPIO_PIN_SET == PinState);
+	}
+
+	if((SPI2_NSS_GPIO_Port == GPIOx) && (0 != (GPIO_Pin & SPI2_NSS_Pin)))
+	{
+		HostW25q_Select(GPIO_PIN_RESET == PinState, HostClock_GetNs());
+	}
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+	/* A loop polling a pin, as the flash button wait, lets time pass like one polling the tick */
+	HostClock_Poll();
+
+	return (0 != (GPIOx->IDR & GPIO_Pin))? GPIO_PIN_SET: GPIO_PIN_RESET;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma)
+{
+	assert(NULL != hdma);
+
+	hdma->Instance->CCR = hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc | hdma->Init.PeriphDataAlignment |
+			hdma->Init.MemDataAlignment | hdma->Init.Mode | hdma->Init.Priority;
+	hdma->State = HAL_DMA_STATE_READY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	assert(NULL != hdma);
+
+	/* SPI handles go through HAL_SPI_*_DMA, the console transmit ring is the only direct user */
+	assert((DMA1_Channel4 == hdma->Instance) && ((uint32_t)(uintptr_t)&USART1->DR == DstAddress));
+
+	if(HAL_DMA_STATE_READY != hdma->State)
+	{
+		return HAL_BUSY;
+	}
+
+	hdma->State = HAL_DMA_STATE_BUSY;
+	hdma->Instance->CMAR = SrcAddress;
+	hdma->Instance->CPAR = DstAddress;
+	hdma->Instance->CNDTR = DataLength;
+	SET_BIT(hdma->Instance->CCR, DMA_CCR_TCIE | DMA_CCR_TEIE | DMA_CCR_EN);
+
+	uint64_t SendNs = HostUart_TransmitDma((const uint8_t*)(uintptr_t)SrcAddress, DataLength);
+
+	HostClock_Schedule(eHOSTCLOCK_EVENT_DMA1_CH4, HostClock_GetNs() + SendNs, HOSTCLOCK_NO_IRQ, HostHal_cbDma1Channel4);
+
+	return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef* hdma)
+{
+	uint32_t Flags = __HAL_DMA_GET_TC_FLAG_INDEX(hdma) | __HAL_DMA_GET_GI_FLAG_INDEX(hdma);
+
+	if((0 != (DMA1->ISR & __HAL_DMA_GET_TC_FLAG_INDEX(hdma))) && (0 != (hdma->Instance->CCR & DMA_CCR_TCIE)))
+	{
+		CLEAR_BIT(DMA1->ISR, Flags);
+		CLEAR_BIT(hdma->Instance->CCR, DMA_CCR_TCIE | DMA_CCR_TEIE | DMA_CCR_EN);
+		hdma->State = HAL_DMA_STATE_READY;
+
+		if(NULL != hdma->XferCpltCallback)
+		{
+			hdma->XferCpltCallback(hdma);
+		}
+	}
+}
+
+HAL_StatusTypeDef HAL_SPI_DeInit(SPI_HandleTypeDef* hspi)
+{
+	CLEAR_BIT(hspi->Instance->CR1, SPI_CR1_SPE);
+	hspi->State = HAL_SPI_STATE_RESET;
+
+	if(SPI2 == hspi->Instance)
+	{
+		HAL_NVIC_DisableIRQ(DMA1_Channel5_IRQn);
+	}
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+	UNUSED(Timeout);
+
+	if(HAL_SPI_STATE_READY != hspi->State)
+	{
+		return HAL_BUSY;
+	}
+
+	HostHal_SpiTransfer(hspi, pData, NULL, Size);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef* hspi, uint8_t* pTxData, uint8_t* pRxData, uint16_t Size, uint32_t Timeout)
+{
+	UNUSED(Timeout);
+
+	if(HAL_SPI_STATE_READY != hspi->State)
+	{
+		return HAL_BUSY;
+	}
+
+	HostHal_SpiTransfer(hspi, pTxData, pRxData, Size);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+	/* A full duplex master receives by sending the buffer it receives into, as the HAL does */
+	return HAL_SPI_TransmitReceive(hspi, pData, pData, Size, Timeout);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size)
+{
+	if(HAL_SPI_STATE_READY != hspi->State)
+	{
+		return HAL_BUSY;
+	}
+
+	if((NULL == pData) || (0 == Size) || (NULL == hspi->hdmatx) || (DMA1_Channel5 != hspi->hdmatx->Instance))
+	{
+		return HAL_ERROR;
+	}
+
+	hspi->State = HAL_SPI_STATE_BUSY_TX;
+	HostHal_SpiDma(hspi, pData, NULL, Size, eHOSTCLOCK_EVENT_DMA1_CH5, DMA1_Channel5_IRQn, HostHal_Dma1Channel5IRQHandler);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef* hspi, uint8_t* pTxData, uint8_t* pRxData, uint16_t Size)
+{
+	if(HAL_SPI_STATE_READY != hspi->State)
+	{
+		return HAL_BUSY;
+	}
+
+	if((NULL == pTxData) || (NULL == pRxData) || (0 == Size) || (NULL == hspi->hdmatx) || (NULL == hspi->hdmarx) ||
+			(DMA1_Channel2 != hspi->hdmarx->Instance))
+	{
+		return HAL_ERROR;
+	}
+
+	hspi->State = HAL_SPI_STATE_BUSY_TX_RX;
+	HostHal_SpiDma(hspi, pTxData, pRxData, Size, eHOSTCLOCK_EVENT_DMA1_CH2, DMA1_Channel2_IRQn, HostHal_Dma1Channel2IRQHandler);
+
+	return HAL_OK;
+}
+
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef* hspi)
+{
+	return hspi->State;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef* hspi)
+{
+	HostClock_Cancel((SPI1 == hspi->Instance)? eHOSTCLOCK_EVENT_DMA1_CH2: eHOSTCLOCK_EVENT_DMA1_CH5);
+	HostHal_SpiDmaComplete(hspi);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim)
+{
+	eHostClockEvent_t Event;
+	IRQn_Type Irq;
+	pfHostClockHandler_t pfHandler = HostHal_GetTimer(htim, &Event, &Irq);
+
+	if(NULL == pfHandler)
+	{
+		return HAL_ERROR;
+	}
+
+	SET_BIT(htim->Instance->DIER, TIM_DIER_UIE);
+	SET_BIT(htim->Instance->CR1, TIM_CR1_CEN);
+	htim->State = HAL_TIM_STATE_BUSY;
+
+	HostClock_Cancel(Event);
+	HostClock_Schedule(Event, HostClock_GetNs() + HostHal_GetTimerPeriodNs(htim), Irq, pfHandler);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim)
+{
+	eHostClockEvent_t Event;
+	IRQn_Type Irq;
+
+	if(NULL == HostHal_GetTimer(htim, &Event, &Irq))
+	{
+		return HAL_ERROR;
+	}
+
+	CLEAR_BIT(htim->Instance->DIER, TIM_DIER_UIE);
+	CLEAR_BIT(htim->Instance->CR1, TIM_CR1_CEN);
+	htim->State = HAL_TIM_STATE_READY;
+
+	HostClock_Cancel(Event);
+
+	return HAL_OK;
+}
+
+HAL_UART_StateTypeDef HAL_UART_GetState(const UART_HandleTypeDef* huart)
+{
+	return (HAL_UART_StateTypeDef)(huart->gState | huart->RxState);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+	UNUSED(Timeout);
+
+	if(HAL_UART_STATE_READY != huart->gState)
+	{
+		return HAL_BUSY;
+	}
+
+	if((NULL == pData) || (0 == Size))
+	{
+		return HAL_ERROR;
+	}
+
+	if(USART1 == huart->Instance)
+	{
+		HostUart_Transmit(pData, Size);
+	}
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+	USART_TypeDef* pUart = huart->Instance;
+
+	if(HAL_UART_STATE_READY != huart->RxState)
+	{
+		return HAL_BUSY;
+	}
+
+	if((NULL == pData) || (0 == Size))
+	{
+		return HAL_ERROR;
+	}
+
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+	uint32_t tickstart = HAL_GetTick();
+
+	for(uint16_t i = 0; i < Size; i++)
+	{
+		while(0 == (pUart->SR & USART_SR_RXNE))
+		{
+			if((HAL_MAX_DELAY != Timeout) && ((HAL_GetTick() - tickstart) > Timeout))
+			{
+				huart->RxState = HAL_UART_STATE_READY;
+				return HAL_TIMEOUT;
+			}
+		}
+
+		pData[i] = (uint8_t)pUart->DR;
+		CLEAR_BIT(pUart->SR, USART_SR_RXNE | USART_SR_ORE);
+	}
+
+	huart->RxState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+	if(HAL_UART_STATE_READY != huart->RxState)
+	{
+		return HAL_BUSY;
+	}
+
+	/* Armed as on target, where USART1 interrupt only serves the idle line while its NVIC line is on */
+	huart->pRxBuffPtr = pData;
+	huart->RxXferSize = Size;
+	huart->RxXferCount = Size;
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+	SET_BIT(huart->Instance->CR1, USART_CR1_RXNEIE);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart)
+{
+	CLEAR_BIT(huart->Instance->CR1, USART_CR1_RXNEIE);
+	huart->RxState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef* huart)
+{
+	huart->gState = HAL_UART_STATE_READY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef* huart)
+{
+	(void)HAL_UART_AbortTransmit(huart);
+
+	return HAL_UART_AbortReceive(huart);
+}
+
+void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
+{
+	UNUSED(huart);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,66 @@
+/**
+ * @file HostHal.h
+ * @author Vishal Keshava Murthy
+ * @brief HAL and CubeMX initialisation of the host simulation. Implements the
+ * HAL calls the firmware makes on top of the virtual clock and routes the SPI
+ * buses, chip selects and interrupts of the board to the device models.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SIM_HOSTHAL_H_
+#define HOST_SIM_HOSTHAL_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stm32f1xx_hal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTHAL_EXIT_RESET			(3)		/**< Exit status when the firmware resets the MCU */
+#define HOSTHAL_EXIT_ERROR			(4)		/**< Exit status when Error_Handler runs */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief SPI bus of the board
+ *
+ */
+typedef enum
+{
+	eHOSTHAL_BUS_SD,				/**< SPI1, SD card */
+	eHOSTHAL_BUS_FLASH,				/**< SPI2, W25Qxx */
+	eHOSTHAL_BUS_MAX
+}eHostHalBus_t;
+
+/**
+ * @brief Bus counters printed after a run
+ *
+ */
+typedef struct
+{
+	uint64_t Bytes;
+	uint64_t DmaBytes;
+	uint64_t BusyNs;				/**< Time the bus was clocking */
+}sHostHalBusStatistics_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void HostHal_Init(void);
+void HostHal_SetInput(GPIO_TypeDef* const pPort, uint16_t Pin, GPIO_PinState State);
+uint8_t HostHal_SpiExchange(SPI_TypeDef* const pSpi, uint8_t Data);
+void HostHal_Usart1IRQHandler(void);
+void HostHal_Dma1Channel5IRQHandler(void);
+void HostHal_PrintStatistics(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* HOST_SIM_HOSTHAL_H_ */
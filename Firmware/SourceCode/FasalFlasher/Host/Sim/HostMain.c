@@ -0,0 +1,490 @@
+/**
+ * @file HostMain.c
+ * @author Vishal Keshava Murthy
+ * @brief Entry of the host simulation. Boots the firmware against the flash and
+ * SD card models, presses the flash button or sends console commands, and runs
+ * the application state machine through one transfer, then reports what the
+ * buses and devices saw and how long the transfer took on the virtual clock.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "fatfs.h"
+
+#include "AppCommon.h"
+#include "AppFasal.h"
+#include "AppTrace.h"
+#include "Console.h"
+
+#include "HostClock.h"
+#include "HostHal.h"
+#include "HostSdCard.h"
+#include "HostUart.h"
+#include "HostW25q.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTMAIN_EXIT_FIRMWARE_ERROR	(1)		/**< Transfer ended with a non zero application error code */
+#define HOSTMAIN_EXIT_SETUP_ERROR		(2)		/**< Bad arguments, device models or SD card preparation failed */
+#define HOSTMAIN_EXIT_VERIFY_ERROR		(5)		/**< Flash content differs from the reference file */
+#define HOSTMAIN_EXIT_WIRE_ERROR		(6)		/**< Console input was dropped by the simulation, the run does not show what the device would do */
+
+#define HOSTMAIN_FLASH_SIZE_DEFAULT		(16u * 1024u * 1024u)	/**< W25Q128, as fitted on the board */
+#define HOSTMAIN_PROFILE_MAX			(3u)
+#define HOSTMAIN_COPY_CHUNK				(4096u)
+#define HOSTMAIN_COMMAND_MAX			(8u)		/**< Console command lines taken from the command line */
+#define HOSTMAIN_GOLDEN_IMAGE_NAME		"fallback.txt"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Command line of a run
+ *
+ */
+typedef struct
+{
+	const char* pFlashPath;
+	size_t FlashSize;
+	const char* pSdPath;
+	size_t SdSize;
+	const char* pSdPut;				/**< Golden image to copy onto the SD card before boot, NULL to keep the card as is */
+	const char* pVerifyPath;		/**< Reference to compare the flash array with after the run, NULL for none */
+	const char* pTracePath;			/**< File the event trace is dumped to after the run, NULL for none */
+	const char* pConsolePath;		/**< File console output goes to instead of stdout, NULL for stdout */
+	const char* pCommands[HOSTMAIN_COMMAND_MAX];	/**< Lines sent to the console shell once the firmware waits for a start */
+	uint32_t CommandCount;
+	uint32_t VerifyOffset;
+	uint32_t Profile;
+	bool IsXModem;
+	bool IsPty;
+	bool IsWorstCase;
+	bool IsBinaryLog;
+}sHostMainOptions_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static FILE* gpHostMainTraceFile = NULL;	/**< Destination of @ref HostMain_TraceSink */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Print the command line
+ *
+ * @param pName program name
+ */
+static void HostMain_PrintUsage(const char* pName)
+{
+	fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --flash FILE          flash array backing file (default fasal_flash.bin)\n"
+			"  --flash-size BYTES    flash capacity, power of two (default 16 MB)\n"
+			"  --sd FILE             SD card image (default fasal_sd.img)\n"
+			"  --sd-size MB          capacity of a new SD card image (default 64)\n"
+			"  --sd-put FILE         copy FILE onto the SD card as " HOSTMAIN_GOLDEN_IMAGE_NAME " before boot\n"
+			"  --profile N           storage profile jumpers, 0 to 3 (default 0)\n"
+			"  --xmodem              transfer mode jumper set to X-Modem\n"
+			"  --pty                 console on a pseudo terminal, virtual time paced to wall clock\n"
+			"  --worst-case          flash program and erase take their datasheet maximum\n"
+			"  --verify FILE[:OFFS]  compare the flash array at OFFS with FILE after the run\n"
+			"  --trace FILE          dump the event trace to FILE after the run, see Tools/trace2chrome.py\n"
+			"  --console FILE        write console output to FILE instead of stdout\n"
+			"  --binary-log          console prints as binary log frames, see Tools/consolelog.py\n"
+			"  --command LINE        send LINE to the console shell instead of pressing the flash button,\n"
+			"                        repeat for more lines, e.g. --command \"START SD\" --command STATUS\n",
+			pName);
+}
+
+/**
+ * @brief Parse the command line
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @param pOptions parsed options
+ * @return true when the run can go ahead
+ */
+static bool HostMain_ParseOptions(int argc, char* argv[], sHostMainOptions_t* const pOptions)
+{
+	static const struct option gcOptions[] =
+	{
+		{"flash",		required_argument,	NULL, 'f'},
+		{"flash-size",	required_argument,	NULL, 'F'},
+		{"sd",			required_argument,	NULL, 's'},
+		{"sd-size",		required_argument,	NULL, 'S'},
+		{"sd-put",		required_argument,	NULL, 'p'},
+		{"profile",		required_argument,	NULL, 'P'},
+		{"xmodem",		no_argument,		NULL, 'x'},
+		{"pty",			no_argument,		NULL, 't'},
+		{"worst-case",	no_argument,		NULL, 'w'},
+		{"verify",		required_argument,	NULL, 'v'},
+		{"trace",		required_argument,	NULL, 'T'},
+		{"console",		required_argument,	NULL, 'c'},
+		{"binary-log",	no_argument,		NULL, 'b'},
+		{"command",		required_argument,	NULL, 'C'},
+		{"help",		no_argument,		NULL, 'h'},
+		{NULL,			0,					NULL, 0},
+	};
+
+	*pOptions = (sHostMainOptions_t)
+	{
+		.pFlashPath = "fasal_flash.bin",
+		.FlashSize = HOSTMAIN_FLASH_SIZE_DEFAULT,
+		.pSdPath = "fasal_sd.img",
+		.SdSize = HOSTSDCARD_CAPACITY_DEFAULT,
+	};
+
+	int Option;
+
+	while(-1 != (Option = getopt_long(argc, argv, "", gcOptions, NULL)))
+	{
+		switch(Option)
+		{
+			case 'f':
+				pOptions->pFlashPath = optarg;
+				break;
+
+			case 'F':
+				pOptions->FlashSize = (size_t)strtoul(optarg, NULL, 0);
+				break;
+
+			case 's':
+				pOptions->pSdPath = optarg;
+				break;
+
+			case 'S':
+				pOptions->SdSize = (size_t)strtoul(optarg, NULL, 0) * 1024u * 1024u;
+				break;
+
+			case 'p':
+				pOptions->pSdPut = optarg;
+				break;
+
+			case 'P':
+				pOptions->Profile = (uint32_t)strtoul(optarg, NULL, 0);
+				if(pOptions->Profile > HOSTMAIN_PROFILE_MAX)
+				{
+					fprintf(stderr, "profile %s out of range\n", optarg);
+					return false;
+				}
+				break;
+
+			case 'x':
+				pOptions->IsXModem = true;
+				break;
+
+			case 't':
+				pOptions->IsPty = true;
+				break;
+
+			case 'w':
+				pOptions->IsWorstCase = true;
+				break;
+
+			case 'v':
+			{
+				char* pOffset = strrchr(optarg, ':');
+
+				pOptions->pVerifyPath = optarg;
+				if(NULL != pOffset)
+				{
+					*pOffset = '\0';
+					pOptions->VerifyOffset = (uint32_t)strtoul(pOffset + 1, NULL, 0);
+				}
+				break;
+			}
+
+			case 'T':
+				pOptions->pTracePath = optarg;
+				break;
+
+			case 'c':
+				pOptions->pConsolePath = optarg;
+				break;
+
+			case 'b':
+				pOptions->IsBinaryLog = true;
+				break;
+
+			case 'C':
+				if(pOptions->CommandCount >= HOSTMAIN_COMMAND_MAX)
+				{
+					fprintf(stderr, "at most %u command lines\n", HOSTMAIN_COMMAND_MAX);
+					return false;
+				}
+				pOptions->pCommands[pOptions->CommandCount++] = optarg;
+				break;
+
+			case 'h':
+			default:
+				HostMain_PrintUsage(argv[0]);
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Copy the golden image onto the SD card through FatFs and the SD
+ * driver of the firmware, formatting the card when it has no file system
+ *
+ * @param pPath file on the host
+ * @return true on success
+ */
+static bool HostMain_PutGoldenImage(const char* pPath)
+{
+	FILE* pSource = fopen(pPath, "rb");
+
+	if(NULL == pSource)
+	{
+		perror(pPath);
+		return false;
+	}
+
+	FRESULT Result = f_mount(&USERFatFS, USERPath, 1);
+
+	if(FR_NO_FILESYSTEM == Result)
+	{
+		Result = f_mkfs(USERPath, 0, 0);
+
+		if(FR_OK == Result)
+		{
+			Result = f_mount(&USERFatFS, USERPath, 1);
+		}
+	}
+
+	if(FR_OK == Result)
+	{
+		Result = f_open(&USERFile, HOSTMAIN_GOLDEN_IMAGE_NAME, FA_CREATE_ALWAYS | FA_WRITE);
+	}
+
+	if(FR_OK == Result)
+	{
+		static uint8_t Chunk[HOSTMAIN_COPY_CHUNK];
+		size_t Length;
+
+		while((FR_OK == Result) && (0 != (Length = fread(Chunk, 1, sizeof(Chunk), pSource))))
+		{
+			UINT Written = 0;
+
+			Result = f_write(&USERFile, Chunk, (UINT)Length, &Written);
+			if((FR_OK == Result) && (Written != Length))
+			{
+				Result = FR_DENIED;
+			}
+		}
+
+		FRESULT CloseResult = f_close(&USERFile);
+		Result = (FR_OK == Result)? CloseResult: Result;
+	}
+
+	(void)f_mount(NULL, USERPath, 0);
+	fclose(pSource);
+
+	if(FR_OK != Result)
+	{
+		fprintf(stderr, "could not put %s on the SD card, FatFs error %d\n", pPath, (int)Result);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Compare the flash array with a reference file
+ *
+ * @param pPath reference file
+ * @param Offset flash address the reference starts at
+ * @return true when they match
+ */
+static bool HostMain_Verify(const char* pPath, uint32_t Offset)
+{
+	FILE* pReference = fopen(pPath, "rb");
+
+	if(NULL == pReference)
+	{
+		perror(pPath);
+		return false;
+	}
+
+	const uint8_t* pArray = HostW25q_GetArray();
+	size_t Capacity = HostW25q_GetCapacity();
+	size_t Address = Offset;
+	bool IsMatch = true;
+	int Data;
+
+	while(EOF != (Data = fgetc(pReference)))
+	{
+		if((Address >= Capacity) || (pArray[Address] != (uint8_t)Data))
+		{
+			fprintf(stderr, "verify: %s differs at flash address 0x%08zX\n", pPath, Address);
+			IsMatch = false;
+			break;
+		}
+
+		Address++;
+	}
+
+	fclose(pReference);
+
+	if(true == IsMatch)
+	{
+		printf("verify: %zu bytes at 0x%08X match %s\n", Address - Offset, (unsigned)Offset, pPath);
+	}
+
+	return IsMatch;
+}
+
+/**
+ * @brief Put command lines on the console receive line, as a host would once
+ * the firmware offers to start a transfer
+ *
+ * @param pOptions options holding the lines
+ */
+static void HostMain_SendCommands(const sHostMainOptions_t* const pOptions)
+{
+	for(uint32_t i = 0; i < pOptions->CommandCount; i++)
+	{
+		HostUart_Feed((const uint8_t*)pOptions->pCommands[i], (uint32_t)strlen(pOptions->pCommands[i]));
+		HostUart_Feed((const uint8_t*)"\r\n", 2u);
+	}
+}
+
+/**
+ * @brief Receives the event trace dump, the same bytes the firmware streams over the console
+ *
+ * @param pData bytes of the dump
+ * @param Length number of bytes
+ */
+static void HostMain_TraceSink(const uint8_t* pData, uint16_t Length)
+{
+	(void)fwrite(pData, 1, Length, gpHostMainTraceFile);
+}
+
+/**
+ * @brief Dump the event trace of the run to a file
+ *
+ * @param pPath dump file
+ * @return true on success
+ */
+static bool HostMain_DumpTrace(const char* pPath)
+{
+	gpHostMainTraceFile = fopen(pPath, "wb");
+
+	if(NULL == gpHostMainTraceFile)
+	{
+		perror(pPath);
+		return false;
+	}
+
+	AppTrace_Stream(HostMain_TraceSink);
+
+	bool IsWritten = (0 == ferror(gpHostMainTraceFile));
+	IsWritten &= (0 == fclose(gpHostMainTraceFile));
+	gpHostMainTraceFile = NULL;
+
+	return IsWritten;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+	sHostMainOptions_t Options;
+
+	if(false == HostMain_ParseOptions(argc, argv, &Options))
+	{
+		return HOSTMAIN_EXIT_SETUP_ERROR;
+	}
+
+	HostClock_Init(Options.IsPty);
+
+	if((false == HostW25q_Init(Options.pFlashPath, Options.FlashSize, Options.IsWorstCase)) ||
+			(false == HostSdCard_Init(Options.pSdPath, Options.SdSize)) || (false == HostUart_Init(Options.IsPty, Options.pConsolePath)))
+	{
+		return HOSTMAIN_EXIT_SETUP_ERROR;
+	}
+
+	HostHal_Init();
+
+	if((NULL != Options.pSdPut) && (false == HostMain_PutGoldenImage(Options.pSdPut)))
+	{
+		return HOSTMAIN_EXIT_SETUP_ERROR;
+	}
+
+	/* Jumpers as set on the board, then the operator presses the flash button unless the host starts the transfer */
+	bool IsCommandPending = (0 != Options.CommandCount);
+
+	HostHal_SetInput(TRANSFER_MODE_GPIO_Port, TRANSFER_MODE_Pin, (true == Options.IsXModem)? GPIO_PIN_SET: GPIO_PIN_RESET);
+	HostHal_SetInput(SETTING_GPIO1_GPIO_Port, SETTING_GPIO1_Pin, (0 != (Options.Profile & 1u))? GPIO_PIN_SET: GPIO_PIN_RESET);
+	HostHal_SetInput(SETTING_GPIO2_GPIO_Port, SETTING_GPIO2_Pin, (0 != (Options.Profile & 2u))? GPIO_PIN_SET: GPIO_PIN_RESET);
+	HostHal_SetInput(FLASH_BUTTON_GPIO_Port, FLASH_BUTTON_Pin, (true == IsCommandPending)? GPIO_PIN_SET: GPIO_PIN_RESET);
+
+	Console_SetLogMode((true == Options.IsBinaryLog)? eCONSOLE_LOG_BINARY: eCONSOLE_LOG_TEXT);
+
+	uint64_t StartNs = HostClock_GetNs();
+	eAppFasalStates_t State;
+
+	while(eFASAL_APP_END != (State = AppFasal_Run()))
+	{
+		if((true == IsCommandPending) && (eFASAL_APP_BUTTON_WAIT == State))
+		{
+			HostMain_SendCommands(&Options);
+			IsCommandPending = false;
+		}
+	}
+
+	uint64_t EndNs = HostClock_GetNs();
+	eDeviceErrorCode_t ErrorCode = AppCommon_GetErrorCode();
+
+	/* Result display, latency statistics and flash power down */
+	HostHal_SetInput(FLASH_BUTTON_GPIO_Port, FLASH_BUTTON_Pin, GPIO_PIN_SET);
+	(void)AppFasal_Run();
+	Console_Flush();
+
+	printf("\n\n");
+	HostHal_PrintStatistics();
+	HostSdCard_PrintStatistics();
+	HostW25q_PrintStatistics();
+	HostUart_PrintStatistics();
+	printf("time: preparation %.3f ms, boot to result %.3f ms, error code 0x%04X\n", (double)StartNs / 1e6,
+			(double)(EndNs - StartNs) / 1e6, (unsigned)ErrorCode);
+
+	int ExitCode = (eERR_NO_ERRORS == ErrorCode)? EXIT_SUCCESS: HOSTMAIN_EXIT_FIRMWARE_ERROR;
+
+	if(false == HostUart_IsLossless())
+	{
+		fprintf(stderr, "console input was dropped by the simulation\n");
+		ExitCode = HOSTMAIN_EXIT_WIRE_ERROR;
+	}
+
+	if((NULL != Options.pTracePath) && (false == HostMain_DumpTrace(Options.pTracePath)))
+	{
+		ExitCode = HOSTMAIN_EXIT_SETUP_ERROR;
+	}
+
+	if((EXIT_SUCCESS == ExitCode) && (NULL != Options.pVerifyPath) &&
+			(false == HostMain_Verify(Options.pVerifyPath, Options.VerifyOffset)))
+	{
+		ExitCode = HOSTMAIN_EXIT_VERIFY_ERROR;
+	}
+
+	fflush(stdout);
+	HostUart_DeInit();
+	HostSdCard_DeInit();
+	HostW25q_DeInit();
+
+	return ExitCode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,713 @@
+/**
+ * @file HostSdCard.c
+ * @author Vishal Keshava Murthy
+ * @brief Image file backed SD card model, SPI mode
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HostSdCard.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Delays of a typical class 10 SDHC card
+ */
+static const sHostSdCardTiming_t gcTimingTable[eHOSTSDCARD_TIME_MAX] =
+{
+		[eHOSTSDCARD_TIME_INIT]			= {.pName = "Initialisation",	.Us = 50000u},
+		[eHOSTSDCARD_TIME_READ_ACCESS]	= {.pName = "Read access",		.Us = 250u},
+		[eHOSTSDCARD_TIME_BLOCK_GAP]	= {.pName = "Block gap",		.Us = 20u},
+		[eHOSTSDCARD_TIME_WRITE_BUSY]	= {.pName = "Write busy",		.Us = 500u},
+		[eHOSTSDCARD_TIME_STOP_BUSY]	= {.pName = "Stop busy",		.Us = 1000u},
+		[eHOSTSDCARD_TIME_ERASE_BUSY]	= {.pName = "Erase busy",		.Us = 20000u},
+};
+
+/**
+ * @brief CID, manufacturer 0x03, "SD64G" rev 8.0, serial 0x12345678, 2024-06
+ */
+static const uint8_t gcCid[16] =
+{
+		0x03, 0x53, 0x44, 0x53, 0x44, 0x36, 0x34, 0x47, 0x80, 0x12, 0x34, 0x56, 0x78, 0x01, 0x86, 0x01,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sHostSdCard_t gHostSdCard = {.Fd = -1};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get model instance
+ *
+ * @return sHostSdCard_t*
+ */
+static sHostSdCard_t* HostSdCard_GetInstance()
+{
+	return &gHostSdCard;
+}
+
+/**
+ * @brief CRC7 protecting commands and registers
+ *
+ * @param pData data
+ * @param Length bytes
+ * @return uint8_t 7 bit CRC
+ */
+static uint8_t HostSdCard_Crc7(const uint8_t* pData, uint32_t Length)
+{
+	uint8_t Crc = 0;
+
+	while(Length-- > 0)
+	{
+		uint8_t Data = *pData++;
+
+		for(uint8_t i = 0; i < 8u; i++)
+		{
+			Crc = (uint8_t)(Crc << 1u);
+			if(0 != ((Data ^ Crc) & 0x80u))
+			{
+				Crc ^= 0x09u;
+			}
+			Data = (uint8_t)(Data << 1u);
+		}
+	}
+
+	return (uint8_t)(Crc & 0x7Fu);
+}
+
+/**
+ * @brief CRC16-CCITT protecting data blocks
+ *
+ * @param pData data
+ * @param Length bytes
+ * @return uint16_t
+ */
+static uint16_t HostSdCard_Crc16(const uint8_t* pData, uint32_t Length)
+{
+	uint16_t Crc = 0;
+
+	while(Length-- > 0)
+	{
+		Crc ^= (uint16_t)(*pData++ << 8u);
+
+		for(uint8_t i = 0; i < 8u; i++)
+		{
+			Crc = (0 != (Crc & 0x8000u))? (uint16_t)((Crc << 1u) ^ 0x1021u): (uint16_t)(Crc << 1u);
+		}
+	}
+
+	return Crc;
+}
+
+/**
+ * @brief Spend a card delay
+ *
+ * @param pMe model instance
+ * @param Time delay
+ * @return uint64_t delay in nanoseconds
+ */
+static uint64_t HostSdCard_GetDelayNs(sHostSdCard_t* const pMe, eHostSdCardTime_t Time)
+{
+	uint64_t DelayNs = (uint64_t)gcTimingTable[Time].Us * 1000u;
+
+	pMe->Stats.WaitNs[Time] += DelayNs;
+
+	return DelayNs;
+}
+
+/**
+ * @brief Queue bytes for MISO
+ *
+ * @param pMe model instance
+ * @param pData bytes
+ * @param Length number of bytes
+ */
+static void HostSdCard_Queue(sHostSdCard_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	assert((pMe->OutHead + pMe->OutCount + Length) <= sizeof(pMe->Out));
+
+	memcpy(&pMe->Out[pMe->OutHead + pMe->OutCount], pData, Length);
+	pMe->OutCount += Length;
+}
+
+/**
+ * @brief Replace whatever was queued with a response, one idle byte (Ncr) ahead of it
+ *
+ * @param pMe model instance
+ * @param pData response
+ * @param Length bytes
+ */
+static void HostSdCard_Respond(sHostSdCard_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	static const uint8_t cNcr = 0xFF;
+
+	pMe->OutHead = 0;
+	pMe->OutCount = 0;
+	pMe->OutReadyNs = 0;
+
+	HostSdCard_Queue(pMe, &cNcr, 1u);
+	HostSdCard_Queue(pMe, pData, Length);
+}
+
+/**
+ * @brief Queue a data packet, start token, data and CRC16
+ *
+ * @param pMe model instance
+ * @param pData data
+ * @param Length bytes
+ */
+static void HostSdCard_QueueDataPacket(sHostSdCard_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	static const uint8_t cStartToken = 0xFE;
+	uint16_t Crc = HostSdCard_Crc16(pData, Length);
+	const uint8_t cCrc[2] = {(uint8_t)(Crc >> 8u), (uint8_t)Crc};
+
+	HostSdCard_Queue(pMe, &cStartToken, 1u);
+	HostSdCard_Queue(pMe, pData, Length);
+	HostSdCard_Queue(pMe, cCrc, sizeof(cCrc));
+}
+
+/**
+ * @brief Queue the next block of a read, after the access time or block gap
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ */
+static void HostSdCard_LoadBlock(sHostSdCard_t* const pMe, uint64_t Ns)
+{
+	eHostSdCardTime_t Delay = (true == pMe->IsFirstBlock)? eHOSTSDCARD_TIME_READ_ACCESS: eHOSTSDCARD_TIME_BLOCK_GAP;
+
+	pMe->OutHead = 0;
+	pMe->OutCount = 0;
+	pMe->OutReadyNs = Ns + HostSdCard_GetDelayNs(pMe, Delay);
+	pMe->IsFirstBlock = false;
+
+	if(pMe->ReadBlock >= (pMe->Capacity / HOSTSDCARD_BLOCK_SIZE))
+	{
+		/* Error token, out of range */
+		static const uint8_t cOutOfRange = 0x08;
+
+		HostSdCard_Queue(pMe, &cOutOfRange, 1u);
+		pMe->ReadBlocksLeft = 0;
+		return;
+	}
+
+	HostSdCard_QueueDataPacket(pMe, &pMe->pImage[(size_t)pMe->ReadBlock * HOSTSDCARD_BLOCK_SIZE], HOSTSDCARD_BLOCK_SIZE);
+
+	pMe->ReadBlock++;
+	pMe->Stats.BlocksRead++;
+
+	if(UINT32_MAX != pMe->ReadBlocksLeft)
+	{
+		pMe->ReadBlocksLeft--;
+	}
+}
+
+/**
+ * @brief Byte the card drives on MISO
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ * @return uint8_t
+ */
+static uint8_t HostSdCard_NextMiso(sHostSdCard_t* const pMe, uint64_t Ns)
+{
+	if((0 == pMe->OutCount) && (pMe->ReadBlocksLeft > 0))
+	{
+		HostSdCard_LoadBlock(pMe, Ns);
+	}
+
+	if(pMe->OutCount > 0)
+	{
+		if(Ns < pMe->OutReadyNs)
+		{
+			return 0xFF;
+		}
+
+		pMe->OutCount--;
+		return pMe->Out[pMe->OutHead++];
+	}
+
+	/* Programming holds MISO low */
+	return (Ns < pMe->BusyUntilNs)? 0x00: 0xFF;
+}
+
+/**
+ * @brief Byte of a data packet written by the host
+ *
+ * @param pMe model instance
+ * @param Mosi byte from the host
+ * @param Ns current time
+ */
+static void HostSdCard_ReceiveWriteData(sHostSdCard_t* const pMe, uint8_t Mosi, uint64_t Ns)
+{
+	if(0 == pMe->WriteCount)
+	{
+		if((0xFD == Mosi) && (true == pMe->IsMultipleWrite))
+		{
+			pMe->IsWriting = false;
+			pMe->BusyUntilNs = Ns + HostSdCard_GetDelayNs(pMe, eHOSTSDCARD_TIME_STOP_BUSY);
+		}
+		else if(Mosi == ((true == pMe->IsMultipleWrite)? 0xFC: 0xFE))
+		{
+			pMe->WriteCount = 1u;
+		}
+
+		return;
+	}
+
+	pMe->WriteBuffer[pMe->WriteCount - 1u] = Mosi;
+	pMe->WriteCount++;
+
+	if(pMe->WriteCount <= sizeof(pMe->WriteBuffer))
+	{
+		return;
+	}
+
+	/* Data response: accepted, or write error past the end of the card */
+	uint8_t DataResponse = 0xE5;
+
+	if(pMe->WriteBlock < (pMe->Capacity / HOSTSDCARD_BLOCK_SIZE))
+	{
+		memcpy(&pMe->pImage[(size_t)pMe->WriteBlock * HOSTSDCARD_BLOCK_SIZE], pMe->WriteBuffer, HOSTSDCARD_BLOCK_SIZE);
+		pMe->Stats.BlocksWritten++;
+		pMe->BusyUntilNs = Ns + HostSdCard_GetDelayNs(pMe, eHOSTSDCARD_TIME_WRITE_BUSY);
+	}
+	else
+	{
+		DataResponse = 0xED;
+		pMe->IsMultipleWrite = false;
+	}
+
+	pMe->OutHead = 0;
+	pMe->OutCount = 0;
+	HostSdCard_Queue(pMe, &DataResponse, 1u);
+
+	pMe->WriteBlock++;
+	pMe->WriteCount = 0;
+	pMe->IsWriting = pMe->IsMultipleWrite;
+}
+
+/**
+ * @brief Check whether a command is accepted in idle state
+ *
+ * @param Command command index
+ * @param IsAppCommand true for ACMD
+ * @return true if accepted
+ */
+static bool HostSdCard_IsIdleCommand(uint8_t Command, bool IsAppCommand)
+{
+	if(true == IsAppCommand)
+	{
+		return (41u == Command);
+	}
+
+	return (0u == Command) || (8u == Command) || (55u == Command) || (58u == Command) || (59u == Command);
+}
+
+/**
+ * @brief Run a complete command packet
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ */
+static void HostSdCard_Execute(sHostSdCard_t* const pMe, uint64_t Ns)
+{
+	uint8_t Command = (uint8_t)(pMe->Command[0] & 0x3Fu);
+	uint32_t Argument = ((uint32_t)pMe->Command[1] << 24u) | ((uint32_t)pMe->Command[2] << 16u) | ((uint32_t)pMe->Command[3] << 8u) | pMe->Command[4];
+	uint32_t Blocks = (uint32_t)(pMe->Capacity / HOSTSDCARD_BLOCK_SIZE);
+	bool IsAppCommand = pMe->IsAppCommand;
+	uint8_t R1 = (true == pMe->IsIdle)? HOSTSDCARD_R1_IDLE: 0x00u;
+
+	pMe->Stats.Commands++;
+	pMe->IsAppCommand = false;
+
+	/* Any command ends a read, CMD12 is the one meant to */
+	pMe->ReadBlocksLeft = 0;
+	pMe->IsWriting = false;
+
+	/* Without CRC mode the card still checks the CRC of CMD0 and CMD8 */
+	if(((0u == Command) || (8u == Command)) && ((pMe->Command[5] >> 1u) != HostSdCard_Crc7(pMe->Command, 5u)))
+	{
+		R1 |= HOSTSDCARD_R1_CRC_ERROR;
+		HostSdCard_Respond(pMe, &R1, 1u);
+		return;
+	}
+
+	if((true == pMe->IsIdle) && (false == HostSdCard_IsIdleCommand(Command, IsAppCommand)))
+	{
+		R1 |= HOSTSDCARD_R1_ILLEGAL_COMMAND;
+		HostSdCard_Respond(pMe, &R1, 1u);
+		return;
+	}
+
+	if(true == IsAppCommand)
+	{
+		switch(Command)
+		{
+			case 41u:	/* SD_SEND_OP_COND */
+			{
+				if(UINT64_MAX == pMe->InitStartNs)
+				{
+					pMe->InitStartNs = Ns;
+				}
+
+				if((Ns - pMe->InitStartNs) >= ((uint64_t)gcTimingTable[eHOSTSDCARD_TIME_INIT].Us * 1000u))
+				{
+					if(true == pMe->IsIdle)
+					{
+						pMe->Stats.WaitNs[eHOSTSDCARD_TIME_INIT] += Ns - pMe->InitStartNs;
+					}
+
+					pMe->IsIdle = false;
+				}
+
+				R1 = (true == pMe->IsIdle)? HOSTSDCARD_R1_IDLE: 0x00u;
+				HostSdCard_Respond(pMe, &R1, 1u);
+				return;
+			}
+
+			case 13u:	/* SD_STATUS, R2 then the status block */
+			{
+				uint8_t Status[HOSTSDCARD_STATUS_SIZE] = {0};
+				const uint8_t cR2[2] = {R1, 0x00};
+				static const uint8_t cNac = 0xFF;
+
+				Status[8] = 0x04;	/* Speed class 10 */
+				Status[10] = 0x90;	/* 4 MB allocation unit */
+
+				HostSdCard_Respond(pMe, cR2, sizeof(cR2));
+				HostSdCard_Queue(pMe, &cNac, 1u);
+				HostSdCard_QueueDataPacket(pMe, Status, sizeof(Status));
+				return;
+			}
+
+			case 23u:	/* SET_WR_BLK_ERASE_COUNT, pre-erase hint */
+				HostSdCard_Respond(pMe, &R1, 1u);
+				return;
+
+			default:
+				break;
+		}
+	}
+
+	switch(Command)
+	{
+		case 0u:	/* GO_IDLE_STATE */
+			pMe->IsIdle = true;
+			R1 = HOSTSDCARD_R1_IDLE;
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 8u:	/* SEND_IF_COND, R7 echoes voltage and check pattern */
+		{
+			const uint8_t cR7[5] = {R1, 0x00, 0x00, (uint8_t)((Argument >> 8u) & 0x0Fu), (uint8_t)Argument};
+			HostSdCard_Respond(pMe, cR7, sizeof(cR7));
+			break;
+		}
+
+		case 55u:	/* APP_CMD */
+			pMe->IsAppCommand = true;
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 58u:	/* READ_OCR, busy bit set once powered up */
+		{
+			uint32_t Ocr = (true == pMe->IsIdle)? (HOSTSDCARD_OCR & 0x7FFFFFFFu): HOSTSDCARD_OCR;
+			const uint8_t cR3[5] = {R1, (uint8_t)(Ocr >> 24u), (uint8_t)(Ocr >> 16u), (uint8_t)(Ocr >> 8u), (uint8_t)Ocr};
+			HostSdCard_Respond(pMe, cR3, sizeof(cR3));
+			break;
+		}
+
+		case 9u:	/* SEND_CSD, version 2 */
+		{
+			uint32_t CSize = (uint32_t)(pMe->Capacity / HOSTSDCARD_CAPACITY_UNIT) - 1u;
+			uint8_t Csd[16] =
+			{
+					0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, (uint8_t)((CSize >> 16u) & 0x3Fu),
+					(uint8_t)(CSize >> 8u), (uint8_t)CSize, 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x00,
+			};
+			static const uint8_t cNac = 0xFF;
+
+			Csd[15] = (uint8_t)((HostSdCard_Crc7(Csd, 15u) << 1u) | 0x01u);
+
+			HostSdCard_Respond(pMe, &R1, 1u);
+			HostSdCard_Queue(pMe, &cNac, 1u);
+			HostSdCard_QueueDataPacket(pMe, Csd, sizeof(Csd));
+			break;
+		}
+
+		case 10u:	/* SEND_CID */
+		{
+			static const uint8_t cNac = 0xFF;
+
+			HostSdCard_Respond(pMe, &R1, 1u);
+			HostSdCard_Queue(pMe, &cNac, 1u);
+			HostSdCard_QueueDataPacket(pMe, gcCid, sizeof(gcCid));
+			break;
+		}
+
+		case 12u:	/* STOP_TRANSMISSION */
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 13u:	/* SEND_STATUS, R2 */
+		{
+			const uint8_t cR2[2] = {R1, 0x00};
+			HostSdCard_Respond(pMe, cR2, sizeof(cR2));
+			break;
+		}
+
+		case 16u:	/* SET_BLOCKLEN, fixed at 512 on SDHC */
+			R1 |= (HOSTSDCARD_BLOCK_SIZE == Argument)? 0x00u: HOSTSDCARD_R1_PARAMETER_ERROR;
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 17u:	/* READ_SINGLE_BLOCK */
+		case 18u:	/* READ_MULTIPLE_BLOCK */
+			if(Argument >= Blocks)
+			{
+				R1 |= HOSTSDCARD_R1_ADDRESS_ERROR;
+			}
+			else
+			{
+				pMe->ReadBlock = Argument;
+				pMe->ReadBlocksLeft = (17u == Command)? 1u: UINT32_MAX;
+				pMe->IsFirstBlock = true;
+				pMe->Stats.ReadCommands++;
+			}
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 24u:	/* WRITE_BLOCK */
+		case 25u:	/* WRITE_MULTIPLE_BLOCK */
+			if(Argument >= Blocks)
+			{
+				R1 |= HOSTSDCARD_R1_ADDRESS_ERROR;
+			}
+			else
+			{
+				pMe->IsWriting = true;
+				pMe->IsMultipleWrite = (25u == Command);
+				pMe->WriteBlock = Argument;
+				pMe->WriteCount = 0;
+				pMe->Stats.WriteCommands++;
+			}
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 32u:	/* ERASE_WR_BLK_START */
+		case 33u:	/* ERASE_WR_BLK_END */
+			if(Argument >= Blocks)
+			{
+				R1 |= HOSTSDCARD_R1_ADDRESS_ERROR;
+			}
+			else if(32u == Command)
+			{
+				pMe->EraseStart = Argument;
+			}
+			else
+			{
+				pMe->EraseEnd = Argument;
+			}
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 38u:	/* ERASE, erased blocks read back as zero */
+			if(pMe->EraseEnd >= pMe->EraseStart)
+			{
+				uint32_t Count = pMe->EraseEnd - pMe->EraseStart + 1u;
+				uint32_t Units = (Count + ((4u * 1024u * 1024u) / HOSTSDCARD_BLOCK_SIZE) - 1u) / ((4u * 1024u * 1024u) / HOSTSDCARD_BLOCK_SIZE);
+
+				memset(&pMe->pImage[(size_t)pMe->EraseStart * HOSTSDCARD_BLOCK_SIZE], 0x00, (size_t)Count * HOSTSDCARD_BLOCK_SIZE);
+				pMe->BusyUntilNs = Ns + (Units * HostSdCard_GetDelayNs(pMe, eHOSTSDCARD_TIME_ERASE_BUSY));
+			}
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+
+		case 59u:	/* CRC_ON_OFF, refused so the driver keeps CRC off. Its CRC path needs the SPI CRC unit. */
+		default:
+			R1 |= HOSTSDCARD_R1_ILLEGAL_COMMAND;
+			HostSdCard_Respond(pMe, &R1, 1u);
+			break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Map the card image, a missing image is created blank
+ *
+ * @param pPath image file
+ * @param Capacity size of a new image, an existing image keeps its own size
+ * @return true on success
+ */
+bool HostSdCard_Init(const char* pPath, size_t Capacity)
+{
+	sHostSdCard_t* pMe = HostSdCard_GetInstance();
+	struct stat FileStat;
+
+	assert(NULL != pPath);
+
+	int Fd = open(pPath, O_RDWR | O_CREAT, 0644);
+
+	if((Fd < 0) || (0 != fstat(Fd, &FileStat)))
+	{
+		perror(pPath);
+		return false;
+	}
+
+	if(0 != FileStat.st_size)
+	{
+		Capacity = (size_t)FileStat.st_size;
+	}
+	else if(0 != ftruncate(Fd, (off_t)Capacity))
+	{
+		perror(pPath);
+		close(Fd);
+		return false;
+	}
+
+	if((0 == Capacity) || (0 != (Capacity % HOSTSDCARD_CAPACITY_UNIT)))
+	{
+		fprintf(stderr, "%s: %zu bytes, image must be a multiple of %u bytes\n", pPath, Capacity, HOSTSDCARD_CAPACITY_UNIT);
+		close(Fd);
+		return false;
+	}
+
+	void* pImage = mmap(NULL, Capacity, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+
+	if(MAP_FAILED == pImage)
+	{
+		perror(pPath);
+		close(Fd);
+		return false;
+	}
+
+	memset(pMe, 0, sizeof(*pMe));
+	pMe->pImage = pImage;
+	pMe->Capacity = Capacity;
+	pMe->Fd = Fd;
+	pMe->IsIdle = true;
+	pMe->InitStartNs = UINT64_MAX;
+
+	return true;
+}
+
+/**
+ * @brief Write back and unmap the image
+ *
+ */
+void HostSdCard_DeInit(void)
+{
+	sHostSdCard_t* pMe = HostSdCard_GetInstance();
+
+	if(NULL != pMe->pImage)
+	{
+		msync(pMe->pImage, pMe->Capacity, MS_SYNC);
+		munmap(pMe->pImage, pMe->Capacity);
+		pMe->pImage = NULL;
+	}
+
+	if(pMe->Fd >= 0)
+	{
+		close(pMe->Fd);
+		pMe->Fd = -1;
+	}
+}
+
+/**
+ * @brief Chip select edge, a partly clocked command is dropped on release
+ *
+ * @param IsSelected true on the falling edge
+ * @param Ns current time
+ */
+void HostSdCard_Select(bool IsSelected, uint64_t Ns)
+{
+	sHostSdCard_t* pMe = HostSdCard_GetInstance();
+
+	(void)Ns;
+
+	pMe->IsSelected = IsSelected;
+
+	if(false == IsSelected)
+	{
+		pMe->CommandCount = 0;
+	}
+}
+
+/**
+ * @brief Clock a byte through the card
+ *
+ * @param Mosi byte from the host
+ * @param Ns time the byte is clocked
+ * @return uint8_t byte to the host, 0xFF while not selected
+ */
+uint8_t HostSdCard_Exchange(uint8_t Mosi, uint64_t Ns)
+{
+	sHostSdCard_t* pMe = HostSdCard_GetInstance();
+
+	if((NULL == pMe->pImage) || (false == pMe->IsSelected))
+	{
+		return 0xFF;
+	}
+
+	uint8_t Miso = HostSdCard_NextMiso(pMe, Ns);
+
+	if((true == pMe->IsWriting) && ((0 != pMe->WriteCount) || (0x40u != (Mosi & 0xC0u))))
+	{
+		HostSdCard_ReceiveWriteData(pMe, Mosi, Ns);
+		return Miso;
+	}
+
+	if((0 == pMe->CommandCount) && (0x40u != (Mosi & 0xC0u)))
+	{
+		return Miso;
+	}
+
+	pMe->Command[pMe->CommandCount++] = Mosi;
+
+	if(sizeof(pMe->Command) == pMe->CommandCount)
+	{
+		pMe->CommandCount = 0;
+		HostSdCard_Execute(pMe, Ns);
+	}
+
+	return Miso;
+}
+
+/**
+ * @brief Print command and block counts and the time spent waiting on the card
+ *
+ */
+void HostSdCard_PrintStatistics(void)
+{
+	sHostSdCard_t* pMe = HostSdCard_GetInstance();
+
+	printf("sd: %zu MB, %u commands, %u reads / %llu blocks, %u writes / %llu blocks\n", pMe->Capacity >> 20u, pMe->Stats.Commands,
+			pMe->Stats.ReadCommands, (unsigned long long)pMe->Stats.BlocksRead, pMe->Stats.WriteCommands, (unsigned long long)pMe->Stats.BlocksWritten);
+
+	for(uint32_t i = 0; i < eHOSTSDCARD_TIME_MAX; i++)
+	{
+		if(0 != pMe->Stats.WaitNs[i])
+		{
+			printf("sd: %-16s %10.3f ms\n", gcTimingTable[i].pName, (double)pMe->Stats.WaitNs[i] / 1e6);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,120 @@
+/**
+ * @file HostSdCard.h
+ * @author Vishal Keshava Murthy
+ * @brief SDHC card in SPI mode, backed by a disk image file. Answers the
+ * command set of the FatFs SPI driver and spends read access, block gap and
+ * write busy times of a class 10 card on the virtual clock.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SIM_HOSTSDCARD_H_
+#define HOST_SIM_HOSTSDCARD_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTSDCARD_BLOCK_SIZE			(512u)
+#define HOSTSDCARD_CAPACITY_DEFAULT		(64u * 1024u * 1024u)
+#define HOSTSDCARD_CAPACITY_UNIT		(512u * 1024u)		/**< CSD v2 counts capacity in 512 KB */
+#define HOSTSDCARD_OUT_SIZE				(HOSTSDCARD_BLOCK_SIZE + 8u)	/**< Longest response, a data block with token, CRC and padding */
+#define HOSTSDCARD_STATUS_SIZE			(64u)				/**< ACMD13 SD status block */
+#define HOSTSDCARD_OCR					(0xC0FF8000u)		/**< Powered up, CCS (block addressed), 2.7 - 3.6 V */
+
+#define HOSTSDCARD_R1_IDLE				(0x01u)
+#define HOSTSDCARD_R1_ILLEGAL_COMMAND	(0x04u)
+#define HOSTSDCARD_R1_CRC_ERROR			(0x08u)
+#define HOSTSDCARD_R1_ADDRESS_ERROR		(0x20u)
+#define HOSTSDCARD_R1_PARAMETER_ERROR	(0x40u)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Card delays spent on the virtual clock
+ *
+ */
+typedef enum
+{
+	eHOSTSDCARD_TIME_INIT,				/**< Power up until ACMD41 reports ready */
+	eHOSTSDCARD_TIME_READ_ACCESS,		/**< Command to first data token */
+	eHOSTSDCARD_TIME_BLOCK_GAP,			/**< Between blocks of a multiple block read */
+	eHOSTSDCARD_TIME_WRITE_BUSY,		/**< Data response to end of busy */
+	eHOSTSDCARD_TIME_STOP_BUSY,			/**< Stop token or CMD12 to end of busy */
+	eHOSTSDCARD_TIME_ERASE_BUSY,		/**< Per erased 4 MB allocation unit */
+	eHOSTSDCARD_TIME_MAX
+}eHostSdCardTime_t;
+
+typedef struct
+{
+	const char* pName;
+	uint32_t Us;
+}sHostSdCardTiming_t;
+
+/**
+ * @brief Counters printed after a run
+ *
+ */
+typedef struct
+{
+	uint32_t Commands;
+	uint32_t ReadCommands;				/**< CMD17 and CMD18 */
+	uint32_t WriteCommands;				/**< CMD24 and CMD25 */
+	uint64_t BlocksRead;
+	uint64_t BlocksWritten;
+	uint64_t WaitNs[eHOSTSDCARD_TIME_MAX];
+}sHostSdCardStatistics_t;
+
+/**
+ * @brief Card model
+ *
+ */
+typedef struct
+{
+	uint8_t* pImage;					/**< Image file mapped in memory */
+	size_t Capacity;
+	int Fd;
+	bool IsSelected;
+	bool IsIdle;						/**< In idle state since CMD0 */
+	bool IsAppCommand;					/**< Previous command was CMD55 */
+	uint64_t InitStartNs;				/**< First ACMD41, UINT64_MAX before it */
+	uint8_t Command[6];
+	uint8_t CommandCount;
+	uint8_t Out[HOSTSDCARD_OUT_SIZE];	/**< Bytes queued for MISO */
+	uint32_t OutHead;
+	uint32_t OutCount;
+	uint64_t OutReadyNs;				/**< MISO idles high until then, access time of a data block */
+	uint32_t ReadBlock;					/**< Next block of a read */
+	uint32_t ReadBlocksLeft;			/**< UINT32_MAX for an open ended CMD18 */
+	bool IsFirstBlock;					/**< Next block of the read waits the access time rather than the block gap */
+	bool IsWriting;						/**< CMD24 / CMD25 accepted, expecting data tokens */
+	bool IsMultipleWrite;
+	uint32_t WriteBlock;
+	uint32_t WriteCount;				/**< Bytes of the current data packet including its token, 0 while expecting a token */
+	uint8_t WriteBuffer[HOSTSDCARD_BLOCK_SIZE + 2u];
+	uint32_t EraseStart;
+	uint32_t EraseEnd;
+	uint64_t BusyUntilNs;				/**< MISO held low while programming */
+	sHostSdCardStatistics_t Stats;
+}sHostSdCard_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HostSdCard_Init(const char* pPath, size_t Capacity);
+void HostSdCard_DeInit(void);
+void HostSdCard_Select(bool IsSelected, uint64_t Ns);
+uint8_t HostSdCard_Exchange(uint8_t Mosi, uint64_t Ns);
+void HostSdCard_PrintStatistics(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* HOST_SIM_HOSTSDCARD_H_ */
@@ -0,0 +1,488 @@
+/**
+ * @file HostUart.c
+ * @author Vishal Keshava Murthy
+ * @brief Console line of the host simulation, USART1 receive path with circular DMA
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Output delay flags of termios.h take the names of USART control registers */
+#undef CR0
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include "HostUart.h"
+#include "HostClock.h"
+#include "HostHal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTUART_INSTANCE		(USART1)
+#define HOSTUART_RX_DMA			(DMA1_Channel5)
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sHostUart_t gHostUart = {.PtyFd = -1, .OutFd = STDOUT_FILENO};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void HostUart_cbWire(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get model instance
+ *
+ * @return sHostUart_t*
+ */
+static sHostUart_t* HostUart_GetInstance()
+{
+	return &gHostUart;
+}
+
+/**
+ * @brief Time of one frame at the rate programmed in BRR
+ *
+ * @return uint64_t nanoseconds
+ */
+static uint64_t HostUart_GetFrameNs()
+{
+	uint32_t Brr = HOSTUART_INSTANCE->BRR;
+
+	if(0 == Brr)
+	{
+		Brr = HOSTCLOCK_PCLK2_HZ / 115200u;
+	}
+
+	/* Oversampling by 16, BRR holds the divider in 1/16 so the rate is PCLK2 / BRR */
+	return ((uint64_t)HOSTUART_FRAME_BITS * Brr * 1000000000u) / HOSTCLOCK_PCLK2_HZ;
+}
+
+/**
+ * @brief Line stayed quiet for a frame after the last byte
+ *
+ */
+static void HostUart_cbIdle(void)
+{
+	SET_BIT(HOSTUART_INSTANCE->SR, USART_SR_IDLE);
+
+	if(0 != (HOSTUART_INSTANCE->CR1 & USART_CR1_IDLEIE))
+	{
+		HostClock_Schedule(eHOSTCLOCK_EVENT_USART1, HostClock_GetNs(), USART1_IRQn, HostHal_Usart1IRQHandler);
+	}
+}
+
+/**
+ * @brief Move a received byte through DMA channel 5 into memory
+ *
+ * @param pMe model instance
+ * @param Data byte
+ */
+static void HostUart_DmaWrite(sHostUart_t* const pMe, uint8_t Data)
+{
+	DMA_Channel_TypeDef* pChannel = HOSTUART_RX_DMA;
+
+	if(false == pMe->IsDmaRunning)
+	{
+		pMe->DmaReload = pChannel->CNDTR;
+		pMe->IsDmaRunning = true;
+	}
+
+	if(0 == pChannel->CNDTR)
+	{
+		return;
+	}
+
+	uint8_t* pMemory = (uint8_t*)(uintptr_t)pChannel->CMAR;
+	uint32_t Index = (0 != (pChannel->CCR & DMA_CCR_MINC))? (pMe->DmaReload - pChannel->CNDTR): 0u;
+
+	pMemory[Index] = Data;
+	pChannel->CNDTR--;
+
+	bool IsInterrupt = false;
+
+	if((pMe->DmaReload / 2u) == pChannel->CNDTR)
+	{
+		SET_BIT(DMA1->ISR, DMA_ISR_GIF5 | DMA_ISR_HTIF5);
+		IsInterrupt = (0 != (pChannel->CCR & DMA_CCR_HTIE));
+	}
+
+	if(0 == pChannel->CNDTR)
+	{
+		SET_BIT(DMA1->ISR, DMA_ISR_GIF5 | DMA_ISR_TCIF5);
+		IsInterrupt = (0 != (pChannel->CCR & DMA_CCR_TCIE));
+
+		if(0 != (pChannel->CCR & DMA_CCR_CIRC))
+		{
+			pChannel->CNDTR = pMe->DmaReload;
+		}
+	}
+
+	if(true == IsInterrupt)
+	{
+		HostClock_Schedule(eHOSTCLOCK_EVENT_DMA1_CH5, HostClock_GetNs(), DMA1_Channel5_IRQn, HostHal_Dma1Channel5IRQHandler);
+	}
+}
+
+/**
+ * @brief A byte finished arriving in the receiver
+ *
+ * @param pMe model instance
+ * @param Data byte
+ */
+static void HostUart_Receive(sHostUart_t* const pMe, uint8_t Data)
+{
+	USART_TypeDef* pUart = HOSTUART_INSTANCE;
+
+	pMe->Stats.BytesReceived++;
+
+	if((0 != (pUart->CR3 & USART_CR3_DMAR)) && (0 != (HOSTUART_RX_DMA->CCR & DMA_CCR_EN)))
+	{
+		HostUart_DmaWrite(pMe, Data);
+	}
+	else
+	{
+		pMe->IsDmaRunning = false;
+
+		if(0 != (pUart->SR & USART_SR_RXNE))
+		{
+			SET_BIT(pUart->SR, USART_SR_ORE);
+			pMe->Stats.Overruns++;
+		}
+		else
+		{
+			pUart->DR = Data;
+			SET_BIT(pUart->SR, USART_SR_RXNE);
+		}
+
+		if(0 != (pUart->CR1 & USART_CR1_RXNEIE))
+		{
+			HostClock_Schedule(eHOSTCLOCK_EVENT_USART1, HostClock_GetNs(), USART1_IRQn, HostHal_Usart1IRQHandler);
+		}
+	}
+
+	HostClock_Cancel(eHOSTCLOCK_EVENT_UART_IDLE);
+	HostClock_Schedule(eHOSTCLOCK_EVENT_UART_IDLE, HostClock_GetNs() + HostUart_GetFrameNs(), HOSTCLOCK_NO_IRQ, HostUart_cbIdle);
+}
+
+/**
+ * @brief Start clocking the next byte of the wire in
+ *
+ * @param pMe model instance
+ */
+static void HostUart_ScheduleWire(sHostUart_t* const pMe)
+{
+	if(pMe->WireCount > 0)
+	{
+		HostClock_Schedule(eHOSTCLOCK_EVENT_UART_WIRE, HostClock_GetNs() + HostUart_GetFrameNs(), HOSTCLOCK_NO_IRQ, HostUart_cbWire);
+	}
+}
+
+/**
+ * @brief Frame time of the byte at the head of the wire is over
+ *
+ */
+static void HostUart_cbWire(void)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+
+	if(0 == pMe->WireCount)
+	{
+		return;
+	}
+
+	uint8_t Data = pMe->Wire[pMe->WireHead];
+
+	pMe->WireHead = (pMe->WireHead + 1u) % HOSTUART_WIRE_SIZE;
+	pMe->WireCount--;
+
+	if(0 != (HOSTUART_INSTANCE->CR1 & USART_CR1_RE))
+	{
+		HostUart_Receive(pMe, Data);
+	}
+
+	HostUart_ScheduleWire(pMe);
+}
+
+/**
+ * @brief Hand transmitted bytes to the far end
+ *
+ * @param pMe model instance
+ * @param pData bytes
+ * @param Length number of bytes
+ */
+static void HostUart_Write(sHostUart_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	while(Length > 0)
+	{
+		ssize_t Written = write(pMe->OutFd, pData, Length);
+
+		if(Written > 0)
+		{
+			pData += Written;
+			Length -= (uint32_t)Written;
+		}
+		else if((Written < 0) && (EINTR != errno) && (EAGAIN != errno))
+		{
+			break;
+		}
+		else if((Written < 0) && (EAGAIN == errno))
+		{
+			/* Far end is not reading, the pseudo terminal is full */
+			struct timespec Sleep = {.tv_sec = 0, .tv_nsec = 1000000};
+			nanosleep(&Sleep, NULL);
+		}
+	}
+}
+
+/**
+ * @brief Tick poll hook, picks up what the far end sent on the pseudo terminal
+ *
+ */
+static void HostUart_cbPoll(void)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+	uint64_t Ns = HostClock_GetNs();
+
+	if(Ns < pMe->NextPollNs)
+	{
+		return;
+	}
+
+	pMe->NextPollNs = Ns + HOSTUART_POLL_PERIOD_NS;
+
+	/* Take no more than the wire holds, the rest waits in the pseudo terminal as a UART would hold off the sender */
+	uint8_t Buffer[256];
+	size_t Room = HOSTUART_WIRE_SIZE - pMe->WireCount;
+
+	if(0 == Room)
+	{
+		return;
+	}
+
+	ssize_t Length = read(pMe->PtyFd, Buffer, (Room < sizeof(Buffer))? Room: sizeof(Buffer));
+
+	if(Length > 0)
+	{
+		HostUart_Feed(Buffer, (uint32_t)Length);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Open the console line. With a pseudo terminal its name is printed and
+ * the simulation waits for the far end to open it, so nothing printed at boot
+ * is lost. Virtual time then runs at wall clock speed for the far end's sake.
+ *
+ * @param IsPty true for a pseudo terminal, false to print to stdout
+ * @param pCapturePath without a pseudo terminal, file transmitted bytes go to instead of stdout. NULL for stdout.
+ * @return true on success
+ */
+bool HostUart_Init(bool IsPty, const char* pCapturePath)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+
+	memset(pMe, 0, sizeof(*pMe));
+	pMe->PtyFd = -1;
+	pMe->OutFd = STDOUT_FILENO;
+
+	if((false == IsPty) && (NULL != pCapturePath))
+	{
+		int Fd = open(pCapturePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if(Fd < 0)
+		{
+			perror(pCapturePath);
+			return false;
+		}
+
+		pMe->OutFd = Fd;
+		pMe->IsOutFile = true;
+	}
+
+	if(false == IsPty)
+	{
+		return true;
+	}
+
+	int Fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if((Fd < 0) || (0 != grantpt(Fd)) || (0 != unlockpt(Fd)) || (NULL == ptsname(Fd)))
+	{
+		perror("pty");
+		return false;
+	}
+
+	struct termios Termios;
+
+	if(0 == tcgetattr(Fd, &Termios))
+	{
+		cfmakeraw(&Termios);
+		(void)tcsetattr(Fd, TCSANOW, &Termios);
+	}
+
+	snprintf(pMe->PtyName, sizeof(pMe->PtyName), "%s", ptsname(Fd));
+	fprintf(stderr, "console on %s, waiting for it to be opened\n", pMe->PtyName);
+
+	/* The master reports hang up until the slave side is opened */
+	struct pollfd Poll = {.fd = Fd, .events = POLLIN};
+
+	while((poll(&Poll, 1, 0) >= 0) && (0 != (Poll.revents & POLLHUP)))
+	{
+		struct timespec Sleep = {.tv_sec = 0, .tv_nsec = 50000000};
+		nanosleep(&Sleep, NULL);
+	}
+
+	(void)fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK);
+
+	pMe->PtyFd = Fd;
+	pMe->OutFd = Fd;
+
+	HostClock_SetPollHook(HostUart_cbPoll);
+
+	return true;
+}
+
+/**
+ * @brief Close the pseudo terminal
+ *
+ */
+void HostUart_DeInit(void)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+
+	HostClock_SetPollHook(NULL);
+
+	if(pMe->PtyFd >= 0)
+	{
+		/* Let the far end read the last lines */
+		(void)tcdrain(pMe->PtyFd);
+		close(pMe->PtyFd);
+		pMe->PtyFd = -1;
+	}
+
+	if(true == pMe->IsOutFile)
+	{
+		close(pMe->OutFd);
+		pMe->IsOutFile = false;
+	}
+
+	pMe->OutFd = STDOUT_FILENO;
+}
+
+/**
+ * @brief Send bytes to the far end, the caller is blocked for their frame times
+ *
+ * @param pData bytes
+ * @param Length number of bytes
+ */
+void HostUart_Transmit(const uint8_t* pData, uint32_t Length)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+	uint64_t SendNs = HostUart_GetFrameNs() * Length;
+
+	assert(NULL != pData);
+
+	pMe->Stats.BytesSent += Length;
+	pMe->Stats.SendNs += SendNs;
+
+	HostUart_Write(pMe, pData, Length);
+
+	HostClock_Advance(SendNs);
+}
+
+/**
+ * @brief Send bytes a DMA channel moves into the transmitter, the caller
+ * carries on and schedules completion after their frame times
+ *
+ * @param pData bytes
+ * @param Length number of bytes
+ * @return uint64_t nanoseconds until the last byte is in the transmitter
+ */
+uint64_t HostUart_TransmitDma(const uint8_t* pData, uint32_t Length)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+
+	assert(NULL != pData);
+
+	pMe->Stats.BytesSent += Length;
+	pMe->Stats.DmaBytes += Length;
+
+	HostUart_Write(pMe, pData, Length);
+
+	return HostUart_GetFrameNs() * Length;
+}
+
+/**
+ * @brief Put bytes on the receive line, clocked in one frame time apart
+ *
+ * @param pData bytes
+ * @param Length number of bytes
+ */
+void HostUart_Feed(const uint8_t* pData, uint32_t Length)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+	bool IsIdle = (0 == pMe->WireCount);
+
+	for(uint32_t i = 0; i < Length; i++)
+	{
+		if(pMe->WireCount >= HOSTUART_WIRE_SIZE)
+		{
+			pMe->Stats.WireDrops += Length - i;
+			break;
+		}
+
+		pMe->Wire[(pMe->WireHead + pMe->WireCount) % HOSTUART_WIRE_SIZE] = pData[i];
+		pMe->WireCount++;
+	}
+
+	if(true == IsIdle)
+	{
+		HostUart_ScheduleWire(pMe);
+	}
+}
+
+/**
+ * @brief Check that nothing the far end sent was thrown away for a full wire
+ *
+ * @return true if no byte was dropped
+ */
+bool HostUart_IsLossless(void)
+{
+	return (0 == HostUart_GetInstance()->Stats.WireDrops);
+}
+
+/**
+ * @brief Print byte counts and time spent transmitting
+ *
+ */
+void HostUart_PrintStatistics(void)
+{
+	sHostUart_t* pMe = HostUart_GetInstance();
+
+	printf("uart: %llu bytes sent (%llu over DMA), blocked %.3f ms, %llu received, %u overruns, %u dropped on the wire\n",
+			(unsigned long long)pMe->Stats.BytesSent, (unsigned long long)pMe->Stats.DmaBytes, (double)pMe->Stats.SendNs / 1e6,
+			(unsigned long long)pMe->Stats.BytesReceived, pMe->Stats.Overruns, pMe->Stats.WireDrops);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,81 @@
+/**
+ * @file HostUart.h
+ * @author Vishal Keshava Murthy
+ * @brief Console line of the host simulation. The far end is a pseudo terminal
+ * a terminal program or transfer tool opens, or plain stdout or a capture file
+ * for batch runs.
+ * Bytes take their frame time at the rate programmed in USART1 BRR in both
+ * directions, and received bytes land in USART1 and DMA1 channel 5 registers
+ * as they would on target.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SIM_HOSTUART_H_
+#define HOST_SIM_HOSTUART_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTUART_WIRE_SIZE			(4096u)		/**< Bytes from the far end not yet clocked into the receiver */
+#define HOSTUART_POLL_PERIOD_NS		(1000000u)	/**< Far end is checked for input once per this much virtual time */
+#define HOSTUART_FRAME_BITS			(10u)		/**< 8N1 */
+#define HOSTUART_NAME_SIZE			(64u)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Counters printed after a run
+ *
+ */
+typedef struct
+{
+	uint64_t BytesSent;
+	uint64_t DmaBytes;					/**< Part of BytesSent moved by transmit DMA, the firmware carried on meanwhile */
+	uint64_t BytesReceived;
+	uint64_t SendNs;					/**< Time the firmware spent blocked on transmission */
+	uint32_t Overruns;					/**< Bytes lost to a full receive register */
+	uint32_t WireDrops;					/**< Bytes from the far end dropped for a full wire buffer */
+}sHostUartStatistics_t;
+
+/**
+ * @brief Console line model
+ *
+ */
+typedef struct
+{
+	int PtyFd;							/**< Pseudo terminal master, -1 without one */
+	int OutFd;							/**< Where transmitted bytes go */
+	bool IsOutFile;						/**< OutFd is a capture file opened by @ref HostUart_Init */
+	char PtyName[HOSTUART_NAME_SIZE];
+	uint8_t Wire[HOSTUART_WIRE_SIZE];
+	uint32_t WireHead;
+	uint32_t WireCount;
+	uint64_t NextPollNs;
+	uint32_t DmaReload;					/**< CNDTR as programmed, reloaded in circular mode */
+	bool IsDmaRunning;					/**< Channel seen enabled, DmaReload is valid */
+	sHostUartStatistics_t Stats;
+}sHostUart_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HostUart_Init(bool IsPty, const char* pCapturePath);
+void HostUart_DeInit(void);
+void HostUart_Transmit(const uint8_t* pData, uint32_t Length);
+uint64_t HostUart_TransmitDma(const uint8_t* pData, uint32_t Length);
+void HostUart_Feed(const uint8_t* pData, uint32_t Length);
+bool HostUart_IsLossless(void);
+void HostUart_PrintStatistics(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* HOST_SIM_HOSTUART_H_ */
@@ -0,0 +1,738 @@
+/**
+ * @file HostW25q.c
+ * @author Vishal Keshava Murthy
+ * @brief File backed W25Q serial NOR flash model
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HostW25q.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief W25Q128JV datasheet times, chip erase is scaled to the density at init
+ */
+static const sHostW25qTiming_t gcTimingTable[eHOSTW25Q_OP_MAX] =
+{
+		[eHOSTW25Q_OP_PAGE_PROGRAM]		= {.pName = "Page program",		.TypicalUs = 400u,		.MaxUs = 3000u},
+		[eHOSTW25Q_OP_SECTOR_ERASE]		= {.pName = "Sector erase",		.TypicalUs = 45000u,	.MaxUs = 400000u},
+		[eHOSTW25Q_OP_BLOCK32_ERASE]	= {.pName = "32K block erase",	.TypicalUs = 120000u,	.MaxUs = 1600000u},
+		[eHOSTW25Q_OP_BLOCK_ERASE]		= {.pName = "64K block erase",	.TypicalUs = 150000u,	.MaxUs = 2000000u},
+		[eHOSTW25Q_OP_CHIP_ERASE]		= {.pName = "Chip erase",		.TypicalUs = 0u,		.MaxUs = 0u},
+		[eHOSTW25Q_OP_WRITE_STATUS]		= {.pName = "Status write",		.TypicalUs = 10000u,	.MaxUs = 15000u},
+};
+
+static const uint8_t gcUniqueId[HOSTW25Q_UNIQUE_ID_SIZE] = {0xD2, 0x63, 0x8C, 0x13, 0x47, 0x1F, 0x2E, 0x29};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sHostW25q_t gHostW25q = {.Fd = -1};
+static sHostW25qTiming_t gTiming[eHOSTW25Q_OP_MAX];
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get model instance
+ *
+ * @return sHostW25q_t*
+ */
+static sHostW25q_t* HostW25q_GetInstance()
+{
+	return &gHostW25q;
+}
+
+/**
+ * @brief Encode a time into an SFDP count / unit field, smallest unit that fits 5 count bits
+ *
+ * @param TimeUs time
+ * @param pcUnitsUs units selectable by the field, ascending
+ * @param UnitCount number of units
+ * @param UnitShift position of the unit bits in the field
+ * @return uint32_t field
+ */
+static uint32_t HostW25q_SfdpEncodeTime(uint32_t TimeUs, const uint32_t* pcUnitsUs, uint32_t UnitCount, uint32_t UnitShift)
+{
+	uint32_t Unit = 0;
+
+	while(((Unit + 1u) < UnitCount) && (((TimeUs + pcUnitsUs[Unit] - 1u) / pcUnitsUs[Unit]) > 32u))
+	{
+		Unit++;
+	}
+
+	uint32_t Count = (TimeUs + pcUnitsUs[Unit] - 1u) / pcUnitsUs[Unit];
+
+	Count = (0u == Count)? 1u: ((Count > 32u)? 32u: Count);
+
+	return (Unit << UnitShift) | (Count - 1u);
+}
+
+/**
+ * @brief Encode the typical to maximum ratio of a group of operations into an SFDP multiplier field
+ *
+ * @param Operation operation with the ratio
+ * @return uint32_t field, maximum = 2 * (field + 1) * typical
+ */
+static uint32_t HostW25q_SfdpEncodeMultiplier(eHostW25qOperation_t Operation)
+{
+	uint32_t Ratio = (gTiming[Operation].MaxUs + gTiming[Operation].TypicalUs - 1u) / gTiming[Operation].TypicalUs;
+	uint32_t Field = (Ratio + 1u) / 2u;
+
+	Field = (0u == Field)? 0u: (Field - 1u);
+
+	return (Field > 15u)? 15u: Field;
+}
+
+/**
+ * @brief Store a little endian DWORD of the basic flash parameter table
+ *
+ * @param pMe model instance
+ * @param Dword DWORD number as numbered by JESD216, starting at 1
+ * @param Value value
+ */
+static void HostW25q_SfdpSetDword(sHostW25q_t* const pMe, uint32_t Dword, uint32_t Value)
+{
+	uint8_t* pData = &pMe->Sfdp[HOSTW25Q_SFDP_TABLE_ADDRESS + ((Dword - 1u) * 4u)];
+
+	pData[0] = (uint8_t)Value;
+	pData[1] = (uint8_t)(Value >> 8u);
+	pData[2] = (uint8_t)(Value >> 16u);
+	pData[3] = (uint8_t)(Value >> 24u);
+}
+
+/**
+ * @brief Build the SFDP space, a single JESD216B basic flash parameter table
+ * advertising the geometry and typical times of the model
+ *
+ * @param pMe model instance
+ */
+static void HostW25q_BuildSfdp(sHostW25q_t* const pMe)
+{
+	static const uint32_t cEraseUnitsUs[] = {1000u, 16000u, 128000u, 1000000u};
+	static const uint32_t cProgramUnitsUs[] = {8u, 64u};
+	static const uint32_t cChipEraseUnitsUs[] = {16000u, 256000u, 4000000u, 64000000u};
+	static const uint8_t cHeader[16] =
+	{
+			'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+			0x00, 0x06, 0x01, HOSTW25Q_SFDP_TABLE_DWORDS, HOSTW25Q_SFDP_TABLE_ADDRESS, 0x00, 0x00, 0xFF,
+	};
+
+	memset(pMe->Sfdp, 0xFF, sizeof(pMe->Sfdp));
+	memcpy(pMe->Sfdp, cHeader, sizeof(cHeader));
+
+	uint32_t AddressMode = (pMe->Capacity > HOSTW25Q_3BYTE_ADDRESS_LIMIT)? 1u: 0u;
+
+	HostW25q_SfdpSetDword(pMe, 1, 0xFFF00000u | (AddressMode << 17u) | (1u << 16u) | (0x20u << 8u) | 0xE5u);
+	HostW25q_SfdpSetDword(pMe, 2, (uint32_t)(pMe->Capacity * 8u) - 1u);
+	HostW25q_SfdpSetDword(pMe, 8, (0x52u << 24u) | (15u << 16u) | (0x20u << 8u) | 12u);
+	HostW25q_SfdpSetDword(pMe, 9, (0x00u << 24u) | (0u << 16u) | (0xD8u << 8u) | 16u);
+
+	uint32_t EraseTimes = HostW25q_SfdpEncodeMultiplier(eHOSTW25Q_OP_SECTOR_ERASE);
+
+	EraseTimes |= HostW25q_SfdpEncodeTime(gTiming[eHOSTW25Q_OP_SECTOR_ERASE].TypicalUs, cEraseUnitsUs, 4u, 5u) << 4u;
+	EraseTimes |= HostW25q_SfdpEncodeTime(gTiming[eHOSTW25Q_OP_BLOCK32_ERASE].TypicalUs, cEraseUnitsUs, 4u, 5u) << 11u;
+	EraseTimes |= HostW25q_SfdpEncodeTime(gTiming[eHOSTW25Q_OP_BLOCK_ERASE].TypicalUs, cEraseUnitsUs, 4u, 5u) << 18u;
+	HostW25q_SfdpSetDword(pMe, 10, EraseTimes);
+
+	uint32_t ProgramTimes = HostW25q_SfdpEncodeMultiplier(eHOSTW25Q_OP_PAGE_PROGRAM);
+
+	ProgramTimes |= 8u << 4u;
+	ProgramTimes |= HostW25q_SfdpEncodeTime(gTiming[eHOSTW25Q_OP_PAGE_PROGRAM].TypicalUs, cProgramUnitsUs, 2u, 5u) << 8u;
+	ProgramTimes |= HostW25q_SfdpEncodeTime(gTiming[eHOSTW25Q_OP_CHIP_ERASE].TypicalUs, cChipEraseUnitsUs, 4u, 5u) << 24u;
+	HostW25q_SfdpSetDword(pMe, 11, ProgramTimes);
+}
+
+/**
+ * @brief Check whether an operation is still running
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ * @return true while busy
+ */
+static bool HostW25q_IsBusy(const sHostW25q_t* const pMe, uint64_t Ns)
+{
+	return (Ns < pMe->BusyUntilNs);
+}
+
+/**
+ * @brief Start an operation that keeps the part busy
+ *
+ * @param pMe model instance
+ * @param Operation operation
+ * @param Ns current time
+ * @param Fraction share of the datasheet time taken, in 1/256 (page program of part of a page)
+ */
+static void HostW25q_StartBusy(sHostW25q_t* const pMe, eHostW25qOperation_t Operation, uint64_t Ns, uint32_t Fraction)
+{
+	uint32_t TimeUs = (true == pMe->IsWorstCase)? gTiming[Operation].MaxUs: gTiming[Operation].TypicalUs;
+	uint64_t BusyNs = ((uint64_t)TimeUs * 1000u * Fraction) / 256u;
+
+	pMe->BusyUntilNs = Ns + BusyNs;
+	pMe->IsWriteEnabled = false;
+	pMe->Stats.Operations[Operation]++;
+	pMe->Stats.BusyNs[Operation] += BusyNs;
+}
+
+/**
+ * @brief Erase a naturally aligned region
+ *
+ * @param pMe model instance
+ * @param Operation erase operation
+ * @param Size region size
+ * @param Ns current time
+ */
+static void HostW25q_Erase(sHostW25q_t* const pMe, eHostW25qOperation_t Operation, size_t Size, uint64_t Ns)
+{
+	size_t Start = (pMe->Address % pMe->Capacity) & ~(Size - 1u);
+
+	memset(&pMe->pArray[Start], 0xFF, Size);
+	HostW25q_StartBusy(pMe, Operation, Ns, 256u);
+}
+
+/**
+ * @brief Program the page buffer, bits can only go from 1 to 0
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ */
+static void HostW25q_Program(sHostW25q_t* const pMe, uint64_t Ns)
+{
+	if(0 == pMe->DataCount)
+	{
+		return;
+	}
+
+	size_t PageStart = (pMe->Address % pMe->Capacity) & ~((size_t)HOSTW25Q_PAGE_SIZE - 1u);
+	uint32_t Length = (pMe->DataCount > HOSTW25Q_PAGE_SIZE)? HOSTW25Q_PAGE_SIZE: pMe->DataCount;
+
+	for(uint32_t i = 0; i < HOSTW25Q_PAGE_SIZE; i++)
+	{
+		uint8_t* pCell = &pMe->pArray[PageStart + i];
+
+		if(0 != (pMe->PageBuffer[i] & (uint8_t)~*pCell))
+		{
+			pMe->Stats.BitsSetByProgram++;
+		}
+
+		*pCell &= pMe->PageBuffer[i];
+	}
+
+	pMe->Stats.BytesProgrammed += Length;
+	HostW25q_StartBusy(pMe, eHOSTW25Q_OP_PAGE_PROGRAM, Ns, Length);
+}
+
+/**
+ * @brief Decode an opcode into the phases that follow it
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ */
+static void HostW25q_DecodeOpcode(sHostW25q_t* const pMe, uint64_t Ns)
+{
+	uint8_t AddressBytes = (true == pMe->Is4ByteMode)? 4u: 3u;
+
+	pMe->AddressBytes = 0;
+	pMe->AddressCount = 0;
+	pMe->Address = 0;
+	pMe->DummyLeft = 0;
+	pMe->DataCount = 0;
+	pMe->Phase = eHOSTW25Q_PHASE_DATA;
+
+	/* Only status reads get through while busy */
+	if((true == HostW25q_IsBusy(pMe, Ns)) && (0x05 != pMe->Opcode) && (0x35 != pMe->Opcode) && (0x15 != pMe->Opcode))
+	{
+		pMe->Stats.CommandsWhileBusy++;
+		pMe->Phase = eHOSTW25Q_PHASE_IGNORE;
+		return;
+	}
+
+	switch(pMe->Opcode)
+	{
+		case 0x03:	/* Read */
+		case 0x02:	/* Page program */
+		case 0x20:	/* Sector erase */
+		case 0x52:	/* 32K block erase */
+		case 0xD8:	/* 64K block erase */
+			pMe->AddressBytes = AddressBytes;
+			break;
+
+		case 0x13:	/* Read, 4 byte address */
+		case 0x12:	/* Page program, 4 byte address */
+		case 0x21:	/* Sector erase, 4 byte address */
+		case 0x5C:	/* 32K block erase, 4 byte address */
+		case 0xDC:	/* 64K block erase, 4 byte address */
+			pMe->AddressBytes = 4u;
+			break;
+
+		case 0x0B:	/* Fast read */
+			pMe->AddressBytes = AddressBytes;
+			pMe->DummyLeft = 1u;
+			break;
+
+		case 0x0C:	/* Fast read, 4 byte address */
+			pMe->AddressBytes = 4u;
+			pMe->DummyLeft = 1u;
+			break;
+
+		case 0x5A:	/* SFDP, always 3 byte address */
+			pMe->AddressBytes = 3u;
+			pMe->DummyLeft = 1u;
+			break;
+
+		case 0x4B:	/* Unique ID */
+			pMe->DummyLeft = 4u;
+			break;
+
+		case 0xAB:	/* Release power down, device ID */
+		case 0x90:	/* Manufacturer / device ID */
+			pMe->DummyLeft = 3u;
+			break;
+
+		case 0x06:	/* Write enable */
+			pMe->IsWriteEnabled = true;
+			pMe->Phase = eHOSTW25Q_PHASE_IGNORE;
+			break;
+
+		case 0x04:	/* Write disable */
+			pMe->IsWriteEnabled = false;
+			pMe->Phase = eHOSTW25Q_PHASE_IGNORE;
+			break;
+
+		default:
+			break;
+	}
+
+	if(0 != pMe->AddressBytes)
+	{
+		pMe->Phase = eHOSTW25Q_PHASE_ADDRESS;
+	}
+	else if(0 != pMe->DummyLeft)
+	{
+		pMe->Phase = eHOSTW25Q_PHASE_DUMMY;
+	}
+
+	if((0x02 == pMe->Opcode) || (0x12 == pMe->Opcode))
+	{
+		memset(pMe->PageBuffer, 0xFF, sizeof(pMe->PageBuffer));
+	}
+}
+
+/**
+ * @brief Data phase of the command in progress
+ *
+ * @param pMe model instance
+ * @param Mosi byte from the host
+ * @param Ns current time
+ * @return uint8_t byte to the host
+ */
+static uint8_t HostW25q_Data(sHostW25q_t* const pMe, uint8_t Mosi, uint64_t Ns)
+{
+	uint8_t Miso = 0xFF;
+	uint32_t Index = pMe->DataCount++;
+
+	switch(pMe->Opcode)
+	{
+		case 0x03:
+		case 0x0B:
+		case 0x13:
+		case 0x0C:
+			Miso = pMe->pArray[(pMe->Address + Index) % pMe->Capacity];
+			pMe->Stats.BytesRead++;
+			break;
+
+		case 0x02:
+		case 0x12:
+			/* Address wraps inside the page, the last bytes clocked in win */
+			pMe->PageBuffer[(pMe->Address + Index) % HOSTW25Q_PAGE_SIZE] = Mosi;
+			break;
+
+		case 0x05:
+			Miso = (uint8_t)(((true == HostW25q_IsBusy(pMe, Ns))? 0x03u: 0x00u) | ((true == pMe->IsWriteEnabled)? 0x02u: 0x00u));
+			break;
+
+		case 0x35:
+			Miso = 0x00;
+			break;
+
+		case 0x15:
+			Miso = (true == pMe->Is4ByteMode)? 0x01u: 0x00u;
+			break;
+
+		case 0x9F:
+		{
+			uint8_t CapacityCode = 0;
+			while(((size_t)1u << CapacityCode) < pMe->Capacity)
+			{
+				CapacityCode++;
+			}
+			const uint8_t cJedecId[3] = {HOSTW25Q_MANUFACTURER_ID, HOSTW25Q_MEMORY_TYPE, CapacityCode};
+			Miso = (Index < sizeof(cJedecId))? cJedecId[Index]: 0xFF;
+			break;
+		}
+
+		case 0x5A:
+			Miso = pMe->Sfdp[(pMe->Address + Index) % HOSTW25Q_SFDP_SIZE];
+			break;
+
+		case 0x4B:
+			Miso = (Index < HOSTW25Q_UNIQUE_ID_SIZE)? gcUniqueId[Index]: 0xFF;
+			break;
+
+		default:
+			break;
+	}
+
+	return Miso;
+}
+
+/**
+ * @brief Chip select released, commands that act on the whole transaction run now
+ *
+ * @param pMe model instance
+ * @param Ns current time
+ */
+static void HostW25q_Execute(sHostW25q_t* const pMe, uint64_t Ns)
+{
+	if(eHOSTW25Q_PHASE_IGNORE == pMe->Phase)
+	{
+		return;
+	}
+
+	bool IsAddressComplete = (pMe->AddressCount == pMe->AddressBytes);
+	bool IsWrite = false;
+
+	switch(pMe->Opcode)
+	{
+		case 0x02: case 0x12:
+		case 0x20: case 0x21:
+		case 0x52: case 0x5C:
+		case 0xD8: case 0xDC:
+		case 0xC7: case 0x60:
+		case 0x01: case 0x31: case 0x11:
+			IsWrite = true;
+			break;
+
+		default:
+			break;
+	}
+
+	if((true == IsWrite) && (false == pMe->IsWriteEnabled))
+	{
+		pMe->Stats.CommandsWithoutWel++;
+		return;
+	}
+
+	if((true == IsWrite) && (false == IsAddressComplete))
+	{
+		return;
+	}
+
+	switch(pMe->Opcode)
+	{
+		case 0x02: case 0x12:
+			HostW25q_Program(pMe, Ns);
+			break;
+
+		case 0x20: case 0x21:
+			HostW25q_Erase(pMe, eHOSTW25Q_OP_SECTOR_ERASE, HOSTW25Q_SECTOR_SIZE, Ns);
+			break;
+
+		case 0x52: case 0x5C:
+			HostW25q_Erase(pMe, eHOSTW25Q_OP_BLOCK32_ERASE, HOSTW25Q_BLOCK32_SIZE, Ns);
+			break;
+
+		case 0xD8: case 0xDC:
+			HostW25q_Erase(pMe, eHOSTW25Q_OP_BLOCK_ERASE, HOSTW25Q_BLOCK_SIZE, Ns);
+			break;
+
+		case 0xC7: case 0x60:
+			pMe->Address = 0;
+			HostW25q_Erase(pMe, eHOSTW25Q_OP_CHIP_ERASE, pMe->Capacity, Ns);
+			break;
+
+		case 0x01: case 0x31: case 0x11:
+			HostW25q_StartBusy(pMe, eHOSTW25Q_OP_WRITE_STATUS, Ns, 256u);
+			break;
+
+		case 0xB7:	/* Enter 4 byte address mode */
+			pMe->Is4ByteMode = (pMe->Capacity > HOSTW25Q_3BYTE_ADDRESS_LIMIT);
+			break;
+
+		case 0xE9:	/* Exit 4 byte address mode */
+		case 0x99:	/* Reset */
+			pMe->Is4ByteMode = false;
+			pMe->IsWriteEnabled = false;
+			break;
+
+		default:
+			break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Map the backing file, a new file reads as freshly erased flash
+ *
+ * @param pPath backing file, created if missing
+ * @param Capacity part size in bytes, a power of two
+ * @param IsWorstCase true to stay busy for datasheet maximum times
+ * @return true on success
+ */
+bool HostW25q_Init(const char* pPath, size_t Capacity, bool IsWorstCase)
+{
+	sHostW25q_t* pMe = HostW25q_GetInstance();
+	struct stat FileStat;
+
+	assert(NULL != pPath);
+
+	if((Capacity < HOSTW25Q_CAPACITY_MIN) || (Capacity > HOSTW25Q_CAPACITY_MAX) || (0 != (Capacity & (Capacity - 1u))))
+	{
+		fprintf(stderr, "flash: capacity must be a power of two from %u to %u bytes\n", HOSTW25Q_CAPACITY_MIN, HOSTW25Q_CAPACITY_MAX);
+		return false;
+	}
+
+	int Fd = open(pPath, O_RDWR | O_CREAT, 0644);
+
+	if((Fd < 0) || (0 != fstat(Fd, &FileStat)))
+	{
+		perror(pPath);
+		return false;
+	}
+
+	bool IsNew = (0 == FileStat.st_size);
+
+	if((false == IsNew) && ((size_t)FileStat.st_size != Capacity))
+	{
+		fprintf(stderr, "%s: %ld bytes, does not match a %zu byte part\n", pPath, (long)FileStat.st_size, Capacity);
+		close(Fd);
+		return false;
+	}
+
+	if((true == IsNew) && (0 != ftruncate(Fd, (off_t)Capacity)))
+	{
+		perror(pPath);
+		close(Fd);
+		return false;
+	}
+
+	void* pArray = mmap(NULL, Capacity, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+
+	if(MAP_FAILED == pArray)
+	{
+		perror(pPath);
+		close(Fd);
+		return false;
+	}
+
+	memset(pMe, 0, sizeof(*pMe));
+	pMe->pArray = pArray;
+	pMe->Capacity = Capacity;
+	pMe->Fd = Fd;
+	pMe->IsWorstCase = IsWorstCase;
+
+	if(true == IsNew)
+	{
+		memset(pMe->pArray, 0xFF, Capacity);
+	}
+
+	memcpy(gTiming, gcTimingTable, sizeof(gTiming));
+	gTiming[eHOSTW25Q_OP_CHIP_ERASE].TypicalUs = (uint32_t)((HOSTW25Q_CHIP_ERASE_US_PER_MB * (uint64_t)Capacity) >> 20u);
+	gTiming[eHOSTW25Q_OP_CHIP_ERASE].MaxUs = gTiming[eHOSTW25Q_OP_CHIP_ERASE].TypicalUs * 5u;
+
+	HostW25q_BuildSfdp(pMe);
+
+	return true;
+}
+
+/**
+ * @brief Write back and unmap the backing file
+ *
+ */
+void HostW25q_DeInit(void)
+{
+	sHostW25q_t* pMe = HostW25q_GetInstance();
+
+	if(NULL != pMe->pArray)
+	{
+		msync(pMe->pArray, pMe->Capacity, MS_SYNC);
+		munmap(pMe->pArray, pMe->Capacity);
+		pMe->pArray = NULL;
+	}
+
+	if(pMe->Fd >= 0)
+	{
+		close(pMe->Fd);
+		pMe->Fd = -1;
+	}
+}
+
+/**
+ * @brief Supply of the part, driven by the sensor power enable pin. Volatile state is lost without it.
+ *
+ * @param IsPowered true if supplied
+ */
+void HostW25q_SetPower(bool IsPowered)
+{
+	sHostW25q_t* pMe = HostW25q_GetInstance();
+
+	if(false == IsPowered)
+	{
+		pMe->IsWriteEnabled = false;
+		pMe->Is4ByteMode = false;
+		pMe->Phase = eHOSTW25Q_PHASE_IGNORE;
+	}
+
+	pMe->IsPowered = IsPowered;
+}
+
+/**
+ * @brief Chip select edge
+ *
+ * @param IsSelected true on the falling edge
+ * @param Ns current time
+ */
+void HostW25q_Select(bool IsSelected, uint64_t Ns)
+{
+	sHostW25q_t* pMe = HostW25q_GetInstance();
+
+	if(IsSelected == pMe->IsSelected)
+	{
+		return;
+	}
+
+	pMe->IsSelected = IsSelected;
+
+	if(false == pMe->IsPowered)
+	{
+		return;
+	}
+
+	if(true == IsSelected)
+	{
+		pMe->Phase = eHOSTW25Q_PHASE_OPCODE;
+	}
+	else
+	{
+		if(eHOSTW25Q_PHASE_OPCODE != pMe->Phase)
+		{
+			HostW25q_Execute(pMe, Ns);
+		}
+
+		pMe->Phase = eHOSTW25Q_PHASE_IGNORE;
+	}
+}
+
+/**
+ * @brief Clock a byte through the part
+ *
+ * @param Mosi byte from the host
+ * @param Ns time the byte is clocked
+ * @return uint8_t byte to the host, 0xFF while not selected
+ */
+uint8_t HostW25q_Exchange(uint8_t Mosi, uint64_t Ns)
+{
+	sHostW25q_t* pMe = HostW25q_GetInstance();
+	uint8_t Miso = 0xFF;
+
+	if((false == pMe->IsPowered) || (false == pMe->IsSelected))
+	{
+		return Miso;
+	}
+
+	switch(pMe->Phase)
+	{
+		case eHOSTW25Q_PHASE_OPCODE:
+			pMe->Opcode = Mosi;
+			HostW25q_DecodeOpcode(pMe, Ns);
+			break;
+
+		case eHOSTW25Q_PHASE_ADDRESS:
+			pMe->Address = (pMe->Address << 8u) | Mosi;
+			pMe->AddressCount++;
+			if(pMe->AddressCount == pMe->AddressBytes)
+			{
+				pMe->Phase = (0 != pMe->DummyLeft)? eHOSTW25Q_PHASE_DUMMY: eHOSTW25Q_PHASE_DATA;
+			}
+			break;
+
+		case eHOSTW25Q_PHASE_DUMMY:
+			pMe->DummyLeft--;
+			if(0 == pMe->DummyLeft)
+			{
+				pMe->Phase = eHOSTW25Q_PHASE_DATA;
+			}
+			break;
+
+		case eHOSTW25Q_PHASE_DATA:
+			Miso = HostW25q_Data(pMe, Mosi, Ns);
+			break;
+
+		case eHOSTW25Q_PHASE_IGNORE:
+		default:
+			break;
+	}
+
+	return Miso;
+}
+
+/**
+ * @brief Get the array, for checks of what the firmware stored
+ *
+ * @return const uint8_t*
+ */
+const uint8_t* HostW25q_GetArray(void)
+{
+	return HostW25q_GetInstance()->pArray;
+}
+
+/**
+ * @brief Get part size
+ *
+ * @return size_t bytes
+ */
+size_t HostW25q_GetCapacity(void)
+{
+	return HostW25q_GetInstance()->Capacity;
+}
+
+/**
+ * @brief Print operation counts and the time the part spent busy
+ *
+ */
+void HostW25q_PrintStatistics(void)
+{
+	sHostW25q_t* pMe = HostW25q_GetInstance();
+
+	printf("flash: %zu KB, %s times, %llu bytes read, %llu bytes programmed\n", pMe->Capacity / 1024u,
+			(true == pMe->IsWorstCase)? "maximum": "typical", (unsigned long long)pMe->Stats.BytesRead, (unsigned long long)pMe->Stats.BytesProgrammed);
+
+	for(uint32_t i = 0; i < eHOSTW25Q_OP_MAX; i++)
+	{
+		if(0 != pMe->Stats.Operations[i])
+		{
+			printf("flash: %-16s %8u, busy %10.3f ms\n", gTiming[i].pName, pMe->Stats.Operations[i], (double)pMe->Stats.BusyNs[i] / 1e6);
+		}
+	}
+
+	if((0 != pMe->Stats.CommandsWhileBusy) || (0 != pMe->Stats.CommandsWithoutWel) || (0 != pMe->Stats.BitsSetByProgram))
+	{
+		printf("flash: %u commands while busy, %u writes without write enable, %u program bytes over unerased bits\n",
+				pMe->Stats.CommandsWhileBusy, pMe->Stats.CommandsWithoutWel, pMe->Stats.BitsSetByProgram);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,139 @@
+/**
+ * @file HostW25q.h
+ * @author Vishal Keshava Murthy
+ * @brief File backed model of a Winbond W25Q serial NOR flash on the SPI bus.
+ * Speaks the single lane command set the driver uses, reports its geometry and
+ * timing through JEDEC ID and SFDP, and stays busy for datasheet program and
+ * erase times measured on the virtual clock.
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SIM_HOSTW25Q_H_
+#define HOST_SIM_HOSTW25Q_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOSTW25Q_MANUFACTURER_ID		(0xEFu)			/**< Winbond */
+#define HOSTW25Q_MEMORY_TYPE			(0x40u)			/**< W25Q..JV, SPI mode */
+#define HOSTW25Q_PAGE_SIZE				(256u)
+#define HOSTW25Q_SECTOR_SIZE			(0x1000u)
+#define HOSTW25Q_BLOCK32_SIZE			(0x8000u)
+#define HOSTW25Q_BLOCK_SIZE				(0x10000u)
+#define HOSTW25Q_3BYTE_ADDRESS_LIMIT	(0x1000000u)	/**< Larger parts power up in 3 byte mode and have 4 byte opcodes */
+#define HOSTW25Q_CAPACITY_MIN			(0x20000u)		/**< W25Q10 */
+#define HOSTW25Q_CAPACITY_MAX			(0x4000000u)	/**< W25Q512 */
+#define HOSTW25Q_SFDP_SIZE				(256u)
+#define HOSTW25Q_SFDP_TABLE_ADDRESS		(0x80u)
+#define HOSTW25Q_SFDP_TABLE_DWORDS		(16u)
+#define HOSTW25Q_UNIQUE_ID_SIZE			(8u)
+#define HOSTW25Q_CHIP_ERASE_US_PER_MB	(2500000u)		/**< tCE grows with density, 40 s typical on the 16 MB part */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Operations that keep the part busy
+ *
+ */
+typedef enum
+{
+	eHOSTW25Q_OP_PAGE_PROGRAM,
+	eHOSTW25Q_OP_SECTOR_ERASE,
+	eHOSTW25Q_OP_BLOCK32_ERASE,
+	eHOSTW25Q_OP_BLOCK_ERASE,
+	eHOSTW25Q_OP_CHIP_ERASE,
+	eHOSTW25Q_OP_WRITE_STATUS,
+	eHOSTW25Q_OP_MAX
+}eHostW25qOperation_t;
+
+/**
+ * @brief Datasheet time of an operation
+ *
+ */
+typedef struct
+{
+	const char* pName;
+	uint32_t TypicalUs;
+	uint32_t MaxUs;
+}sHostW25qTiming_t;
+
+/**
+ * @brief Phase of the command being clocked in
+ *
+ */
+typedef enum
+{
+	eHOSTW25Q_PHASE_OPCODE,
+	eHOSTW25Q_PHASE_ADDRESS,
+	eHOSTW25Q_PHASE_DUMMY,
+	eHOSTW25Q_PHASE_DATA,
+	eHOSTW25Q_PHASE_IGNORE,			/**< Rest of the transaction is dropped, MISO stays high */
+}eHostW25qPhase_t;
+
+/**
+ * @brief Counters printed after a run
+ *
+ */
+typedef struct
+{
+	uint32_t Operations[eHOSTW25Q_OP_MAX];
+	uint64_t BusyNs[eHOSTW25Q_OP_MAX];
+	uint64_t BytesRead;
+	uint64_t BytesProgrammed;
+	uint32_t CommandsWhileBusy;		/**< Dropped by the part, anything but a status read while busy */
+	uint32_t CommandsWithoutWel;	/**< Program / erase dropped for lack of write enable */
+	uint32_t BitsSetByProgram;		/**< Program tried to turn a 0 bit into 1, a missing erase */
+}sHostW25qStatistics_t;
+
+/**
+ * @brief Flash model
+ *
+ */
+typedef struct
+{
+	uint8_t* pArray;				/**< Backing file mapped in memory */
+	size_t Capacity;
+	int Fd;
+	uint8_t Sfdp[HOSTW25Q_SFDP_SIZE];
+	bool IsWorstCase;				/**< Busy for datasheet maximum rather than typical times */
+	bool IsPowered;
+	bool IsSelected;
+	bool IsWriteEnabled;
+	bool Is4ByteMode;
+	uint64_t BusyUntilNs;
+	uint8_t Opcode;
+	eHostW25qPhase_t Phase;
+	uint8_t AddressBytes;
+	uint8_t AddressCount;
+	uint32_t Address;
+	uint8_t DummyLeft;
+	uint32_t DataCount;
+	uint8_t PageBuffer[HOSTW25Q_PAGE_SIZE];
+	sHostW25qStatistics_t Stats;
+}sHostW25q_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HostW25q_Init(const char* pPath, size_t Capacity, bool IsWorstCase);
+void HostW25q_DeInit(void);
+void HostW25q_SetPower(bool IsPowered);
+void HostW25q_Select(bool IsSelected, uint64_t Ns);
+uint8_t HostW25q_Exchange(uint8_t Mosi, uint64_t Ns);
+const uint8_t* HostW25q_GetArray(void);
+size_t HostW25q_GetCapacity(void);
+void HostW25q_PrintStatistics(void);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* HOST_SIM_HOSTW25Q_H_ */
@@ -67,6 +67,9 @@ static void AppCommon_PreResetRoutine()
 {
 	/**< Device has been reset so set up-time back to Zero*/
 	__NOP();
+
+	/**< Let the last messages leave the console transmit ring*/
+	Console_Flush();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -11,10 +11,73 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <assert.h>
+
 #include "AppConfiguration.h"
+#include "ConfigSetting.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Programming profiles, one per config setting. Raw partitions must match
+ * the offset the target bootloader reads the image from.
+ */
+static const sAppProfile_t gcAppProfileTable[eCONFIG_SETTING_MAX] =
+{
+		[eCONFIG_SETTING_0] = {.pName = "LittleFS",		.StorageMode = eSTORAGE_MODE_LFS,	.RawBaseAddress = 0,		.RawMaxLength = 0,			.SerialProtocol = eSERIAL_PROTOCOL_YMODEM},
+		[eCONFIG_SETTING_1] = {.pName = "Raw @0x0",		.StorageMode = eSTORAGE_MODE_RAW,	.RawBaseAddress = 0x000000,	.RawMaxLength = 0x400000,	.SerialProtocol = eSERIAL_PROTOCOL_YMODEM},
+		[eCONFIG_SETTING_2] = {.pName = "Raw @0x100000",	.StorageMode = eSTORAGE_MODE_RAW,	.RawBaseAddress = 0x100000,	.RawMaxLength = 0x300000,	.SerialProtocol = eSERIAL_PROTOCOL_FRAMELINK},
+		[eCONFIG_SETTING_3] = {.pName = "LittleFS YMODEM-G",	.StorageMode = eSTORAGE_MODE_LFS,	.RawBaseAddress = 0,		.RawMaxLength = 0,			.SerialProtocol = eSERIAL_PROTOCOL_YMODEM_G},
+};
 
+///////////////////////////////////////////////////////////////////////////////
+
+static eConfigSettingMode_t gProfileOverride = eCONFIG_SETTING_MAX;	/**< Profile chosen over the console, @ref eCONFIG_SETTING_MAX to follow the pins */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get config setting in effect, the console override or else the pins
+ *
+ * @return eConfigSettingMode_t
+ */
+eConfigSettingMode_t AppConfiguration_GetActiveSetting()
+{
+	return (eCONFIG_SETTING_MAX != gProfileOverride)? gProfileOverride: ConfigSetting_GetCurrentSetting();
+}
+
+/**
+ * @brief Get programming profile selected by the config setting pins, or by the console override
+ *
+ * @return const sAppProfile_t*
+ */
+const sAppProfile_t* AppConfiguration_GetActiveProfile()
+{
+	eConfigSettingMode_t currentSetting = AppConfiguration_GetActiveSetting();
+
+	return &gcAppProfileTable[currentSetting];
+}
+
+/**
+ * @brief Select the programming profile regardless of the config setting pins
+ *
+ * @param Setting profile, @ref eCONFIG_SETTING_MAX to follow the pins again
+ */
+void AppConfiguration_SetProfileOverride(eConfigSettingMode_t Setting)
+{
+	assert(Setting <= eCONFIG_SETTING_MAX);
+
+	gProfileOverride = Setting;
+}
+
+/**
+ * @brief Check whether the profile was chosen over the console
+ *
+ * @return true if the pins are overridden
+ */
+bool AppConfiguration_IsProfileOverridden()
+{
+	return (eCONFIG_SETTING_MAX != gProfileOverride);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -21,7 +21,57 @@
 //#define ENABLE_DEBUG_PRINT 				/**< Enabling this macro will redirect @ref DEBUG_PRINT to @ref Console_Print */
 //#define ENABLE_TESTS_DEFINITIONS          /**< If this is enabled then tests defined for individual modules are defined*/
 //#define FORCE_DISABLE_FILE_CRC_CHECK		/**< CRC of the SD card an Flash file copy will be computed and compared by default, define this variable to skip CRC check*/
+//#define FORCE_ENABLE_FULL_FILE_CRC_CHECK	/**< Flash is read back and verified while programming, define this variable to also re-read both copies and compare CRC after transfer*/
+//#define FORCE_DISABLE_EVENT_TRACE			/**< Events are traced into a RAM ring by default, see AppTrace.h, define this variable to compile the trace points out*/
+//#define ENABLE_BINARY_CONSOLE_LOG			/**< Console prints leave as format string address and raw arguments, see Tools/consolelog.py, instead of text formatted on target*/
 
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ConfigSetting.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief How the golden image is laid out in external flash
+ */
+typedef enum
+{
+	eSTORAGE_MODE_LFS,			/**< Golden image saved as a file in LittleFS */
+	eSTORAGE_MODE_RAW,			/**< Golden image streamed to a fixed flash address range */
+	eSTORAGE_MODE_MAX
+}eStorageMode_t;
+
+/**
+ * @brief Serial protocol offered to the host in X-modem transfer mode
+ */
+typedef enum
+{
+	eSERIAL_PROTOCOL_YMODEM,		/**< XMODEM-CRC/1K, or YMODEM batch if the host opens with block 0. A packet is acknowledged before the next one is sent */
+	eSERIAL_PROTOCOL_YMODEM_G,		/**< YMODEM-G batch, packets are streamed without acknowledgment. Needs an error free link, any error aborts the session */
+	eSERIAL_PROTOCOL_FRAMELINK,		/**< COBS/CRC32 frames with a window and selective retransmit, an interrupted transfer resumes from the committed offset */
+	eSERIAL_PROTOCOL_MAX
+}eSerialProtocol_t;
+
+/**
+ * @brief Programming profile, selected by config setting pins or by the PROFILE console command
+ */
+typedef struct
+{
+	const char* pName;				/**< Name printed on console */
+	eStorageMode_t StorageMode;		/**< Golden image layout in flash */
+	uint32_t RawBaseAddress;		/**< Start of raw partition, must be page aligned. Used in @ref eSTORAGE_MODE_RAW only */
+	uint32_t RawMaxLength;			/**< Size of raw partition. Used in @ref eSTORAGE_MODE_RAW only */
+	eSerialProtocol_t SerialProtocol;	/**< Protocol of X-modem transfer mode */
+}sAppProfile_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+const sAppProfile_t* AppConfiguration_GetActiveProfile();
+eConfigSettingMode_t AppConfiguration_GetActiveSetting();
+void AppConfiguration_SetProfileOverride(eConfigSettingMode_t Setting);
+bool AppConfiguration_IsProfileOverridden();
 
 ///////////////////////////////////////////////////////////////////////////////
 
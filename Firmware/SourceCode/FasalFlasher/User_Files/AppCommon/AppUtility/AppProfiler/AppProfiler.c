@@ -11,19 +11,80 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "AppProfiler.h"
+#include "Console.h"
 #include "stm32f1xx_hal.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
+static sAppProfiler_t gAppProfiler;
+
+static volatile uint32_t gvCycleCountHigh = 0;		/**< Upper word of the 64 bit cycle clock */
+static volatile uint32_t gvCycleCountLast = 0;		/**< CYCCNT when the clock was last read, to detect wrap */
+
+static uint64_t gExecutionStartCycles = 0;			/**< Start of @ref AppProfiler_StartExecutionTimeMeasurement */
+
+static const char* const gcAppProfilerScopeNames[eAPPPROFILER_SCOPE_MAX] =
+{
+		[eAPPPROFILER_SCOPE_TRANSFER]		= "Transfer",
+		[eAPPPROFILER_SCOPE_SD_READ]		= "SD read",
+		[eAPPPROFILER_SCOPE_DECOMPRESS]		= "Decompress",
+		[eAPPPROFILER_SCOPE_FLASH_PROGRAM]	= "Page program",
+		[eAPPPROFILER_SCOPE_FLASH_ERASE]	= "Erase",
+		[eAPPPROFILER_SCOPE_CRC]			= "CRC",
+		[eAPPPROFILER_SCOPE_UART_WAIT]		= "UART wait",
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get profiler instance
+ *
+ * @return sAppProfiler_t*
+ */
+static sAppProfiler_t* AppProfiler_GetInstance()
+{
+	return &gAppProfiler;
+}
+
+/**
+ * @brief Convert cycles to microseconds
+ *
+ * @param Cycles cycle count
+ * @return uint64_t microseconds
+ */
+static uint64_t AppProfiler_CyclesToMicroseconds(uint64_t Cycles)
+{
+	return Cycles / (SystemCoreClock / 1000000u);
+}
+
+/**
+ * @brief Histogram bin of a duration, floor(log2(Cycles))
+ *
+ * @param Cycles duration
+ * @return uint32_t bin index
+ */
+static uint32_t AppProfiler_GetHistogramBin(uint64_t Cycles)
+{
+	uint32_t Bin = (0 == Cycles)? 0u: (uint32_t)(63 - __builtin_clzll(Cycles));
+
+	return (Bin < APPPROFILER_HISTOGRAM_BINS)? Bin: (APPPROFILER_HISTOGRAM_BINS - 1u);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 /**
  * @brief Start measurement of function execution time
+ * @note Leaves CYCCNT running, so scopes and cycle stamps taken elsewhere are not disturbed
  */
 void AppProfiler_StartExecutionTimeMeasurement()
 {
-	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
-	DWT->CYCCNT = 0;
-	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	AppProfiler_EnableCycleCounter();
+	gExecutionStartCycles = AppProfiler_GetCycleCount64();
 }
 
 /**
@@ -34,11 +95,243 @@ void AppProfiler_StartExecutionTimeMeasurement()
  */
 uint32_t AppProfiler_GetExecutionTimeMS()
 {
-	uint32_t currentTick = DWT->CYCCNT;
+	uint64_t elapsedCycles = AppProfiler_GetCycleCount64() - gExecutionStartCycles;
 
-	uint32_t executionTimeMs = currentTick / (SystemCoreClock / 1000u) ;
+	uint32_t executionTimeMs = (uint32_t)(elapsedCycles / (SystemCoreClock / 1000u));
 
 	return executionTimeMs;
 }
 
+/**
+ * @brief Enable the DWT cycle counter without disturbing its current value
+ */
+void AppProfiler_EnableCycleCounter()
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Get free running cycle count, used as a microsecond resolution time base
+ * @note This function expects @ref AppProfiler_EnableCycleCounter to be invoked prior to use
+ *
+ * @return current DWT cycle count
+ */
+uint32_t AppProfiler_GetCycleCount()
+{
+	return DWT->CYCCNT;
+}
+
+/**
+ * @brief Get microseconds elapsed since a cycle count captured with @ref AppProfiler_GetCycleCount
+ * @note Wraps after 2^32 cycles (~59 s at 72 MHz), longer intervals must be measured with HAL ticks
+ *
+ * @param startCycleCount cycle count at start of interval
+ * @return elapsed time in microseconds
+ */
+uint32_t AppProfiler_GetElapsedMicroseconds(uint32_t startCycleCount)
+{
+	uint32_t elapsedCycles = DWT->CYCCNT - startCycleCount;
+
+	return elapsedCycles / (SystemCoreClock / 1000000u);
+}
+
+/**
+ * @brief Get the 64 bit cycle clock, CYCCNT extended by counting its wraps
+ * @note A wrap is only seen if the clock is read at least once per wrap
+ * (~59 s at 72 MHz), @ref AppProfiler_cbPeriodicCheck takes care of that
+ *
+ * @return uint64_t cycles since the counter was enabled
+ */
+uint64_t AppProfiler_GetCycleCount64()
+{
+	uint32_t PriMask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t CycleCount = DWT->CYCCNT;
+
+	if(CycleCount < gvCycleCountLast)
+	{
+		gvCycleCountHigh++;
+	}
+
+	gvCycleCountLast = CycleCount;
+
+	uint64_t Cycles = ((uint64_t)gvCycleCountHigh << 32) | CycleCount;
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+
+	return Cycles;
+}
+
+/**
+ * @brief Periodic call from the soft-timer tick, keeps the 64 bit cycle clock from missing a wrap
+ *
+ */
+void AppProfiler_cbPeriodicCheck()
+{
+	(void)AppProfiler_GetCycleCount64();
+}
+
+/**
+ * @brief Open a named scope. Scopes nest, a scope opened inside another one
+ * is charged to both but only to its own self time.
+ * @note Main context only, scopes are not to be used from interrupts
+ *
+ * @param Scope scope to open
+ */
+void AppProfiler_ScopeBegin(eAppProfilerScope_t Scope)
+{
+	assert(Scope < eAPPPROFILER_SCOPE_MAX);
+
+	sAppProfiler_t* pMe = AppProfiler_GetInstance();
+
+	if(pMe->Depth < APPPROFILER_NEST_DEPTH_MAX)
+	{
+		sAppProfilerFrame_t* pFrame = &pMe->Stack[pMe->Depth];
+
+		pFrame->Scope = Scope;
+		pFrame->ChildCycles = 0;
+		pFrame->StartCycles = AppProfiler_GetCycleCount64();
+	}
+	else
+	{
+		pMe->DroppedCount++;
+	}
+
+	pMe->Depth++;
+}
+
+/**
+ * @brief Close the innermost scope and account its duration
+ *
+ * @param Scope scope to close, must be the innermost open scope
+ */
+void AppProfiler_ScopeEnd(eAppProfilerScope_t Scope)
+{
+	uint64_t EndCycles = AppProfiler_GetCycleCount64();
+	sAppProfiler_t* pMe = AppProfiler_GetInstance();
+
+	if(0 == pMe->Depth)
+	{
+		pMe->DroppedCount++;
+		return;
+	}
+
+	pMe->Depth--;
+
+	if(pMe->Depth >= APPPROFILER_NEST_DEPTH_MAX)
+	{
+		return;
+	}
+
+	sAppProfilerFrame_t* pFrame = &pMe->Stack[pMe->Depth];
+
+	if(Scope != pFrame->Scope)
+	{
+		pMe->DroppedCount++;
+		return;
+	}
+
+	uint64_t Cycles = EndCycles - pFrame->StartCycles;
+	sAppProfilerScopeStats_t* pStats = &pMe->Stats[Scope];
+
+	if((0 == pStats->Count) || (Cycles < pStats->MinCycles))
+	{
+		pStats->MinCycles = Cycles;
+	}
+
+	if(Cycles > pStats->MaxCycles)
+	{
+		pStats->MaxCycles = Cycles;
+	}
+
+	pStats->Count++;
+	pStats->TotalCycles += Cycles;
+	pStats->SelfCycles += (Cycles > pFrame->ChildCycles)? (Cycles - pFrame->ChildCycles): 0u;
+	pStats->Histogram[AppProfiler_GetHistogramBin(Cycles)]++;
+
+	if(pMe->Depth > 0)
+	{
+		pMe->Stack[pMe->Depth - 1u].ChildCycles += Cycles;
+	}
+}
+
+/**
+ * @brief Clear statistics of every scope, open scopes stay open
+ *
+ */
+void AppProfiler_ResetScopes()
+{
+	sAppProfiler_t* pMe = AppProfiler_GetInstance();
+
+	AppProfiler_EnableCycleCounter();
+
+	memset(pMe->Stats, 0, sizeof(pMe->Stats));
+	pMe->DroppedCount = 0;
+}
+
+/**
+ * @brief Get statistics of a scope
+ *
+ * @param Scope scope
+ * @return const sAppProfilerScopeStats_t*
+ */
+const sAppProfilerScopeStats_t* AppProfiler_GetScopeStats(eAppProfilerScope_t Scope)
+{
+	assert(Scope < eAPPPROFILER_SCOPE_MAX);
+
+	return &AppProfiler_GetInstance()->Stats[Scope];
+}
+
+/**
+ * @brief Print the table of every scope measured since the last reset, with
+ * its latency histogram as "2^bin:count" over cycles
+ *
+ */
+void AppProfiler_PrintScopes()
+{
+	sAppProfiler_t* pMe = AppProfiler_GetInstance();
+
+	for(eAppProfilerScope_t Scope = 0; Scope < eAPPPROFILER_SCOPE_MAX; Scope++)
+	{
+		const sAppProfilerScopeStats_t* pStats = &pMe->Stats[Scope];
+
+		if(0 == pStats->Count)
+		{
+			continue;
+		}
+
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Profile %-12s: count %lu, min %lu us, avg %lu us, max %lu us, total %lu ms, self %lu ms",
+				gcAppProfilerScopeNames[Scope], (unsigned long)pStats->Count,
+				(unsigned long)AppProfiler_CyclesToMicroseconds(pStats->MinCycles),
+				(unsigned long)AppProfiler_CyclesToMicroseconds(pStats->TotalCycles / pStats->Count),
+				(unsigned long)AppProfiler_CyclesToMicroseconds(pStats->MaxCycles),
+				(unsigned long)(AppProfiler_CyclesToMicroseconds(pStats->TotalCycles) / 1000u),
+				(unsigned long)(AppProfiler_CyclesToMicroseconds(pStats->SelfCycles) / 1000u));
+
+		char Histogram[APPPROFILER_HISTOGRAM_BINS * 12u] = {0};
+		uint32_t Length = 0;
+
+		for(uint32_t Bin = 0; (Bin < APPPROFILER_HISTOGRAM_BINS) && (Length < sizeof(Histogram)); Bin++)
+		{
+			if(0 != pStats->Histogram[Bin])
+			{
+				Length += (uint32_t)snprintf(&Histogram[Length], sizeof(Histogram) - Length, " 2^%lu:%lu",
+						(unsigned long)Bin, (unsigned long)pStats->Histogram[Bin]);
+			}
+		}
+
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>>   cycles%s", Histogram);
+	}
+
+	if(0 != pMe->DroppedCount)
+	{
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Profile scopes dropped: %lu", (unsigned long)pMe->DroppedCount);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
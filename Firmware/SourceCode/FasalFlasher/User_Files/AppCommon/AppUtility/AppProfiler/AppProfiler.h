@@ -20,9 +20,81 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#define APPPROFILER_HISTOGRAM_BINS		(32u)	/**< Bin n counts scopes that took [2^n, 2^(n+1)) cycles, the last bin also takes longer ones */
+#define APPPROFILER_NEST_DEPTH_MAX		(8u)	/**< Scopes open at once, deeper scopes are not measured */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Named profiler scopes, one per section of a unit's cycle time
+ *
+ */
+typedef enum
+{
+	eAPPPROFILER_SCOPE_TRANSFER,		/**< Whole golden image transfer */
+	eAPPPROFILER_SCOPE_SD_READ,			/**< Golden image read from SD card */
+	eAPPPROFILER_SCOPE_DECOMPRESS,		/**< LZSS decode of a packed image */
+	eAPPPROFILER_SCOPE_FLASH_PROGRAM,	/**< Page program until the flash is ready */
+	eAPPPROFILER_SCOPE_FLASH_ERASE,		/**< Erase until the flash is ready */
+	eAPPPROFILER_SCOPE_CRC,				/**< Digest update */
+	eAPPPROFILER_SCOPE_UART_WAIT,		/**< Blocked on console transmission */
+	eAPPPROFILER_SCOPE_MAX
+}eAppProfilerScope_t;
+
+/**
+ * @brief Statistics of a scope, in cycles of the 64 bit cycle clock
+ *
+ */
+typedef struct
+{
+	uint32_t Count;
+	uint64_t MinCycles;
+	uint64_t MaxCycles;
+	uint64_t TotalCycles;
+	uint64_t SelfCycles;				/**< Total less the time spent in scopes nested inside */
+	uint32_t Histogram[APPPROFILER_HISTOGRAM_BINS];
+}sAppProfilerScopeStats_t;
+
+/**
+ * @brief Open scope
+ *
+ */
+typedef struct
+{
+	eAppProfilerScope_t Scope;
+	uint64_t StartCycles;
+	uint64_t ChildCycles;				/**< Time spent in scopes nested inside so far */
+}sAppProfilerFrame_t;
+
+/**
+ * @brief Profiler instance
+ *
+ */
+typedef struct
+{
+	sAppProfilerScopeStats_t Stats[eAPPPROFILER_SCOPE_MAX];
+	sAppProfilerFrame_t Stack[APPPROFILER_NEST_DEPTH_MAX];
+	uint8_t Depth;						/**< Open scopes, may exceed the stack while too deep */
+	uint32_t DroppedCount;				/**< Scopes not measured for nesting too deep or ending out of order */
+}sAppProfiler_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
 void AppProfiler_StartExecutionTimeMeasurement();
 uint32_t AppProfiler_GetExecutionTimeMS();
 
+void AppProfiler_EnableCycleCounter();
+uint32_t AppProfiler_GetCycleCount();
+uint32_t AppProfiler_GetElapsedMicroseconds(uint32_t startCycleCount);
+uint64_t AppProfiler_GetCycleCount64();
+void AppProfiler_cbPeriodicCheck();
+
+void AppProfiler_ScopeBegin(eAppProfilerScope_t Scope);
+void AppProfiler_ScopeEnd(eAppProfilerScope_t Scope);
+void AppProfiler_ResetScopes();
+const sAppProfilerScopeStats_t* AppProfiler_GetScopeStats(eAppProfilerScope_t Scope);
+void AppProfiler_PrintScopes();
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #endif /* APPCOMMON_APPUTILITY_APPPROFILER_APPPROFILER_H_ */
@@ -0,0 +1,171 @@
+/**
+ * @file AppTrace.c
+ * @author Vishal Keshava Murthy
+ * @brief Binary event trace implementation
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "AppTrace.h"
+#include "AppProfiler.h"
+#include "Console.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sAppTrace_t gAppTrace = {.WriteCount = 0, .IsPaused = false};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get trace instance
+ *
+ * @return sAppTrace_t*
+ */
+static sAppTrace_t* AppTrace_GetInstance()
+{
+	return &gAppTrace;
+}
+
+/**
+ * @brief Sink of @ref AppTrace_Dump, the console UART
+ *
+ * @param pData bytes of the dump
+ * @param Length number of bytes
+ */
+static void AppTrace_ConsoleSink(const uint8_t* pData, uint16_t Length)
+{
+	(void)Console_Transmit(pData, Length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FORCE_DISABLE_EVENT_TRACE
+/**
+ * @brief Write a record into the ring, overwriting the oldest one when full
+ * @note Safe to call from interrupts
+ *
+ * @param Event event id
+ * @param Phase begin, end or instant
+ * @param Arg0 first argument, meaning depends on the event
+ * @param Arg1 second argument, meaning depends on the event
+ */
+void AppTrace_Record(eAppTraceEvent_t Event, eAppTracePhase_t Phase, uint32_t Arg0, uint32_t Arg1)
+{
+	sAppTrace_t* pMe = AppTrace_GetInstance();
+
+	uint32_t PriMask = __get_PRIMASK();
+	__disable_irq();
+
+	if(false == pMe->IsPaused)
+	{
+		uint64_t Cycles = AppProfiler_GetCycleCount64();
+		sAppTraceRecord_t* pRecord = &pMe->Ring[pMe->WriteCount % APPTRACE_RECORD_COUNT];
+
+		pRecord->CyclesLow = (uint32_t)Cycles;
+		pRecord->CyclesHigh = (uint16_t)(Cycles >> 32);
+		pRecord->Event = (uint8_t)Event;
+		pRecord->Phase = (uint8_t)Phase;
+		pRecord->Arg0 = Arg0;
+		pRecord->Arg1 = Arg1;
+
+		pMe->WriteCount++;
+	}
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+}
+#endif
+
+/**
+ * @brief Empty the ring
+ *
+ */
+void AppTrace_Reset()
+{
+	sAppTrace_t* pMe = AppTrace_GetInstance();
+
+	AppProfiler_EnableCycleCounter();
+
+	uint32_t PriMask = __get_PRIMASK();
+	__disable_irq();
+	pMe->WriteCount = 0;
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+}
+
+/**
+ * @brief Stream header and records, oldest first. Recording is paused meanwhile
+ * so the sink sees a consistent ring.
+ *
+ * @param pfSink receives the dump
+ */
+void AppTrace_Stream(pfAppTraceSink_t pfSink)
+{
+	assert(NULL != pfSink);
+
+	sAppTrace_t* pMe = AppTrace_GetInstance();
+
+	uint32_t PriMask = __get_PRIMASK();
+	__disable_irq();
+	pMe->IsPaused = true;
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+
+	uint32_t RecordCount = (pMe->WriteCount < APPTRACE_RECORD_COUNT)? pMe->WriteCount: APPTRACE_RECORD_COUNT;
+	uint32_t FirstRecord = pMe->WriteCount - RecordCount;
+
+	sAppTraceDumpHeader_t Header =
+	{
+			.Version = APPTRACE_DUMP_VERSION,
+			.RecordSize = sizeof(sAppTraceRecord_t),
+			.CycleClockHz = SystemCoreClock,
+			.RecordCount = RecordCount,
+			.LostCount = FirstRecord,
+	};
+
+	memcpy(Header.Magic, APPTRACE_DUMP_MAGIC, sizeof(Header.Magic));
+	pfSink((const uint8_t*)&Header, sizeof(Header));
+
+	for(uint32_t Record = FirstRecord; Record < pMe->WriteCount; Record++)
+	{
+		pfSink((const uint8_t*)&pMe->Ring[Record % APPTRACE_RECORD_COUNT], sizeof(sAppTraceRecord_t));
+	}
+
+	PriMask = __get_PRIMASK();
+	__disable_irq();
+	pMe->IsPaused = false;
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+}
+
+/**
+ * @brief Stream the ring over the console, see Tools/trace2chrome.py for the host side
+ *
+ */
+void AppTrace_Dump()
+{
+	AppTrace_Stream(AppTrace_ConsoleSink);
+}
+
+///////////////////////////////////////////////////////////////////////////////
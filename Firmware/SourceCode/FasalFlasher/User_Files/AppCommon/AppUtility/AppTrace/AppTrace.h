@@ -0,0 +1,123 @@
+/**
+ * @file AppTrace.h
+ * @author Vishal Keshava Murthy
+ * @brief Binary event trace. Fixed size records with a cycle timestamp, an
+ * event id and two arguments go into a RAM ring, which is dumped over the
+ * console and turned into a timeline on the host by Tools/trace2chrome.py
+ * @version 0.1
+ * @date 2024-06-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPCOMMON_APPUTILITY_APPTRACE_APPTRACE_H_
+#define APPCOMMON_APPUTILITY_APPTRACE_APPTRACE_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "AppConfiguration.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPTRACE_RECORD_COUNT
+#define APPTRACE_RECORD_COUNT		(256u)		/**< Ring size in records, a power of two. 4 KB of RAM */
+#endif
+
+#define APPTRACE_DUMP_MAGIC			"FTRC"		/**< Start of a dump, the decoder looks for it in the console capture */
+#define APPTRACE_DUMP_VERSION		(1u)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Traced events. The decoder has the same list, add new events at the end
+ *
+ */
+typedef enum
+{
+	eAPPTRACE_EVENT_FASAL_STATE,		/**< Instant, Arg0 new state, Arg1 previous state */
+	eAPPTRACE_EVENT_FLASH_COMMAND,		/**< Begin: Arg0 operation, Arg1 address. End: Arg0 operation, Arg1 status */
+	eAPPTRACE_EVENT_FLASH_DATA_DONE,	/**< Instant, page data left SPI2 by DMA, chip is now programming */
+	eAPPTRACE_EVENT_SD_READ,			/**< Begin: Arg0 sector, Arg1 count. End: Arg0 sector, Arg1 result */
+	eAPPTRACE_EVENT_XMODEM_FRAME,		/**< Begin: Arg0 header byte, Arg1 slot. End: Arg0 length, Arg1 slot */
+	eAPPTRACE_EVENT_XMODEM_PACKET,		/**< Instant, Arg0 packet number, Arg1 status */
+	eAPPTRACE_EVENT_MAX
+}eAppTraceEvent_t;
+
+/**
+ * @brief How a record relates to the ones around it
+ *
+ */
+typedef enum
+{
+	eAPPTRACE_PHASE_INSTANT,
+	eAPPTRACE_PHASE_BEGIN,
+	eAPPTRACE_PHASE_END,
+}eAppTracePhase_t;
+
+/**
+ * @brief Trace record, 16 bytes. The timestamp is the 64 bit cycle clock cut
+ * to 48 bits, about 45 days at 72 MHz
+ *
+ */
+typedef struct
+{
+	uint32_t CyclesLow;
+	uint16_t CyclesHigh;
+	uint8_t Event;						/**< @ref eAppTraceEvent_t */
+	uint8_t Phase;						/**< @ref eAppTracePhase_t */
+	uint32_t Arg0;
+	uint32_t Arg1;
+}sAppTraceRecord_t;
+
+/**
+ * @brief Header streamed ahead of the records, little endian
+ *
+ */
+typedef struct __attribute__ ((packed))
+{
+	char Magic[4];						/**< @ref APPTRACE_DUMP_MAGIC */
+	uint16_t Version;
+	uint16_t RecordSize;
+	uint32_t CycleClockHz;
+	uint32_t RecordCount;				/**< Records following the header, oldest first */
+	uint32_t LostCount;					/**< Older records overwritten by the ring */
+}sAppTraceDumpHeader_t;
+
+/**
+ * @brief Trace instance
+ *
+ */
+typedef struct
+{
+	sAppTraceRecord_t Ring[APPTRACE_RECORD_COUNT];
+	uint32_t WriteCount;				/**< Records written since the last reset, the ring holds the latest ones */
+	bool IsPaused;						/**< Recording stops while the ring is being dumped */
+}sAppTrace_t;
+
+/**
+ * @brief Receives a dump piece by piece
+ *
+ */
+typedef void (*pfAppTraceSink_t)(const uint8_t* pData, uint16_t Length);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef FORCE_DISABLE_EVENT_TRACE
+#define AppTrace_Record(Event, Phase, Arg0, Arg1)		((void)0)
+#else
+void AppTrace_Record(eAppTraceEvent_t Event, eAppTracePhase_t Phase, uint32_t Arg0, uint32_t Arg1);
+#endif
+
+void AppTrace_Reset();
+void AppTrace_Stream(pfAppTraceSink_t pfSink);
+void AppTrace_Dump();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* APPCOMMON_APPUTILITY_APPTRACE_APPTRACE_H_ */
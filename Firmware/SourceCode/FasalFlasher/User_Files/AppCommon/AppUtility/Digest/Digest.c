@@ -0,0 +1,415 @@
+/**
+ * @file Digest.c
+ * @author Vishal Keshava Murthy
+ * @brief Streaming digest implementation
+ * @version 0.1
+ * @date 2024-06-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Digest.h"
+#include "AppConfiguration.h"
+#include "AppProfiler.h"
+
+#ifdef ENABLE_TESTS_DEFINITIONS
+#include "Console.h"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define DIGEST_CRC32_POLYNOMIAL		(0x04C11DB7u)	/**< Polynomial of the CRC unit */
+#define DIGEST_CRC32_INIT			(0xFFFFFFFFu)	/**< Reset value of the CRC unit */
+#define DIGEST_UNROLL_WORDS			(8u)			/**< Words fed to the CRC unit per loop iteration */
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Digest_HwCrc32Init(sDigestContext_t* const pMe);
+static void Digest_HwCrc32UpdateWords(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t WordCount);
+static uint32_t Digest_HwCrc32Final(sDigestContext_t* const pMe);
+static void Digest_SwCrc32Init(sDigestContext_t* const pMe);
+static void Digest_SwCrc32UpdateWords(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t WordCount);
+static uint32_t Digest_SwCrc32Final(sDigestContext_t* const pMe);
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Map algorithm enums to their implementation
+ */
+static const sDigestAlgorithm_t gcDigestAlgorithmTable[eDIGEST_MAX] =
+{
+#ifdef HOST_SIMULATION
+		/* No CRC unit off target, the software table computes the same polynomial */
+		[eDIGEST_CRC32_HW] = {.pName = "CRC32",		.pfInit = Digest_SwCrc32Init,	.pfUpdateWords = Digest_SwCrc32UpdateWords,	.pfFinal = Digest_SwCrc32Final},
+#else
+		[eDIGEST_CRC32_HW] = {.pName = "CRC32",		.pfInit = Digest_HwCrc32Init,	.pfUpdateWords = Digest_HwCrc32UpdateWords,	.pfFinal = Digest_HwCrc32Final},
+#endif
+		[eDIGEST_CRC32_SW] = {.pName = "CRC32-SW",	.pfInit = Digest_SwCrc32Init,	.pfUpdateWords = Digest_SwCrc32UpdateWords,	.pfFinal = Digest_SwCrc32Final},
+};
+
+/**
+ * @brief CRC32 of every nibble value, MSB first
+ */
+static const uint32_t gcCrc32NibbleTable[16] =
+{
+		0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9, 0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+		0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61, 0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sDigestContext_t* gpCrcUnitOwner = NULL;		/**< Context whose running value is held in the CRC unit */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Claim the CRC unit. The running value of the unit cannot be saved and
+ * restored, so a previous owner finds out on its next update and turns invalid.
+ *
+ * @param pMe digest context
+ */
+static void Digest_HwCrc32Init(sDigestContext_t* const pMe)
+{
+	gpCrcUnitOwner = pMe;
+
+	__HAL_RCC_CRC_CLK_ENABLE();
+	__HAL_CRC_DR_RESET(DIGEST_CRC_HANDLE);
+}
+
+/**
+ * @brief Feed words to the CRC unit, unrolled so the loop is bound by the bus
+ * rather than by loop overhead
+ *
+ * @note The F1 CRC unit has no input byte reversal, so words are swapped with
+ * REV on the way in. Memory to memory DMA cannot do that swap, which is why the
+ * CPU feeds the unit here.
+ *
+ * @param pMe digest context
+ * @param pData data to be fed
+ * @param WordCount number of words
+ */
+static void Digest_HwCrc32UpdateWords(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t WordCount)
+{
+	if(pMe != gpCrcUnitOwner)
+	{
+		pMe->IsValid = false;
+		return;
+	}
+
+	volatile uint32_t* const pDR = &DIGEST_CRC_HANDLE->Instance->DR;
+
+	if(0 == ((uintptr_t)pData % DIGEST_WORD_SIZE))
+	{
+		const uint32_t* pWord = (const uint32_t*)pData;
+
+		while(WordCount >= DIGEST_UNROLL_WORDS)
+		{
+			*pDR = __REV(pWord[0]);
+			*pDR = __REV(pWord[1]);
+			*pDR = __REV(pWord[2]);
+			*pDR = __REV(pWord[3]);
+			*pDR = __REV(pWord[4]);
+			*pDR = __REV(pWord[5]);
+			*pDR = __REV(pWord[6]);
+			*pDR = __REV(pWord[7]);
+			pWord += DIGEST_UNROLL_WORDS;
+			WordCount -= DIGEST_UNROLL_WORDS;
+		}
+
+		while(WordCount > 0)
+		{
+			*pDR = __REV(*pWord++);
+			WordCount--;
+		}
+	}
+	else
+	{
+		while(WordCount > 0)
+		{
+			*pDR = __REV(__UNALIGNED_UINT32_READ(pData));
+			pData += DIGEST_WORD_SIZE;
+			WordCount--;
+		}
+	}
+}
+
+/**
+ * @brief Read running value from CRC unit and release it
+ *
+ * @param pMe digest context
+ * @return uint32_t
+ */
+static uint32_t Digest_HwCrc32Final(sDigestContext_t* const pMe)
+{
+	uint32_t Digest = 0;
+
+	if(pMe == gpCrcUnitOwner)
+	{
+		Digest = DIGEST_CRC_HANDLE->Instance->DR;
+		gpCrcUnitOwner = NULL;
+	}
+	else
+	{
+		pMe->IsValid = false;
+	}
+
+	return Digest;
+}
+
+/**
+ * @brief Reset software CRC running value
+ *
+ * @param pMe digest context
+ */
+static void Digest_SwCrc32Init(sDigestContext_t* const pMe)
+{
+	pMe->Value = DIGEST_CRC32_INIT;
+}
+
+/**
+ * @brief Software CRC32, nibble table driven to keep flash footprint low
+ *
+ * @param pMe digest context
+ * @param pData data to be fed
+ * @param WordCount number of words
+ */
+static void Digest_SwCrc32UpdateWords(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t WordCount)
+{
+	uint32_t Crc = pMe->Value;
+
+	for(uint32_t Byte = 0; Byte < (WordCount * DIGEST_WORD_SIZE); Byte++)
+	{
+		Crc ^= ((uint32_t)pData[Byte] << 24);
+		Crc = (Crc << 4) ^ gcCrc32NibbleTable[Crc >> 28];
+		Crc = (Crc << 4) ^ gcCrc32NibbleTable[Crc >> 28];
+	}
+
+	pMe->Value = Crc;
+}
+
+/**
+ * @brief Software CRC has no post processing
+ *
+ * @param pMe digest context
+ * @return uint32_t
+ */
+static uint32_t Digest_SwCrc32Final(sDigestContext_t* const pMe)
+{
+	return pMe->Value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Start a new digest
+ *
+ * @param pMe digest context
+ * @param Algorithm algorithm to be used
+ */
+void Digest_Init(sDigestContext_t* const pMe, eDigestAlgorithm_t Algorithm)
+{
+	assert(NULL != pMe);
+	assert(Algorithm < eDIGEST_MAX);
+
+	memset(pMe, 0, sizeof(sDigestContext_t));
+	pMe->pAlgorithm = &gcDigestAlgorithmTable[Algorithm];
+	pMe->IsValid = true;
+
+	pMe->pAlgorithm->pfInit(pMe);
+}
+
+/**
+ * @brief Feed a chunk of data, chunks need not be word multiples
+ *
+ * @param pMe digest context
+ * @param pData data to be fed
+ * @param Length number of bytes
+ */
+void Digest_Update(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	assert(NULL != pMe);
+	assert((NULL != pData) || (0 == Length));
+
+	if(false == pMe->IsValid)
+	{
+		return;
+	}
+
+	AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_CRC);
+
+	pMe->ByteCount += Length;
+
+	if(pMe->CarryLength > 0)
+	{
+		while((pMe->CarryLength < DIGEST_WORD_SIZE) && (Length > 0))
+		{
+			pMe->Carry[pMe->CarryLength++] = *pData++;
+			Length--;
+		}
+
+		if(DIGEST_WORD_SIZE == pMe->CarryLength)
+		{
+			pMe->pAlgorithm->pfUpdateWords(pMe, pMe->Carry, 1);
+			pMe->CarryLength = 0;
+		}
+	}
+
+	uint32_t WordCount = Length / DIGEST_WORD_SIZE;
+
+	if(WordCount > 0)
+	{
+		pMe->pAlgorithm->pfUpdateWords(pMe, pData, WordCount);
+		pData += (WordCount * DIGEST_WORD_SIZE);
+		Length -= (WordCount * DIGEST_WORD_SIZE);
+	}
+
+	while(Length > 0)
+	{
+		pMe->Carry[pMe->CarryLength++] = *pData++;
+		Length--;
+	}
+
+	AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_CRC);
+}
+
+/**
+ * @brief Pad the last incomplete word with zeros and get the digest
+ *
+ * @param pMe digest context
+ * @param pOutDigest digest is saved here
+ * @return true if digest covers every byte fed since @ref Digest_Init
+ */
+bool Digest_Final(sDigestContext_t* const pMe, uint32_t* const pOutDigest)
+{
+	assert(NULL != pMe);
+	assert(NULL != pOutDigest);
+
+	if((NULL == pMe->pAlgorithm) || (false == pMe->IsValid))
+	{
+		return false;
+	}
+
+	if(pMe->CarryLength > 0)
+	{
+		memset(&pMe->Carry[pMe->CarryLength], 0, DIGEST_WORD_SIZE - pMe->CarryLength);
+		pMe->pAlgorithm->pfUpdateWords(pMe, pMe->Carry, 1);
+		pMe->CarryLength = 0;
+	}
+
+	*pOutDigest = pMe->pAlgorithm->pfFinal(pMe);
+
+	bool IsDigestValid = pMe->IsValid;
+	pMe->IsValid = false;
+
+	return IsDigestValid;
+}
+
+/**
+ * @brief Get printable name of digest algorithm
+ *
+ * @param pMe digest context
+ * @return const char*
+ */
+const char* Digest_GetName(const sDigestContext_t* const pMe)
+{
+	assert(NULL != pMe);
+
+	return (NULL != pMe->pAlgorithm)? pMe->pAlgorithm->pName: "None";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef ENABLE_TESTS_DEFINITIONS
+
+#define DIGEST_BENCHMARK_SIZE		(8u * 1024u)	/**< Bytes digested per benchmark run */
+#define DIGEST_CRC32_CHECK_VALUE	(0xAE24E09Du)	/**< CRC-32/MPEG-2 of "123456789" zero padded to 12 bytes */
+
+/**
+ * @brief Digest a buffer and report throughput
+ *
+ * @param Algorithm algorithm to be benchmarked
+ * @param pData data to be digested
+ * @param Length number of bytes
+ * @param pOutDigest digest is saved here
+ * @return true if digest is valid
+ */
+static bool Digest_BenchmarkRun(eDigestAlgorithm_t Algorithm, const uint8_t* const pData, uint32_t Length, uint32_t* const pOutDigest)
+{
+	sDigestContext_t digest;
+
+	uint32_t startCycleCount = AppProfiler_GetCycleCount();
+
+	Digest_Init(&digest, Algorithm);
+	Digest_Update(&digest, pData, Length);
+	bool IsDigestValid = Digest_Final(&digest, pOutDigest);
+
+	uint32_t elapsedUs = AppProfiler_GetElapsedMicroseconds(startCycleCount);
+	uint32_t kiloBytesPerSecond = (0 == elapsedUs)? 0: (uint32_t)(((uint64_t)Length * 1000u) / elapsedUs);
+
+	Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> %s: %lu bytes in %lu us, %lu.%03lu MB/s", Digest_GetName(&digest), (unsigned long)Length, (unsigned long)elapsedUs,
+			(unsigned long)(kiloBytesPerSecond / 1000u), (unsigned long)(kiloBytesPerSecond % 1000u));
+
+	return IsDigestValid;
+}
+
+/**
+ * @brief Check every algorithm against the reference value and against each
+ * other on aligned, unaligned and odd length input, and print throughput
+ *
+ * @return true if all digests match
+ */
+bool Digest_Test()
+{
+	static __attribute__ ((aligned (4))) uint8_t BenchBuf[DIGEST_BENCHMARK_SIZE + 1];
+	static const uint8_t cCheckInput[] = "123456789";
+
+	AppProfiler_EnableCycleCounter();
+
+	for(uint32_t i = 0; i < sizeof(BenchBuf); i++)
+	{
+		BenchBuf[i] = (uint8_t)((i * 31u) + (i >> 8));
+	}
+
+	bool IsPass = true;
+
+	for(eDigestAlgorithm_t Algorithm = eDIGEST_CRC32_HW; Algorithm < eDIGEST_MAX; Algorithm++)
+	{
+		sDigestContext_t digest;
+		uint32_t checkValue = 0;
+
+		/* Split feed exercises the carry of incomplete words */
+		Digest_Init(&digest, Algorithm);
+		Digest_Update(&digest, cCheckInput, 1);
+		Digest_Update(&digest, &cCheckInput[1], sizeof(cCheckInput) - 2);
+		IsPass &= Digest_Final(&digest, &checkValue);
+		IsPass &= (DIGEST_CRC32_CHECK_VALUE == checkValue);
+	}
+
+	uint32_t alignedDigest[eDIGEST_MAX] = {0};
+	uint32_t unalignedDigest[eDIGEST_MAX] = {0};
+
+	for(eDigestAlgorithm_t Algorithm = eDIGEST_CRC32_HW; Algorithm < eDIGEST_MAX; Algorithm++)
+	{
+		IsPass &= Digest_BenchmarkRun(Algorithm, BenchBuf, DIGEST_BENCHMARK_SIZE, &alignedDigest[Algorithm]);
+		IsPass &= Digest_BenchmarkRun(Algorithm, &BenchBuf[1], DIGEST_BENCHMARK_SIZE - 3, &unalignedDigest[Algorithm]);
+	}
+
+	for(eDigestAlgorithm_t Algorithm = eDIGEST_CRC32_HW; Algorithm < eDIGEST_MAX; Algorithm++)
+	{
+		IsPass &= (alignedDigest[Algorithm] == alignedDigest[eDIGEST_CRC32_HW]);
+		IsPass &= (unalignedDigest[Algorithm] == unalignedDigest[eDIGEST_CRC32_HW]);
+	}
+
+	return IsPass;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,81 @@
+/**
+ * @file Digest.h
+ * @author Vishal Keshava Murthy
+ * @brief Streaming digest interface, data is fed in chunks of any size as it
+ * passes through and the digest is available as soon as the last chunk is in
+ * @version 0.1
+ * @date 2024-06-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPCOMMON_APPUTILITY_DIGEST_DIGEST_H_
+#define APPCOMMON_APPUTILITY_DIGEST_DIGEST_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "crc.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define DIGEST_CRC_HANDLE		(&hcrc)		/**< CRC unit used by @ref eDIGEST_CRC32_HW */
+#define DIGEST_WORD_SIZE		(4u)		/**< Digests consume data in 32 bit big endian words, tail is zero padded */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Digest algorithms supported
+ * @note Both CRC32 variants compute the same value (CRC-32/MPEG-2 over the
+ * byte stream zero padded to a word multiple), the software one can run while
+ * the CRC unit is owned by another context
+ */
+typedef enum
+{
+	eDIGEST_CRC32_HW,		/**< CRC32 on the CRC unit, a single context can own the unit at a time */
+	eDIGEST_CRC32_SW,		/**< CRC32 in software, any number of contexts */
+	eDIGEST_MAX
+}eDigestAlgorithm_t;
+
+typedef struct sDigestContext sDigestContext_t;
+
+/**
+ * @brief Operations implemented by each digest algorithm
+ */
+typedef struct
+{
+	const char* pName;
+	void (*pfInit)(sDigestContext_t* const pMe);
+	void (*pfUpdateWords)(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t WordCount);	/**< pData is not necessarily word aligned */
+	uint32_t (*pfFinal)(sDigestContext_t* const pMe);
+}sDigestAlgorithm_t;
+
+/**
+ * @brief Running digest
+ */
+struct sDigestContext
+{
+	const sDigestAlgorithm_t* pAlgorithm;
+	uint32_t Value;								/**< Running value of algorithms that keep state in RAM */
+	uint32_t ByteCount;							/**< Bytes fed so far */
+	uint8_t Carry[DIGEST_WORD_SIZE];			/**< Bytes of an incomplete word waiting for the next update */
+	uint8_t CarryLength;
+	bool IsValid;								/**< Cleared if the context lost its hardware unit or was never initialized */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Digest_Init(sDigestContext_t* const pMe, eDigestAlgorithm_t Algorithm);
+void Digest_Update(sDigestContext_t* const pMe, const uint8_t* pData, uint32_t Length);
+bool Digest_Final(sDigestContext_t* const pMe, uint32_t* const pOutDigest);
+const char* Digest_GetName(const sDigestContext_t* const pMe);
+
+bool Digest_Test();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* APPCOMMON_APPUTILITY_DIGEST_DIGEST_H_ */
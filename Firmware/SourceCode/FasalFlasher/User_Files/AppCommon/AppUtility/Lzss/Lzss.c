@@ -0,0 +1,171 @@
+/**
+ * @file Lzss.c
+ * @author Vishal Keshava Murthy
+ * @brief Streaming LZSS decoder implementation
+ * @version 0.1
+ * @date 2024-06-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Lzss.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Take the next field from the input
+ *
+ * @param pMe decoder
+ * @param ppIn input cursor, advanced past consumed bytes
+ * @param pInLength input bytes left, reduced by consumed bytes
+ * @param Count field width in bits, at most 16
+ * @param pOutValue field value is saved here
+ * @return true if the input held enough bits, false leaves the partial field in the decoder
+ */
+static bool Lzss_GetBits(sLzssDecoder_t* const pMe, const uint8_t** ppIn, uint32_t* const pInLength, uint8_t Count, uint16_t* const pOutValue)
+{
+	while(pMe->BitCount < Count)
+	{
+		if(0 == *pInLength)
+		{
+			return false;
+		}
+
+		pMe->BitBuffer = (pMe->BitBuffer << 8u) | **ppIn;
+		(*ppIn)++;
+		(*pInLength)--;
+		pMe->BitCount += 8u;
+	}
+
+	pMe->BitCount -= Count;
+	*pOutValue = (uint16_t)((pMe->BitBuffer >> pMe->BitCount) & ((1u << Count) - 1u));
+
+	return true;
+}
+
+/**
+ * @brief Initialize decoder for a stream
+ *
+ * @param pMe decoder
+ * @param WindowBits window size of the stream, log2
+ * @param LookaheadBits longest back reference of the stream, log2
+ * @return true if the stream parameters are supported
+ */
+bool Lzss_Init(sLzssDecoder_t* const pMe, uint8_t WindowBits, uint8_t LookaheadBits)
+{
+	assert(NULL != pMe);
+
+	if((WindowBits < LZSS_WINDOW_BITS_MIN) || (WindowBits > LZSS_WINDOW_BITS_MAX) ||
+		(LookaheadBits < LZSS_LOOKAHEAD_BITS_MIN) || (LookaheadBits >= WindowBits))
+	{
+		return false;
+	}
+
+	memset(pMe->Window, 0, sizeof(pMe->Window));
+	pMe->WindowHead = 0;
+	pMe->WindowMask = (uint16_t)((1u << WindowBits) - 1u);
+	pMe->WindowBits = WindowBits;
+	pMe->LookaheadBits = LookaheadBits;
+	pMe->State = eLZSS_STATE_TAG;
+	pMe->BitBuffer = 0;
+	pMe->BitCount = 0;
+	pMe->Distance = 0;
+	pMe->CopyLeft = 0;
+
+	return true;
+}
+
+/**
+ * @brief Decode as much of the input as fits the output buffer
+ *
+ * @note Call again with the remaining input once the output is consumed. Input
+ * is fully consumed when fewer than OutSize bytes are returned.
+ *
+ * @param pMe decoder
+ * @param ppIn input cursor, advanced past consumed bytes
+ * @param pInLength input bytes left, reduced by consumed bytes
+ * @param pOut decoded bytes are saved here
+ * @param OutSize size of pOut
+ * @return uint32_t number of decoded bytes
+ */
+uint32_t Lzss_Decode(sLzssDecoder_t* const pMe, const uint8_t** ppIn, uint32_t* const pInLength, uint8_t* pOut, uint32_t OutSize)
+{
+	assert(NULL != pMe);
+	assert(NULL != ppIn);
+	assert(NULL != pInLength);
+	assert(NULL != pOut);
+
+	uint32_t Produced = 0;
+	uint16_t Value = 0;
+
+	while(Produced < OutSize)
+	{
+		switch(pMe->State)
+		{
+			case eLZSS_STATE_TAG:
+				if(false == Lzss_GetBits(pMe, ppIn, pInLength, 1u, &Value))
+				{
+					return Produced;
+				}
+				pMe->State = (0 != Value)? eLZSS_STATE_LITERAL: eLZSS_STATE_DISTANCE;
+				break;
+
+			case eLZSS_STATE_LITERAL:
+				if(false == Lzss_GetBits(pMe, ppIn, pInLength, 8u, &Value))
+				{
+					return Produced;
+				}
+				pMe->Window[pMe->WindowHead] = (uint8_t)Value;
+				pMe->WindowHead = (pMe->WindowHead + 1u) & pMe->WindowMask;
+				pOut[Produced++] = (uint8_t)Value;
+				pMe->State = eLZSS_STATE_TAG;
+				break;
+
+			case eLZSS_STATE_DISTANCE:
+				if(false == Lzss_GetBits(pMe, ppIn, pInLength, pMe->WindowBits, &Value))
+				{
+					return Produced;
+				}
+				pMe->Distance = Value + 1u;
+				pMe->State = eLZSS_STATE_LENGTH;
+				break;
+
+			case eLZSS_STATE_LENGTH:
+				if(false == Lzss_GetBits(pMe, ppIn, pInLength, pMe->LookaheadBits, &Value))
+				{
+					return Produced;
+				}
+				pMe->CopyLeft = Value + 1u;
+				pMe->State = eLZSS_STATE_COPY;
+				break;
+
+			case eLZSS_STATE_COPY:
+			default:
+			{
+				uint8_t data = pMe->Window[(pMe->WindowHead - pMe->Distance) & pMe->WindowMask];
+
+				pMe->Window[pMe->WindowHead] = data;
+				pMe->WindowHead = (pMe->WindowHead + 1u) & pMe->WindowMask;
+				pOut[Produced++] = data;
+
+				pMe->CopyLeft--;
+				if(0 == pMe->CopyLeft)
+				{
+					pMe->State = eLZSS_STATE_TAG;
+				}
+				break;
+			}
+		}
+	}
+
+	return Produced;
+}
+
+///////////////////////////////////////////////////////////////////////////////
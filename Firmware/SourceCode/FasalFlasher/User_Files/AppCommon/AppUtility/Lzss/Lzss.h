@@ -0,0 +1,75 @@
+/**
+ * @file Lzss.h
+ * @author Vishal Keshava Murthy
+ * @brief Streaming LZSS decoder, bit compatible with heatshrink. Input is fed
+ * in chunks of any size and output is polled into a caller buffer, RAM use is
+ * bounded by the window.
+ * @version 0.1
+ * @date 2024-06-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPCOMMON_APPUTILITY_LZSS_LZSS_H_
+#define APPCOMMON_APPUTILITY_LZSS_LZSS_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Bitstream, most significant bit first
+ * Literal:        1, byte (8 bits)
+ * Back reference: 0, distance - 1 (window bits), length - 1 (lookahead bits)
+ * History before the first byte reads as zero.
+ */
+
+#define LZSS_WINDOW_BITS_MIN		(4u)
+#define LZSS_WINDOW_BITS_MAX		(10u)		/**< Decoder window is 1 KB, streams with a larger window are refused */
+#define LZSS_WINDOW_SIZE			(1u << LZSS_WINDOW_BITS_MAX)
+#define LZSS_LOOKAHEAD_BITS_MIN		(3u)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Decoder states, each one waits for the bits of one field
+ */
+typedef enum
+{
+	eLZSS_STATE_TAG,			/**< Next field is the literal / back reference flag */
+	eLZSS_STATE_LITERAL,		/**< Next field is a literal byte */
+	eLZSS_STATE_DISTANCE,		/**< Next field is a back reference distance */
+	eLZSS_STATE_LENGTH,			/**< Next field is a back reference length */
+	eLZSS_STATE_COPY,			/**< Back reference is being copied out */
+}eLzssState_t;
+
+/**
+ * @brief Streaming decoder
+ */
+typedef struct
+{
+	uint8_t Window[LZSS_WINDOW_SIZE];			/**< Most recent output, ring indexed by @ref WindowHead */
+	uint16_t WindowHead;
+	uint16_t WindowMask;
+	uint8_t WindowBits;
+	uint8_t LookaheadBits;
+	eLzssState_t State;
+	uint32_t BitBuffer;							/**< Input bits not consumed yet, right aligned */
+	uint8_t BitCount;
+	uint16_t Distance;							/**< Back reference being copied */
+	uint16_t CopyLeft;
+}sLzssDecoder_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Lzss_Init(sLzssDecoder_t* const pMe, uint8_t WindowBits, uint8_t LookaheadBits);
+uint32_t Lzss_Decode(sLzssDecoder_t* const pMe, const uint8_t** ppIn, uint32_t* const pInLength, uint8_t* pOut, uint32_t OutSize);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* APPCOMMON_APPUTILITY_LZSS_LZSS_H_ */
@@ -0,0 +1,129 @@
+/**
+ * @file SpiLL.h
+ * @author Vishal Keshava Murthy
+ * @brief Register level SPI transport for short transactions (opcodes,
+ * addresses, status polls and tokens) where the HAL state machine costs more
+ * than the byte on the wire. Block transfers stay on HAL/DMA.
+ * @version 0.1
+ * @date 2024-06-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPCOMMON_APPUTILITY_SPILL_H_
+#define APPCOMMON_APPUTILITY_SPILL_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Drive chip select low through BSRR, single store with no read-modify-write
+ *
+ * @param pPort GPIO port of chip select
+ * @param Pin GPIO pin mask of chip select
+ */
+static inline void SpiLL_CsLow(GPIO_TypeDef* const pPort, uint16_t Pin)
+{
+	pPort->BSRR = ((uint32_t)Pin << 16u);
+}
+
+/**
+ * @brief Drive chip select high through BSRR
+ *
+ * @param pPort GPIO port of chip select
+ * @param Pin GPIO pin mask of chip select
+ */
+static inline void SpiLL_CsHigh(GPIO_TypeDef* const pPort, uint16_t Pin)
+{
+	pPort->BSRR = (uint32_t)Pin;
+}
+
+/**
+ * @brief Prepare peripheral for a polled transaction. Enables SPI if a HAL
+ * deinit/init left it disabled and drops any byte left in the receive buffer
+ * by a previous transmit only transfer.
+ *
+ * @param pSpi SPI instance
+ */
+static inline void SpiLL_Begin(SPI_TypeDef* const pSpi)
+{
+	if(0 == (pSpi->CR1 & SPI_CR1_SPE))
+	{
+		pSpi->CR1 |= SPI_CR1_SPE;
+	}
+
+	while(0 != (pSpi->SR & SPI_SR_RXNE))
+	{
+		(void)pSpi->DR;
+	}
+}
+
+/**
+ * @brief Exchange a single byte
+ *
+ * @note Returns once the byte is fully shifted, so chip select can be released right after
+ *
+ * @param pSpi SPI instance
+ * @param Data byte to be sent
+ * @return uint8_t byte received
+ */
+static inline uint8_t SpiLL_Transfer(SPI_TypeDef* const pSpi, uint8_t Data)
+{
+	while(0 == (pSpi->SR & SPI_SR_TXE))
+	{
+	}
+
+	*(__IO uint8_t*)&pSpi->DR = Data;
+
+	while(0 == (pSpi->SR & SPI_SR_RXNE))
+	{
+	}
+
+	return (uint8_t)pSpi->DR;
+}
+
+/**
+ * @brief Send a short run of bytes back to back, received bytes are dropped
+ *
+ * @note Next byte is queued while the previous one shifts, so there is no gap between bytes
+ *
+ * @param pSpi SPI instance
+ * @param pData bytes to be sent
+ * @param Length number of bytes
+ */
+static inline void SpiLL_Write(SPI_TypeDef* const pSpi, const uint8_t* pData, uint32_t Length)
+{
+	while(Length > 0)
+	{
+		while(0 == (pSpi->SR & SPI_SR_TXE))
+		{
+		}
+
+		*(__IO uint8_t*)&pSpi->DR = *pData++;
+		Length--;
+
+		/* Drain receive buffer so it never overruns */
+		if(0 != (pSpi->SR & SPI_SR_RXNE))
+		{
+			(void)pSpi->DR;
+		}
+	}
+
+	while(0 != (pSpi->SR & SPI_SR_BSY))
+	{
+	}
+
+	(void)pSpi->DR;
+	(void)pSpi->SR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* APPCOMMON_APPUTILITY_SPILL_H_ */
@@ -11,40 +11,57 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#include "usart.h"
+#include "spi.h"
 
-#include "Console.h"
-#include "softTimer.h"
+#include "SoftTimer.h"
+#include "W25Qxx.h"
+#include "AppProfiler.h"
 
 #include "CommonInterrupts.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief STM HAL reception callback
+ * @brief Timer callback associated with soft-timer, part of STM HAL
  *
- * @param huart
+ * @param htim timer instance
  */
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
-	UNUSED(huart);
-    if (huart == &huart1)
+    if (htim->Instance == (SOFTTIMER_TIMER_INSTANCE)->Instance)
+    {
+    	SoftTimer_cbPeriodicCheck();
+    	AppProfiler_cbPeriodicCheck();
+    }
+    else if (htim->Instance == (W25QXXH_POLL_TIMER_HANDLE)->Instance)
     {
-    	Console_cbCommandReceived();
+    	W25qxx_cbPollTimerElapsed();
     }
 }
 
+/**
+ * @brief STM HAL SPI transmit complete callback
+ *
+ * @param hspi SPI instance
+ */
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi->Instance == (W25QXXH_SPI_HANDLE)->Instance)
+    {
+    	W25qxx_cbDataPhaseComplete();
+    }
+}
 
 /**
- * @brief Timer callback associated with soft-timer, part of STM HAL
+ * @brief STM HAL SPI error callback
  *
- * @param htim timer instance
+ * @param hspi SPI instance
  */
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
 {
-    if (htim->Instance == (SOFTTIMER_TIMER_INSTANCE)->Instance)
+    if (hspi->Instance == (W25QXXH_SPI_HANDLE)->Instance)
     {
-    	SoftTimer_cbPeriodicCheck();
+    	W25qxx_cbDataPhaseError();
     }
 }
 
@@ -11,7 +11,7 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#include "GPIO.h"
+#include "gpio.h"
 #include "ConfigSetting.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -14,51 +14,584 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <assert.h>
+#include <stdlib.h>
 
 #include "usart.h"
 
 #include "Console.h"
 #include "SoftTimer.h"
 #include "AppConfiguration.h"
+#include "W25Qxx.h"
+#include "AppProfiler.h"
+#include "AppTrace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef ENABLE_BINARY_CONSOLE_LOG
+#define CONSOLE_LOG_MODE_DEFAULT	(eCONSOLE_LOG_BINARY)
+#else
+#define CONSOLE_LOG_MODE_DEFAULT	(eCONSOLE_LOG_TEXT)
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static char gDataBuffer[CONSOLE_BUFFER_SIZE] = {0};		/**< Global buffer used by Console print*/
 
+static sConsoleTxDma_t gvTxDma = {.Fill = 0, .DmaLength = 0, .IsStarted = false, .LogMode = CONSOLE_LOG_MODE_DEFAULT};	/**< Transmit ring drained by DMA */
+
 ///////////////////////////////////////////////////////////////////////////////
 
+static void Console_PrintHelp();
+static void Console_cbProfileDump();
+static void Console_cbTraceDump();
+
 /**
- * @brief Console commands, names and their flags are stored in this table
+ * @brief Console commands, names and their flags are stored in this table.
+ * Commands without actor are served by the application, see @ref Console_SetCommandActor
  *
  */
 static sConsoleCommand_t gConsoleCommandHelperTable[eCONSOLE_MAX_COMMANDS] =
 {
+		[eCONSOLE_PROFILE_DUMP_REQUEST] = {.CommandName = "Profile Dump", .CommandStr = "PRF", .pfConsoleCommandActor = Console_cbProfileDump},
+		[eCONSOLE_TRACE_DUMP_REQUEST] = {.CommandName = "Trace Dump", .CommandStr = "TRC", .pfConsoleCommandActor = Console_cbTraceDump},
+		[eCONSOLE_START_REQUEST] = {.CommandName = "Start Transfer [SD|XMODEM]", .CommandStr = "START"},
+		[eCONSOLE_PROFILE_SELECT_REQUEST] = {.CommandName = "Storage Profile [0-3|PINS]", .CommandStr = "PROFILE"},
+		[eCONSOLE_STATUS_REQUEST] = {.CommandName = "Application Status", .CommandStr = "STATUS"},
+		[eCONSOLE_RESULT_REQUEST] = {.CommandName = "Last Transfer Result", .CommandStr = "RESULT"},
+		[eCONSOLE_HELP_REQUEST] = {.CommandName = "Command List", .CommandStr = "HELP", .pfConsoleCommandActor = Console_PrintHelp},
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sConsoleShell_t gvShell = {.Head = 0, .Tail = 0};		/**< Command line reception */
+
+static volatile pfConsoleRxByteHook_t gvpfRxByteHook = NULL;	/**< Receive hook of active capture, NULL while command lines are received */
+
+static sConsoleRxDma_t gvRxDma = {.IsActive = false};			/**< Circular DMA receive ring */
+
+/**
+ * @brief Rates a host may ask for in @ref Console_NegotiateBaudRate, all within 1% on a 72 MHz APB2
+ */
+static const uint32_t gcConsoleBaudRateTable[] =
+{
+		230400, 460800, 921600, 1000000, 1500000, 2000000, 3000000,
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static volatile sElevatedPromptData_t gvElevatedPromptData = {.buf = {0}};  /**< Buffer for saving elevated prompt data */
+static uint16_t Console_RxRingGetFill();
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Start DMA on the oldest queued bytes, up to the end of the ring, unless it is already running
+ * @note Caller holds interrupts off
+ *
+ * @param pMe transmit ring
+ */
+static void Console_TxDmaKick(sConsoleTxDma_t* const pMe)
+{
+	if((false == pMe->IsStarted) || (0 != pMe->DmaLength) || (0 == pMe->Fill))
+	{
+		return;
+	}
+
+	uint16_t Length = pMe->Fill;
+
+	if(Length > (CONSOLE_TX_RING_SIZE - pMe->Tail))
+	{
+		Length = (uint16_t)(CONSOLE_TX_RING_SIZE - pMe->Tail);
+	}
+
+	if(HAL_OK == HAL_DMA_Start_IT(CONSOLE_TX_DMA_HANDLE, (uint32_t)&pMe->Ring[pMe->Tail],
+			(uint32_t)&CONSOLE_UART_HANDLE->Instance->DR, Length))
+	{
+		pMe->DmaLength = Length;
+	}
+}
+
+/**
+ * @brief Transmit DMA finished, release its bytes and send what was queued meanwhile.
+ * Runs from the DMA1 channel 4 interrupt through HAL_DMA_IRQHandler, or from @ref Console_TxDmaPoll
+ *
+ * @param hdma transmit DMA handle
+ */
+static void Console_cbTxDmaComplete(DMA_HandleTypeDef* hdma)
+{
+	UNUSED(hdma);
+
+	sConsoleTxDma_t* pMe = &gvTxDma;
+
+	uint32_t PriMask = __get_PRIMASK();
+	__disable_irq();
+
+	pMe->Tail = (uint16_t)((pMe->Tail + pMe->DmaLength) % CONSOLE_TX_RING_SIZE);
+	pMe->Fill = (uint16_t)(pMe->Fill - pMe->DmaLength);
+	pMe->DmaLength = 0;
+
+	Console_TxDmaKick(pMe);
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+}
+
+/**
+ * @brief Complete a finished transfer without waiting for its interrupt, so a
+ * writer waiting for room makes progress with interrupts off or from a handler
+ * @note Caller holds interrupts off
+ *
+ */
+static void Console_TxDmaPoll()
+{
+	DMA_HandleTypeDef* hdma = CONSOLE_TX_DMA_HANDLE;
+
+	if(0 != __HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma)))
+	{
+		HAL_DMA_IRQHandler(hdma);
+	}
+}
+
+/**
+ * @brief Copy bytes into the ring if they fit as a whole
+ * @note Caller holds interrupts off
+ *
+ * @param pMe transmit ring
+ * @param pData bytes
+ * @param Length number of bytes
+ * @return true if queued
+ */
+static bool Console_TxRingPut(sConsoleTxDma_t* const pMe, const uint8_t* pData, uint16_t Length)
+{
+	if(Length > (CONSOLE_TX_RING_SIZE - pMe->Fill))
+	{
+		return false;
+	}
+
+	uint16_t First = (uint16_t)(CONSOLE_TX_RING_SIZE - pMe->Head);
+
+	if(First > Length)
+	{
+		First = Length;
+	}
+
+	memcpy(&pMe->Ring[pMe->Head], pData, First);
+	memcpy(pMe->Ring, &pData[First], Length - First);
+
+	pMe->Head = (uint16_t)((pMe->Head + Length) % CONSOLE_TX_RING_SIZE);
+	pMe->Fill = (uint16_t)(pMe->Fill + Length);
+
+	pMe->Stats.BytesQueued += Length;
+	if(pMe->Fill > pMe->Stats.PeakFill)
+	{
+		pMe->Stats.PeakFill = pMe->Fill;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Queue bytes for transmission, safe from any context. Time spent
+ * waiting for room is accounted to the UART wait profiler scope when the
+ * writer runs in thread mode with interrupts enabled, as scopes are main
+ * context only.
+ *
+ * @param pData bytes
+ * @param Length number of bytes, at most @ref CONSOLE_TX_RING_SIZE
+ * @param IsWaitAllowed true to wait up to @ref CONSOLE_UART_TIMEOUT_MS for room, false to drop them when the ring is full
+ * @return true if queued
+ */
+static bool Console_TxRingWrite(const uint8_t* pData, uint16_t Length, bool IsWaitAllowed)
+{
+	sConsoleTxDma_t* pMe = &gvTxDma;
+	bool IsQueued = false;
+	bool IsWaiting = false;
+	bool IsScopeOpen = false;
+	uint32_t TickStart = 0;
+
+	while(true)
+	{
+		bool IsTimedOut = (true == IsWaiting) && ((HAL_GetTick() - TickStart) >= CONSOLE_UART_TIMEOUT_MS);
+
+		uint32_t PriMask = __get_PRIMASK();
+		__disable_irq();
+
+		IsQueued = Console_TxRingPut(pMe, pData, Length);
+
+		if(true == IsQueued)
+		{
+			Console_TxDmaKick(pMe);
+		}
+		else if(false == IsWaiting)
+		{
+			pMe->Stats.Overruns++;
+		}
+		else
+		{
+			Console_TxDmaPoll();
+		}
+
+		if((false == IsQueued) && ((false == IsWaitAllowed) || (true == IsTimedOut)))
+		{
+			pMe->Stats.MessagesDropped++;
+			pMe->Stats.BytesDropped += Length;
+			IsWaitAllowed = false;
+		}
+
+		if(0 == PriMask)
+		{
+			__enable_irq();
+		}
+
+		if((true == IsQueued) || (false == IsWaitAllowed))
+		{
+			break;
+		}
+
+		if(false == IsWaiting)
+		{
+			IsWaiting = true;
+			TickStart = HAL_GetTick();
+
+			/* A print from a handler or a masked section could land inside an open scope and corrupt the scope stack */
+			IsScopeOpen = (0 == __get_IPSR()) && (0 == __get_PRIMASK());
+
+			if(true == IsScopeOpen)
+			{
+				AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_UART_WAIT);
+			}
+		}
+	}
+
+	if(true == IsScopeOpen)
+	{
+		AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_UART_WAIT);
+	}
+
+	return IsQueued;
+}
+
+/**
+ * @brief Append bytes to a binary log frame
+ *
+ * @param pFrame frame
+ * @param pLength frame length, advanced
+ * @param pData bytes
+ * @param Size number of bytes
+ * @return false if they do not fit
+ */
+static bool Console_BinaryLogPut(uint8_t* const pFrame, uint16_t* const pLength, const void* pData, uint16_t Size)
+{
+	if((*pLength + Size) > (CONSOLE_BINARY_LOG_PAYLOAD_MAX + 2u))
+	{
+		return false;
+	}
+
+	memcpy(&pFrame[*pLength], pData, Size);
+	*pLength = (uint16_t)(*pLength + Size);
+
+	return true;
+}
+
+/**
+ * @brief Build a binary log frame, see @ref CONSOLE_BINARY_LOG_SYNC. The format
+ * is only scanned for conversions and the arguments copied raw: integers as 4
+ * bytes, ll and j as 8, floating point as a double and strings as a length byte
+ * followed by at most @ref CONSOLE_BINARY_LOG_STRING_MAX characters. Arguments
+ * that do not fit the payload are left out.
+ *
+ * @param pFrame frame is built here, @ref CONSOLE_BINARY_LOG_PAYLOAD_MAX + 2 bytes at least
+ * @param format format string, sent as its address
+ * @param args arguments
+ * @return uint16_t frame length
+ */
+static uint16_t Console_BuildBinaryLog(uint8_t* const pFrame, const char* format, va_list args)
+{
+	uint32_t FormatId = (uint32_t)(uintptr_t)format;
+	uint16_t Length = 2u;
+	bool IsFit = Console_BinaryLogPut(pFrame, &Length, &FormatId, sizeof(FormatId));
+	const char* p = format;
+
+	while((true == IsFit) && ('\0' != *p))
+	{
+		if(('%' != *p++) || ('\0' == *p))
+		{
+			continue;
+		}
+
+		if('%' == *p)
+		{
+			p++;
+			continue;
+		}
+
+		while(('-' == *p) || ('+' == *p) || (' ' == *p) || ('#' == *p) || ('0' == *p))
+		{
+			p++;
+		}
+
+		/* Width and precision, '*' takes either from an int argument */
+		if('*' == *p)
+		{
+			int Value = va_arg(args, int);
+			IsFit &= Console_BinaryLogPut(pFrame, &Length, &Value, sizeof(Value));
+			p++;
+		}
+
+		while(('0' <= *p) && ('9' >= *p))
+		{
+			p++;
+		}
+
+		if('.' == *p)
+		{
+			p++;
+
+			if('*' == *p)
+			{
+				int Value = va_arg(args, int);
+				IsFit &= Console_BinaryLogPut(pFrame, &Length, &Value, sizeof(Value));
+				p++;
+			}
+
+			while(('0' <= *p) && ('9' >= *p))
+			{
+				p++;
+			}
+		}
+
+		/* Length modifier, size_t and ptrdiff_t are long sized and intmax_t long long sized on both target and host */
+		uint8_t LongCount = 0;
+
+		while(('l' == *p) || ('h' == *p) || ('z' == *p) || ('j' == *p) || ('t' == *p) || ('L' == *p))
+		{
+			if('l' == *p)
+			{
+				LongCount++;
+			}
+			else if('j' == *p)
+			{
+				LongCount = 2u;
+			}
+			else if(('z' == *p) || ('t' == *p))
+			{
+				LongCount = 1u;
+			}
+			p++;
+		}
+
+		switch(*p)
+		{
+			case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+				if(LongCount >= 2u)
+				{
+					unsigned long long Value = va_arg(args, unsigned long long);
+					IsFit &= Console_BinaryLogPut(pFrame, &Length, &Value, sizeof(Value));
+				}
+				else
+				{
+					uint32_t Value = (1u == LongCount)? (uint32_t)va_arg(args, unsigned long): va_arg(args, unsigned int);
+					IsFit &= Console_BinaryLogPut(pFrame, &Length, &Value, sizeof(Value));
+				}
+				break;
+
+			case 'p':
+			{
+				uint32_t Value = (uint32_t)(uintptr_t)va_arg(args, void*);
+				IsFit &= Console_BinaryLogPut(pFrame, &Length, &Value, sizeof(Value));
+				break;
+			}
+
+			case 's':
+			{
+				const char* pString = va_arg(args, const char*);
+				uint8_t StringLength = (uint8_t)((NULL != pString)? strnlen(pString, CONSOLE_BINARY_LOG_STRING_MAX): 0u);
+				IsFit &= Console_BinaryLogPut(pFrame, &Length, &StringLength, sizeof(StringLength));
+				IsFit &= Console_BinaryLogPut(pFrame, &Length, pString, StringLength);
+				break;
+			}
+
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			{
+				double Value = va_arg(args, double);
+				IsFit &= Console_BinaryLogPut(pFrame, &Length, &Value, sizeof(Value));
+				break;
+			}
+
+			case '\0':
+				/* Format ends in a broken conversion, the loop condition stops on it */
+				continue;
+
+			default:
+				break;
+		}
+
+		p++;
+	}
+
+	pFrame[0] = CONSOLE_BINARY_LOG_SYNC;
+	pFrame[1] = (uint8_t)(Length - 2u);
+
+	return Length;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief Call back function invoked by @ref HAL_UART_RxCpltCallback upon receiving @ref CONSOLE_COMMAND_TOKEN_SIZE characters
- * @note CONSOLE_COMMAND_TOKEN_SIZE is set to strlen(gConsoleCommandHelperTable[eCONSOLE_LEVEL2_ENABLE].CommandStr) when expecting Secret key for level 2 logs
+ * @brief Queue a byte of a command line, runs from the UART receive interrupt
+ *
+ * @param data received byte
+ */
+static void Console_ShellRxByte(uint8_t data)
+{
+	sConsoleShell_t* pMe = &gvShell;
+	uint16_t Head = pMe->Head;
+	uint16_t Next = (uint16_t)((Head + 1u) % CONSOLE_SHELL_RX_SIZE);
+
+	if(Next == pMe->Tail)
+	{
+		pMe->Overruns++;
+		return;
+	}
+
+	pMe->Ring[Head] = data;
+	pMe->Head = Next;
+}
+
+/**
+ * @brief Take command line reception back from a capture, or start it. Bytes
+ * left over from before are dropped.
+ *
+ */
+static void Console_ShellRxEnable()
+{
+	sConsoleShell_t* pMe = &gvShell;
+	USART_TypeDef* pUart = CONSOLE_UART_HANDLE->Instance;
+
+	pMe->Tail = pMe->Head;
+	pMe->LineLength = 0;
+	pMe->IsLineTooLong = false;
+
+	/* Drop stale byte and overrun flag, SR read followed by DR read clears both */
+	(void)pUart->SR;
+	(void)pUart->DR;
+
+	__HAL_UART_ENABLE_IT(CONSOLE_UART_HANDLE, UART_IT_RXNE);
+	HAL_NVIC_SetPriority(CONSOLE_UART_IRQ, CONSOLE_UART_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(CONSOLE_UART_IRQ);
+}
+
+/**
+ * @brief Run a command line: the first word selects the command from
+ * @ref gConsoleCommandHelperTable, the rest is left for its actor
+ *
+ * @param pLine NUL terminated line without line ending, upper cased
+ */
+static void Console_ShellExecute(char* pLine)
+{
+	sConsoleShell_t* pMe = &gvShell;
+
+	size_t Length = strlen(pLine);
+
+	while((Length > 0) && (' ' == pLine[Length - 1u]))
+	{
+		pLine[--Length] = '\0';
+	}
+
+	while(' ' == *pLine)
+	{
+		pLine++;
+	}
+
+	if('\0' == *pLine)
+	{
+		return;
+	}
+
+	char* pArgs = pLine;
+
+	while(('\0' != *pArgs) && (' ' != *pArgs))
+	{
+		pArgs++;
+	}
+
+	if('\0' != *pArgs)
+	{
+		*pArgs++ = '\0';
+
+		while(' ' == *pArgs)
+		{
+			pArgs++;
+		}
+	}
+
+	for(int i = 0; i < eCONSOLE_MAX_COMMANDS; i++)
+	{
+		sConsoleCommand_t* pCommand = &gConsoleCommandHelperTable[i];
+
+		if(('\0' == pCommand->CommandStr[0]) || (0 != strcmp(pLine, pCommand->CommandStr)))
+		{
+			continue;
+		}
+
+		if(NULL == pCommand->pfConsoleCommandActor)
+		{
+			(void)Console_Reply(false, "%s not available", pCommand->CommandStr);
+			return;
+		}
+
+		pCommand->IsCommandRaised = true;
+		pMe->pArgs = pArgs;
+		pCommand->pfConsoleCommandActor();
+		pMe->pArgs = NULL;
+		return;
+	}
+
+	(void)Console_Reply(false, "unknown command %s, try HELP", pLine);
+}
+
+/**
+ * @brief List the commands the shell takes
  *
  */
-void Console_cbCommandReceived()
+static void Console_PrintHelp()
 {
-	for(int i=0; i<eCONSOLE_MAX_COMMANDS; i++)
+	for(int i = 0; i < eCONSOLE_MAX_COMMANDS; i++)
 	{
-		/**< Check if required passkey is received, if not continue to listen on the console Rx*/
-    	if(NULL != strstr((const char*)gvElevatedPromptData.buf , gConsoleCommandHelperTable[i].CommandStr) )
-    	{
-    		memset(((char*)gvElevatedPromptData.buf), 0, sizeof(gvElevatedPromptData.buf));
-    		Console_RaiseConsoleCmdRequest(i);
-            break;
-    	}
+		const sConsoleCommand_t* pCommand = &gConsoleCommandHelperTable[i];
+
+		if(('\0' != pCommand->CommandStr[0]) && (NULL != pCommand->pfConsoleCommandActor))
+		{
+			(void)Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> %-8s %s", pCommand->CommandStr, pCommand->CommandName);
+		}
 	}
-	HAL_UART_Receive_IT(CONSOLE_UART_HANDLE, (uint8_t*)gvElevatedPromptData.buf, CONSOLE_COMMAND_TOKEN_SIZE);
+
+	(void)Console_Reply(true, "help");
+}
+
+/**
+ * @brief PRF command, print the profiler scopes
+ *
+ */
+static void Console_cbProfileDump()
+{
+	AppProfiler_PrintScopes();
+
+	(void)Console_Reply(true, "profile dump");
+}
+
+/**
+ * @brief TRC command, stream the event trace. The reply follows the binary
+ * dump, Tools/trace2chrome.py takes the records its header announces only.
+ *
+ */
+static void Console_cbTraceDump()
+{
+	AppTrace_Dump();
+
+	(void)Console_Reply(true, "trace dump");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -69,7 +602,18 @@ void Console_cbCommandReceived()
  */
 void Console_Init()
 {
-	HAL_UART_Receive_IT(CONSOLE_UART_HANDLE, (uint8_t*)gvElevatedPromptData.buf, CONSOLE_COMMAND_TOKEN_SIZE);
+	sConsoleTxDma_t* pMe = &gvTxDma;
+
+	CONSOLE_TX_DMA_HANDLE->XferCpltCallback = Console_cbTxDmaComplete;
+	SET_BIT(CONSOLE_UART_HANDLE->Instance->CR3, USART_CR3_DMAT);
+
+	/* Send whatever was printed before */
+	__disable_irq();
+	pMe->IsStarted = true;
+	Console_TxDmaKick(pMe);
+	__enable_irq();
+
+	Console_ShellRxEnable();
 }
 
 /**
@@ -78,6 +622,10 @@ void Console_Init()
  */
 void Console_DeInit()
 {
+	Console_Flush();
+	gvTxDma.IsStarted = false;
+	CLEAR_BIT(CONSOLE_UART_HANDLE->Instance->CR3, USART_CR3_DMAT);
+
 	HAL_UART_Abort(CONSOLE_UART_HANDLE);
 	HAL_UART_MspDeInit(CONSOLE_UART_HANDLE);
 }
@@ -89,18 +637,35 @@ void Console_DeInit()
  */
 eConsolePrintStatus_t Console_TransmitChar(uint8_t data)
 {
-	eConsolePrintStatus_t status = eCONSOLE_FAIL;
+	/* Protocol bytes wait for room rather than get lost */
+	return (true == Console_TxRingWrite(&data, 1u, true))? eCONSOLE_SUCCESS: eCONSOLE_FAIL;
+}
 
-	/* Make available the UART module. */
-	if (HAL_UART_STATE_TIMEOUT == HAL_UART_GetState(CONSOLE_UART_HANDLE))
-	{
-		HAL_UART_Abort(CONSOLE_UART_HANDLE);
-	}
+/**
+ * @brief   Transmit a block of bytes over Console, used for binary protocol frames
+ * @param   pData: bytes to be transmitted
+ * @param   length: number of bytes
+ * @return  eConsoleStatus_t
+ */
+eConsolePrintStatus_t Console_Transmit(const uint8_t* pData, uint16_t length)
+{
+	assert(NULL != pData);
+
+	eConsolePrintStatus_t status = eCONSOLE_SUCCESS;
 
-	if (HAL_OK == HAL_UART_Transmit(CONSOLE_UART_HANDLE, &data, 1u, CONSOLE_UART_TIMEOUT_MS*10u))
+	while((length > 0) && (eCONSOLE_SUCCESS == status))
 	{
-		status = eCONSOLE_SUCCESS;
+		uint16_t Chunk = (length > CONSOLE_TX_RING_SIZE)? CONSOLE_TX_RING_SIZE: length;
+
+		if(false == Console_TxRingWrite(pData, Chunk, true))
+		{
+			status = eCONSOLE_FAIL;
+		}
+
+		pData += Chunk;
+		length = (uint16_t)(length - Chunk);
 	}
+
 	return status;
 }
 
@@ -129,14 +694,23 @@ eConsolePrintStatus_t Console_Print(eConsolePrintLevel_t currentLevel, char *for
 	/**< For print to get through, print level should be sufficient, Hardware override works on levels below @ref eCONSOLE_PRINT_LVL2*/
 	if((true == PrintLevelSufficient) || ((true == IsHardwareOverRideActive) && (eCONSOLE_PRINT_LVL2 != currentLevel)))
 	{
-		memset(gDataBuffer, 0, sizeof(gDataBuffer));
+		uint16_t Length = 0;
 
 		va_list args;
 		va_start(args, format);
-		int formattedLength = vsnprintf(gDataBuffer, sizeof(gDataBuffer), format, args);
+		if(eCONSOLE_LOG_BINARY == gvTxDma.LogMode)
+		{
+			Length = Console_BuildBinaryLog((uint8_t*)gDataBuffer, format, args);
+		}
+		else
+		{
+			int formattedLength = vsnprintf(gDataBuffer, sizeof(gDataBuffer), format, args);
+			Length = (formattedLength < 0)? 0u: (uint16_t)((formattedLength < (int)sizeof(gDataBuffer))? formattedLength: (sizeof(gDataBuffer) - 1u));
+		}
 		va_end(args);
 
-		if(HAL_OK != HAL_UART_Transmit(CONSOLE_UART_HANDLE, (uint8_t*)gDataBuffer, formattedLength , CONSOLE_UART_TIMEOUT_MS))
+		/* Messages for the operator wait for room, debug output is dropped rather than stretch the transfer */
+		if((Length > 0) && (false == Console_TxRingWrite((uint8_t*)gDataBuffer, Length, (eCONSOLE_PRINT_LVL0 == currentLevel))))
 		{
 			status = eCONSOLE_FAIL;
 		}
@@ -146,7 +720,8 @@ eConsolePrintStatus_t Console_Print(eConsolePrintLevel_t currentLevel, char *for
 }
 
 /**
- * @brief   Receive data over console
+ * @brief   Receive data over console. While a capture without hook is running
+ *          bytes come from the receive ring, otherwise from a blocking HAL receive.
  * @param   pOutdata Received data is saved here
  * @param   length:  Size of data read
  * @return  eConsoleStatus_t
@@ -155,14 +730,41 @@ eConsolePrintStatus_t Console_receive(uint8_t* pOutdata, uint16_t length)
 {
 	eConsolePrintStatus_t status = eCONSOLE_FAIL;
 
+	if((true == gvRxDma.IsActive) && (NULL == gvpfRxByteHook))
+	{
+		sConsoleRxDma_t* pMe = &gvRxDma;
+		uint32_t TickStart = HAL_GetTick();
+
+		while((length > 0) && ((HAL_GetTick() - TickStart) < CONSOLE_UART_TIMEOUT_MS))
+		{
+			if(0 < Console_RxRingGetFill())
+			{
+				*pOutdata++ = pMe->Ring[pMe->ReadIndex];
+				pMe->ReadIndex = (uint16_t)((pMe->ReadIndex + 1u) % CONSOLE_RX_RING_SIZE);
+				length--;
+			}
+		}
+
+		return (0 == length)? eCONSOLE_SUCCESS: eCONSOLE_FAIL;
+	}
+
 	/* Make available the UART module. */
 	if (HAL_UART_STATE_READY != HAL_UART_GetState(CONSOLE_UART_HANDLE))
 	{
 		HAL_UART_Abort(CONSOLE_UART_HANDLE);
 	}
 
+	/* Command line reception would take the bytes from under the polled receive */
+	bool IsShellRxEnabled = (0 != (CONSOLE_UART_HANDLE->Instance->CR1 & USART_CR1_RXNEIE));
+	__HAL_UART_DISABLE_IT(CONSOLE_UART_HANDLE, UART_IT_RXNE);
+
 	HAL_StatusTypeDef HALStatus =  HAL_UART_Receive(CONSOLE_UART_HANDLE, pOutdata, length, CONSOLE_UART_TIMEOUT_MS);
 
+	if(true == IsShellRxEnabled)
+	{
+		__HAL_UART_ENABLE_IT(CONSOLE_UART_HANDLE, UART_IT_RXNE);
+	}
+
 	status = (HAL_OK == HALStatus)? eCONSOLE_SUCCESS: eCONSOLE_FAIL;
 
 	return status;
@@ -170,15 +772,382 @@ eConsolePrintStatus_t Console_receive(uint8_t* pOutdata, uint16_t length)
 
 
 /**
- * @brief Thin wrapper around UART transmit for Progress Bar print on console
+ * @brief Progress Bar print on console, dropped when the transmit ring is full
  *
  */
 void Console_PrintProgressBar()
 {
 	const char cPROGRESS_BAR[] = ".";
-	HAL_UART_Transmit(CONSOLE_UART_HANDLE, (uint8_t*)cPROGRESS_BAR, strlen(cPROGRESS_BAR) , 0);
+	(void)Console_TxRingWrite((const uint8_t*)cPROGRESS_BAR, strlen(cPROGRESS_BAR), false);
+}
+
+
+/**
+ * @brief Bytes written into the ring by DMA and not yet consumed
+ *
+ * @return uint16_t
+ */
+static uint16_t Console_RxRingGetFill()
+{
+	sConsoleRxDma_t* pMe = &gvRxDma;
+	uint16_t WriteIndex = (uint16_t)(CONSOLE_RX_RING_SIZE - CONSOLE_RX_DMA_CHANNEL->CNDTR);
+
+	if(CONSOLE_RX_RING_SIZE == WriteIndex)
+	{
+		WriteIndex = 0;
+	}
+
+	return (uint16_t)((WriteIndex + CONSOLE_RX_RING_SIZE - pMe->ReadIndex) % CONSOLE_RX_RING_SIZE);
+}
+
+/**
+ * @brief Hand every byte the DMA wrote since the last drain to the capture hook,
+ * runs from IDLE line, half transfer and transfer complete interrupts
+ *
+ * @note All three interrupts share @ref CONSOLE_UART_IRQ_PRIORITY, so drains never preempt each other
+ */
+static void Console_RxRingDrain()
+{
+	sConsoleRxDma_t* pMe = &gvRxDma;
+	uint16_t Fill = Console_RxRingGetFill();
+
+	while(Fill > 0)
+	{
+		gvpfRxByteHook(pMe->Ring[pMe->ReadIndex]);
+		pMe->ReadIndex = (uint16_t)((pMe->ReadIndex + 1u) % CONSOLE_RX_RING_SIZE);
+		Fill--;
+	}
+}
+
+/**
+ * @brief Receive into the ring with circular DMA on @ref CONSOLE_RX_DMA_CHANNEL,
+ * with an interrupt on line idle and at every half of the ring
+ *
+ * @note The channel is shared with SPI2 TX, W25Qxx page programs are polled
+ * until @ref Console_StopRxCapture hands the channel back
+ *
+ * @param pfHook receive hook, runs in interrupt context. NULL leaves bytes in the ring for @ref Console_receive
+ */
+void Console_StartRxCapture(pfConsoleRxByteHook_t pfHook)
+{
+	sConsoleRxDma_t* pMe = &gvRxDma;
+	USART_TypeDef* pUart = CONSOLE_UART_HANDLE->Instance;
+
+	HAL_UART_AbortReceive(CONSOLE_UART_HANDLE);
+	__HAL_UART_DISABLE_IT(CONSOLE_UART_HANDLE, UART_IT_RXNE);
+	W25qxx_SetDmaEnable(false);
+
+	gvpfRxByteHook = pfHook;
+	pMe->ReadIndex = 0;
+
+	/* Drop stale byte and overrun flag, SR read followed by DR read clears both */
+	(void)pUart->SR;
+	(void)pUart->DR;
+
+	CONSOLE_RX_DMA_CHANNEL->CCR = 0;
+	CONSOLE_RX_DMA_CHANNEL->CPAR = (uint32_t)&pUart->DR;
+	CONSOLE_RX_DMA_CHANNEL->CMAR = (uint32_t)pMe->Ring;
+	CONSOLE_RX_DMA_CHANNEL->CNDTR = CONSOLE_RX_RING_SIZE;
+	CONSOLE_RX_DMA_CHANNEL->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PL_1 |
+			((NULL != pfHook)? (DMA_CCR_HTIE | DMA_CCR_TCIE): 0) | DMA_CCR_EN;
+
+	pMe->IsActive = true;
+
+	SET_BIT(pUart->CR3, USART_CR3_DMAR);
+
+	if(NULL != pfHook)
+	{
+		__HAL_UART_ENABLE_IT(CONSOLE_UART_HANDLE, UART_IT_IDLE);
+		HAL_NVIC_SetPriority(CONSOLE_RX_DMA_IRQ, CONSOLE_UART_IRQ_PRIORITY, 0);
+		HAL_NVIC_EnableIRQ(CONSOLE_RX_DMA_IRQ);
+		HAL_NVIC_SetPriority(CONSOLE_UART_IRQ, CONSOLE_UART_IRQ_PRIORITY, 0);
+		HAL_NVIC_EnableIRQ(CONSOLE_UART_IRQ);
+	}
 }
 
+/**
+ * @brief Stop capture started by @ref Console_StartRxCapture, hand DMA channel back to W25Qxx and resume command reception
+ *
+ */
+void Console_StopRxCapture()
+{
+	sConsoleRxDma_t* pMe = &gvRxDma;
+	USART_TypeDef* pUart = CONSOLE_UART_HANDLE->Instance;
+
+	__HAL_UART_DISABLE_IT(CONSOLE_UART_HANDLE, UART_IT_IDLE);
+	CLEAR_BIT(pUart->CR3, USART_CR3_DMAR);
+
+	CONSOLE_RX_DMA_CHANNEL->CCR = 0;
+	CONSOLE_RX_DMA->IFCR = CONSOLE_RX_DMA_IFCR_ALL;
+	HAL_NVIC_SetPriority(CONSOLE_RX_DMA_IRQ, 0, 0);
+
+	pMe->IsActive = false;
+	gvpfRxByteHook = NULL;
+
+	W25qxx_SetDmaEnable(true);
+
+	Console_ShellRxEnable();
+}
+
+/**
+ * @brief Check whether console reception owns @ref CONSOLE_RX_DMA_CHANNEL
+ *
+ * @return true while a capture is running
+ */
+bool Console_IsRxDmaActive()
+{
+	return gvRxDma.IsActive;
+}
+
+/**
+ * @brief Console UART interrupt, a command line byte arrived, or during a
+ * capture the line went idle so a frame is probably complete
+ *
+ */
+void Console_cbUartIRQ()
+{
+	USART_TypeDef* pUart = CONSOLE_UART_HANDLE->Instance;
+
+	/* Overrun raises the interrupt too, the DR read clears it along with RXNE */
+	if((0 != (pUart->CR1 & USART_CR1_RXNEIE)) && (0 != (pUart->SR & (USART_SR_RXNE | USART_SR_ORE))))
+	{
+		Console_ShellRxByte((uint8_t)pUart->DR);
+	}
+
+	if(0 != (pUart->SR & USART_SR_IDLE))
+	{
+		/* SR read followed by DR read clears IDLE */
+		(void)pUart->DR;
+
+		if(NULL != gvpfRxByteHook)
+		{
+			Console_RxRingDrain();
+		}
+	}
+}
+
+/**
+ * @brief Receive DMA half transfer / transfer complete interrupt
+ *
+ */
+void Console_cbRxDmaIRQ()
+{
+	CONSOLE_RX_DMA->IFCR = CONSOLE_RX_DMA_IFCR_ALL;
+
+	if(NULL != gvpfRxByteHook)
+	{
+		Console_RxRingDrain();
+	}
+}
+
+/**
+ * @brief Set console baud rate, the receive ring keeps running across the change
+ *
+ * @param BaudRate new rate
+ */
+static void Console_SetBaudRate(uint32_t BaudRate)
+{
+	USART_TypeDef* pUart = CONSOLE_UART_HANDLE->Instance;
+
+	/* Let the last byte leave at the old rate */
+	Console_Flush();
+
+	CLEAR_BIT(pUart->CR1, USART_CR1_UE);
+	pUart->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), BaudRate);
+	CONSOLE_UART_HANDLE->Init.BaudRate = BaudRate;
+	SET_BIT(pUart->CR1, USART_CR1_UE);
+}
+
+/**
+ * @brief Collect a line from the receive ring
+ *
+ * @param pOutLine line is saved here, NUL terminated without line ending
+ * @param Size size of pOutLine
+ * @param TimeoutMs time to wait for line ending
+ * @return true if a line ending was received in time
+ */
+static bool Console_ReceiveLine(char* const pOutLine, uint16_t Size, uint32_t TimeoutMs)
+{
+	uint16_t Length = 0;
+	uint32_t TickStart = HAL_GetTick();
+
+	while((HAL_GetTick() - TickStart) < TimeoutMs)
+	{
+		uint8_t data = 0;
+
+		if(eCONSOLE_SUCCESS != Console_receive(&data, 1))
+		{
+			continue;
+		}
+
+		if(('\r' == data) || ('\n' == data))
+		{
+			if(Length > 0)
+			{
+				pOutLine[Length] = '\0';
+				return true;
+			}
+		}
+		else if(Length < (Size - 1u))
+		{
+			pOutLine[Length++] = (char)data;
+		}
+		else
+		{
+			Length = 0;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Offer the host a faster console for the transfer that follows. The
+ * host asks with "BAUD <rate>" within @ref CONSOLE_BAUD_OFFER_MS, the device
+ * answers "OK <rate>" and switches, then the host confirms with "SYNC" at the
+ * new rate within @ref CONSOLE_BAUD_SYNC_MS. Anything else keeps, or falls back
+ * to, @ref CONSOLE_DEFAULT_BAUD.
+ *
+ * @return uint32_t baud rate in use
+ */
+uint32_t Console_NegotiateBaudRate()
+{
+	char Line[BUFFER_SIZE_32];
+	uint32_t BaudRate = CONSOLE_DEFAULT_BAUD;
+
+	Console_StartRxCapture(NULL);
+
+	if((true == Console_ReceiveLine(Line, sizeof(Line), CONSOLE_BAUD_OFFER_MS)) && (0 == strncmp(Line, "BAUD ", 5)))
+	{
+		uint32_t Requested = (uint32_t)strtoul(&Line[5], NULL, 10);
+
+		for(uint8_t i = 0; i < (sizeof(gcConsoleBaudRateTable) / sizeof(gcConsoleBaudRateTable[0])); i++)
+		{
+			if(Requested == gcConsoleBaudRateTable[i])
+			{
+				BaudRate = Requested;
+				break;
+			}
+		}
+
+		if(CONSOLE_DEFAULT_BAUD == BaudRate)
+		{
+			(void)Console_Print(eCONSOLE_PRINT_LVL0, "NO\r\n");
+		}
+		else
+		{
+			(void)Console_Print(eCONSOLE_PRINT_LVL0, "OK %lu\r\n", (unsigned long)BaudRate);
+			Console_SetBaudRate(BaudRate);
+
+			if((true == Console_ReceiveLine(Line, sizeof(Line), CONSOLE_BAUD_SYNC_MS)) && (0 == strcmp(Line, "SYNC")))
+			{
+				(void)Console_Print(eCONSOLE_PRINT_LVL0, "OK\r\n");
+			}
+			else
+			{
+				BaudRate = CONSOLE_DEFAULT_BAUD;
+				Console_SetBaudRate(BaudRate);
+			}
+		}
+	}
+
+	Console_StopRxCapture();
+
+	return BaudRate;
+}
+
+/**
+ * @brief Return to @ref CONSOLE_DEFAULT_BAUD after a transfer at a negotiated rate
+ *
+ */
+void Console_RestoreBaudRate()
+{
+	if(CONSOLE_DEFAULT_BAUD != CONSOLE_UART_HANDLE->Init.BaudRate)
+	{
+		Console_SetBaudRate(CONSOLE_DEFAULT_BAUD);
+	}
+}
+
+/**
+ * @brief Wait until everything queued has left the UART, ahead of a baud rate
+ * change or a reset. Works with interrupts off. Each wait gives up after
+ * @ref CONSOLE_UART_TIMEOUT_MS so a stuck UART cannot hang the caller.
+ *
+ */
+void Console_Flush()
+{
+	sConsoleTxDma_t* pMe = &gvTxDma;
+	USART_TypeDef* pUart = CONSOLE_UART_HANDLE->Instance;
+	uint32_t TickStart = HAL_GetTick();
+
+	while((0 != pMe->Fill) && (true == pMe->IsStarted) && ((HAL_GetTick() - TickStart) < CONSOLE_UART_TIMEOUT_MS))
+	{
+		uint32_t PriMask = __get_PRIMASK();
+		__disable_irq();
+
+		Console_TxDmaPoll();
+
+		if(0 == PriMask)
+		{
+			__enable_irq();
+		}
+	}
+
+	/* DMA is done once the last byte is in DR, wait for it to leave the shift register.
+	 * A stuck or disabled UART never sets TC, whatever is left is given up on */
+	TickStart = HAL_GetTick();
+
+	while((0 == (pUart->SR & USART_SR_TC)) && ((HAL_GetTick() - TickStart) < CONSOLE_UART_TIMEOUT_MS))
+	{
+	}
+}
+
+/**
+ * @brief Choose how @ref Console_Print output leaves the device, text or binary log frames
+ *
+ * @param Mode log mode
+ */
+void Console_SetLogMode(eConsoleLogMode_t Mode)
+{
+	assert(Mode < eCONSOLE_LOG_MODE_MAX);
+
+	gvTxDma.LogMode = Mode;
+}
+
+/**
+ * @brief Get a copy of the transmit ring counters
+ *
+ * @param pOutStats counters are saved here
+ */
+void Console_GetTxStatistics(sConsoleTxStatistics_t* const pOutStats)
+{
+	assert(NULL != pOutStats);
+
+	uint32_t PriMask = __get_PRIMASK();
+	__disable_irq();
+
+	*pOutStats = gvTxDma.Stats;
+
+	if(0 == PriMask)
+	{
+		__enable_irq();
+	}
+}
+
+/**
+ * @brief Print the transmit ring counters
+ *
+ */
+void Console_PrintTxStatistics()
+{
+	sConsoleTxStatistics_t Stats;
+
+	Console_GetTxStatistics(&Stats);
+
+	Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Console TX: %lu bytes queued, peak fill %u of %u, %lu overruns, %lu messages (%lu bytes) dropped",
+			(unsigned long)Stats.BytesQueued, Stats.PeakFill, CONSOLE_TX_RING_SIZE, (unsigned long)Stats.Overruns,
+			(unsigned long)Stats.MessagesDropped, (unsigned long)Stats.BytesDropped);
+}
 
 /**
  * @brief Utility function to check if any command request has been made
@@ -204,27 +1173,96 @@ void Console_RaiseConsoleCmdRequest(eConsoleCommandsEnum_t cmd)
 	if(cmd < eCONSOLE_MAX_COMMANDS)
 	{
 		gConsoleCommandHelperTable[cmd].IsCommandRaised = true;
-		HAL_UART_Transmit(CONSOLE_UART_HANDLE, (uint8_t*)&cmd, sizeof(cmd), 0);
 	}
 }
 
 /**
- * @brief Deferred processing of commands received over console
+ * @brief Attach the handler of a command, for commands served outside the console module
+ *
+ * @param cmd command
+ * @param pfActor handler, NULL to make the command unavailable
+ */
+void Console_SetCommandActor(eConsoleCommandsEnum_t cmd, pfConsoleCommandActor_t pfActor)
+{
+	assert(cmd < eCONSOLE_MAX_COMMANDS);
+
+	gConsoleCommandHelperTable[cmd].pfConsoleCommandActor = pfActor;
+}
+
+/**
+ * @brief Arguments of the command being run, upper cased and without leading blanks
+ *
+ * @return const char* arguments, empty if none
+ */
+const char* Console_GetCommandArgs()
+{
+	return (NULL != gvShell.pArgs)? gvShell.pArgs: "";
+}
+
+/**
+ * @brief Answer a command line with "=> OK" or "=> ERR" followed by the formatted
+ * text. Replies are text in either log mode, so the host can parse them.
+ *
+ * @param IsSuccess true for OK, false for ERR
+ * @param format format string
+ * @param ...
+ * @return eConsolePrintStatus_t
+ */
+eConsolePrintStatus_t Console_Reply(bool IsSuccess, const char* format, ...)
+{
+	int Length = snprintf(gDataBuffer, sizeof(gDataBuffer), "\r\n=> %s ", (true == IsSuccess)? "OK": "ERR");
+
+	va_list args;
+	va_start(args, format);
+	int formattedLength = vsnprintf(&gDataBuffer[Length], sizeof(gDataBuffer) - (size_t)Length, format, args);
+	va_end(args);
+
+	if(formattedLength > 0)
+	{
+		Length += (formattedLength < (int)(sizeof(gDataBuffer) - (size_t)Length))? formattedLength: (int)(sizeof(gDataBuffer) - (size_t)Length - 1u);
+	}
+
+	return (true == Console_TxRingWrite((uint8_t*)gDataBuffer, (uint16_t)Length, true))? eCONSOLE_SUCCESS: eCONSOLE_FAIL;
+}
+
+/**
+ * @brief Deferred processing of commands received over console. Assembles the
+ * bytes queued by the receive interrupt into lines ended by CR or LF and runs
+ * each one. Call from thread context wherever the application can answer.
  *
  */
 void Console_Sync()
 {
-    for(int i = 0; i<eCONSOLE_MAX_COMMANDS; i++ )
-    {
-        if((true == gConsoleCommandHelperTable[i].IsCommandRaised) && (false == gConsoleCommandHelperTable[i].IsCommandServiced) )
-        {
-            if(NULL != gConsoleCommandHelperTable[i].pfConsoleCommandActor)
-            {
-                gConsoleCommandHelperTable[i].IsCommandServiced = true;
-                gConsoleCommandHelperTable[i].pfConsoleCommandActor() ;
-            }
-        }
-
-    }
+	sConsoleShell_t* pMe = &gvShell;
+
+	while(pMe->Tail != pMe->Head)
+	{
+		char data = (char)pMe->Ring[pMe->Tail];
+		pMe->Tail = (uint16_t)((pMe->Tail + 1u) % CONSOLE_SHELL_RX_SIZE);
+
+		if(('\r' == data) || ('\n' == data))
+		{
+			if(true == pMe->IsLineTooLong)
+			{
+				(void)Console_Reply(false, "line longer than %u characters", CONSOLE_SHELL_LINE_SIZE - 1u);
+			}
+			else if(pMe->LineLength > 0)
+			{
+				pMe->Line[pMe->LineLength] = '\0';
+				Console_ShellExecute(pMe->Line);
+			}
+
+			pMe->LineLength = 0;
+			pMe->IsLineTooLong = false;
+		}
+		else if(pMe->LineLength < (CONSOLE_SHELL_LINE_SIZE - 1u))
+		{
+			pMe->Line[pMe->LineLength++] = (('a' <= data) && ('z' >= data))? (char)(data - 'a' + 'A'): data;
+		}
+		else
+		{
+			pMe->IsLineTooLong = true;
+		}
+	}
 }
 
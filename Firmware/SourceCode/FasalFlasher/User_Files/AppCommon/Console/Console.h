@@ -28,19 +28,47 @@
  */
 #define CONSOLE_BUFFER_SIZE		    (512u)	/**< Maximum expected response is just under 200 bytes*/
 #define CONSOLE_UART_TIMEOUT_MS     (1000u)
-#define CONSOLE_PROMPT_BUFFER_SIZE  (8u)
-#define CONSOLE_COMMAND_TOKEN_SIZE	(3u)
+#define CONSOLE_SHELL_RX_SIZE		(128u)		/**< Bytes received between two @ref Console_Sync calls, a few command lines */
+#define CONSOLE_SHELL_LINE_SIZE		(64u)		/**< Longest command line, longer ones are rejected */
 
 #define CONSOLE_UART_HANDLE			(&huart1)
+#define CONSOLE_UART_IRQ			(USART1_IRQn)
+#define CONSOLE_UART_IRQ_PRIORITY	(1u)		/**< Below SPI DMA and timers, the receive ring absorbs the latency */
+#define CONSOLE_RX_DMA				(DMA1)
+#define CONSOLE_RX_DMA_CHANNEL		(DMA1_Channel5)		/**< USART1 RX request, shared with SPI2 TX of W25Qxx */
+#define CONSOLE_RX_DMA_IRQ			(DMA1_Channel5_IRQn)
+#define CONSOLE_RX_DMA_IFCR_ALL		(DMA_IFCR_CGIF5 | DMA_IFCR_CTCIF5 | DMA_IFCR_CHTIF5 | DMA_IFCR_CTEIF5)
+#define CONSOLE_RX_RING_SIZE		(1024u)		/**< Circular DMA target, drained to the capture hook every half ring or line idle */
+#define CONSOLE_DEFAULT_BAUD		(115200u)	/**< Rate set by MX_USART1_UART_Init, restored after a negotiated transfer */
+#define CONSOLE_BAUD_OFFER_MS		(1500u)		/**< Host may ask for a faster rate this long */
+#define CONSOLE_BAUD_SYNC_MS		(500u)		/**< Host must confirm the new rate this long after the switch */
+#define CONSOLE_TX_DMA_HANDLE		(&hdma_usart1_tx)	/**< DMA1 channel 4, USART1 TX request */
+#define CONSOLE_TX_RING_SIZE		(2048u)		/**< Bytes queued for transmit DMA, about 180 ms of output at the default rate */
+
+/**
+ * @brief Binary log frame: @ref CONSOLE_BINARY_LOG_SYNC, payload length, then
+ * the payload of the format string address, 4 bytes, and the raw arguments.
+ * Tools/consolelog.py resolves the address in the ELF image and formats on the host.
+ */
+#define CONSOLE_BINARY_LOG_SYNC		(0x1Fu)		/**< ASCII unit separator, never part of console text */
+#define CONSOLE_BINARY_LOG_PAYLOAD_MAX	(255u)
+#define CONSOLE_BINARY_LOG_STRING_MAX	(128u)		/**< Longest %s argument carried, longer ones are cut */
 
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief Console command handlers
+ * @brief Console command handlers, run from @ref Console_Sync. Arguments are
+ * read with @ref Console_GetCommandArgs, the outcome is sent with @ref Console_Reply.
  *
  */
 typedef void (*pfConsoleCommandActor_t)(void);
 
+/**
+ * @brief Receive hook, called from UART interrupt for each byte while a capture is active
+ *
+ */
+typedef void (*pfConsoleRxByteHook_t)(uint8_t data);
+
 /**
  * @brief Enum that maintains Console status
  *
@@ -63,9 +91,27 @@ typedef enum
     eCONSOLE_LEVEL2_ENABLE,
     eCONSOLE_ERASE_FLASH_REQUEST,
 	eCONSOLE_SENSOR_TEST_REQUEST,
+    eCONSOLE_PROFILE_DUMP_REQUEST,
+    eCONSOLE_TRACE_DUMP_REQUEST,
+    eCONSOLE_START_REQUEST,
+    eCONSOLE_PROFILE_SELECT_REQUEST,
+    eCONSOLE_STATUS_REQUEST,
+    eCONSOLE_RESULT_REQUEST,
+    eCONSOLE_HELP_REQUEST,
     eCONSOLE_MAX_COMMANDS
 }eConsoleCommandsEnum_t;
 
+/**
+ * @brief How @ref Console_Print output leaves the device
+ *
+ */
+typedef enum
+{
+	eCONSOLE_LOG_TEXT,				/**< Formatted on target */
+	eCONSOLE_LOG_BINARY,			/**< Format string address and raw arguments, formatted on the host */
+	eCONSOLE_LOG_MODE_MAX,
+}eConsoleLogMode_t;
+
 /**
  * @brief Console print level
  *
@@ -81,13 +127,61 @@ typedef enum
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief Prompt structure
+ * @brief Console receive ring, written by circular DMA and read by a single consumer
+ *
+ */
+typedef struct
+{
+	uint8_t Ring[CONSOLE_RX_RING_SIZE];
+	volatile uint16_t ReadIndex;		/**< Next byte to be consumed, write index is derived from DMA CNDTR */
+	volatile bool IsActive;				/**< DMA channel is owned by console reception */
+}sConsoleRxDma_t;
+
+/**
+ * @brief Transmit ring counters
+ *
+ */
+typedef struct
+{
+	uint32_t BytesQueued;
+	uint32_t BytesDropped;				/**< Log output thrown away for a full ring */
+	uint32_t MessagesDropped;
+	uint32_t Overruns;					/**< Writes that found the ring full, dropped or waited for */
+	uint16_t PeakFill;
+}sConsoleTxStatistics_t;
+
+/**
+ * @brief Console transmit ring, filled by producers in any context and drained by DMA
+ *
+ */
+typedef struct
+{
+	uint8_t Ring[CONSOLE_TX_RING_SIZE];
+	volatile uint16_t Head;				/**< Next free byte */
+	volatile uint16_t Tail;				/**< Oldest byte not yet sent, DMA reads from here */
+	volatile uint16_t Fill;				/**< Bytes between tail and head, including those DMA is moving */
+	volatile uint16_t DmaLength;		/**< Bytes of the DMA transfer running from tail, 0 when idle */
+	volatile bool IsStarted;			/**< DMA is set up, output queued before @ref Console_Init waits for it */
+	eConsoleLogMode_t LogMode;
+	sConsoleTxStatistics_t Stats;
+}sConsoleTxDma_t;
+
+/**
+ * @brief Command shell, bytes are queued by the UART receive interrupt and
+ * assembled into lines by @ref Console_Sync
  *
  */
 typedef struct
 {
-	char buf[CONSOLE_PROMPT_BUFFER_SIZE];
-}sElevatedPromptData_t;
+	uint8_t Ring[CONSOLE_SHELL_RX_SIZE];
+	volatile uint16_t Head;				/**< Written by the receive interrupt only */
+	volatile uint16_t Tail;				/**< Written by @ref Console_Sync only */
+	volatile uint32_t Overruns;			/**< Bytes lost to a full ring */
+	char Line[CONSOLE_SHELL_LINE_SIZE];
+	uint16_t LineLength;
+	bool IsLineTooLong;					/**< Rest of the line is thrown away */
+	const char* pArgs;					/**< Arguments of the command being run */
+}sConsoleShell_t;
 
 /**
  * @brief Helper structure used by console to process incoming commands
@@ -95,10 +189,9 @@ typedef struct
  */
 typedef struct
 {
-    const char* CommandName;
-    char CommandStr[BUFFER_SIZE_8];
+    const char* CommandName;			/**< Help text */
+    char CommandStr[BUFFER_SIZE_8];		/**< First word of the command line, upper case */
     volatile bool IsCommandRaised;
-    volatile bool IsCommandServiced;
     pfConsoleCommandActor_t pfConsoleCommandActor;
 }sConsoleCommand_t;
 
@@ -107,13 +200,27 @@ typedef struct
 void Console_Init();
 void Console_DeInit();
 eConsolePrintStatus_t Console_TransmitChar(uint8_t data);
+eConsolePrintStatus_t Console_Transmit(const uint8_t* pData, uint16_t length);
 eConsolePrintStatus_t Console_Print(eConsolePrintLevel_t currentLevel, char *format,...);
 eConsolePrintStatus_t Console_receive(uint8_t* pOutdata, uint16_t length);
-void Console_cbCommandReceived();
 bool Console_IsCommandRaised(eConsoleCommandsEnum_t cmd);
 void Console_RaiseConsoleCmdRequest(eConsoleCommandsEnum_t cmd);
+void Console_SetCommandActor(eConsoleCommandsEnum_t cmd, pfConsoleCommandActor_t pfActor);
+const char* Console_GetCommandArgs();
+eConsolePrintStatus_t Console_Reply(bool IsSuccess, const char* format, ...);
 void Console_Sync();
 void Console_PrintProgressBar();
+void Console_StartRxCapture(pfConsoleRxByteHook_t pfHook);
+void Console_StopRxCapture();
+void Console_cbUartIRQ();
+void Console_cbRxDmaIRQ();
+bool Console_IsRxDmaActive();
+uint32_t Console_NegotiateBaudRate();
+void Console_RestoreBaudRate();
+void Console_Flush();
+void Console_SetLogMode(eConsoleLogMode_t Mode);
+void Console_GetTxStatistics(sConsoleTxStatistics_t* const pOutStats);
+void Console_PrintTxStatistics();
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -13,6 +13,10 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
 
 #include "AppFasal.h"
 #include "AppCommon.h"
@@ -27,7 +31,10 @@
 #include "AppSD_API.h"
 #include "ConfigSetting.h"
 #include "xmodem.h"
+#include "FrameLink.h"
 #include "AppProfiler.h"
+#include "AppTrace.h"
+#include "W25Qxx.h"
 #include "AppConfiguration.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -57,6 +64,172 @@ static const eAppIndicationStates_t gcIndicationToAppStateMap[eFASAL_MAX_STATE]
 		[eFASAL_APP_END] 				= eIND_NO_CHANGE,
 };
 
+/**
+ * @brief State names answered to the STATUS and RESULT console commands
+ *
+ */
+static const char* const gcAppFasalStateNames[eFASAL_MAX_STATE] =
+{
+		[eFASAL_APP_INIT] 				= "Init",
+		[eFASAL_APP_STARTUP_MSG] 		= "Startup message",
+		[eFASAL_APP_BUTTON_WAIT] 		= "Button wait",
+		[eFASAL_APP_SD_INIT] 			= "SD init",
+		[eFASAL_APP_SD_CHECK] 			= "SD check",
+		[eFASAL_APP_FLASH_INIT] 		= "Flash init",
+		[eFASAL_APP_MODE_SELECTION]		= "Mode selection",
+		[eFASAL_APP_SD_FLASH_TRANSFER] 	= "SD to flash transfer",
+		[eFASAL_APP_XMODEM_TRANSFER] 	= "XMODEM transfer",
+		[eFASAL_APP_CRC_COMPARE] 		= "CRC compare",
+		[eFASAL_APP_TRANSFER_SUCCESS] 	= "Transfer success",
+		[eFASAL_APP_SD_FAIL] 			= "SD fail",
+		[eFASAL_APP_SD_FILE_FAIL] 		= "SD file fail",
+		[eFASAL_APP_FLASH_FAIL] 		= "Flash fail",
+		[eFASAL_APP_TRANSFER_FAIL] 		= "Transfer fail",
+		[eFASAL_APP_CRC_FAIL] 			= "CRC fail",
+		[eFASAL_APP_END] 				= "End",
+};
+
+/**
+ * @brief Transfer mode names used by the START console command, @ref eTX_MODE_MAX follows the pin
+ *
+ */
+static const char* const gcTransferModeNames[eTX_MODE_MAX + 1] =
+{
+		[eTX_MODE_SDCARD_TO_FLASH] 		= "SD",
+		[eTX_MODE_XMODEM_TO_FLASH] 		= "XMODEM",
+		[eTX_MODE_MAX] 					= "PINS",
+};
+
+static sAppFasalJob_t gAppFasalJob = {.State = eFASAL_APP_INIT, .PreviousState = eFASAL_APP_INIT, .RequestedMode = eTX_MODE_MAX};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get job instance
+ *
+ * @return sAppFasalJob_t*
+ */
+static sAppFasalJob_t* AppFasal_GetJobInstance()
+{
+	return &gAppFasalJob;
+}
+
+/**
+ * @brief START [SD|XMODEM] console command, the job begins as if the flash
+ * button was pressed. Without a mode the transfer mode pin decides.
+ *
+ */
+static void AppFasal_cbStartCommand()
+{
+	sAppFasalJob_t* pMe = AppFasal_GetJobInstance();
+	const char* pArgs = Console_GetCommandArgs();
+	eTransferMode_t Mode = eTX_MODE_MAX;
+
+	if(true == pMe->IsJobRunning)
+	{
+		(void)Console_Reply(false, "busy, job %lu in %s", (unsigned long)pMe->RunCount, gcAppFasalStateNames[pMe->State]);
+		return;
+	}
+
+	for(eTransferMode_t i = 0; i < eTX_MODE_MAX; i++)
+	{
+		if(0 == strcmp(pArgs, gcTransferModeNames[i]))
+		{
+			Mode = i;
+		}
+	}
+
+	if((eTX_MODE_MAX == Mode) && ('\0' != *pArgs))
+	{
+		(void)Console_Reply(false, "unknown mode %s, use SD or XMODEM", pArgs);
+		return;
+	}
+
+	pMe->RequestedMode = Mode;
+	pMe->IsStartRequested = true;
+
+	(void)Console_Reply(true, "start %s", gcTransferModeNames[Mode]);
+}
+
+/**
+ * @brief PROFILE [0-3|PINS] console command, selects the storage profile of the
+ * next jobs over the config setting pins. Without argument the profile in use is answered.
+ *
+ */
+static void AppFasal_cbProfileCommand()
+{
+	sAppFasalJob_t* pMe = AppFasal_GetJobInstance();
+	const char* pArgs = Console_GetCommandArgs();
+
+	if('\0' != *pArgs)
+	{
+		char* pEnd = NULL;
+		unsigned long Profile = strtoul(pArgs, &pEnd, 10);
+
+		if(true == pMe->IsJobRunning)
+		{
+			(void)Console_Reply(false, "busy, job %lu in %s", (unsigned long)pMe->RunCount, gcAppFasalStateNames[pMe->State]);
+			return;
+		}
+
+		if(0 == strcmp(pArgs, gcTransferModeNames[eTX_MODE_MAX]))
+		{
+			AppConfiguration_SetProfileOverride(eCONFIG_SETTING_MAX);
+		}
+		else if((pEnd != pArgs) && ('\0' == *pEnd) && (Profile < eCONFIG_SETTING_MAX))
+		{
+			AppConfiguration_SetProfileOverride((eConfigSettingMode_t)Profile);
+		}
+		else
+		{
+			(void)Console_Reply(false, "unknown profile %s, use 0 to %u or PINS", pArgs, eCONFIG_SETTING_MAX - 1u);
+			return;
+		}
+	}
+
+	(void)Console_Reply(true, "profile %u %s, %s", AppConfiguration_GetActiveSetting(), AppConfiguration_GetActiveProfile()->pName,
+			(true == AppConfiguration_IsProfileOverridden())? "console": "pins");
+}
+
+/**
+ * @brief STATUS console command
+ *
+ */
+static void AppFasal_cbStatusCommand()
+{
+	sAppFasalJob_t* pMe = AppFasal_GetJobInstance();
+
+	if(true == pMe->IsJobRunning)
+	{
+		(void)Console_Reply(true, "running job %lu, %s for %lu ms, profile %u %s", (unsigned long)pMe->RunCount,
+				gcAppFasalStateNames[pMe->State], (unsigned long)(HAL_GetTick() - pMe->JobStartTick),
+				AppConfiguration_GetActiveSetting(), AppConfiguration_GetActiveProfile()->pName);
+	}
+	else
+	{
+		(void)Console_Reply(true, "idle, %s, %lu job(s) run, profile %u %s", gcAppFasalStateNames[pMe->State],
+				(unsigned long)pMe->RunCount, AppConfiguration_GetActiveSetting(), AppConfiguration_GetActiveProfile()->pName);
+	}
+}
+
+/**
+ * @brief RESULT console command, outcome of the last job that finished
+ *
+ */
+static void AppFasal_cbResultCommand()
+{
+	const sAppFasalResult_t* pResult = &AppFasal_GetJobInstance()->LastResult;
+
+	if(0 == pResult->Run)
+	{
+		(void)Console_Reply(false, "no job finished yet");
+		return;
+	}
+
+	(void)Console_Reply(true, "job %lu, error code %04X, %s in %lu ms", (unsigned long)pResult->Run, pResult->ErrorCode,
+			gcAppFasalStateNames[pResult->Outcome], (unsigned long)pResult->DurationMs);
+}
+
 
 /**
  * @brief Initialize all Application modules here
@@ -66,10 +239,15 @@ static void AppFasal_Init()
 {
 	SoftTimer_Init();
 	AppIndicate_Init();
+	AppProfiler_EnableCycleCounter();
 
 	AppIndicate_SetState(eIND_BLUE_250MS);
 
 	Console_Init();
+	Console_SetCommandActor(eCONSOLE_START_REQUEST, AppFasal_cbStartCommand);
+	Console_SetCommandActor(eCONSOLE_PROFILE_SELECT_REQUEST, AppFasal_cbProfileCommand);
+	Console_SetCommandActor(eCONSOLE_STATUS_REQUEST, AppFasal_cbStatusCommand);
+	Console_SetCommandActor(eCONSOLE_RESULT_REQUEST, AppFasal_cbResultCommand);
 }
 
 
@@ -82,9 +260,15 @@ static void AppFasal_Init()
 eAppFasalStates_t AppFasal_Run()
 {
 	static eAppFasalStates_t NextState = eFASAL_APP_INIT ;
+	const eAppFasalStates_t CurrentState = NextState;
+	sAppFasalJob_t* pMe = AppFasal_GetJobInstance();
+
+	pMe->State = CurrentState;
 
 	AppIndicate_SetState(gcIndicationToAppStateMap[NextState]);
 
+	Console_Sync();	/**< Command lines are answered between states, and at progress points of an SD transfer*/
+
 	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "\r\n>> App State %u", NextState );
 
 	switch(NextState)
@@ -97,22 +281,35 @@ eAppFasalStates_t AppFasal_Run()
 		case eFASAL_APP_STARTUP_MSG:
 			AppCommon_StartUpMessagePrint();
 			AppCommon_PrintLineBreak();
-			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Press Flash Button for Initiating Transfer");
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Press Flash Button or send START for Initiating Transfer");
 			NextState = eFASAL_APP_BUTTON_WAIT;
 			break;
 
 		case eFASAL_APP_BUTTON_WAIT:
 		{
 			bool IsButtonPressed = PushButton_IsFlashButtonPressed();
-			NextState = (true == IsButtonPressed)? eFASAL_APP_FLASH_INIT: eFASAL_APP_BUTTON_WAIT ;
+			bool IsStartRequested = pMe->IsStartRequested;
+
+			if((true == IsButtonPressed) || (true == IsStartRequested))
+			{
+				pMe->IsStartRequested = false;
+				pMe->IsJobRunning = true;
+				pMe->RunCount++;
+				pMe->JobStartTick = HAL_GetTick();
+			}
+
+			NextState = (true == pMe->IsJobRunning)? eFASAL_APP_FLASH_INIT: eFASAL_APP_BUTTON_WAIT ;
 			break;
 		}
 
 		case eFASAL_APP_FLASH_INIT:
 		{
+			AppProfiler_ResetScopes();	/**< Profile covers one programming run*/
+			AppTrace_Reset();	/**< Trace starts with this state, so the timeline opens with the flash init*/
+			AppTrace_Record(eAPPTRACE_EVENT_FASAL_STATE, eAPPTRACE_PHASE_INSTANT, eFASAL_APP_FLASH_INIT, eFASAL_APP_BUTTON_WAIT);
 			AppStorage_SetPower(true);	/**< Set power to External Flash prior to Initializing the same*/
-			eStorageFSStatus_t FlashInitStatus = FlashFs_API_Init();
-			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Flash Init %s", AppCommon_GetStatusString(FlashInitStatus));
+			eStorageFSStatus_t FlashInitStatus = AppStorage_FlashInit();
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Flash Init %s, Storage Profile: %s", AppCommon_GetStatusString(FlashInitStatus), AppConfiguration_GetActiveProfile()->pName);
 
 			NextState = (eFS_SUCCESS == FlashInitStatus)? eFASAL_APP_MODE_SELECTION: eFASAL_APP_FLASH_FAIL ;
 			break;
@@ -120,7 +317,7 @@ eAppFasalStates_t AppFasal_Run()
 
 		case eFASAL_APP_MODE_SELECTION:
 		{
-			eTransferMode_t TransferMode = AppStorage_GetCurrentTransferMode();
+			eTransferMode_t TransferMode = (eTX_MODE_MAX != pMe->RequestedMode)? pMe->RequestedMode: AppStorage_GetCurrentTransferMode();
 			switch(TransferMode)
 			{
 				case eTX_MODE_SDCARD_TO_FLASH:
@@ -159,15 +356,30 @@ eAppFasalStates_t AppFasal_Run()
 
 		case eFASAL_APP_SD_FLASH_TRANSFER:
 		{
-			FlashFs_API_DeleteGoldenImageFile();
+			AppStorage_DeleteGoldenImage();
 			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Transferring Golden Image file from SD-Card to Flash. Estimated Time to Completion: 30s");
+			AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_TRANSFER);
 			eStorageFSStatus_t TransferStatus = AppStorage_TransferGoldenImageFileFromSDToFlash();
+			AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_TRANSFER);
 			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> File Transfer from SD-Card to Flash %s", AppCommon_GetStatusString(TransferStatus));
+			AppStorage_PrintGoldenImageDigest();
 
 	#ifdef FORCE_DISABLE_FILE_CRC_CHECK
 			NextState = (eFS_SUCCESS == TransferStatus)? eFASAL_APP_TRANSFER_SUCCESS: eFASAL_APP_TRANSFER_FAIL;
 	#else
-			NextState = (eFS_SUCCESS == TransferStatus)? eFASAL_APP_CRC_COMPARE: eFASAL_APP_TRANSFER_FAIL;
+			if(eFS_SUCCESS != TransferStatus)
+			{
+				NextState = eFASAL_APP_TRANSFER_FAIL;
+			}
+			else if(true == AppStorage_IsPostTransferCRCCheckNeeded())
+			{
+				NextState = eFASAL_APP_CRC_COMPARE;
+			}
+			else
+			{
+				Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Flash contents verified against SD-Card while programming");
+				NextState = eFASAL_APP_TRANSFER_SUCCESS;
+			}
 	#endif
 			break;
 		}
@@ -175,17 +387,60 @@ eAppFasalStates_t AppFasal_Run()
 
 		case eFASAL_APP_XMODEM_TRANSFER:
 		{
-			FlashFs_API_DeleteGoldenImageFile();
-			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Send Golden Image over X-modem for Update. Estimated Time to Completion: 45s \r\n");
-			xmodem_status xModemTransferstatus = xmodem_API_receive();
+			eSerialProtocol_t Protocol = AppConfiguration_GetActiveProfile()->SerialProtocol;
+			bool IsTransferComplete = false;
+
+			bool IsStreaming = (eSERIAL_PROTOCOL_YMODEM_G == Protocol);
+
+			AppStorage_DeleteGoldenImage();
 
-			NextState = (X_COMPLETE == xModemTransferstatus)? eFASAL_APP_TRANSFER_SUCCESS: eFASAL_APP_TRANSFER_FAIL;
+			if(eSERIAL_PROTOCOL_FRAMELINK == Protocol)
+			{
+				Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Send Golden Image over frame link for Update, a dropped link can be resumed within %lu s \r\n", (unsigned long)(FRAMELINK_IDLE_TIMEOUT_MS / 1000u));
+			}
+			else
+			{
+				Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Send Golden Image over %s for Update, files after it are stored alongside. Estimated Time to Completion: 45s \r\n", (true == IsStreaming)? "YMODEM-G": "X-modem/Y-modem");
+			}
+
+			uint32_t BaudRate = Console_NegotiateBaudRate();
+
+			if(eSERIAL_PROTOCOL_FRAMELINK == Protocol)
+			{
+				IsTransferComplete = (eFRAMELINK_SUCCESS == FrameLink_API_Receive());
+			}
+			else
+			{
+				IsTransferComplete = (X_COMPLETE == xmodem_API_receive((true == IsStreaming)? X_MODE_G: X_MODE_CRC));
+			}
+
+			Console_RestoreBaudRate();
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Transfer ran at %lu baud", (unsigned long)BaudRate);
+
+			if(eSERIAL_PROTOCOL_FRAMELINK == Protocol)
+			{
+				FrameLink_API_PrintStatistics();
+			}
+			else if(true == IsTransferComplete)
+			{
+				Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> %u file(s) received", xmodem_API_getFileCount());
+			}
+
+			if(false == IsTransferComplete)
+			{
+				NextState = eFASAL_APP_TRANSFER_FAIL;
+			}
+			else
+			{
+				AppStorage_PrintGoldenImageDigest();
+				NextState = (true == AppStorage_IsPostTransferCRCCheckNeeded())? eFASAL_APP_CRC_COMPARE: eFASAL_APP_TRANSFER_SUCCESS;
+			}
 			break;
 		}
 
 		case eFASAL_APP_CRC_COMPARE:
 		{
-			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Computing CRC of files in SD card and Flash storage... Estimated Time to Completion: 5s");
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Computing CRC of Golden Image in Flash storage... Estimated Time to Completion: 5s");
 			bool IsCRCMatching = false;
 
 			eStorageFSStatus_t CRCComputeStatus = AppStorage_CompareCRCOfGoldenImageFileInSDAndFlash(&IsCRCMatching);
@@ -246,7 +501,7 @@ eAppFasalStates_t AppFasal_Run()
 			AppCommon_AccumlateErrorCode(eERR_FLASH_TRANSFER_FAILURE);
 			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> File transfer Fail!");
 
-			FlashFs_API_DeleteGoldenImageFile();
+			AppStorage_DeleteGoldenImage();
 
 			NextState = eFASAL_APP_END;
 			break;
@@ -254,13 +509,33 @@ eAppFasalStates_t AppFasal_Run()
 
 		case eFASAL_APP_END:
 		{
-			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Application Error Code: %04X", AppCommon_GetErrorCode());
+			sAppFasalResult_t* pResult = &pMe->LastResult;
+
+			pResult->Run = pMe->RunCount;
+			pResult->ErrorCode = AppCommon_GetErrorCode();
+			pResult->Outcome = pMe->PreviousState;
+			pResult->DurationMs = HAL_GetTick() - pMe->JobStartTick;
+
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Application Error Code: %04X", pResult->ErrorCode);
+			W25qxx_PrintLatencyStats();
+			AppProfiler_PrintScopes();
+			Console_PrintTxStatistics();
 
 			AppStorage_SetPower(false); /**< Stop powering the external flash since transfer operation is complete*/
 			AppCommon_ResetErrorCode();	/**< Errors from previous run if any must be cleared here*/
 
+			pMe->IsJobRunning = false;
+			pMe->RequestedMode = eTX_MODE_MAX;	/**< Mode of a START command holds for its own job only*/
+
+			/* Results stay on display, the console keeps answering and a START cuts the wait short */
 			static const uint32_t cRESULT_DISPLAY_TIME_MS = 5000u;
-			SoftTimer_DelayMS(cRESULT_DISPLAY_TIME_MS);
+			uint32_t TickStart = HAL_GetTick();
+
+			while(((HAL_GetTick() - TickStart) < cRESULT_DISPLAY_TIME_MS) && (false == pMe->IsStartRequested))
+			{
+				Console_Sync();
+			}
+
 			NextState = eFASAL_APP_STARTUP_MSG;
 			break;
 		}
@@ -272,6 +547,12 @@ eAppFasalStates_t AppFasal_Run()
 			break;
 		}
 
+	if(CurrentState != NextState)
+	{
+		AppTrace_Record(eAPPTRACE_EVENT_FASAL_STATE, eAPPTRACE_PHASE_INSTANT, NextState, CurrentState);
+		pMe->PreviousState = CurrentState;
+	}
+
 	return NextState;
 }
 
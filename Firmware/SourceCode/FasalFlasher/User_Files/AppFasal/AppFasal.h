@@ -16,7 +16,11 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "AppCommon.h"
+#include "AppStorage.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -52,6 +56,37 @@ typedef enum
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Outcome of a transfer job, answered to the RESULT console command
+ *
+ */
+typedef struct
+{
+	uint32_t Run;						/**< Job number since boot, 0 if no job finished yet */
+	eDeviceErrorCode_t ErrorCode;
+	eAppFasalStates_t Outcome;			/**< Last state before @ref eFASAL_APP_END */
+	uint32_t DurationMs;
+}sAppFasalResult_t;
+
+/**
+ * @brief Transfer job bookkeeping, a job runs from the button press or START
+ * command up to @ref eFASAL_APP_END
+ *
+ */
+typedef struct
+{
+	eAppFasalStates_t State;			/**< State being run */
+	eAppFasalStates_t PreviousState;
+	volatile bool IsStartRequested;		/**< START received, taken by @ref eFASAL_APP_BUTTON_WAIT */
+	eTransferMode_t RequestedMode;		/**< Mode of the START command, @ref eTX_MODE_MAX to follow the transfer mode pin */
+	bool IsJobRunning;
+	uint32_t RunCount;
+	uint32_t JobStartTick;
+	sAppFasalResult_t LastResult;
+}sAppFasalJob_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
 eAppFasalStates_t AppFasal_Run();
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,477 @@
+/**
+ * @file AppFlashRaw_API.c
+ * @author Vishal Keshava Murthy
+ * @brief API implementation of raw partition on external Flash. Golden image is
+ * programmed in full pages straight to a fixed address range, erases are planned
+ * ahead of the write pointer.
+ * @version 0.1
+ * @date 2024-06-07
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <string.h>
+
+#include "AppFlashRaw_API.h"
+#include "Digest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sFlashRaw_t gsFlashRaw = {.IsInitialized = false};	/**< raw partition instance*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get raw partition instance
+ *
+ * @return sFlashRaw_t*
+ */
+static sFlashRaw_t* FlashRaw_GetInstance()
+{
+	return &gsFlashRaw;
+}
+
+/**
+ * @brief Add erase operations issued by one erase call to the image summary
+ *
+ * @param pMe raw partition instance
+ * @param pPlan summary of erase call
+ */
+static void FlashRaw_AccumulateEraseSummary(sFlashRaw_t* const pMe, const sW25qxxErasePlan_t* const pPlan)
+{
+	assert(NULL != pMe);
+	assert(NULL != pPlan);
+
+	for(eW25qxxOperation_t Operation = eW25QXX_OP_NONE; Operation < eW25QXX_OP_MAX; Operation++)
+	{
+		pMe->EraseSummary.OperationCount[Operation] += pPlan->OperationCount[Operation];
+	}
+
+	pMe->EraseSummary.IsChipErase |= pPlan->IsChipErase;
+	pMe->EraseSummary.Length += pPlan->Length;
+	pMe->EraseSummary.BlankBytesSkipped += pPlan->BlankBytesSkipped;
+	pMe->EraseSummary.EstimatedUs += pPlan->EstimatedUs;
+}
+
+/**
+ * @brief Erase partition from current erase pointer up to requested address
+ *
+ * @param pMe raw partition instance
+ * @param EndAddress flash up to this address must be erased on return
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FlashRaw_EraseUpTo(sFlashRaw_t* const pMe, uint32_t EndAddress)
+{
+	assert(NULL != pMe);
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+	uint32_t PartitionEnd = pMe->BaseAddress + pMe->MaxLength;
+
+	while((pMe->ErasedUpTo < EndAddress) && (eFS_SUCCESS == status))
+	{
+		uint32_t EraseLength = FLASHRAW_ERASE_AHEAD_SIZE - (pMe->ErasedUpTo % FLASHRAW_ERASE_AHEAD_SIZE);
+
+		if(EraseLength > (PartitionEnd - pMe->ErasedUpTo))
+		{
+			EraseLength = PartitionEnd - pMe->ErasedUpTo;
+		}
+
+		sW25qxxErasePlan_t Plan;
+		eW25qxxStatus fRes = W25qxx_EraseRange(pMe->ErasedUpTo, EraseLength, &Plan);
+
+		FlashRaw_AccumulateEraseSummary(pMe, &Plan);
+
+		if((0 == fRes) && (0 != Plan.Length))
+		{
+			pMe->ErasedUpTo = Plan.Address + Plan.Length;
+		}
+		else
+		{
+			status = eFS_ERROR;
+		}
+	}
+
+	return status;
+}
+
+/**
+ * @brief Read back a freshly programmed page and compare it against the source
+ * still in RAM
+ *
+ * @param pMe raw partition instance
+ * @param Address flash address of page
+ * @param pInBuf data that was programmed
+ * @param Length number of bytes programmed
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FlashRaw_VerifyPage(sFlashRaw_t* const pMe, uint32_t Address, const uint8_t* const pInBuf, uint32_t Length)
+{
+	assert(NULL != pMe);
+	assert(NULL != pInBuf);
+	assert(Length <= FLASHRAW_PAGE_SIZE);
+
+	eW25qxxStatus fRes = W25qxx_ReadBytes(pMe->VerifyBuf, Address, Length);
+
+	eStorageFSStatus_t status = ((0 == fRes) && (0 == memcmp(pMe->VerifyBuf, pInBuf, Length)))? eFS_SUCCESS: eFS_ERROR;
+
+	if((eFS_SUCCESS != status) && (false == pMe->IsVerifyFailed))
+	{
+		pMe->IsVerifyFailed = true;
+		pMe->VerifyFailAddress = Address;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Program one page worth of data at the write pointer, page is read
+ * back and verified before the write pointer advances
+ *
+ * @note All 0xFF pages are not programmed by the driver, the read back still
+ * proves the range was erased, so they are verified and counted like any other
+ *
+ * @param pMe raw partition instance
+ * @param pInBuf data to be programmed
+ * @param Length number of bytes, a full page except for the tail of the image
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FlashRaw_ProgramPage(sFlashRaw_t* const pMe, const uint8_t* const pInBuf, uint32_t Length)
+{
+	assert(NULL != pMe);
+	assert(NULL != pInBuf);
+	assert(Length <= FLASHRAW_PAGE_SIZE);
+
+	uint32_t Address = pMe->BaseAddress + pMe->BytesWritten;
+
+	eStorageFSStatus_t status = FlashRaw_EraseUpTo(pMe, Address + FLASHRAW_PAGE_SIZE);
+
+	if(eFS_SUCCESS == status)
+	{
+		eW25qxxStatus fRes = W25qxx_WritePage((uint8_t*)pInBuf, Address / FLASHRAW_PAGE_SIZE, 0, Length);
+		status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+	}
+
+	if(eFS_SUCCESS == status)
+	{
+		status = FlashRaw_VerifyPage(pMe, Address, pInBuf, Length);
+	}
+
+	if(eFS_SUCCESS == status)
+	{
+		pMe->BytesWritten += Length;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Write to raw partition. Full pages are programmed straight from the
+ * caller buffer, partial pages are collected in the page buffer.
+ *
+ * @param pMe raw partition instance
+ * @param pInWriteBuf data to be written
+ * @param bufSize size of data
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FlashRaw_WriteRaw(sFlashRaw_t* const pMe, const uint8_t* pInWriteBuf, size_t bufSize)
+{
+	assert(NULL != pMe);
+	assert(NULL != pInWriteBuf);
+
+	if((false == pMe->IsOpen) || ((pMe->BytesWritten + pMe->PageFill + bufSize) > pMe->MaxLength))
+	{
+		return eFS_ERROR;
+	}
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+
+	while((bufSize > 0) && (eFS_SUCCESS == status))
+	{
+		if((0 == pMe->PageFill) && (bufSize >= FLASHRAW_PAGE_SIZE))
+		{
+			status = FlashRaw_ProgramPage(pMe, pInWriteBuf, FLASHRAW_PAGE_SIZE);
+			pInWriteBuf += FLASHRAW_PAGE_SIZE;
+			bufSize -= FLASHRAW_PAGE_SIZE;
+			continue;
+		}
+
+		uint32_t CopyLength = FLASHRAW_PAGE_SIZE - pMe->PageFill;
+
+		if(CopyLength > bufSize)
+		{
+			CopyLength = bufSize;
+		}
+
+		memcpy(&pMe->PageBuf[pMe->PageFill], pInWriteBuf, CopyLength);
+		pMe->PageFill += CopyLength;
+		pInWriteBuf += CopyLength;
+		bufSize -= CopyLength;
+
+		if(FLASHRAW_PAGE_SIZE == pMe->PageFill)
+		{
+			status = FlashRaw_ProgramPage(pMe, pMe->PageBuf, FLASHRAW_PAGE_SIZE);
+			pMe->PageFill = 0;
+		}
+	}
+
+	return status;
+}
+
+/**
+ * @brief compute CRC of image in raw partition
+ *
+ * @note Same digest as @ref FlashFs_API_ComputeGoldenImageFileCRC so both
+ * storage modes produce the same value for the same image
+ *
+ * @param pMe raw partition instance
+ * @param pInOutRamBuf Ram buffer that will be used as temporary storage while computing CRC
+ * @param RamBufSize ram buffer size passed
+ * @param pOutCRC computed CRC will be saved here
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FlashRaw_ComputeCRC(sFlashRaw_t* const pMe, uint8_t* const pInOutRamBuf, uint32_t RamBufSize, uint32_t* const pOutCRC)
+{
+	assert(NULL != pMe);
+	assert(NULL != pOutCRC);
+	assert(NULL != pInOutRamBuf);
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+
+	sDigestContext_t digest;
+	Digest_Init(&digest, eDIGEST_CRC32_HW);
+
+	uint32_t Address = pMe->BaseAddress;
+	uint32_t BytesRemaining = pMe->BytesWritten;
+
+	while((BytesRemaining > 0) && (eFS_SUCCESS == status))
+	{
+		uint32_t numBytesRead = (BytesRemaining > RamBufSize)? RamBufSize: BytesRemaining;
+
+		if(0 == W25qxx_ReadBytes(pInOutRamBuf, Address, numBytesRead))
+		{
+			Digest_Update(&digest, pInOutRamBuf, numBytesRead);
+			Address += numBytesRead;
+			BytesRemaining -= numBytesRead;
+		}
+		else
+		{
+			status = eFS_ERROR;
+		}
+	}
+
+	if(false == Digest_Final(&digest, pOutCRC))
+	{
+		status = eFS_ERROR;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Report first page of current image that failed read back verification
+ *
+ * @param pOutAddress flash address of page is saved here
+ * @return true if a page failed verification
+ */
+bool FlashRaw_API_GetVerifyFailAddress(uint32_t* const pOutAddress)
+{
+	assert(NULL != pOutAddress);
+
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	*pOutAddress = pMe->VerifyFailAddress;
+
+	return pMe->IsVerifyFailed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief API to initialize raw partition
+ *
+ * @param BaseAddress start of partition, must be sector aligned
+ * @param MaxLength size of partition
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_Init(uint32_t BaseAddress, uint32_t MaxLength)
+{
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	assert(0 == (BaseAddress % (DF_SECTOR_SIZE * DF_PAGE_SIZE)));
+
+	eW25qxxStatus fRes = W25qxx_Init();
+
+	memset(pMe, 0, sizeof(sFlashRaw_t));
+	pMe->BaseAddress = BaseAddress;
+	pMe->MaxLength = MaxLength;
+	pMe->ErasedUpTo = BaseAddress;
+	pMe->IsInitialized = (0 == fRes);
+
+	eStorageFSStatus_t status = (true == pMe->IsInitialized)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
+/**
+ * @brief Erase the footprint of an image of known size in one planned pass,
+ * so no erase is interleaved with page programs during the transfer
+ *
+ * @param ImageSize size of image to be written
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_PrepareGoldenImage(uint32_t ImageSize)
+{
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	if((false == pMe->IsInitialized) || (ImageSize > pMe->MaxLength))
+	{
+		return eFS_ERROR;
+	}
+
+	memset(&pMe->EraseSummary, 0, sizeof(sW25qxxErasePlan_t));
+	pMe->ErasedUpTo = pMe->BaseAddress;
+	pMe->IsPrepared = false;
+
+	sW25qxxErasePlan_t Plan;
+	eW25qxxStatus fRes = W25qxx_EraseRange(pMe->BaseAddress, ImageSize, &Plan);
+
+	FlashRaw_AccumulateEraseSummary(pMe, &Plan);
+
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	if(eFS_SUCCESS == status)
+	{
+		pMe->ErasedUpTo = Plan.Address + Plan.Length;
+		pMe->IsPrepared = true;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Open Golden Image in raw partition, write pointer is reset to partition start
+ *
+ * @note The erase watermark of @ref FlashRaw_API_PrepareGoldenImage is kept for the
+ * image it was prepared for, otherwise nothing past the partition start is assumed erased
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_OpenGoldenImageFile()
+{
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	if(false == pMe->IsInitialized)
+	{
+		return eFS_ERROR;
+	}
+
+	if(false == pMe->IsPrepared)
+	{
+		memset(&pMe->EraseSummary, 0, sizeof(sW25qxxErasePlan_t));
+		pMe->ErasedUpTo = pMe->BaseAddress;
+	}
+
+	pMe->IsPrepared = false;
+	pMe->BytesWritten = 0;
+	pMe->PageFill = 0;
+	pMe->IsVerifyFailed = false;
+	pMe->VerifyFailAddress = 0;
+	pMe->IsOpen = true;
+
+	return eFS_SUCCESS;
+}
+
+/**
+ * @brief Write to Golden Image in raw partition
+ *
+ * @note @ref FlashRaw_API_OpenGoldenImageFile must be invoked prior to using this function
+ *
+ * @param pInWriteBuf Contents to be written are passed here
+ * @param bufSize write buffer size
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_WriteToGoldenImageFile(const char* const pInWriteBuf, size_t bufSize)
+{
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	eStorageFSStatus_t status = FlashRaw_WriteRaw(pMe, (const uint8_t*)pInWriteBuf, bufSize);
+
+	return status;
+}
+
+/**
+ * @brief Close golden Image, remaining partial page is programmed
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_CloseGoldenImageFile()
+{
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+
+	if((true == pMe->IsOpen) && (pMe->PageFill > 0))
+	{
+		status = FlashRaw_ProgramPage(pMe, pMe->PageBuf, pMe->PageFill);
+		pMe->PageFill = 0;
+	}
+
+	pMe->IsOpen = false;
+
+	return status;
+}
+
+/**
+ * @brief Invalidate golden Image by erasing the first sector of the partition
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_DeleteGoldenImageFile()
+{
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	if(false == pMe->IsInitialized)
+	{
+		return eFS_ERROR;
+	}
+
+	pMe->IsOpen = false;
+	pMe->IsPrepared = false;
+	pMe->BytesWritten = 0;
+	pMe->PageFill = 0;
+	pMe->ErasedUpTo = pMe->BaseAddress;
+
+	sW25qxxErasePlan_t Plan;
+	eW25qxxStatus fRes = W25qxx_EraseRange(pMe->BaseAddress, DF_SECTOR_SIZE * DF_PAGE_SIZE, &Plan);
+
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
+/**
+ * @brief compute CRC of golden Image in raw partition
+ *
+ * @param pInOutRamBuf Ram buffer that will be used as temporary storage while computing CRC
+ * @param RamBufSize ram buffer size passed
+ * @param pOutCRC computed CRC will be saved here
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashRaw_API_ComputeGoldenImageFileCRC(uint8_t* const pInOutRamBuf, uint32_t RamBufSize, uint32_t* const pOutCRC)
+{
+	assert(NULL != pInOutRamBuf);
+	assert(NULL != pOutCRC);
+
+	sFlashRaw_t* pMe = FlashRaw_GetInstance();
+
+	eStorageFSStatus_t status = FlashRaw_ComputeCRC(pMe, pInOutRamBuf, RamBufSize, pOutCRC);
+
+	return status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,67 @@
+/**
+ * @file AppFlashRaw_API.h
+ * @author Vishal Keshava Murthy
+ * @brief API interface of raw partition on external Flash, golden image is
+ * streamed to a fixed address range without a file system
+ * @version 0.1
+ * @date 2024-06-07
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPSTORAGE_APPFLASHFS_APPFLASHRAW_API_H_
+#define APPSTORAGE_APPFLASHFS_APPFLASHRAW_API_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "W25Qxx.h"
+#include "AppStorageDataStructures.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define FLASHRAW_PAGE_SIZE			(256u)		/**< Program granularity, one full W25Qxx page */
+#define FLASHRAW_ERASE_AHEAD_SIZE	(0x10000u)	/**< Erase granularity when the image size is not known up front */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Raw partition instance
+ *
+ */
+typedef struct
+{
+	bool IsInitialized;
+	bool IsOpen;
+	uint32_t BaseAddress;							/**< Start of partition in flash */
+	uint32_t MaxLength;								/**< Size of partition */
+	uint32_t BytesWritten;							/**< Image bytes accepted since open */
+	uint32_t ErasedUpTo;							/**< Flash up to this address is known to be erased */
+	bool IsPrepared;								/**< ErasedUpTo was set by a prepare for the image opened next */
+	uint32_t PageFill;								/**< Bytes waiting in page buffer */
+	__attribute__ ((aligned (4))) uint8_t PageBuf[FLASHRAW_PAGE_SIZE];	/**< Collects partial pages between writes */
+	__attribute__ ((aligned (4))) uint8_t VerifyBuf[FLASHRAW_PAGE_SIZE];	/**< Page read back after programming */
+	bool IsVerifyFailed;							/**< A page did not read back as written */
+	uint32_t VerifyFailAddress;						/**< Address of first page that did not read back as written */
+	sW25qxxErasePlan_t EraseSummary;				/**< Erase operations issued for current image */
+}sFlashRaw_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+eStorageFSStatus_t FlashRaw_API_Init(uint32_t BaseAddress, uint32_t MaxLength);
+eStorageFSStatus_t FlashRaw_API_PrepareGoldenImage(uint32_t ImageSize);
+eStorageFSStatus_t FlashRaw_API_OpenGoldenImageFile();
+eStorageFSStatus_t FlashRaw_API_WriteToGoldenImageFile(const char* const pInWriteBuf, size_t bufSize);
+eStorageFSStatus_t FlashRaw_API_CloseGoldenImageFile();
+eStorageFSStatus_t FlashRaw_API_DeleteGoldenImageFile();
+bool FlashRaw_API_GetVerifyFailAddress(uint32_t* const pOutAddress);
+eStorageFSStatus_t FlashRaw_API_ComputeGoldenImageFileCRC(uint8_t* const pInOutRamBuf, uint32_t RamBufSize, uint32_t* const pOutCRC);
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+#endif /* APPSTORAGE_APPFLASHFS_APPFLASHRAW_API_H_ */
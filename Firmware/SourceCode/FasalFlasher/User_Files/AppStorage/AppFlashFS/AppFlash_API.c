@@ -18,6 +18,7 @@
 #include "W25Qxx.h"
 #include "LittleFS_Wrapper.h"
 #include "AppConfiguration.h"
+#include "Digest.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -74,7 +75,11 @@ static eStorageFSStatus_t FlashFS_Init(sFlashFS_t* const pMe)
 
 	eStorageFSStatus_t status = eFS_ERROR;
 
-    W25qxx_Init();
+    /* Filesystem geometry is taken from the detected part */
+    if(0 != W25qxx_Init())
+    {
+    	return status;
+    }
 
     int fRes = lfsWrapper_Init((lfs_t*)&(pMe->fs));
 	if(0 == fRes)
@@ -233,27 +238,21 @@ static eStorageFSStatus_t FlashFs_ComputeFileCRC(sFlashFS_t* const pMe, eStorage
 
 	if(eFS_SUCCESS == status)
 	{
-		__HAL_RCC_CRC_CLK_ENABLE();
-		__HAL_LOCK(FLASHFS_CRC_INSTANCE);
-		__HAL_CRC_DR_RESET(FLASHFS_CRC_INSTANCE);
-		__HAL_UNLOCK(FLASHFS_CRC_INSTANCE);
-
-		memset(pInOutRamBuf, 0, RamBufSize);
+		sDigestContext_t digest;
+		Digest_Init(&digest, eDIGEST_CRC32_HW);
 
 		int32_t numBytesRead = 0;
 
 		do
 		{
 			FlashFs_ReadFileRaw(pMe, fileEnum, (char* const)pInOutRamBuf, RamBufSize, &numBytesRead);
-
-			for(int i=0; i<numBytesRead; i=(i+4))
-			{
-				uint32_t crcIntermediete = (pInOutRamBuf[i]<<24) | (pInOutRamBuf[i+1]<<16) | (pInOutRamBuf[i+2]<<8) | (pInOutRamBuf[i+3]) ;
-				(*pOutCRC) = HAL_CRC_Accumulate(FLASHFS_CRC_INSTANCE, &crcIntermediete, 1);
-			}
+			Digest_Update(&digest, pInOutRamBuf, (numBytesRead > 0)? numBytesRead: 0);
 
 		}while(RamBufSize == numBytesRead);
 
+		bool IsDigestValid = Digest_Final(&digest, pOutCRC);
+		status = ((numBytesRead >= 0) && (true == IsDigestValid))? eFS_SUCCESS: eFS_ERROR;
+
 		FlashFs_CloseFileRaw(pMe, fileEnum);
 
 	}
@@ -277,6 +276,22 @@ eStorageFSStatus_t FlashFs_API_Init()
 	return status;
 }
 
+/**
+ * @brief Erase the flash a golden image of known size is written into, ahead of @ref FlashFs_API_OpenGoldenImageFile
+ *
+ * @param ImageSize size of image in bytes
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashFs_API_PrepareGoldenImageFile(uint32_t ImageSize)
+{
+	sFlashFS_t* pMe = FlashFS_GetInstance();
+
+	int fRes = lfsWrapper_PreErase((lfs_t*)&(pMe->fs), ImageSize);
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
 /**
  * @brief Open Golden Image file
  *
@@ -359,6 +374,93 @@ eStorageFSStatus_t FlashFs_API_ComputeGoldenImageFileCRC(uint8_t* const pInOutRa
 	return status;
 }
 
+/**
+ * @brief Erase the flash a named file of known size is written into, ahead of @ref FlashFs_API_OpenNamedFile
+ *
+ * @param Size file size in bytes
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashFs_API_PrepareNamedFile(uint32_t Size)
+{
+	sFlashFS_t* pMe = FlashFS_GetInstance();
+
+	int fRes = lfsWrapper_PreErase((lfs_t*)&(pMe->fs), Size);
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
+/**
+ * @brief Create or truncate a file by name for writing, only one named file is open at a time
+ *
+ * @param pName file name
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashFs_API_OpenNamedFile(const char* const pName)
+{
+	assert(NULL != pName);
+
+	sFlashFS_t* pMe = FlashFS_GetInstance();
+
+	int fRes = lfs_file_open((lfs_t*)&(pMe->fs), &(pMe->namedFileHandle), pName, (LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC));
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
+/**
+ * @brief Write to file opened by @ref FlashFs_API_OpenNamedFile
+ *
+ * @param pInWriteBuf data to be written is passed here
+ * @param bufSize size of buffer passed for writing
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashFs_API_WriteToNamedFile(const char* const pInWriteBuf, size_t bufSize)
+{
+	assert(NULL != pInWriteBuf);
+
+	sFlashFS_t* pMe = FlashFS_GetInstance();
+
+	lfs_ssize_t bytesWritten = lfs_file_write((lfs_t*)&(pMe->fs), &(pMe->namedFileHandle), pInWriteBuf, bufSize);
+
+	eStorageFSStatus_t status = (bytesWritten == (lfs_ssize_t)bufSize)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
+/**
+ * @brief Close file opened by @ref FlashFs_API_OpenNamedFile
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashFs_API_CloseNamedFile()
+{
+	sFlashFS_t* pMe = FlashFS_GetInstance();
+
+	int fRes = lfs_file_close((lfs_t*)&(pMe->fs), &(pMe->namedFileHandle));
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
+/**
+ * @brief Delete a file by name
+ *
+ * @param pName file name
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t FlashFs_API_DeleteNamedFile(const char* const pName)
+{
+	assert(NULL != pName);
+
+	sFlashFS_t* pMe = FlashFS_GetInstance();
+
+	int fRes = lfs_remove((lfs_t*)&(pMe->fs), pName);
+	eStorageFSStatus_t status = (0 == fRes)? eFS_SUCCESS: eFS_ERROR;
+
+	return status;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifdef ENABLE_TESTS_DEFINITIONS
@@ -17,16 +17,11 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <stdbool.h>
-#include "crc.h"
 #include "lfs.h"
 #include "AppStorageDataStructures.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#define FLASHFS_CRC_INSTANCE	(&hcrc)		/**< CRC instance used by flash module for file integrity check*/
-
-///////////////////////////////////////////////////////////////////////////////
-
 /**
  * @brief wrapper around littleFS file structure
  * 
@@ -36,15 +31,22 @@ typedef struct
 	bool IsMounted;
 	lfs_t fs;
 	lfs_file_t fileHandles[eFS_MAX];
+	lfs_file_t namedFileHandle;		/**< File opened by name, next to the golden image in a batch transfer */
 }sFlashFS_t;
 
 ///////////////////////////////////////////////////////////////////////////////
 eStorageFSStatus_t FlashFs_API_Init();
+eStorageFSStatus_t FlashFs_API_PrepareGoldenImageFile(uint32_t ImageSize);
 eStorageFSStatus_t FlashFs_API_OpenGoldenImageFile();
 eStorageFSStatus_t FlashFs_API_WriteToGoldenImageFile(const char* const pInWriteBuf, size_t bufSize);
 eStorageFSStatus_t FlashFs_API_CloseGoldenImageFile();
 eStorageFSStatus_t FlashFs_API_DeleteGoldenImageFile();
 eStorageFSStatus_t FlashFs_API_ComputeGoldenImageFileCRC(uint8_t* const pInOutRamBuf, uint32_t RamBufSize, uint32_t* const pOutCRC);
+eStorageFSStatus_t FlashFs_API_PrepareNamedFile(uint32_t Size);
+eStorageFSStatus_t FlashFs_API_OpenNamedFile(const char* const pName);
+eStorageFSStatus_t FlashFs_API_WriteToNamedFile(const char* const pInWriteBuf, size_t bufSize);
+eStorageFSStatus_t FlashFs_API_CloseNamedFile();
+eStorageFSStatus_t FlashFs_API_DeleteNamedFile(const char* const pName);
 
 ///////////////////////////////////////////////////////////////////////////////
 
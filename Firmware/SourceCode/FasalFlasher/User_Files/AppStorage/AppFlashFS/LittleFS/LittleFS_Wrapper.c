@@ -11,29 +11,46 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <string.h>
+
 #include "LittleFS_Wrapper.h"
 #include "W25Qxx.h"
 #include "Console.h"
 #include "AppConfiguration.h"
+#include "AppProfiler.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#define LFS_READ_SIZE 			(128)
-#define LFS_PROG_SIZE 			(LFS_READ_SIZE)
-#define LFS_LOOKAHEAD_SIZE      (LFS_READ_SIZE / 8)
-#define LFS_BLOCK_SIZE          (65536)
-#define LFS_BLOCK_COUNT 		(128)
+/* Block size and count come from the detected part, see @ref lfsWrapper_BuildConfig */
+#define LFS_PROG_SIZE 			(DF_PAGE_SIZE)		/**< A whole page per program, half pages doubled the program operations */
+#define LFS_READ_SIZE 			(LFS_PROG_SIZE)
+#define LFS_CACHE_SIZE          (2 * LFS_PROG_SIZE)	/**< Two pages per cache flush, also the size of each file cache on the heap */
+#define LFS_LOOKAHEAD_SIZE_MIN  (8)
+#define LFS_LOOKAHEAD_SIZE_MAX  (128)				/**< One bit per block, covers 1024 blocks (W25Q512) in one scan */
 #define LFS_BLOCK_CYCLES 		(-1)
-#define LFS_CACHE_SIZE          (64 % LFS_PROG_SIZE == 0 ? 64 : LFS_PROG_SIZE)
 #define LFS_ERASE_VALUE 		(0xff)
 #define LFS_ERASE_CYCLES 		(-1)
 #define LFS_BADBLOCK_BEHAVIOR 	(LFS_TESTBD_BADBLOCK_PROGERROR)
+#define LFS_BLOCK_MAP_WORDS		((LFS_LOOKAHEAD_SIZE_MAX * 8) / 32)	/**< One bit per block, blocks past the map are never pre-erased */
+#define LFS_PRE_ERASE_SPARE_BLOCKS	(4u)		/**< Covers metadata and CTZ skip-list blocks allocated along the file data */
+
+#ifdef ENABLE_TESTS_DEFINITIONS
+#define LFS_CACHE_SIZE_MAX		(4 * LFS_PROG_SIZE)	/**< Largest cache the benchmark tries */
+#else
+#define LFS_CACHE_SIZE_MAX		(LFS_CACHE_SIZE)
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static uint8_t lfs_read_buf[LFS_READ_SIZE];
-static uint8_t lfs_prog_buf[LFS_PROG_SIZE];
-static __attribute__ ((aligned (32))) uint8_t lfs_lookahead_buf[LFS_LOOKAHEAD_SIZE];	// 128/8=16
+static __attribute__ ((aligned (4))) uint8_t lfs_read_buf[LFS_CACHE_SIZE_MAX];
+static __attribute__ ((aligned (4))) uint8_t lfs_prog_buf[LFS_CACHE_SIZE_MAX];
+static __attribute__ ((aligned (32))) uint8_t lfs_lookahead_buf[LFS_LOOKAHEAD_SIZE_MAX];
+
+/**
+ * @brief Free blocks erased by @ref lfsWrapper_PreErase and not programmed since,
+ * the erase callback finds them blank without touching the flash
+ */
+static uint32_t lfs_erased_map[LFS_BLOCK_MAP_WORDS];
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -71,6 +88,8 @@ static int lfs_device_prog(const struct lfs_config *c, lfs_block_t block,
 
 /**
  * @brief Erase function provided to LitleFS
+ * @note Goes through the erase planner, sectors that are already blank are
+ * skipped and a partly used block is erased with the cheapest command mix
  * 
  * @param c 
  * @param block 
@@ -78,7 +97,16 @@ static int lfs_device_prog(const struct lfs_config *c, lfs_block_t block,
  */
 static int lfs_device_erase(const struct lfs_config *c, lfs_block_t block)
 {    
-    return W25qxx_EraseBlock(block);
+    sW25qxxErasePlan_t erasePlan;
+
+    if((block < (LFS_BLOCK_MAP_WORDS * 32)) && (0 != (lfs_erased_map[block / 32] & (1u << (block % 32)))))
+    {
+        /* Blank since the pre-erase, littleFS programs it right after this call */
+        lfs_erased_map[block / 32] &= ~(1u << (block % 32));
+        return 0;
+    }
+
+    return W25qxx_EraseRange(block * c->block_size, c->block_size, &erasePlan);
 }
 
 /**
@@ -96,41 +124,93 @@ static int lfs_device_sync(const struct lfs_config *c)
 
 
 /**
- * @brief configuration of the filesystem is provided by this struct
+ * @brief configuration of the filesystem, built at init from the detected part
  * 
  */
-static const struct lfs_config cfg = {
+static struct lfs_config cfg;
+
+/**
+ * @brief Build filesystem configuration for the detected part
+ *
+ * @note A filesystem formatted for a different block count does not mount and is reformatted
+ *
+ * @param pCfg configuration is saved here
+ * @param ProgSize program and read size, a multiple of the page size
+ * @param CacheSize read and program cache size, a multiple of ProgSize
+ */
+static void lfsWrapper_BuildConfig(struct lfs_config* const pCfg, lfs_size_t ProgSize, lfs_size_t CacheSize)
+{
+    const w25qxx_t* pDevice = W25qxx_GetDevice();
+
+    memset(pCfg, 0, sizeof(struct lfs_config));
+
     // block device operations
-    .read  = lfs_device_read,
-    .prog  = lfs_device_prog,
-    .erase = lfs_device_erase,
-    .sync  = lfs_device_sync,
+    pCfg->read  = lfs_device_read;
+    pCfg->prog  = lfs_device_prog;
+    pCfg->erase = lfs_device_erase;
+    pCfg->sync  = lfs_device_sync;
 
     // block device configuration
-    .read_size = LFS_READ_SIZE,
-    .prog_size = LFS_PROG_SIZE,
-    .block_size = LFS_BLOCK_SIZE,
-    .block_count = LFS_BLOCK_COUNT,
-    .cache_size = LFS_CACHE_SIZE,
-    .lookahead_size = LFS_LOOKAHEAD_SIZE,
-    .block_cycles = LFS_BLOCK_CYCLES,
-    
-    .read_buffer = lfs_read_buf,
-	.prog_buffer = lfs_prog_buf,
-	.lookahead_buffer = lfs_lookahead_buf,
-};
+    pCfg->read_size = ProgSize;
+    pCfg->prog_size = ProgSize;
+    pCfg->block_size = pDevice->BlockSize;
+    pCfg->block_count = pDevice->BlockCount;
+    pCfg->cache_size = CacheSize;
+    pCfg->block_cycles = LFS_BLOCK_CYCLES;
+
+    // one lookahead bit per block, rounded up to the 8 byte multiple littleFS asks for
+    lfs_size_t LookaheadSize = (((pDevice->BlockCount + 7) / 8) + 7) & ~7u;
+    if(LookaheadSize < LFS_LOOKAHEAD_SIZE_MIN)
+    {
+        LookaheadSize = LFS_LOOKAHEAD_SIZE_MIN;
+    }
+    if(LookaheadSize > LFS_LOOKAHEAD_SIZE_MAX)
+    {
+        LookaheadSize = LFS_LOOKAHEAD_SIZE_MAX;
+    }
+    pCfg->lookahead_size = LookaheadSize;
+
+    pCfg->read_buffer = lfs_read_buf;
+    pCfg->prog_buffer = lfs_prog_buf;
+    pCfg->lookahead_buffer = lfs_lookahead_buf;
+
+    /* A new configuration comes with a format or a mount, blocks may have been written outside littleFS */
+    memset(lfs_erased_map, 0, sizeof(lfs_erased_map));
+}
+
+/**
+ * @brief littleFS traverse callback, marks a block in use
+ *
+ * @param p in use bitmap
+ * @param block block in use
+ * @return int always 0, traversal continues
+ */
+static int lfsWrapper_MarkInUse(void *p, lfs_block_t block)
+{
+    uint32_t* pInUseMap = (uint32_t*)p;
+
+    if(block < (LFS_BLOCK_MAP_WORDS * 32))
+    {
+        pInUseMap[block / 32] |= (1u << (block % 32));
+    }
+
+    return 0;
+}
 
-    
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
  * @brief Wrapper around littleFS initialization
  * 
+ * @note @ref W25qxx_Init must have succeeded, filesystem spans the whole detected part
+ *
  * @param plfs pointer to lfs structure 
  * @return int non zero if error 
  */
 int lfsWrapper_Init(lfs_t* const plfs)
 {
+    lfsWrapper_BuildConfig(&cfg, LFS_PROG_SIZE, LFS_CACHE_SIZE);
+
     int err = lfs_mount(plfs, &cfg);
     /**< reformat if we can't mount the filesystem */ 
     /**< this should only happen on the first boot */ 
@@ -141,6 +221,57 @@ int lfsWrapper_Init(lfs_t* const plfs)
     return err;
 }
 
+/**
+ * @brief Erase the free blocks littleFS hands out next, enough for a file of the given size
+ *
+ * @note The allocator walks free blocks in order from its lookahead position, so the blocks
+ * erased here are the ones the next file gets. Blocks still marked used in the current
+ * lookahead window are skipped the same way the allocator skips them. The erase callback
+ * then finds these blocks blank and returns at once, a stream being written into the file
+ * does not wait for a block erase. Blocks littleFS takes in another order are erased
+ * when allocated, as without this call.
+ *
+ * @param plfs pointer to a mounted lfs structure, no file may be open for writing
+ * @param Size file size in bytes
+ * @return int non zero if error
+ */
+int lfsWrapper_PreErase(lfs_t* const plfs, lfs_size_t Size)
+{
+    uint32_t InUseMap[LFS_BLOCK_MAP_WORDS] = {0};
+    sW25qxxErasePlan_t erasePlan;
+
+    int err = lfs_fs_traverse(plfs, lfsWrapper_MarkInUse, InUseMap);
+
+    lfs_block_t BlocksLeft = ((Size + cfg.block_size - 1) / cfg.block_size) + LFS_PRE_ERASE_SPARE_BLOCKS;
+
+    for(lfs_block_t i = plfs->free.i; (0 == err) && (0 != BlocksLeft) && (i < (plfs->free.i + cfg.block_count)); i++)
+    {
+        lfs_block_t block = (plfs->free.off + i) % cfg.block_count;
+        bool IsUsed = (block >= (LFS_BLOCK_MAP_WORDS * 32)) || (0 != (InUseMap[block / 32] & (1u << (block % 32))));
+
+        if((i < plfs->free.size) && (0 != (plfs->free.buffer[i / 32] & (1u << (i % 32)))))
+        {
+            IsUsed = true;
+        }
+
+        if(false == IsUsed)
+        {
+            if(0 == (lfs_erased_map[block / 32] & (1u << (block % 32))))
+            {
+                err = W25qxx_EraseRange(block * cfg.block_size, cfg.block_size, &erasePlan);
+            }
+
+            if(0 == err)
+            {
+                lfs_erased_map[block / 32] |= (1u << (block % 32));
+            }
+            BlocksLeft--;
+        }
+    }
+
+    return err;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifdef ENABLE_TESTS_DEFINITIONS
@@ -157,6 +288,8 @@ bool lfs_Test(void)
     lfs_file_t file;
 
     W25qxx_Init();
+    lfsWrapper_BuildConfig(&cfg, LFS_PROG_SIZE, LFS_CACHE_SIZE);
+
     // mount the filesystem
     int err = lfs_mount(&lfs, &cfg);
 
@@ -195,6 +328,83 @@ bool lfs_Test(void)
     return (0 == err);
 }
 
+#define LFS_BENCHMARK_FILE_SIZE		(64u * 1024u)	/**< Bytes written per configuration */
+#define LFS_BENCHMARK_CHUNK_SIZE	(100u)			/**< Write size, deliberately not page aligned */
+
+/**
+ * @brief Configurations compared by @ref lfs_Benchmark, program size and cache size
+ */
+static const lfs_size_t gcBenchmarkConfigTable[][2] =
+{
+    {128,               128},                   /**< Half page programs of the fixed configuration this replaced */
+    {LFS_PROG_SIZE,     LFS_PROG_SIZE},
+    {LFS_PROG_SIZE,     LFS_CACHE_SIZE},
+    {LFS_PROG_SIZE,     LFS_CACHE_SIZE_MAX},
+};
+
+/**
+ * @brief Format the flash with each configuration and report file write throughput
+ *
+ * @warning Destroys the filesystem, it is left formatted with the runtime configuration
+ *
+ * @return true if every run wrote the whole file
+ */
+bool lfs_Benchmark(void)
+{
+    static uint8_t ChunkBuf[LFS_BENCHMARK_CHUNK_SIZE];
+    lfs_t lfs;
+    lfs_file_t file;
+    bool IsPass = (0 == W25qxx_Init());
+
+    AppProfiler_EnableCycleCounter();
+
+    for(uint32_t i = 0; i < sizeof(ChunkBuf); i++)
+    {
+        ChunkBuf[i] = (uint8_t)(i * 7u);
+    }
+
+    for(uint32_t Config = 0; (Config < (sizeof(gcBenchmarkConfigTable) / sizeof(gcBenchmarkConfigTable[0]))) && (true == IsPass); Config++)
+    {
+        lfsWrapper_BuildConfig(&cfg, gcBenchmarkConfigTable[Config][0], gcBenchmarkConfigTable[Config][1]);
+
+        int err = lfs_format(&lfs, &cfg);
+        err |= lfs_mount(&lfs, &cfg);
+        err |= lfs_file_open(&lfs, &file, "bench", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+
+        uint32_t BytesWritten = 0;
+        uint32_t StartTick = HAL_GetTick();
+
+        while((0 == err) && (BytesWritten < LFS_BENCHMARK_FILE_SIZE))
+        {
+            lfs_ssize_t Written = lfs_file_write(&lfs, &file, ChunkBuf, sizeof(ChunkBuf));
+            err = (Written == (lfs_ssize_t)sizeof(ChunkBuf))? 0: -1;
+
+            /* A short write or an error must not count towards the rate of a failing configuration */
+            if(Written > 0)
+            {
+                BytesWritten += (uint32_t)Written;
+            }
+        }
+
+        err |= lfs_file_close(&lfs, &file);
+
+        uint32_t ElapsedMs = HAL_GetTick() - StartTick;
+        uint32_t KiloBytesPerSecond = (0 == ElapsedMs)? 0: (BytesWritten / ElapsedMs);
+
+        Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> LFS prog %lu cache %lu: %lu bytes in %lu ms, %lu.%03lu MB/s",
+                (unsigned long)cfg.prog_size, (unsigned long)cfg.cache_size, (unsigned long)BytesWritten, (unsigned long)ElapsedMs,
+                (unsigned long)(KiloBytesPerSecond / 1000u), (unsigned long)(KiloBytesPerSecond % 1000u));
+
+        lfs_unmount(&lfs);
+        IsPass &= (0 == err);
+    }
+
+    lfsWrapper_BuildConfig(&cfg, LFS_PROG_SIZE, LFS_CACHE_SIZE);
+    IsPass &= (0 == lfs_format(&lfs, &cfg));
+
+    return IsPass;
+}
+
 #endif
 
 
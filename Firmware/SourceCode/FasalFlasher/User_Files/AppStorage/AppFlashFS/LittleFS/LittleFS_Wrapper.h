@@ -23,7 +23,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 int lfsWrapper_Init(lfs_t* const plfs);
+int lfsWrapper_PreErase(lfs_t* const plfs, lfs_size_t Size);
 bool lfs_Test(void);
+bool lfs_Benchmark(void);
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -11,14 +11,18 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <assert.h>
 #include <stddef.h>                     
 #include <stdbool.h>                    
 #include <stdlib.h>                     
 #include <stdio.h>
 #include <string.h>
 
-#include "W25qxx.h"
+#include "W25Qxx.h"
 #include "DebugPrint.h"
+#include "AppProfiler.h"
+#include "AppTrace.h"
+#include "SpiLL.h"
 
 #include "AppConfiguration.h"
 
@@ -30,25 +34,102 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 static w25qxx_t	gW25qxxDev; /**< Global Device instance*/
+static pfW25qxxBusyHook_t gpfBusyHook = NULL; /**< Work to run while the chip is busy */
+static bool gIsBusyHookRunning = false; /**< Guards the busy hook against re-entry */
+static bool gIsDmaEnabled = true; /**< Page program data phase over DMA */
+static sW25qxxAsync_t gW25qxxAsync = {.State = eW25QXX_ASYNC_IDLE}; /**< Asynchronous operation in flight */
+
+/**
+ * @brief Datasheet typical and maximum latencies (W25Q64JV: tPP, tSE, tBE1, tBE2, tCE)
+ */
+static const sW25qxxLatencyModel_t gcLatencyModelTable[eW25QXX_OP_MAX] =
+{
+		[eW25QXX_OP_NONE]			= {.TypicalUs = 0,			.MaxUs = 0},
+		[eW25QXX_OP_PAGE_PROGRAM]	= {.TypicalUs = 400,		.MaxUs = 3000},
+		[eW25QXX_OP_SECTOR_ERASE]	= {.TypicalUs = 45000,		.MaxUs = 400000},
+		[eW25QXX_OP_BLOCK32_ERASE]	= {.TypicalUs = 120000,		.MaxUs = 1600000},
+		[eW25QXX_OP_BLOCK_ERASE]	= {.TypicalUs = 150000,		.MaxUs = 2000000},
+		[eW25QXX_OP_CHIP_ERASE]		= {.TypicalUs = 20000000,	.MaxUs = 400000000},
+};
+
+static sW25qxxLatencyModel_t gLatencyModel[eW25QXX_OP_MAX]; /**< Latency model of the fitted part, datasheet defaults unless SFDP reports otherwise */
+
+/**
+ * @brief Winbond program and erase commands, used as they are when the part has no SFDP
+ */
+static const sW25qxxCommand_t gcCommandTable[eW25QXX_OP_MAX] =
+{
+		[eW25QXX_OP_NONE]			= {.Opcode3Byte = 0x00,	.Opcode4Byte = 0x00,	.IsSupported = false},
+		[eW25QXX_OP_PAGE_PROGRAM]	= {.Opcode3Byte = 0x02,	.Opcode4Byte = 0x12,	.IsSupported = true},
+		[eW25QXX_OP_SECTOR_ERASE]	= {.Opcode3Byte = 0x20,	.Opcode4Byte = 0x21,	.IsSupported = true},
+		[eW25QXX_OP_BLOCK32_ERASE]	= {.Opcode3Byte = 0x52,	.Opcode4Byte = 0x5C,	.IsSupported = true},
+		[eW25QXX_OP_BLOCK_ERASE]	= {.Opcode3Byte = 0xD8,	.Opcode4Byte = 0xDC,	.IsSupported = true},
+		[eW25QXX_OP_CHIP_ERASE]		= {.Opcode3Byte = 0xC7,	.Opcode4Byte = 0xC7,	.IsSupported = true},
+};
+
+static sW25qxxCommand_t gCommand[eW25QXX_OP_MAX]; /**< Commands of the fitted part, picked at init */
+
+static sW25qxxLatencyStats_t gW25qxxLatencyStats[eW25QXX_OP_MAX]; /**< Measured latency per operation */
+
+static uint8_t gEraseDirtyMap[W25QXXH_ERASE_PLAN_MAX_SECTORS / 8u]; /**< Non-blank sectors of the last planned range, one bit per sector */
+
+static uint32_t gW25qxxBlankPagesSkipped;	/**< Page programs left out since init because the data was all 0xFF */
 
 ///////////////////////////////////////////////////////////////////////////////
 
 
-void FLASH_SS_Clear()
+/**
+ * @brief Select chip, short command traffic goes over @ref SpiLL.h
+ */
+static inline void FLASH_SS_Clear()
 {
-	HAL_GPIO_WritePin(W25QXXH_SPI_CS_PORT, W25XXH_SPI_CS_PIN, GPIO_PIN_RESET);
+	SpiLL_Begin(W25QXXH_SPI_HANDLE->Instance);
+	SpiLL_CsLow(W25QXXH_SPI_CS_PORT, W25XXH_SPI_CS_PIN);
+}
+
+static inline void FLASH_SS_Set()
+{
+	SpiLL_CsHigh(W25QXXH_SPI_CS_PORT, W25XXH_SPI_CS_PIN);
+}
+
+static inline uint8_t W25qxx_Spi(uint8_t Data)
+{
+	return SpiLL_Transfer(W25QXXH_SPI_HANDLE->Instance, Data);
+}
+
+/**
+ * @brief Runs the registered busy hook once, guarding against re-entry
+ *
+ * @return true if the hook was run and found work to do
+ */
+static bool W25qxx_RunBusyHook(void)
+{
+	if((NULL == gpfBusyHook) || (true == gIsBusyHookRunning))
+	{
+		return false;
+	}
+
+	gIsBusyHookRunning = true;
+	bool IsWorkDone = gpfBusyHook();
+	gIsBusyHookRunning = false;
+
+	return IsWorkDone;
 }
 
-void FLASH_SS_Set()
+void W25qxx_RegisterBusyHook(pfW25qxxBusyHook_t pfBusyHook)
 {
-	HAL_GPIO_WritePin(W25QXXH_SPI_CS_PORT, W25XXH_SPI_CS_PIN, GPIO_PIN_SET);
+	gpfBusyHook = pfBusyHook;
 }
 
-uint8_t	W25qxx_Spi(uint8_t	Data)
+void W25qxx_SetDmaEnable(bool IsDmaEnabled)
 {
-	uint8_t ret;
-	HAL_SPI_TransmitReceive(W25QXXH_SPI_HANDLE, &Data, &ret, 1, W25QXXH_SPI_TIMEOUT_MS);
-	return ret;
+	/* The channel may have been lent to another peripheral meanwhile, restore its setup */
+	if((true == IsDmaEnabled) && (false == gIsDmaEnabled) && (NULL != W25QXXH_SPI_HANDLE->hdmatx))
+	{
+		(void)HAL_DMA_Init(W25QXXH_SPI_HANDLE->hdmatx);
+	}
+
+	gIsDmaEnabled = IsDmaEnabled;
 }
 
 uint32_t W25qxx_ReadID(void)
@@ -85,7 +166,6 @@ void W25qxx_WriteEnable(void)
     FLASH_SS_Clear();
     W25qxx_Spi(0x06);
     FLASH_SS_Set();
-	W25qxx_Delay(1);
 }
 
 void W25qxx_WriteDisable(void)
@@ -93,7 +173,6 @@ void W25qxx_WriteDisable(void)
     FLASH_SS_Clear();
     W25qxx_Spi(0x04);
     FLASH_SS_Set();
-	W25qxx_Delay(1);
 }
 
 
@@ -161,43 +240,715 @@ void W25qxx_WriteStatusRegister(uint8_t	SelectStatusRegister_1_2_3, uint8_t Data
 }
 
 
-void W25qxx_WaitForWriteEnd(void)
+/**
+ * @brief Polls WIP until the chip finishes the operation it is busy with
+ *
+ * @note Bound by the longest operation of the fitted part, the chip erase maximum
+ *
+ * @return eW25qxxStatus -1 if the chip is still busy when the time-out expires
+ */
+eW25qxxStatus W25qxx_WaitForWriteEnd(void)
 {
-    W25qxx_Delay(1);
+	uint32_t StartTick = HAL_GetTick();
+	uint32_t TimeoutMs = gLatencyModel[eW25QXX_OP_CHIP_ERASE].MaxUs / 1000u;
+
     FLASH_SS_Clear();
     W25qxx_Spi(0x05);
     do
     {
         gW25qxxDev.StatusRegister1 = W25qxx_Spi(W25QXX_DUMMY_BYTE);
-		W25qxx_Delay(1);
+		if((gW25qxxDev.StatusRegister1 & 0x01) == 0x01)
+		{
+			W25qxx_RunBusyHook();
+		}
     }
-    while ((gW25qxxDev.StatusRegister1 & 0x01) == 0x01);
+    while (((gW25qxxDev.StatusRegister1 & 0x01) == 0x01) && ((HAL_GetTick() - StartTick) < TimeoutMs));
     FLASH_SS_Set();
+
+	return ((gW25qxxDev.StatusRegister1 & 0x01) == 0x01)? -1: 0;
 }
 
 
-eW25qxxStatus W25qxx_Init(void)
+/**
+ * @brief Sends an opcode followed by a 3 or 4 byte address depending on chip size
+ *
+ * @param Opcode3Byte opcode used for 3 byte addressing
+ * @param Opcode4Byte opcode used for 4 byte addressing
+ * @param Address byte address
+ */
+static void W25qxx_SendCommandWithAddress(uint8_t Opcode3Byte, uint8_t Opcode4Byte, uint32_t Address)
 {
-    gW25qxxDev.Lock=1;
+	uint8_t Command[5];
+	uint8_t Length = 0;
 
-	while (HAL_GetTick() < 100)
+	if (true == gW25qxxDev.Is4ByteAddress)
 	{
-		W25qxx_Delay(1);
+		Command[Length++] = Opcode4Byte;
+		Command[Length++] = (Address & 0xFF000000) >> 24;
+	}
+	else
+	{
+		Command[Length++] = Opcode3Byte;
 	}
 
-    FLASH_SS_Set();
-    W25qxx_Delay(100);
-    uint32_t	id;
-    #if (_W25QXX_DEBUG==1)
-    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Init Begin...\r\n");
-    #endif
+	Command[Length++] = (Address & 0xFF0000) >> 16;
+	Command[Length++] = (Address & 0xFF00) >> 8;
+	Command[Length++] = Address & 0xFF;
 
-    id=W25qxx_ReadID();
+	SpiLL_Write(W25QXXH_SPI_HANDLE->Instance, Command, Length);
+}
 
-    #if (_W25QXX_DEBUG==1)
-    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev ID:0x%X\r\n", id);
-    #endif
-    switch(id & 0x000000FF)
+/**
+ * @brief Claims the driver for an asynchronous operation and sets the write enable latch
+ *
+ * @param Operation operation about to be submitted
+ * @return eW25qxxStatus 0 on success, -1 if another operation is in flight
+ */
+static eW25qxxStatus W25qxx_AsyncBegin(eW25qxxOperation_t Operation)
+{
+	if((eW25QXX_ASYNC_IDLE != gW25qxxAsync.State) || (1 == gW25qxxDev.Lock))
+	{
+		return -1;
+	}
+
+	/* An operation that timed out may still be running, the command would be ignored */
+	if(0 != W25qxx_WaitForWriteEnd())
+	{
+		return -1;
+	}
+
+	gW25qxxDev.Lock = 1;
+	gW25qxxAsync.Operation = Operation;
+	gW25qxxAsync.Status = 0;
+	W25qxx_WriteEnable();
+
+	return 0;
+}
+
+/**
+ * @brief Restarts the poll timer to elapse after the given delay
+ *
+ * @param DelayUs delay in microseconds, clamped to what the timer can count
+ */
+static void W25qxx_ArmPollTimer(uint32_t DelayUs)
+{
+	if(DelayUs < W25QXXH_POLL_MIN_US)
+	{
+		DelayUs = W25QXXH_POLL_MIN_US;
+	}
+	else if(DelayUs > W25QXXH_POLL_MAX_US)
+	{
+		DelayUs = W25QXXH_POLL_MAX_US;
+	}
+
+	__HAL_TIM_SET_AUTORELOAD(W25QXXH_POLL_TIMER_HANDLE, DelayUs - 1u);
+	__HAL_TIM_SET_COUNTER(W25QXXH_POLL_TIMER_HANDLE, 0);
+}
+
+/**
+ * @brief Command is with the chip, poll WIP from the poll timer until it clears.
+ * The first poll is aimed just short of the expected latency so the common
+ * case completes with one or two status reads.
+ */
+static void W25qxx_AsyncStartBusyPolling(void)
+{
+	const sW25qxxLatencyStats_t* pStats = &gW25qxxLatencyStats[gW25qxxAsync.Operation];
+
+	gW25qxxAsync.StartTick = HAL_GetTick();
+	gW25qxxAsync.StartCycleCount = AppProfiler_GetCycleCount();
+	gW25qxxAsync.State = eW25QXX_ASYNC_BUSY;
+
+	W25qxx_ArmPollTimer(pStats->ExpectedUs - (pStats->ExpectedUs / W25QXXH_POLL_STEPS));
+	__HAL_TIM_CLEAR_FLAG(W25QXXH_POLL_TIMER_HANDLE, TIM_FLAG_UPDATE);
+	HAL_TIM_Base_Start_IT(W25QXXH_POLL_TIMER_HANDLE);
+}
+
+/**
+ * @brief Time elapsed since the chip started the operation in flight
+ *
+ * @return elapsed time in microseconds
+ */
+static uint32_t W25qxx_AsyncGetElapsedUs(void)
+{
+	uint32_t ElapsedMs = HAL_GetTick() - gW25qxxAsync.StartTick;
+
+	/* Cycle counter wraps after ~59 s, long chip erases fall back to the ms tick */
+	if(ElapsedMs > 50000u)
+	{
+		return ElapsedMs * 1000u;
+	}
+
+	return AppProfiler_GetElapsedMicroseconds(gW25qxxAsync.StartCycleCount);
+}
+
+/**
+ * @brief Records measured latency and adapts the expected latency of the operation
+ *
+ * @param Operation completed operation
+ * @param LatencyUs measured latency
+ */
+static void W25qxx_UpdateLatencyStats(eW25qxxOperation_t Operation, uint32_t LatencyUs)
+{
+	sW25qxxLatencyStats_t* pStats = &gW25qxxLatencyStats[Operation];
+
+	pStats->LastUs = LatencyUs;
+	pStats->TotalUs += LatencyUs;
+	pStats->Count++;
+
+	if((1u == pStats->Count) || (LatencyUs < pStats->MinUs))
+	{
+		pStats->MinUs = LatencyUs;
+	}
+
+	if(LatencyUs > pStats->MaxUs)
+	{
+		pStats->MaxUs = LatencyUs;
+	}
+
+	/* Track the part actually fitted, it is usually faster than the datasheet typical */
+	pStats->ExpectedUs = ((pStats->ExpectedUs * 7u) + LatencyUs) / 8u;
+}
+
+/**
+ * @brief Releases the driver and notifies the completion callback
+ *
+ * @param Status result of the operation
+ */
+static void W25qxx_AsyncComplete(eW25qxxStatus Status)
+{
+	HAL_TIM_Base_Stop_IT(W25QXXH_POLL_TIMER_HANDLE);
+
+	eW25qxxOperation_t Operation = gW25qxxAsync.Operation;
+
+	gW25qxxAsync.Status = Status;
+	gW25qxxAsync.Operation = eW25QXX_OP_NONE;
+	gW25qxxAsync.State = eW25QXX_ASYNC_IDLE;
+	gW25qxxDev.Lock = 0;
+
+	AppTrace_Record(eAPPTRACE_EVENT_FLASH_COMMAND, eAPPTRACE_PHASE_END, Operation, (uint32_t)Status);
+
+	if(NULL != gW25qxxAsync.pfCompleteCallback)
+	{
+		gW25qxxAsync.pfCompleteCallback(Operation, Status);
+	}
+}
+
+/**
+ * @brief Submits an erase command that only carries an address
+ *
+ * @param Operation erase operation, opcode is taken from the commands of the fitted part
+ * @param Address byte address of region to erase
+ * @return eW25qxxStatus -1 if the part has no such erase
+ */
+static eW25qxxStatus W25qxx_SubmitErase(eW25qxxOperation_t Operation, uint32_t Address)
+{
+	const sW25qxxCommand_t* pCommand = &gCommand[Operation];
+
+	if(false == pCommand->IsSupported)
+	{
+		return -1;
+	}
+
+	eW25qxxStatus status = W25qxx_AsyncBegin(Operation);
+
+	if(0 == status)
+	{
+		AppTrace_Record(eAPPTRACE_EVENT_FLASH_COMMAND, eAPPTRACE_PHASE_BEGIN, Operation, Address);
+		FLASH_SS_Clear();
+		W25qxx_SendCommandWithAddress(pCommand->Opcode3Byte, pCommand->Opcode4Byte, Address);
+		FLASH_SS_Set();
+		W25qxx_AsyncStartBusyPolling();
+	}
+
+	return status;
+}
+
+/**
+ * @brief Starts a page program and returns while the data phase and the
+ * programming run in the background.
+ * @note pBuffer must stay valid until the operation completes
+ *
+ * @return eW25qxxStatus 0 if the operation was submitted
+ */
+eW25qxxStatus W25qxx_SubmitPageProgram(uint8_t *pBuffer, uint32_t Page_Address, uint32_t OffsetInByte, uint32_t NumByteToWrite_up_to_PageSize)
+{
+	if(((NumByteToWrite_up_to_PageSize+OffsetInByte)>gW25qxxDev.PageSize)||(NumByteToWrite_up_to_PageSize==0))
+	{
+		NumByteToWrite_up_to_PageSize=gW25qxxDev.PageSize-OffsetInByte;
+	}
+
+	eW25qxxStatus status = W25qxx_AsyncBegin(eW25QXX_OP_PAGE_PROGRAM);
+
+	if(0 != status)
+	{
+		return status;
+	}
+
+	uint32_t Address = (Page_Address * gW25qxxDev.PageSize) + OffsetInByte;
+
+	AppTrace_Record(eAPPTRACE_EVENT_FLASH_COMMAND, eAPPTRACE_PHASE_BEGIN, eW25QXX_OP_PAGE_PROGRAM, Address);
+	FLASH_SS_Clear();
+	W25qxx_SendCommandWithAddress(gCommand[eW25QXX_OP_PAGE_PROGRAM].Opcode3Byte, gCommand[eW25QXX_OP_PAGE_PROGRAM].Opcode4Byte, Address);
+
+	if((gIsDmaEnabled) && (NumByteToWrite_up_to_PageSize >= W25QXXH_SPI_DMA_MIN_LEN) && (NULL != W25QXXH_SPI_HANDLE->hdmatx))
+	{
+		gW25qxxAsync.State = eW25QXX_ASYNC_DATA_PHASE;
+
+		if(HAL_OK == HAL_SPI_Transmit_DMA(W25QXXH_SPI_HANDLE, pBuffer, NumByteToWrite_up_to_PageSize))
+		{
+			return 0;
+		}
+	}
+
+	HAL_SPI_Transmit(W25QXXH_SPI_HANDLE, pBuffer, NumByteToWrite_up_to_PageSize, W25QXXH_SPI_TIMEOUT_MS);
+	FLASH_SS_Set();
+	W25qxx_AsyncStartBusyPolling();
+
+	return 0;
+}
+
+eW25qxxStatus W25qxx_SubmitEraseSector(uint32_t SectorAddr)
+{
+	return W25qxx_SubmitErase(eW25QXX_OP_SECTOR_ERASE, SectorAddr * gW25qxxDev.SectorSize);
+}
+
+eW25qxxStatus W25qxx_SubmitEraseBlock32K(uint32_t Block32Addr)
+{
+	return W25qxx_SubmitErase(eW25QXX_OP_BLOCK32_ERASE, Block32Addr * W25QXXH_BLOCK32_SIZE);
+}
+
+eW25qxxStatus W25qxx_SubmitEraseBlock(uint32_t BlockAddr)
+{
+	return W25qxx_SubmitErase(eW25QXX_OP_BLOCK_ERASE, BlockAddr * gW25qxxDev.BlockSize);
+}
+
+eW25qxxStatus W25qxx_SubmitEraseChip(void)
+{
+	eW25qxxStatus status = W25qxx_AsyncBegin(eW25QXX_OP_CHIP_ERASE);
+
+	if(0 == status)
+	{
+		AppTrace_Record(eAPPTRACE_EVENT_FLASH_COMMAND, eAPPTRACE_PHASE_BEGIN, eW25QXX_OP_CHIP_ERASE, 0);
+		FLASH_SS_Clear();
+		W25qxx_Spi(gCommand[eW25QXX_OP_CHIP_ERASE].Opcode3Byte);
+		FLASH_SS_Set();
+		W25qxx_AsyncStartBusyPolling();
+	}
+
+	return status;
+}
+
+/**
+ * @brief Check if an asynchronous operation is in flight
+ *
+ * @return true if busy
+ */
+bool W25qxx_IsBusy(void)
+{
+	return (eW25QXX_ASYNC_IDLE != gW25qxxAsync.State);
+}
+
+/**
+ * @brief Blocks until the asynchronous operation in flight completes. The busy
+ * hook keeps running meanwhile. Once it runs out of work the core sleeps until
+ * the next interrupt, as the busy poll timer or DMA completion moves the
+ * operation on.
+ *
+ * @return eW25qxxStatus result of the completed operation
+ */
+eW25qxxStatus W25qxx_WaitForAsyncComplete(void)
+{
+	while(eW25QXX_ASYNC_IDLE != gW25qxxAsync.State)
+	{
+		if(false == W25qxx_RunBusyHook())
+		{
+			/* Completion landing between the state check and WFI would leave the core
+			 * asleep, WFI still wakes on an interrupt held pending by PRIMASK */
+			uint32_t PriMask = __get_PRIMASK();
+			__disable_irq();
+			if(eW25QXX_ASYNC_IDLE != gW25qxxAsync.State)
+			{
+				__WFI();
+			}
+			if(0 == PriMask)
+			{
+				__enable_irq();
+			}
+		}
+	}
+
+	return gW25qxxAsync.Status;
+}
+
+void W25qxx_RegisterCompleteCallback(pfW25qxxCompleteCallback_t pfCompleteCallback)
+{
+	gW25qxxAsync.pfCompleteCallback = pfCompleteCallback;
+}
+
+/**
+ * @brief Page data DMA finished, called from HAL_SPI_TxCpltCallback
+ */
+void W25qxx_cbDataPhaseComplete(void)
+{
+	if(eW25QXX_ASYNC_DATA_PHASE == gW25qxxAsync.State)
+	{
+		FLASH_SS_Set();
+		AppTrace_Record(eAPPTRACE_EVENT_FLASH_DATA_DONE, eAPPTRACE_PHASE_INSTANT, gW25qxxAsync.Operation, 0);
+		W25qxx_AsyncStartBusyPolling();
+	}
+}
+
+/**
+ * @brief Page data DMA failed, called from HAL_SPI_ErrorCallback
+ */
+void W25qxx_cbDataPhaseError(void)
+{
+	if(eW25QXX_ASYNC_DATA_PHASE == gW25qxxAsync.State)
+	{
+		FLASH_SS_Set();
+		W25qxx_AsyncComplete(-1);
+	}
+}
+
+/**
+ * @brief Poll timer elapsed, checks WIP of the operation in flight
+ */
+void W25qxx_cbPollTimerElapsed(void)
+{
+	if(eW25QXX_ASYNC_BUSY != gW25qxxAsync.State)
+	{
+		return;
+	}
+
+	uint32_t ElapsedUs = W25qxx_AsyncGetElapsedUs();
+
+	if(0 == (W25qxx_ReadStatusRegister(1) & 0x01))
+	{
+		W25qxx_UpdateLatencyStats(gW25qxxAsync.Operation, ElapsedUs);
+		W25qxx_AsyncComplete(0);
+	}
+	else if(ElapsedUs > gLatencyModel[gW25qxxAsync.Operation].MaxUs)
+	{
+		W25qxx_AsyncComplete(-1);
+	}
+	else
+	{
+		W25qxx_ArmPollTimer(gW25qxxLatencyStats[gW25qxxAsync.Operation].ExpectedUs / W25QXXH_POLL_STEPS);
+	}
+}
+
+/**
+ * @brief Get measured latency of an operation
+ *
+ * @param Operation operation of interest
+ * @param pOutStats measured latency is copied here
+ * @return true if the operation was executed at least once
+ */
+bool W25qxx_GetLatencyStats(eW25qxxOperation_t Operation, sW25qxxLatencyStats_t* const pOutStats)
+{
+	assert(NULL != pOutStats);
+
+	if((eW25QXX_OP_NONE == Operation) || (Operation >= eW25QXX_OP_MAX))
+	{
+		return false;
+	}
+
+	*pOutStats = gW25qxxLatencyStats[Operation];
+
+	return (0 != pOutStats->Count);
+}
+
+/**
+ * @brief Print measured latency of every operation executed since init
+ */
+void W25qxx_PrintLatencyStats(void)
+{
+	static const char* const cOperationNames[eW25QXX_OP_MAX] =
+	{
+			[eW25QXX_OP_NONE]			= "-",
+			[eW25QXX_OP_PAGE_PROGRAM]	= "tPP",
+			[eW25QXX_OP_SECTOR_ERASE]	= "tSE",
+			[eW25QXX_OP_BLOCK32_ERASE]	= "tBE32",
+			[eW25QXX_OP_BLOCK_ERASE]	= "tBE64",
+			[eW25QXX_OP_CHIP_ERASE]		= "tCE",
+	};
+
+	for(eW25qxxOperation_t Operation = eW25QXX_OP_PAGE_PROGRAM; Operation < eW25QXX_OP_MAX; Operation++)
+	{
+		const sW25qxxLatencyStats_t* pStats = &gW25qxxLatencyStats[Operation];
+
+		if(0 != pStats->Count)
+		{
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Flash %s: count %lu, last %lu us, min %lu us, max %lu us, avg %lu us (%s typ %lu us)",
+					cOperationNames[Operation], pStats->Count, pStats->LastUs, pStats->MinUs, pStats->MaxUs,
+					(uint32_t)(pStats->TotalUs / pStats->Count), (true == gW25qxxDev.IsSfdpValid)? "SFDP": "datasheet",
+					gLatencyModel[Operation].TypicalUs);
+		}
+	}
+
+	if(0 != gW25qxxBlankPagesSkipped)
+	{
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Flash tPP skipped for %lu blank pages", gW25qxxBlankPagesSkipped);
+	}
+}
+
+/**
+ * @brief Get geometry of the fitted part, valid once @ref W25qxx_Init succeeded
+ *
+ * @return const w25qxx_t*
+ */
+const w25qxx_t* W25qxx_GetDevice(void)
+{
+	return &gW25qxxDev;
+}
+
+/**
+ * @brief Get number of page programs left out because their data was all 0xFF
+ *
+ * @return uint32_t pages skipped since init
+ */
+uint32_t W25qxx_GetBlankPagesSkipped(void)
+{
+	return gW25qxxBlankPagesSkipped;
+}
+
+/**
+ * @brief Read from the SFDP address space (0x5A, 3 byte address, 8 dummy clocks)
+ *
+ * @param Address byte address in SFDP space
+ * @param pBuffer data read is saved here
+ * @param Length number of bytes
+ */
+static void W25qxx_ReadSfdp(uint32_t Address, uint8_t* pBuffer, uint32_t Length)
+{
+	FLASH_SS_Clear();
+	W25qxx_Spi(0x5A);
+	W25qxx_Spi((Address & 0xFF0000) >> 16);
+	W25qxx_Spi((Address & 0xFF00) >> 8);
+	W25qxx_Spi(Address & 0xFF);
+	W25qxx_Spi(W25QXX_DUMMY_BYTE);
+
+	for(uint32_t i = 0; i < Length; i++)
+	{
+		pBuffer[i] = W25qxx_Spi(W25QXX_DUMMY_BYTE);
+	}
+
+	FLASH_SS_Set();
+}
+
+/**
+ * @brief Get a little endian DWORD of an SFDP table
+ *
+ * @param pTable table as read from SFDP space
+ * @param Dword DWORD number as numbered by JESD216, starting at 1
+ * @return uint32_t
+ */
+static uint32_t W25qxx_SfdpGetDword(const uint8_t* pTable, uint32_t Dword)
+{
+	const uint8_t* pData = &pTable[(Dword - 1u) * 4u];
+
+	return ((uint32_t)pData[0] | ((uint32_t)pData[1] << 8u) | ((uint32_t)pData[2] << 16u) | ((uint32_t)pData[3] << 24u));
+}
+
+/**
+ * @brief Get the opcode of a 4 byte address erase that matches a 3 byte address one
+ *
+ * @param Opcode3Byte erase opcode reported by SFDP
+ * @param pOutOpcode4Byte matching opcode is saved here
+ * @return true if there is a matching opcode
+ */
+static bool W25qxx_SfdpGetErase4ByteOpcode(uint8_t Opcode3Byte, uint8_t* const pOutOpcode4Byte)
+{
+	static const uint8_t cOpcodePairs[][2] =
+	{
+			{0x20, 0x21},
+			{0x52, 0x5C},
+			{0xD8, 0xDC},
+	};
+
+	for(uint32_t i = 0; i < (sizeof(cOpcodePairs) / sizeof(cOpcodePairs[0])); i++)
+	{
+		if(Opcode3Byte == cOpcodePairs[i][0])
+		{
+			*pOutOpcode4Byte = cOpcodePairs[i][1];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Discover the fitted part from its JEDEC basic flash parameter table (JESD216B).
+ * Density, address width, erase sizes with their opcodes and times, page size
+ * and program time replace the Winbond defaults.
+ *
+ * @note The bus is single lane, so reads stay on fast read 0x0B with 8 dummy
+ * clocks, which JESD216 fixes for every part. Page program stays in 256 byte
+ * pieces, which is legal on parts with larger pages.
+ *
+ * @return true if the part has a usable table, false to fall back to the ID table
+ */
+static bool W25qxx_DiscoverSfdp(void)
+{
+	static const uint32_t cEraseUnitUs[4] = {1000u, 16000u, 128000u, 1000000u};
+	static const uint32_t cChipEraseUnitUs[4] = {16000u, 256000u, 4000000u, 64000000u};
+
+	uint8_t Header[W25QXXH_SFDP_HEADER_SIZE];
+	uint8_t Table[W25QXXH_SFDP_BASIC_DWORDS_MAX * 4u] = {0};
+
+	W25qxx_ReadSfdp(0, Header, sizeof(Header));
+
+	/* First parameter header has to be the basic flash parameter table, ID 0xFF00 */
+	if((W25QXXH_SFDP_SIGNATURE != W25qxx_SfdpGetDword(Header, 1)) || (0x00 != Header[8]) || (0xFF != Header[15]) || (Header[11] < 9u))
+	{
+		return false;
+	}
+
+	uint32_t DwordCount = (Header[11] > W25QXXH_SFDP_BASIC_DWORDS_MAX)? W25QXXH_SFDP_BASIC_DWORDS_MAX: Header[11];
+	uint32_t TableAddress = (uint32_t)Header[12] | ((uint32_t)Header[13] << 8u) | ((uint32_t)Header[14] << 16u);
+
+	W25qxx_ReadSfdp(TableAddress, Table, DwordCount * 4u);
+
+	/* Density */
+	uint32_t Density = W25qxx_SfdpGetDword(Table, 2);
+	uint64_t CapacityInBytes = ((uint64_t)Density + 1u) / 8u;
+
+	if(0 != (Density & 0x80000000u))
+	{
+		uint32_t DensityExponent = Density & 0x7FFFFFFFu;
+
+		CapacityInBytes = ((DensityExponent >= 3u) && (DensityExponent < 40u))? ((uint64_t)1u << (DensityExponent - 3u)): 0u;
+	}
+
+	if((CapacityInBytes < (2u * W25QXXH_BLOCK_SIZE)) || (CapacityInBytes > W25QXXH_SFDP_CAPACITY_MAX))
+	{
+		return false;
+	}
+
+	/* Address width, 0: 3 byte only, 1: 3 or 4 byte, 2: 4 byte only */
+	uint32_t AddressMode = (W25qxx_SfdpGetDword(Table, 1) >> 17u) & 0x3u;
+	bool Is4ByteAddress = (CapacityInBytes > W25QXXH_3BYTE_ADDRESS_LIMIT) || (2u == AddressMode);
+
+	if((true == Is4ByteAddress) && (0u == AddressMode))
+	{
+		return false;
+	}
+
+	/* Erase types, DWORD 8 and 9 hold size (2^N) and opcode of up to 4, DWORD 10 their times */
+	uint32_t EraseTimes = (DwordCount >= 11u)? W25qxx_SfdpGetDword(Table, 10): 0u;
+	uint32_t EraseMaxMultiplier = 2u * ((EraseTimes & 0xFu) + 1u);
+	sW25qxxCommand_t Command[eW25QXX_OP_MAX];
+	sW25qxxLatencyModel_t Model[eW25QXX_OP_MAX];
+
+	memcpy(Command, gcCommandTable, sizeof(Command));
+	memcpy(Model, gcLatencyModelTable, sizeof(Model));
+	Command[eW25QXX_OP_SECTOR_ERASE].IsSupported = false;
+	Command[eW25QXX_OP_BLOCK32_ERASE].IsSupported = false;
+	Command[eW25QXX_OP_BLOCK_ERASE].IsSupported = false;
+
+	for(uint32_t Type = 0; Type < W25QXXH_SFDP_ERASE_TYPES; Type++)
+	{
+		uint32_t Field = W25qxx_SfdpGetDword(Table, 8u + (Type / 2u)) >> ((Type % 2u) * 16u);
+		uint8_t SizeExponent = (uint8_t)Field;
+		uint8_t Opcode = (uint8_t)(Field >> 8u);
+		eW25qxxOperation_t Operation = eW25QXX_OP_NONE;
+
+		switch(SizeExponent)
+		{
+			case 12:	Operation = eW25QXX_OP_SECTOR_ERASE;	break;
+			case 15:	Operation = eW25QXX_OP_BLOCK32_ERASE;	break;
+			case 16:	Operation = eW25QXX_OP_BLOCK_ERASE;		break;
+			default:	break;
+		}
+
+		if((eW25QXX_OP_NONE == Operation) || (true == Command[Operation].IsSupported))
+		{
+			continue;
+		}
+
+		Command[Operation].Opcode3Byte = Opcode;
+		Command[Operation].IsSupported = (false == Is4ByteAddress) || (true == W25qxx_SfdpGetErase4ByteOpcode(Opcode, &Command[Operation].Opcode4Byte));
+
+		if((true == Command[Operation].IsSupported) && (0 != EraseTimes))
+		{
+			uint32_t Time = (EraseTimes >> (4u + (Type * 7u))) & 0x7Fu;
+
+			Model[Operation].TypicalUs = ((Time & 0x1Fu) + 1u) * cEraseUnitUs[Time >> 5u];
+			Model[Operation].MaxUs = Model[Operation].TypicalUs * EraseMaxMultiplier;
+		}
+	}
+
+	/* Driver geometry is built on 4K sectors */
+	if(false == Command[eW25QXX_OP_SECTOR_ERASE].IsSupported)
+	{
+		return false;
+	}
+
+	uint16_t PageSize = DF_PAGE_SIZE;
+
+	if(DwordCount >= 11u)
+	{
+		uint32_t ProgramTimes = W25qxx_SfdpGetDword(Table, 11);
+		/* DWORD 11 carries its own multiplier, shared by page program and chip erase */
+		uint32_t ProgramMaxMultiplier = 2u * ((ProgramTimes & 0xFu) + 1u);
+
+		PageSize = (uint16_t)(1u << ((ProgramTimes >> 4u) & 0xFu));
+
+		Model[eW25QXX_OP_PAGE_PROGRAM].TypicalUs = (((ProgramTimes >> 8u) & 0x1Fu) + 1u) * ((0 != (ProgramTimes & (1u << 13u)))? 64u: 8u);
+		Model[eW25QXX_OP_PAGE_PROGRAM].MaxUs = Model[eW25QXX_OP_PAGE_PROGRAM].TypicalUs * ProgramMaxMultiplier;
+
+		Model[eW25QXX_OP_CHIP_ERASE].TypicalUs = (((ProgramTimes >> 24u) & 0x1Fu) + 1u) * cChipEraseUnitUs[(ProgramTimes >> 29u) & 0x3u];
+		Model[eW25QXX_OP_CHIP_ERASE].MaxUs = Model[eW25QXX_OP_CHIP_ERASE].TypicalUs * ProgramMaxMultiplier;
+	}
+
+	if(PageSize < DF_PAGE_SIZE)
+	{
+		return false;
+	}
+
+	/* SFDP has one maximum multiplier for every erase size, which understates the
+	 * larger erases of a W25Q (64K block: 13x typical, sector: 9x). Datasheet
+	 * maximums stay the floor of the time-outs. */
+	for(eW25qxxOperation_t Operation = eW25QXX_OP_NONE; Operation < eW25QXX_OP_MAX; Operation++)
+	{
+		if(Model[Operation].MaxUs < gcLatencyModelTable[Operation].MaxUs)
+		{
+			Model[Operation].MaxUs = gcLatencyModelTable[Operation].MaxUs;
+		}
+	}
+
+	memcpy(gCommand, Command, sizeof(gCommand));
+	memcpy(gLatencyModel, Model, sizeof(gLatencyModel));
+
+	gW25qxxDev.BlockCount = (uint32_t)(CapacityInBytes / W25QXXH_BLOCK_SIZE);
+	gW25qxxDev.ProgramPageSize = PageSize;
+	gW25qxxDev.Is4ByteAddress = Is4ByteAddress;
+
+	/* Nearest Winbond density, kept for code that still reads the ID */
+	uint32_t ID = W25Q10;
+	while(((1u << (ID + 1u)) <= gW25qxxDev.BlockCount) && (ID < W25Q512))
+	{
+		ID++;
+	}
+	gW25qxxDev.ID = (W25QXX_ID_t)ID;
+
+	#if (_W25QXX_DEBUG==1)
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev SFDP: %lu KB, %u byte page, %s address\r\n", (uint32_t)(CapacityInBytes / 1024u), PageSize, (true == Is4ByteAddress)? "4 byte": "3 byte");
+	#endif
+
+	return true;
+}
+
+/**
+ * @brief Identify a Winbond part from the capacity byte of its JEDEC ID, used when the part has no SFDP
+ *
+ * @param id JEDEC ID as read by @ref W25qxx_ReadID
+ * @return true if the part is known
+ */
+static bool W25qxx_IdentifyFromId(uint32_t id)
+{
+	switch(id & 0x000000FF)
     {
 		case 0x20:	// 	w25q512
 			gW25qxxDev.ID=W25Q512;
@@ -273,157 +1024,488 @@ eW25qxxStatus W25qxx_Init(void)
 				#if (_W25QXX_DEBUG==1)
 				DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Unknown ID\r\n");
 				#endif
-			gW25qxxDev.Lock=0;	
 			return false;
-				
-	}		
+	}
+
+	gW25qxxDev.ProgramPageSize = DF_PAGE_SIZE;
+	gW25qxxDev.Is4ByteAddress = (gW25qxxDev.ID >= W25Q256);
+
+	return true;
+}
+
+eW25qxxStatus W25qxx_Init(void)
+{
+    gW25qxxDev.Lock=1;
+
+	AppProfiler_EnableCycleCounter();
+
+	gW25qxxBlankPagesSkipped = 0;
+
+	while (HAL_GetTick() < 100)
+	{
+		W25qxx_Delay(1);
+	}
+
+    FLASH_SS_Set();
+    W25qxx_Delay(100);
+    uint32_t	id;
+    #if (_W25QXX_DEBUG==1)
+    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Init Begin...\r\n");
+    #endif
+
+    id=W25qxx_ReadID();
+
+    #if (_W25QXX_DEBUG==1)
+    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev ID:0x%X\r\n", id);
+    #endif
+	memcpy(gLatencyModel, gcLatencyModelTable, sizeof(gLatencyModel));
+	memcpy(gCommand, gcCommandTable, sizeof(gCommand));
+
+	gW25qxxDev.ManufacturerID = (uint8_t)(id >> 16);
+	gW25qxxDev.IsSfdpValid = W25qxx_DiscoverSfdp();
+
+	if((false == gW25qxxDev.IsSfdpValid) && (false == W25qxx_IdentifyFromId(id)))
+	{
+		gW25qxxDev.Lock=0;
+		return -1;
+	}
+
 	gW25qxxDev.PageSize=256;
 	gW25qxxDev.SectorSize=0x1000;
 	gW25qxxDev.SectorCount=gW25qxxDev.BlockCount*16;
 	gW25qxxDev.PageCount=(gW25qxxDev.SectorCount*gW25qxxDev.SectorSize)/gW25qxxDev.PageSize;
 	gW25qxxDev.BlockSize=gW25qxxDev.SectorSize*16;
 	gW25qxxDev.CapacityInKiloByte=(gW25qxxDev.SectorCount*gW25qxxDev.SectorSize)/1024;
+
+	/* Latency estimates start from the model of the fitted part */
+	for(eW25qxxOperation_t Operation = eW25QXX_OP_NONE; Operation < eW25QXX_OP_MAX; Operation++)
+	{
+		memset(&gW25qxxLatencyStats[Operation], 0, sizeof(sW25qxxLatencyStats_t));
+		gW25qxxLatencyStats[Operation].ExpectedUs = gLatencyModel[Operation].TypicalUs;
+	}
+
 	W25qxx_ReadUniqID();
 	W25qxx_ReadStatusRegister(1);
 	W25qxx_ReadStatusRegister(2);
 	W25qxx_ReadStatusRegister(3);
 
 	#if (_W25QXX_DEBUG==1)
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Page Size: %d Bytes\r\n",gW25qxxDev.PageSize);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Page Count: %d\r\n",gW25qxxDev.PageCount);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Sector Size: %d Bytes\r\n",gW25qxxDev.SectorSize);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Sector Count: %d\r\n",gW25qxxDev.SectorCount);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Block Size: %d Bytes\r\n",gW25qxxDev.BlockSize);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Block Count: %d\r\n",gW25qxxDev.BlockCount);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Capacity: %d KiloBytes\r\n",gW25qxxDev.CapacityInKiloByte);
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Init Done\r\n");
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Page Size: %d Bytes\r\n",gW25qxxDev.PageSize);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Page Count: %d\r\n",gW25qxxDev.PageCount);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Sector Size: %d Bytes\r\n",gW25qxxDev.SectorSize);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Sector Count: %d\r\n",gW25qxxDev.SectorCount);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Block Size: %d Bytes\r\n",gW25qxxDev.BlockSize);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Block Count: %d\r\n",gW25qxxDev.BlockCount);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Capacity: %d KiloBytes\r\n",gW25qxxDev.CapacityInKiloByte);
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev Init Done\r\n");
+	#endif
+
+	gW25qxxDev.Lock=0;	
+	return 0;
+}	
+
+
+eW25qxxStatus W25qxx_EraseChip(void)
+{
+    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "W25qxx_EraseChip initiated please wait\n\r");
+
+	W25qxx_WaitForAsyncComplete();
+
+	eW25qxxStatus status = W25qxx_SubmitEraseChip();
+
+	if(0 == status)
+	{
+		status = W25qxx_WaitForAsyncComplete();
+	}
+
+	return status;
+}
+
+
+eW25qxxStatus W25qxx_EraseSector(uint32_t SectorAddr)
+{
+	#if (_W25QXX_DEBUG==1)
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseSector %d Begin...\r\n",SectorAddr);
+	#endif
+
+	W25qxx_WaitForAsyncComplete();
+
+	eW25qxxStatus status = W25qxx_SubmitEraseSector(SectorAddr);
+
+	if(0 == status)
+	{
+		status = W25qxx_WaitForAsyncComplete();
+	}
+
+	#if (_W25QXX_DEBUG==1)
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseSector done\n\r");
+	#endif
+
+	return status;
+}
+ 
+eW25qxxStatus W25qxx_EraseBlock32K(uint32_t Block32Addr)
+{
+	W25qxx_WaitForAsyncComplete();
+
+	eW25qxxStatus status = W25qxx_SubmitEraseBlock32K(Block32Addr);
+
+	if(0 == status)
+	{
+		status = W25qxx_WaitForAsyncComplete();
+	}
+
+	return status;
+}
+
+eW25qxxStatus W25qxx_EraseBlock(uint32_t BlockAddr)
+{
+	#if (_W25QXX_DEBUG==1)
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseBlock %d Begin...\r\n",BlockAddr);
 	#endif
 
-	gW25qxxDev.Lock=0;	
-	return 0;
-}	
+	W25qxx_WaitForAsyncComplete();
 
+	eW25qxxStatus status = W25qxx_SubmitEraseBlock(BlockAddr);
 
-eW25qxxStatus W25qxx_EraseChip(void)
+	if(0 == status)
+	{
+		status = W25qxx_WaitForAsyncComplete();
+	}
+
+    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseBlock done\n\r");
+
+	return status;
+}
+ 
+/**
+ * @brief Checks that a range reads back as erased using a single fast read
+ *
+ * @param Address byte address of range
+ * @param Length length of range in bytes
+ * @return true if every byte in range is 0xFF
+ */
+bool W25qxx_IsBlank(uint32_t Address, uint32_t Length)
 {
-    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "W25qxx_EraseChip initiated please wait\n\r");
+	uint32_t ChunkBuf[16];
+	bool IsBlank = true;
+
+	W25qxx_WaitForAsyncComplete();
+
 	while(gW25qxxDev.Lock==1)
 	{
 		W25qxx_Delay(1);
 	}
 	gW25qxxDev.Lock=1;
 
-	#if (_W25QXX_DEBUG==1)
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseChip Begin...\r\n");
-	#endif
+	FLASH_SS_Clear();
+	W25qxx_SendCommandWithAddress(0x0B, 0x0C, Address);
+	W25qxx_Spi(0);
 
-	W25qxx_WriteEnable();
-    FLASH_SS_Clear();
-	
-    W25qxx_Spi(0xC7);
-    FLASH_SS_Set();
- 
-	W25qxx_WaitForWriteEnd();
+	while((Length > 0) && (true == IsBlank))
+	{
+		uint32_t ChunkLength = (Length > sizeof(ChunkBuf))? sizeof(ChunkBuf): Length;
 
-	#if (_W25QXX_DEBUG==1)
-    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseBlock done\n\r");
-	#endif
+		HAL_SPI_Receive(W25QXXH_SPI_HANDLE, (uint8_t*)ChunkBuf, ChunkLength, W25QXXH_SPI_TIMEOUT_MS);
 
-	W25qxx_Delay(10);
-	gW25qxxDev.Lock=0;	
-    
-    return 0;
-}
+		uint32_t Word = 0;
+		for( ; Word < (ChunkLength / sizeof(uint32_t)); Word++)
+		{
+			if(0xFFFFFFFF != ChunkBuf[Word])
+			{
+				IsBlank = false;
+				break;
+			}
+		}
+
+		for(uint32_t Byte = Word * sizeof(uint32_t); (true == IsBlank) && (Byte < ChunkLength); Byte++)
+		{
+			if(0xFF != ((uint8_t*)ChunkBuf)[Byte])
+			{
+				IsBlank = false;
+			}
+		}
 
+		Length -= ChunkLength;
+	}
 
-eW25qxxStatus W25qxx_EraseSector(uint32_t SectorAddr)
+	FLASH_SS_Set();
+	gW25qxxDev.Lock=0;
+
+	return IsBlank;
+}
+
+/**
+ * @brief Count non-blank sectors in a run of the last planned range
+ *
+ * @param pPlan plan the dirty map belongs to
+ * @param Sector first absolute sector of run
+ * @param SectorCount sectors in run
+ * @return number of non-blank sectors
+ */
+static uint32_t W25qxx_CountDirtySectors(const sW25qxxErasePlan_t* const pPlan, uint32_t Sector, uint32_t SectorCount)
 {
-	while(gW25qxxDev.Lock==1)
+	uint32_t Index = Sector - (pPlan->Address / gW25qxxDev.SectorSize);
+	uint32_t DirtyCount = 0;
+
+	for(uint32_t i = Index; i < (Index + SectorCount); i++)
 	{
-		W25qxx_Delay(1);
+		if(0 != (gEraseDirtyMap[i >> 3] & (1u << (i & 7u))))
+		{
+			DirtyCount++;
+		}
 	}
-	gW25qxxDev.Lock=1;
 
-	#if (_W25QXX_DEBUG==1)
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseSector %d Begin...\r\n",SectorAddr);
-	#endif
+	return DirtyCount;
+}
 
-	W25qxx_WaitForWriteEnd();
-	SectorAddr = SectorAddr * gW25qxxDev.SectorSize;
-	W25qxx_WriteEnable();
-	FLASH_SS_Clear();
+/**
+ * @brief Counts an erase step into a tally, or executes it if no tally is given
+ *
+ * @param pOutTally plan being tallied, NULL to execute
+ * @param Operation erase operation
+ * @param Sector first absolute sector erased
+ * @return eW25qxxStatus
+ */
+static eW25qxxStatus W25qxx_EmitEraseStep(sW25qxxErasePlan_t* const pOutTally, eW25qxxOperation_t Operation, uint32_t Sector)
+{
+	eW25qxxStatus status = 0;
 
-	if (gW25qxxDev.ID >= W25Q256)
+	if(NULL != pOutTally)
 	{
-		W25qxx_Spi(0x21);
-		W25qxx_Spi((SectorAddr & 0xFF000000) >> 24);
+		pOutTally->OperationCount[Operation]++;
+		pOutTally->EstimatedUs += gW25qxxLatencyStats[Operation].ExpectedUs;
+		return status;
 	}
-	else
+
+	switch(Operation)
 	{
-		W25qxx_Spi(0x20);
+		case eW25QXX_OP_SECTOR_ERASE:
+			status = W25qxx_EraseSector(Sector);
+			break;
+
+		case eW25QXX_OP_BLOCK32_ERASE:
+			status = W25qxx_EraseBlock32K((Sector * gW25qxxDev.SectorSize) / W25QXXH_BLOCK32_SIZE);
+			break;
+
+		case eW25QXX_OP_BLOCK_ERASE:
+			status = W25qxx_EraseBlock(W25qxx_SectorToBlock(Sector));
+			break;
+
+		default:
+			status = -1;
+			break;
 	}
 
-	W25qxx_Spi((SectorAddr & 0xFF0000) >> 16);
-	W25qxx_Spi((SectorAddr & 0xFF00) >> 8);
-	W25qxx_Spi(SectorAddr & 0xFF);
-	FLASH_SS_Set();
-	W25qxx_WaitForWriteEnd();
+	return status;
+}
 
-	#if (_W25QXX_DEBUG==1)
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseSector done\n\r");
-	#endif
+/**
+ * @brief Walks the planned range picking the cheapest erase for every 64K block,
+ * 32K half block and sector that still holds data. Erase sizes the part lacks are not used.
+ *
+ * @param pPlan plan to walk
+ * @param pOutTally plan tally is accumulated here, NULL to execute the steps
+ * @return eW25qxxStatus
+ */
+static eW25qxxStatus W25qxx_WalkErasePlan(const sW25qxxErasePlan_t* const pPlan, sW25qxxErasePlan_t* const pOutTally)
+{
+	const uint32_t SectorsPerBlock32 = W25QXXH_BLOCK32_SIZE / gW25qxxDev.SectorSize;
+	const uint32_t SectorsPerBlock = gW25qxxDev.BlockSize / gW25qxxDev.SectorSize;
+	const uint64_t CostSector = gW25qxxLatencyStats[eW25QXX_OP_SECTOR_ERASE].ExpectedUs;
+	const uint64_t CostBlock32 = gW25qxxLatencyStats[eW25QXX_OP_BLOCK32_ERASE].ExpectedUs;
+	const uint64_t CostBlock = gW25qxxLatencyStats[eW25QXX_OP_BLOCK_ERASE].ExpectedUs;
+	const bool IsBlock32Supported = gCommand[eW25QXX_OP_BLOCK32_ERASE].IsSupported;
+	const bool IsBlockSupported = gCommand[eW25QXX_OP_BLOCK_ERASE].IsSupported;
+
+	uint32_t Sector = pPlan->Address / gW25qxxDev.SectorSize;
+	uint32_t EndSector = Sector + (pPlan->Length / gW25qxxDev.SectorSize);
+	eW25qxxStatus status = 0;
+
+	while((Sector < EndSector) && (0 == status))
+	{
+		if((true == IsBlockSupported) && (0 == (Sector % SectorsPerBlock)) && ((Sector + SectorsPerBlock) <= EndSector))
+		{
+			uint64_t HalvesCost = 0;
+
+			for(uint32_t Half = 0; Half < 2; Half++)
+			{
+				uint64_t DirtyCost = W25qxx_CountDirtySectors(pPlan, Sector + (Half * SectorsPerBlock32), SectorsPerBlock32) * CostSector;
+				HalvesCost += ((false == IsBlock32Supported) || (DirtyCost < CostBlock32))? DirtyCost: CostBlock32;
+			}
+
+			if((0 != HalvesCost) && (CostBlock <= HalvesCost))
+			{
+				status = W25qxx_EmitEraseStep(pOutTally, eW25QXX_OP_BLOCK_ERASE, Sector);
+				Sector += SectorsPerBlock;
+				continue;
+			}
+		}
 
-	W25qxx_Delay(1);
-	gW25qxxDev.Lock=0;
+		if((true == IsBlock32Supported) && (0 == (Sector % SectorsPerBlock32)) && ((Sector + SectorsPerBlock32) <= EndSector))
+		{
+			uint64_t DirtyCost = W25qxx_CountDirtySectors(pPlan, Sector, SectorsPerBlock32) * CostSector;
+
+			if((0 != DirtyCost) && (CostBlock32 < DirtyCost))
+			{
+				status = W25qxx_EmitEraseStep(pOutTally, eW25QXX_OP_BLOCK32_ERASE, Sector);
+				Sector += SectorsPerBlock32;
+				continue;
+			}
+		}
 
-	return 0;
+		if(0 != W25qxx_CountDirtySectors(pPlan, Sector, 1))
+		{
+			status = W25qxx_EmitEraseStep(pOutTally, eW25QXX_OP_SECTOR_ERASE, Sector);
+		}
+		Sector++;
+	}
+
+	return status;
 }
- 
-eW25qxxStatus W25qxx_EraseBlock(uint32_t BlockAddr)
+
+/**
+ * @brief Builds an erase plan for a range. Every sector is blank checked first
+ * so factory fresh or already erased regions are skipped.
+ * @note The plan is only valid until the next call, it refers to a shared sector map.
+ * Ranges longer than @ref W25QXXH_ERASE_PLAN_MAX_SECTORS are truncated, see @ref W25qxx_EraseRange
+ *
+ * @param Address byte address of range, rounded down to a sector
+ * @param Length length of range in bytes, rounded up to a sector
+ * @param pOutPlan plan is saved here
+ * @return eW25qxxStatus
+ */
+eW25qxxStatus W25qxx_PlanErase(uint32_t Address, uint32_t Length, sW25qxxErasePlan_t* const pOutPlan)
 {
-	while(gW25qxxDev.Lock==1)
+	assert(NULL != pOutPlan);
+
+	const uint32_t Capacity = gW25qxxDev.SectorCount * gW25qxxDev.SectorSize;
+	uint32_t End = Address + Length;
+
+	memset(pOutPlan, 0, sizeof(sW25qxxErasePlan_t));
+	memset(gEraseDirtyMap, 0, sizeof(gEraseDirtyMap));
+
+	Address -= (Address % gW25qxxDev.SectorSize);
+	End = ((End + gW25qxxDev.SectorSize - 1u) / gW25qxxDev.SectorSize) * gW25qxxDev.SectorSize;
+
+	if(End > Capacity)
 	{
-		W25qxx_Delay(1);
+		End = Capacity;
 	}
 
-	gW25qxxDev.Lock=1;
+	if((Address >= End) || (0 == Capacity))
+	{
+		return -1;
+	}
 
-	#if (_W25QXX_DEBUG==1)
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseBlock %d Begin...\r\n",BlockAddr);
-	W25qxx_Delay(100);
-	#endif
+	if(((End - Address) / gW25qxxDev.SectorSize) > W25QXXH_ERASE_PLAN_MAX_SECTORS)
+	{
+		End = Address + (W25QXXH_ERASE_PLAN_MAX_SECTORS * gW25qxxDev.SectorSize);
+	}
 
-	W25qxx_WaitForWriteEnd();
-	BlockAddr = BlockAddr * gW25qxxDev.SectorSize*16;
-    W25qxx_WriteEnable();
-    FLASH_SS_Clear();
-  
-	if (gW25qxxDev.ID >= W25Q256)
+	pOutPlan->Address = Address;
+	pOutPlan->Length = End - Address;
+
+	for(uint32_t Index = 0; Index < (pOutPlan->Length / gW25qxxDev.SectorSize); Index++)
 	{
-		W25qxx_Spi(0xDC);
-		W25qxx_Spi((BlockAddr & 0xFF000000) >> 24);
+		if(false == W25qxx_IsBlank(Address + (Index * gW25qxxDev.SectorSize), gW25qxxDev.SectorSize))
+		{
+			gEraseDirtyMap[Index >> 3] |= (1u << (Index & 7u));
+		}
 	}
-	else
+
+	eW25qxxStatus status = W25qxx_WalkErasePlan(pOutPlan, pOutPlan);
+
+	uint32_t ErasedBytes = (pOutPlan->OperationCount[eW25QXX_OP_SECTOR_ERASE] * gW25qxxDev.SectorSize) +
+						   (pOutPlan->OperationCount[eW25QXX_OP_BLOCK32_ERASE] * W25QXXH_BLOCK32_SIZE) +
+						   (pOutPlan->OperationCount[eW25QXX_OP_BLOCK_ERASE] * gW25qxxDev.BlockSize);
+
+	pOutPlan->BlankBytesSkipped = pOutPlan->Length - ErasedBytes;
+
+	/* A whole chip with data spread everywhere is cheapest to erase in one go */
+	if((0 == Address) && (Capacity == pOutPlan->Length) &&
+	   (pOutPlan->EstimatedUs > gW25qxxLatencyStats[eW25QXX_OP_CHIP_ERASE].ExpectedUs))
 	{
-		W25qxx_Spi(0xD8);
+		memset(pOutPlan->OperationCount, 0, sizeof(pOutPlan->OperationCount));
+		pOutPlan->OperationCount[eW25QXX_OP_CHIP_ERASE] = 1;
+		pOutPlan->EstimatedUs = gW25qxxLatencyStats[eW25QXX_OP_CHIP_ERASE].ExpectedUs;
+		pOutPlan->BlankBytesSkipped = 0;
+		pOutPlan->IsChipErase = true;
 	}
 
-    W25qxx_Spi((BlockAddr & 0xFF0000) >> 16);
-    W25qxx_Spi((BlockAddr & 0xFF00) >> 8);
-    W25qxx_Spi(BlockAddr & 0xFF);
-    FLASH_SS_Set();	
-    W25qxx_WaitForWriteEnd();
+	return status;
+}
 
-    #if (_W25QXX_DEBUG==1)
-    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseBlock done\n\r");
-    W25qxx_Delay(100);
-    #endif
+/**
+ * @brief Executes a plan built by @ref W25qxx_PlanErase
+ *
+ * @param pPlan plan to execute
+ * @return eW25qxxStatus
+ */
+eW25qxxStatus W25qxx_ExecuteErasePlan(const sW25qxxErasePlan_t* const pPlan)
+{
+	assert(NULL != pPlan);
 
-    W25qxx_Delay(1);
-    gW25qxxDev.Lock=0;
-    DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev EraseBlock done\n\r");
-    
-    return 0;
+	if(true == pPlan->IsChipErase)
+	{
+		return W25qxx_EraseChip();
+	}
+
+	return W25qxx_WalkErasePlan(pPlan, NULL);
+}
+
+/**
+ * @brief Erases a range of any length with the cheapest mix of erase commands,
+ * skipping regions that are already blank
+ *
+ * @param Address byte address of range
+ * @param Length length of range in bytes
+ * @param pOutSummary accumulated plan of all executed steps is saved here
+ * @return eW25qxxStatus
+ */
+eW25qxxStatus W25qxx_EraseRange(uint32_t Address, uint32_t Length, sW25qxxErasePlan_t* const pOutSummary)
+{
+	assert(NULL != pOutSummary);
+
+	sW25qxxErasePlan_t Plan;
+	uint32_t End = Address + Length;
+	eW25qxxStatus status = 0;
+
+	AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_FLASH_ERASE);
+
+	memset(pOutSummary, 0, sizeof(sW25qxxErasePlan_t));
+	pOutSummary->Address = Address - (Address % gW25qxxDev.SectorSize);
+
+	while((Address < End) && (0 == status))
+	{
+		status = W25qxx_PlanErase(Address, End - Address, &Plan);
+
+		if(0 == status)
+		{
+			status = W25qxx_ExecuteErasePlan(&Plan);
+		}
+
+		for(eW25qxxOperation_t Operation = eW25QXX_OP_NONE; Operation < eW25QXX_OP_MAX; Operation++)
+		{
+			pOutSummary->OperationCount[Operation] += Plan.OperationCount[Operation];
+		}
+
+		pOutSummary->IsChipErase |= Plan.IsChipErase;
+		pOutSummary->Length += Plan.Length;
+		pOutSummary->BlankBytesSkipped += Plan.BlankBytesSkipped;
+		pOutSummary->EstimatedUs += Plan.EstimatedUs;
+
+		if(0 == Plan.Length)
+		{
+			break;
+		}
+
+		Address = Plan.Address + Plan.Length;
+	}
+
+	AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_FLASH_ERASE);
+
+	return status;
 }
  
 uint32_t W25qxx_PageToSector(uint32_t PageAddress)
@@ -472,7 +1554,7 @@ bool W25qxx_IsEmptyPage(uint32_t Page_Address, uint32_t OffsetInByte, uint32_t N
 	{
         FLASH_SS_Clear(); 
 		WorkAddress=(i+Page_Address*gW25qxxDev.PageSize);
-		if (gW25qxxDev.ID >= W25Q256)
+		if (true == gW25qxxDev.Is4ByteAddress)
 		{
 			W25qxx_Spi(0x0C);
 			W25qxx_Spi((WorkAddress & 0xFF000000) >> 24);
@@ -501,7 +1583,7 @@ bool W25qxx_IsEmptyPage(uint32_t Page_Address, uint32_t OffsetInByte, uint32_t N
             FLASH_SS_Clear();
 			WorkAddress=(i+Page_Address*gW25qxxDev.PageSize);
 			W25qxx_Spi(0x0B);
-			if(gW25qxxDev.ID>=W25Q256)
+			if(true == gW25qxxDev.Is4ByteAddress)
 				W25qxx_Spi((WorkAddress & 0xFF000000) >> 24);
 			W25qxx_Spi((WorkAddress & 0xFF0000) >> 16);
 			W25qxx_Spi((WorkAddress & 0xFF00) >> 8);
@@ -559,7 +1641,7 @@ bool W25qxx_IsEmptySector(uint32_t Sector_Address, uint32_t OffsetInByte, uint32
         FLASH_SS_Clear();
 		WorkAddress=(i+Sector_Address*gW25qxxDev.SectorSize);
 		W25qxx_Spi(0x0B);
-		if (gW25qxxDev.ID >= W25Q256)
+		if (true == gW25qxxDev.Is4ByteAddress)
 		{
 			W25qxx_Spi(0x0C);
 			W25qxx_Spi((WorkAddress & 0xFF000000) >> 24);
@@ -588,7 +1670,7 @@ bool W25qxx_IsEmptySector(uint32_t Sector_Address, uint32_t OffsetInByte, uint32
              FLASH_SS_Clear();
 			WorkAddress=(i+Sector_Address*gW25qxxDev.SectorSize);
 			W25qxx_Spi(0x0B);
-			if(gW25qxxDev.ID>=W25Q256)
+			if(true == gW25qxxDev.Is4ByteAddress)
 				W25qxx_Spi((WorkAddress & 0xFF000000) >> 24);
 			W25qxx_Spi((WorkAddress & 0xFF0000) >> 16);
 			W25qxx_Spi((WorkAddress & 0xFF00) >> 8);
@@ -643,7 +1725,7 @@ bool W25qxx_IsEmptyBlock(uint32_t Block_Address, uint32_t OffsetInByte, uint32_t
 	{
          FLASH_SS_Clear();
 		WorkAddress=(i+Block_Address*gW25qxxDev.BlockSize);
-		if (gW25qxxDev.ID >= W25Q256)
+		if (true == gW25qxxDev.Is4ByteAddress)
 		{
 			W25qxx_Spi(0x0C);
 			W25qxx_Spi((WorkAddress & 0xFF000000) >> 24);
@@ -674,7 +1756,7 @@ bool W25qxx_IsEmptyBlock(uint32_t Block_Address, uint32_t OffsetInByte, uint32_t
              FLASH_SS_Clear();
 			WorkAddress=(i+Block_Address*gW25qxxDev.BlockSize);
 			W25qxx_Spi(0x0B);
-			if(gW25qxxDev.ID>=W25Q256)
+			if(true == gW25qxxDev.Is4ByteAddress)
 				W25qxx_Spi((WorkAddress & 0xFF000000) >> 24);
 			W25qxx_Spi((WorkAddress & 0xFF0000) >> 16);
 			W25qxx_Spi((WorkAddress & 0xFF00) >> 8);
@@ -713,27 +1795,31 @@ eW25qxxStatus W25qxx_WriteByte(uint8_t pBuffer, uint32_t WriteAddr_inBytes)
 	uint32_t StartTime = HAL_GetTick();
 	#endif
 
-	W25qxx_WaitForWriteEnd();
-	W25qxx_WriteEnable();
-	FLASH_SS_Clear();
+	eW25qxxStatus status = W25qxx_WaitForWriteEnd();
 
-	if (gW25qxxDev.ID >= W25Q256)
+	if(0 == status)
 	{
-		W25qxx_Spi(0x12);
-		W25qxx_Spi((WriteAddr_inBytes & 0xFF000000) >> 24);
-	}
-	else
-	{
-		W25qxx_Spi(0x02);
-	}
+		W25qxx_WriteEnable();
+		FLASH_SS_Clear();
 
-	W25qxx_Spi((WriteAddr_inBytes & 0xFF0000) >> 16);
-	W25qxx_Spi((WriteAddr_inBytes & 0xFF00) >> 8);
-	W25qxx_Spi(WriteAddr_inBytes & 0xFF);
-	W25qxx_Spi(pBuffer);
-	FLASH_SS_Set();
+		if (true == gW25qxxDev.Is4ByteAddress)
+		{
+			W25qxx_Spi(0x12);
+			W25qxx_Spi((WriteAddr_inBytes & 0xFF000000) >> 24);
+		}
+		else
+		{
+			W25qxx_Spi(0x02);
+		}
+
+		W25qxx_Spi((WriteAddr_inBytes & 0xFF0000) >> 16);
+		W25qxx_Spi((WriteAddr_inBytes & 0xFF00) >> 8);
+		W25qxx_Spi(WriteAddr_inBytes & 0xFF);
+		W25qxx_Spi(pBuffer);
+		FLASH_SS_Set();
 
-	W25qxx_WaitForWriteEnd();
+		status = W25qxx_WaitForWriteEnd();
+	}
 
 	#if (_W25QXX_DEBUG==1)
 	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev WriteByte done after %d ms\r\n",HAL_GetTick()-StartTime);
@@ -741,75 +1827,97 @@ eW25qxxStatus W25qxx_WriteByte(uint8_t pBuffer, uint32_t WriteAddr_inBytes)
 
 	gW25qxxDev.Lock=0;
 
-	return 0;
+	return status;
 }
  
-eW25qxxStatus W25qxx_WritePage(uint8_t *pBuffer, uint32_t Page_Address, uint32_t OffsetInByte, uint32_t NumByteToWrite_up_to_PageSize)
+/**
+ * @brief Check if data to be programmed is all 0xFF, bulk of the buffer is checked a word at a time
+ *
+ * @param pBuffer data to be programmed
+ * @param Length number of bytes
+ * @return true if every byte is 0xFF
+ */
+static bool W25qxx_IsErasedPattern(const uint8_t* pBuffer, uint32_t Length)
 {
-	while(gW25qxxDev.Lock==1)
+	while((Length > 0) && (0 != ((uintptr_t)pBuffer % sizeof(uint32_t))))
 	{
-		W25qxx_Delay(1);
+		if(0xFF != *pBuffer++)
+		{
+			return false;
+		}
+		Length--;
 	}
-	gW25qxxDev.Lock=1;
 
-	if(((NumByteToWrite_up_to_PageSize+OffsetInByte)>gW25qxxDev.PageSize)||(NumByteToWrite_up_to_PageSize==0))
+	const uint32_t* pWord = (const uint32_t*)pBuffer;
+
+	for( ; Length >= sizeof(uint32_t); Length -= sizeof(uint32_t))
 	{
-		NumByteToWrite_up_to_PageSize=gW25qxxDev.PageSize-OffsetInByte;
+		if(0xFFFFFFFF != *pWord++)
+		{
+			return false;
+		}
 	}
 
-	if((OffsetInByte+NumByteToWrite_up_to_PageSize) > gW25qxxDev.PageSize)
+	pBuffer = (const uint8_t*)pWord;
+
+	while(Length > 0)
 	{
-		NumByteToWrite_up_to_PageSize = gW25qxxDev.PageSize-OffsetInByte;
+		if(0xFF != *pBuffer++)
+		{
+			return false;
+		}
+		Length--;
 	}
 
+	return true;
+}
 
+/**
+ * @brief Program a page and wait for it to complete
+ *
+ * @note Programming can only clear bits, so a page of 0xFF leaves flash as it
+ * is and is not sent at all. That saves the data phase and a full tPP for the
+ * padding runs typical of firmware images.
+ *
+ * @return eW25qxxStatus
+ */
+eW25qxxStatus W25qxx_WritePage(uint8_t *pBuffer, uint32_t Page_Address, uint32_t OffsetInByte, uint32_t NumByteToWrite_up_to_PageSize)
+{
 	#if (_W25QXX_DEBUG==1)
 	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev WritePage:%d, Offset:%d ,Writes %d Bytes, begin...\r\n",Page_Address,OffsetInByte,NumByteToWrite_up_to_PageSize);
-	W25qxx_Delay(100);
-	#endif	
+	#endif
 
-	W25qxx_WaitForWriteEnd();
-    W25qxx_WriteEnable();
-    FLASH_SS_Clear();
-	Page_Address = (Page_Address*gW25qxxDev.PageSize)+OffsetInByte;	
-	if (gW25qxxDev.ID >= W25Q256)
+	uint32_t Length = NumByteToWrite_up_to_PageSize;
+
+	if(((Length + OffsetInByte) > gW25qxxDev.PageSize) || (0 == Length))
 	{
-		W25qxx_Spi(0x12);
-		W25qxx_Spi((Page_Address & 0xFF000000) >> 24);
+		Length = gW25qxxDev.PageSize - OffsetInByte;
 	}
-	else
+
+	if(true == W25qxx_IsErasedPattern(pBuffer, Length))
 	{
-		W25qxx_Spi(0x02);
+		gW25qxxBlankPagesSkipped++;
+		return 0;
 	}
 
-    W25qxx_Spi((Page_Address & 0xFF0000) >> 16);
-    W25qxx_Spi((Page_Address & 0xFF00) >> 8);
-    W25qxx_Spi(Page_Address&0xFF);
-  
-	HAL_SPI_Transmit(W25QXXH_SPI_HANDLE, pBuffer, NumByteToWrite_up_to_PageSize, W25QXXH_SPI_TIMEOUT_MS);
-    FLASH_SS_Set();
-    W25qxx_WaitForWriteEnd();
+	W25qxx_WaitForAsyncComplete();
 
-	#if (_W25QXX_DEBUG==1)
-    uint32_t StartTime = HAL_GetTick();
-	for(uint32_t i=0;i<NumByteToWrite_up_to_PageSize ; i++)
+	AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_FLASH_PROGRAM);
+
+	eW25qxxStatus status = W25qxx_SubmitPageProgram(pBuffer, Page_Address, OffsetInByte, NumByteToWrite_up_to_PageSize);
+
+	if(0 == status)
 	{
-		if((i%8==0)&&(i>2))
-		{
-			DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "\r\n");
-			W25qxx_Delay(10);			
-		}
-		DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "0x%02X,",pBuffer[i]);
-	}	
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "\r\n");
-	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev WritePage done after %d ms\n\r", StartTime );
-	W25qxx_Delay(100);
-	#endif	
+		status = W25qxx_WaitForAsyncComplete();
+	}
 
-	W25qxx_Delay(1);
-	gW25qxxDev.Lock=0;
-    
-    return 0;
+	AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_FLASH_PROGRAM);
+
+	#if (_W25QXX_DEBUG==1)
+	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "gW25qxxDev WritePage done\n\r");
+	#endif
+
+    return status;
 }
  
 eW25qxxStatus W25qxx_WriteSector(uint8_t *pBuffer, uint32_t Sector_Address, uint32_t OffsetInByte, uint32_t NumByteToWrite_up_to_SectorSize)
@@ -848,21 +1956,23 @@ eW25qxxStatus W25qxx_WriteSector(uint8_t *pBuffer, uint32_t Sector_Address, uint
 	StartPage = W25qxx_SectorToPage(Sector_Address)+(OffsetInByte/gW25qxxDev.PageSize);
 	LocalOffset = OffsetInByte%gW25qxxDev.PageSize;	
 
+	eW25qxxStatus status = 0;
+
 	do
 	{		
-		W25qxx_WritePage(pBuffer,StartPage,LocalOffset,BytesToWrite);
+		status = W25qxx_WritePage(pBuffer,StartPage,LocalOffset,BytesToWrite);
 		StartPage++;
 		BytesToWrite-=gW25qxxDev.PageSize-LocalOffset;
 		pBuffer += gW25qxxDev.PageSize - LocalOffset;
 		LocalOffset=0;
-	}while(BytesToWrite>0);		
+	}while((BytesToWrite>0) && (0 == status));		
 
 	#if (_W25QXX_DEBUG==1)
 	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "---gW25qxxDev WriteSector Done\r\n");
 	W25qxx_Delay(100);
 	#endif	
 
-    return 0;
+    return status;
 }
  
 eW25qxxStatus W25qxx_WriteBlock(uint8_t* pBuffer, uint32_t Block_Address, uint32_t OffsetInByte, uint32_t NumByteToWrite_up_to_BlockSize)
@@ -901,21 +2011,23 @@ eW25qxxStatus W25qxx_WriteBlock(uint8_t* pBuffer, uint32_t Block_Address, uint32
 	StartPage = W25qxx_BlockToPage(Block_Address)+(OffsetInByte/gW25qxxDev.PageSize);
 	LocalOffset = OffsetInByte%gW25qxxDev.PageSize;
 
+	eW25qxxStatus status = 0;
+
 	do
 	{		
-		W25qxx_WritePage(pBuffer,StartPage,LocalOffset,BytesToWrite);
+		status = W25qxx_WritePage(pBuffer,StartPage,LocalOffset,BytesToWrite);
 		StartPage++;
 		BytesToWrite-=gW25qxxDev.PageSize-LocalOffset;
 		pBuffer += gW25qxxDev.PageSize - LocalOffset;
 		LocalOffset=0;
-	}while(BytesToWrite>0);
+	}while((BytesToWrite>0) && (0 == status));
 
 	#if (_W25QXX_DEBUG==1)
 	DEBUG_PRINT(eCONSOLE_PRINT_LVL0, "---gW25qxxDev WriteBlock Done\r\n");
 	W25qxx_Delay(100);
 	#endif	
 
-    return 0;
+    return status;
 }
  
 eW25qxxStatus W25qxx_ReadByte(uint8_t *pBuffer, uint32_t Bytes_Address)
@@ -933,7 +2045,7 @@ eW25qxxStatus W25qxx_ReadByte(uint8_t *pBuffer, uint32_t Bytes_Address)
 	#endif
 
     FLASH_SS_Clear();
-	if (gW25qxxDev.ID >= W25Q256)
+	if (true == gW25qxxDev.Is4ByteAddress)
 	{
 		W25qxx_Spi(0x0C);
 		W25qxx_Spi((Bytes_Address & 0xFF000000) >> 24);
@@ -974,7 +2086,7 @@ eW25qxxStatus W25qxx_ReadBytes(uint8_t* pBuffer, uint32_t ReadAddr, uint32_t Num
 	#endif	
 
     FLASH_SS_Clear();
-	if (gW25qxxDev.ID >= W25Q256)
+	if (true == gW25qxxDev.Is4ByteAddress)
 	{
 		W25qxx_Spi(0x0C);
 		W25qxx_Spi((ReadAddr & 0xFF000000) >> 24);
@@ -1005,7 +2117,6 @@ eW25qxxStatus W25qxx_ReadBytes(uint8_t* pBuffer, uint32_t ReadAddr, uint32_t Num
 	W25qxx_Delay(100);
 	#endif	
 
-	W25qxx_Delay(1);
 	gW25qxxDev.Lock=0;
     
     return 0;
@@ -1036,7 +2147,7 @@ eW25qxxStatus W25qxx_ReadPage(uint8_t *pBuffer, uint32_t Page_Address, uint32_t
 
 	Page_Address = Page_Address*gW25qxxDev.PageSize+OffsetInByte;
     FLASH_SS_Clear();
-	if (gW25qxxDev.ID >= W25Q256)
+	if (true == gW25qxxDev.Is4ByteAddress)
 	{
 		W25qxx_Spi(0x0C);
 		W25qxx_Spi((Page_Address & 0xFF000000) >> 24);
@@ -1068,7 +2179,6 @@ eW25qxxStatus W25qxx_ReadPage(uint8_t *pBuffer, uint32_t Page_Address, uint32_t
 	W25qxx_Delay(100);
 	#endif
 
-	W25qxx_Delay(1);
 	gW25qxxDev.Lock=0;
     
     return 0;
@@ -1202,4 +2312,49 @@ bool W25qxx_Test()
     
 }
 
+/**
+ * @brief Measure cost of one short transaction (read status register 1) through
+ * HAL with HAL_GPIO_WritePin chip select and through @ref SpiLL.h, and print
+ * the average of each in CPU cycles
+ *
+ * @return true if both paths read the same status
+ */
+bool W25qxx_TestCommandOverhead()
+{
+	static const uint32_t cTRANSACTION_COUNT = 1000u;
+	uint8_t Opcode = 0x05;
+	uint8_t Response[2] = {0};
+	uint8_t HalStatus = 0;
+	uint8_t LLStatus = 0;
+
+	W25qxx_WaitForAsyncComplete();
+	AppProfiler_EnableCycleCounter();
+
+	uint32_t startCycleCount = AppProfiler_GetCycleCount();
+	for(uint32_t i = 0; i < cTRANSACTION_COUNT; i++)
+	{
+		uint8_t Command[2] = {Opcode, W25QXX_DUMMY_BYTE};
+		HAL_GPIO_WritePin(W25QXXH_SPI_CS_PORT, W25XXH_SPI_CS_PIN, GPIO_PIN_RESET);
+		HAL_SPI_TransmitReceive(W25QXXH_SPI_HANDLE, Command, Response, sizeof(Command), W25QXXH_SPI_TIMEOUT_MS);
+		HAL_GPIO_WritePin(W25QXXH_SPI_CS_PORT, W25XXH_SPI_CS_PIN, GPIO_PIN_SET);
+		HalStatus = Response[1];
+	}
+	uint32_t halCycles = AppProfiler_GetCycleCount() - startCycleCount;
+
+	startCycleCount = AppProfiler_GetCycleCount();
+	for(uint32_t i = 0; i < cTRANSACTION_COUNT; i++)
+	{
+		FLASH_SS_Clear();
+		W25qxx_Spi(Opcode);
+		LLStatus = W25qxx_Spi(W25QXX_DUMMY_BYTE);
+		FLASH_SS_Set();
+	}
+	uint32_t llCycles = AppProfiler_GetCycleCount() - startCycleCount;
+
+	Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> W25Qxx status poll: HAL %lu cycles, LL %lu cycles per transaction",
+			(unsigned long)(halCycles / cTRANSACTION_COUNT), (unsigned long)(llCycles / cTRANSACTION_COUNT));
+
+	return (HalStatus == LLStatus);
+}
+
 #endif
@@ -20,11 +20,29 @@
 #include <stdbool.h>
 #include "spi.h"
 #include "gpio.h"
+#include "tim.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 #define W25QXXH_SPI_HANDLE		(&hspi2)
 #define W25QXXH_SPI_TIMEOUT_MS	(100)
+#define W25QXXH_SPI_DMA_MIN_LEN	(16)	/**< Shorter data phases are cheaper as polled transfers */
+
+#define W25QXXH_POLL_TIMER_HANDLE	(&htim7)	/**< Timer that drives busy polling of asynchronous operations, counts in microseconds */
+#define W25QXXH_POLL_MIN_US			(20u)		/**< Shortest interval between two status polls */
+#define W25QXXH_POLL_MAX_US			(65535u)	/**< Longest interval the 16 bit poll timer can count */
+#define W25QXXH_POLL_STEPS			(16u)		/**< Status polls spread over the expected latency once it has passed */
+
+#define W25QXXH_BLOCK32_SIZE				(0x8000u)	/**< Size of a half block erased by 0x52 */
+#define W25QXXH_BLOCK_SIZE					(0x10000u)	/**< Size of a block erased by 0xD8 */
+#define W25QXXH_3BYTE_ADDRESS_LIMIT			(0x1000000u)	/**< Parts larger than this need 4 byte addresses */
+
+#define W25QXXH_SFDP_SIGNATURE				(0x50444653u)	/**< "SFDP" read as a little endian DWORD */
+#define W25QXXH_SFDP_HEADER_SIZE			(16u)		/**< SFDP header followed by the first parameter header */
+#define W25QXXH_SFDP_BASIC_DWORDS_MAX		(16u)		/**< Length of the JESD216B basic flash parameter table, later revisions are read up to here */
+#define W25QXXH_SFDP_ERASE_TYPES			(4u)
+#define W25QXXH_SFDP_CAPACITY_MAX			(0x20000000u)	/**< Largest part the driver addresses, 4 Gbit */
+#define W25QXXH_ERASE_PLAN_MAX_SECTORS		(4096u)		/**< Sectors covered by a single erase plan (16 MB) */
 
 #define W25QXXH_SPI_CS_PORT		(SPI2_NSS_GPIO_Port)
 #define W25XXH_SPI_CS_PIN		(SPI2_NSS_Pin)
@@ -85,10 +103,111 @@ typedef struct
 	uint8_t		StatusRegister2;
 	uint8_t		StatusRegister3;	
 	uint8_t		Lock;
+	uint8_t		ManufacturerID;		/**< JEDEC manufacturer, 0xEF Winbond, 0xC8 GigaDevice, 0xC2 Macronix, 0x9D ISSI */
+	bool		IsSfdpValid;		/**< Geometry, erase commands and timing were discovered through SFDP */
+	bool		Is4ByteAddress;		/**< Commands carry 4 byte addresses */
+	uint16_t	ProgramPageSize;	/**< Page size the part reports, programs are still issued in @ref DF_PAGE_SIZE pieces */
 }w25qxx_t;
 
 typedef int32_t eW25qxxStatus;
 
+/**
+ * @brief Hook invoked repeatedly while the flash reports busy (WIP set).
+ * Lets the application do useful work on another bus instead of sleeping.
+ * The hook must not call back into the W25Qxx driver. Returns false when it
+ * had nothing to do, so the caller can sleep until the next interrupt.
+ */
+typedef bool (*pfW25qxxBusyHook_t)(void);
+
+/**
+ * @brief Operations that can be submitted asynchronously
+ */
+typedef enum
+{
+	eW25QXX_OP_NONE,
+	eW25QXX_OP_PAGE_PROGRAM,
+	eW25QXX_OP_SECTOR_ERASE,
+	eW25QXX_OP_BLOCK32_ERASE,
+	eW25QXX_OP_BLOCK_ERASE,
+	eW25QXX_OP_CHIP_ERASE,
+	eW25QXX_OP_MAX
+}eW25qxxOperation_t;
+
+/**
+ * @brief Progress of the asynchronous operation in flight
+ */
+typedef enum
+{
+	eW25QXX_ASYNC_IDLE,			/**< No operation in flight */
+	eW25QXX_ASYNC_DATA_PHASE,	/**< Page data is being shifted out over DMA */
+	eW25QXX_ASYNC_BUSY,			/**< Command accepted, chip is programming or erasing */
+}eW25qxxAsyncState_t;
+
+/**
+ * @brief Completion callback of asynchronous operations, runs in interrupt context
+ */
+typedef void (*pfW25qxxCompleteCallback_t)(eW25qxxOperation_t Operation, eW25qxxStatus Status);
+
+/**
+ * @brief Datasheet latency of an operation
+ */
+typedef struct
+{
+	uint32_t TypicalUs;		/**< Typical time, first status poll is aimed here */
+	uint32_t MaxUs;			/**< Maximum time, operation is failed beyond this */
+}sW25qxxLatencyModel_t;
+
+/**
+ * @brief Opcodes of an operation on the fitted part
+ */
+typedef struct
+{
+	uint8_t Opcode3Byte;	/**< Opcode used with 3 byte addresses */
+	uint8_t Opcode4Byte;	/**< Opcode used with 4 byte addresses */
+	bool IsSupported;		/**< Part implements the operation */
+}sW25qxxCommand_t;
+
+/**
+ * @brief Measured latency of an operation, from command end until WIP clears
+ */
+typedef struct
+{
+	uint32_t ExpectedUs;	/**< Running estimate, seeded from the latency model */
+	uint32_t LastUs;
+	uint32_t MinUs;
+	uint32_t MaxUs;
+	uint64_t TotalUs;
+	uint32_t Count;
+}sW25qxxLatencyStats_t;
+
+/**
+ * @brief Erase plan for an address range. Built from a blank check of every
+ * 4K sector, the cheapest mix of chip, 64K, 32K and 4K erases that covers all
+ * non-blank sectors is picked using the expected latency of each operation.
+ */
+typedef struct
+{
+	uint32_t Address;							/**< Sector aligned start of range */
+	uint32_t Length;							/**< Sector aligned length of range */
+	bool IsChipErase;							/**< Whole chip is erased with a single command */
+	uint32_t OperationCount[eW25QXX_OP_MAX];	/**< Number of erase commands of each kind */
+	uint32_t BlankBytesSkipped;					/**< Bytes left alone since they are already blank */
+	uint64_t EstimatedUs;						/**< Expected time to execute the plan */
+}sW25qxxErasePlan_t;
+
+/**
+ * @brief Book keeping of the asynchronous operation in flight
+ */
+typedef struct
+{
+	volatile eW25qxxAsyncState_t State;
+	volatile eW25qxxOperation_t Operation;
+	volatile eW25qxxStatus Status;			/**< Result of the last completed operation */
+	uint32_t StartTick;
+	uint32_t StartCycleCount;
+	pfW25qxxCompleteCallback_t pfCompleteCallback;
+}sW25qxxAsync_t;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 //############################################################################
@@ -98,8 +217,14 @@ eW25qxxStatus		W25qxx_Init(void);
 
 eW25qxxStatus		W25qxx_EraseChip(void);
 eW25qxxStatus 		W25qxx_EraseSector(uint32_t SectorAddr);
+eW25qxxStatus 		W25qxx_EraseBlock32K(uint32_t Block32Addr);
 eW25qxxStatus 		W25qxx_EraseBlock(uint32_t BlockAddr);
 
+bool				W25qxx_IsBlank(uint32_t Address, uint32_t Length);
+eW25qxxStatus		W25qxx_PlanErase(uint32_t Address, uint32_t Length, sW25qxxErasePlan_t* const pOutPlan);
+eW25qxxStatus		W25qxx_ExecuteErasePlan(const sW25qxxErasePlan_t* const pPlan);
+eW25qxxStatus		W25qxx_EraseRange(uint32_t Address, uint32_t Length, sW25qxxErasePlan_t* const pOutSummary);
+
 uint32_t	W25qxx_PageToSector(uint32_t PageAddress);
 uint32_t	W25qxx_PageToBlock(uint32_t PageAddress);
 uint32_t	W25qxx_SectorToBlock(uint32_t SectorAddress);
@@ -121,7 +246,29 @@ eW25qxxStatus 		W25qxx_ReadPage(uint8_t *pBuffer, uint32_t Page_Address,uint32_t
 eW25qxxStatus 		W25qxx_ReadSector(uint8_t *pBuffer, uint32_t Sector_Address,uint32_t OffsetInByte, uint32_t NumByteToRead_up_to_SectorSize);
 eW25qxxStatus 		W25qxx_ReadBlock(uint8_t* pBuffer, uint32_t Block_Address, uint32_t OffsetInByte, uint32_t NumByteToRead_up_to_BlockSize);
 
+void		W25qxx_RegisterBusyHook(pfW25qxxBusyHook_t pfBusyHook);
+void		W25qxx_SetDmaEnable(bool IsDmaEnabled);
+
+eW25qxxStatus		W25qxx_SubmitPageProgram(uint8_t *pBuffer, uint32_t Page_Address, uint32_t OffsetInByte, uint32_t NumByteToWrite_up_to_PageSize);
+eW25qxxStatus		W25qxx_SubmitEraseSector(uint32_t SectorAddr);
+eW25qxxStatus		W25qxx_SubmitEraseBlock32K(uint32_t Block32Addr);
+eW25qxxStatus		W25qxx_SubmitEraseBlock(uint32_t BlockAddr);
+eW25qxxStatus		W25qxx_SubmitEraseChip(void);
+bool				W25qxx_IsBusy(void);
+eW25qxxStatus		W25qxx_WaitForAsyncComplete(void);
+void				W25qxx_RegisterCompleteCallback(pfW25qxxCompleteCallback_t pfCompleteCallback);
+
+bool		W25qxx_GetLatencyStats(eW25qxxOperation_t Operation, sW25qxxLatencyStats_t* const pOutStats);
+void		W25qxx_PrintLatencyStats(void);
+uint32_t	W25qxx_GetBlankPagesSkipped(void);
+const w25qxx_t*	W25qxx_GetDevice(void);
+
+void 		W25qxx_cbDataPhaseComplete(void);
+void 		W25qxx_cbDataPhaseError(void);
+void 		W25qxx_cbPollTimerElapsed(void);
+
 bool W25qxx_Test();
+bool W25qxx_TestCommandOverhead();
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -16,6 +16,8 @@
 
 #include "AppSD_API.h"
 #include "AppConfiguration.h"
+#include "Digest.h"
+#include "user_diskio_spi.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -213,6 +215,173 @@ __attribute__((unused)) static eStorageFSStatus_t SDFs_DeleteFile(const sSDFS_t*
 	return status;
 }
 
+/**
+ * @brief Build cluster link map of an open file and arm its streaming reader
+ *
+ * @note If the file has more fragments than @ref SDFS_LINKMAP_SIZE can hold,
+ * the stream stays inactive and the file is read with f_read
+ *
+ * @param pMe FatFS wrapper instance
+ * @param pStream streaming reader to be armed
+ * @param fileEnum File already opened for reading
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t SDFs_StreamInit(sSDFS_t* const pMe, sSDFSStream_t* const pStream, eStorageFileNamesEnums_t fileEnum)
+{
+	assert(NULL != pMe);
+	assert(NULL != pStream);
+	assert(fileEnum < eFS_MAX);
+
+	FIL* pFile = &(pMe->fileHandles[fileEnum]);
+
+	pStream->LinkMap[0] = SDFS_LINKMAP_SIZE;
+	pFile->cltbl = pStream->LinkMap;
+
+	FRESULT fRes = f_lseek(pFile, CREATE_LINKMAP);
+
+	pStream->IsActive = (FR_OK == fRes);
+	pStream->pNextFragment = &pStream->LinkMap[1];
+	pStream->SectorsLeftInRun = 0;
+	pStream->BytesLeft = f_size(pFile);
+	pStream->CachedOffset = 0;
+	pStream->CachedBytes = 0;
+
+	if(false == pStream->IsActive)
+	{
+		pFile->cltbl = NULL;
+	}
+
+	return ((FR_OK == fRes) || (FR_NOT_ENOUGH_CORE == fRes))? eFS_SUCCESS: eFS_ERROR;
+}
+
+/**
+ * @brief Stop streaming reader, releases the card from its multi-block read
+ *
+ * @param pMe FatFS wrapper instance
+ * @param pStream streaming reader
+ */
+static void SDFs_StreamDeInit(sSDFS_t* const pMe, sSDFSStream_t* const pStream)
+{
+	assert(NULL != pMe);
+	assert(NULL != pStream);
+
+	if(true == pStream->IsActive)
+	{
+		USER_SPI_read_stream_close(pMe->fs.drv);
+		pStream->IsActive = false;
+	}
+}
+
+/**
+ * @brief Read from a file through its streaming reader
+ *
+ * @note Whole sectors go straight from the card to pOutReadBuf, a request that
+ * ends inside a sector is served from the file's sector buffer, which f_read
+ * does not use while the stream is active
+ *
+ * @param pMe FatFS wrapper instance
+ * @param pStream armed streaming reader
+ * @param fileEnum File being streamed
+ * @param pOutReadBuf read data will be saved here
+ * @param bytesToRead number of bytes to read
+ * @param pOutBytesRead number of bytes read is saved here
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t SDFs_StreamRead(sSDFS_t* const pMe, sSDFSStream_t* const pStream, eStorageFileNamesEnums_t fileEnum, uint8_t* const pOutReadBuf, uint32_t bytesToRead, uint32_t* const pOutBytesRead)
+{
+	assert(NULL != pMe);
+	assert(NULL != pStream);
+	assert(fileEnum < eFS_MAX);
+	assert(NULL != pOutReadBuf);
+	assert(NULL != pOutBytesRead);
+
+	FATFS* pFs = &(pMe->fs);
+	BYTE* pSectorBuf = pMe->fileHandles[fileEnum].buf.d8;
+	DRESULT dRes = RES_OK;
+	uint32_t bytesRead = 0;
+
+	if(bytesToRead > pStream->BytesLeft)
+	{
+		bytesToRead = pStream->BytesLeft;
+	}
+
+	while((RES_OK == dRes) && (bytesRead < bytesToRead))
+	{
+		uint32_t bytesPending = bytesToRead - bytesRead;
+
+		if(0 != pStream->CachedBytes)
+		{
+			uint32_t bytesToCopy = (bytesPending < pStream->CachedBytes)? bytesPending: pStream->CachedBytes;
+
+			memcpy(&pOutReadBuf[bytesRead], &pSectorBuf[pStream->CachedOffset], bytesToCopy);
+
+			pStream->CachedOffset += bytesToCopy;
+			pStream->CachedBytes -= bytesToCopy;
+			bytesRead += bytesToCopy;
+			continue;
+		}
+
+		if(0 == pStream->SectorsLeftInRun)
+		{
+			DWORD clusterCount = pStream->pNextFragment[0];
+
+			if(0 == clusterCount)
+			{
+				/* Link map ended before the file did */
+				dRes = RES_ERROR;
+				break;
+			}
+
+			/* Data area starts at cluster 2 */
+			DWORD startSector = pFs->database + ((pStream->pNextFragment[1] - 2) * pFs->csize);
+
+			pStream->SectorsLeftInRun = clusterCount * pFs->csize;
+			pStream->pNextFragment += 2;
+
+			dRes = USER_SPI_read_stream_open(pFs->drv, startSector);
+			continue;
+		}
+
+		if(bytesPending >= SDFS_SECTOR_SIZE)
+		{
+			UINT sectorCount = bytesPending / SDFS_SECTOR_SIZE;
+
+			if(sectorCount > pStream->SectorsLeftInRun)
+			{
+				sectorCount = pStream->SectorsLeftInRun;
+			}
+
+			dRes = USER_SPI_read_stream(pFs->drv, &pOutReadBuf[bytesRead], sectorCount);
+
+			pStream->SectorsLeftInRun -= sectorCount;
+			bytesRead += (sectorCount * SDFS_SECTOR_SIZE);
+		}
+		else
+		{
+			dRes = USER_SPI_read_stream(pFs->drv, pSectorBuf, 1);
+
+			pStream->SectorsLeftInRun--;
+			pStream->CachedOffset = 0;
+			pStream->CachedBytes = SDFS_SECTOR_SIZE;
+		}
+	}
+
+	if(RES_OK != dRes)
+	{
+		bytesRead = 0;
+	}
+
+	pStream->BytesLeft -= bytesRead;
+	(*pOutBytesRead) = bytesRead;
+
+	if((RES_OK != dRes) || (0 == pStream->BytesLeft))
+	{
+		USER_SPI_read_stream_close(pFs->drv);
+	}
+
+	return (RES_OK == dRes)? eFS_SUCCESS: eFS_ERROR;
+}
+
 /**
  * @brief compute CRC of requested file
  *
@@ -235,27 +404,20 @@ static eStorageFSStatus_t SDFs_ComputeFileCRC(sSDFS_t* const pMe, eStorageFileNa
 
 	if(eFS_SUCCESS == status)
 	{
-		__HAL_RCC_CRC_CLK_ENABLE();
-		__HAL_LOCK(SDFS_CRC_INSTANCE);
-		__HAL_CRC_DR_RESET(SDFS_CRC_INSTANCE);
-		__HAL_UNLOCK(SDFS_CRC_INSTANCE);
-
-		memset(pInOutRamBuf, 0, RamBufSize);
+		sDigestContext_t digest;
+		Digest_Init(&digest, eDIGEST_CRC32_HW);
 
 		uint32_t numBytesRead = 0;
 
 		do
 		{
 			SDFs_ReadFileRaw(pMe, fileEnum, (char* const)pInOutRamBuf, RamBufSize, &numBytesRead);
-
-			for(int i=0; i<numBytesRead; i=(i+4))
-			{
-				uint32_t crcIntermediete = (pInOutRamBuf[i]<<24) | (pInOutRamBuf[i+1]<<16) | (pInOutRamBuf[i+2]<<8) | (pInOutRamBuf[i+3]) ;
-				(*pOutCRC) = HAL_CRC_Accumulate(SDFS_CRC_INSTANCE, &crcIntermediete, 1);
-			}
+			Digest_Update(&digest, pInOutRamBuf, numBytesRead);
 
 		}while(RamBufSize == numBytesRead);
 
+		status = (true == Digest_Final(&digest, pOutCRC))? eFS_SUCCESS: eFS_ERROR;
+
 		SDFs_CloseFileRaw(pMe, fileEnum);
 
 	}
@@ -346,6 +508,11 @@ eStorageFSStatus_t SDFs_API_OpenGoldenImageFile()
 
 	eStorageFSStatus_t status = SDFs_OpenFileRaw(pMe, eFS_GOLDEN_IMAGE, eFS_READONLY );
 
+	if(eFS_SUCCESS == status)
+	{
+		status = SDFs_StreamInit(pMe, &(pMe->GoldenImageStream), eFS_GOLDEN_IMAGE);
+	}
+
 	return status;
 }
 
@@ -367,7 +534,8 @@ eStorageFSStatus_t SDFs_API_GetGoldenImageFileSize(uint32_t* pOutFileSizeInBytes
 }
 
 /**
- * @brief Read golden image file 
+ * @brief Read golden image file, through the streaming reader when the file
+ * could be mapped when opened
  * 
  * @param pOutReadBuf contents of read file are saved here 
  * @param bytesToRead bytes to read from file 
@@ -378,7 +546,16 @@ eStorageFSStatus_t SDFs_API_ReadGoldenImageFile(char* const pOutReadBuf, uint32_
 {
 	sSDFS_t* pMe = SDFs_GetInstance();
 
-	eStorageFSStatus_t status = SDFs_ReadFileRaw(pMe, eFS_GOLDEN_IMAGE, pOutReadBuf, bytesToRead, pOutBytesRead );
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	if(true == pMe->GoldenImageStream.IsActive)
+	{
+		status = SDFs_StreamRead(pMe, &(pMe->GoldenImageStream), eFS_GOLDEN_IMAGE, (uint8_t* const)pOutReadBuf, bytesToRead, pOutBytesRead);
+	}
+	else
+	{
+		status = SDFs_ReadFileRaw(pMe, eFS_GOLDEN_IMAGE, pOutReadBuf, bytesToRead, pOutBytesRead );
+	}
 
 	return status;
 }
@@ -392,6 +569,8 @@ eStorageFSStatus_t SDFs_API_CloseGoldenImageFile()
 {
 	sSDFS_t* pMe = SDFs_GetInstance();
 
+	SDFs_StreamDeInit(pMe, &(pMe->GoldenImageStream));
+
 	eStorageFSStatus_t status = SDFs_CloseFileRaw(pMe, eFS_GOLDEN_IMAGE);
 
 	return status;
@@ -15,16 +15,32 @@
 #define APPSTORAGE_APPSDFS_APPSD_API_H_
 
 #include <stdbool.h>
-#include "crc.h"
 #include "ff.h"
 #include "AppStorageDataStructures.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#define SDFS_CRC_INSTANCE	(&hcrc)	/**< CRC instance used by SD-Card module for file integrity check*/
+#define SDFS_SECTOR_SIZE		(512u)		/**< SD-card sector size, FatFs is configured for fixed 512 byte sectors */
+#define SDFS_LINKMAP_SIZE		(32u)		/**< Cluster link map table entries, holds (SDFS_LINKMAP_SIZE - 2) / 2 fragments */
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Streaming reader of a file, reads each contiguous run of clusters
+ * with one open ended multi-block read instead of per cluster f_read calls
+ *
+ */
+typedef struct
+{
+	bool IsActive;								/**< File is read through the stream, false falls back to f_read */
+	DWORD LinkMap[SDFS_LINKMAP_SIZE];			/**< Cluster link map table built by FatFs fast seek, (length, start cluster) pairs */
+	const DWORD* pNextFragment;					/**< Link map entry of the next run */
+	DWORD SectorsLeftInRun;						/**< Sectors of the current run not yet read */
+	uint32_t BytesLeft;							/**< File bytes not yet returned */
+	uint32_t CachedOffset;						/**< Read position in the cached sector */
+	uint32_t CachedBytes;						/**< Bytes of the cached sector not yet returned */
+}sSDFSStream_t;
+
 /**
  * @brief Wrapper around FatFS file System
  * 
@@ -34,6 +50,7 @@ typedef struct
 	bool IsMounted;
 	FATFS fs;
 	FIL fileHandles[eFS_MAX];
+	sSDFSStream_t GoldenImageStream;			/**< Streaming reader of @ref eFS_GOLDEN_IMAGE */
 }sSDFS_t;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -13,8 +13,9 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
 
-#include "SPI.h"
+#include "spi.h"
 
 #include "AppStorage.h"
 #include "Console.h"
@@ -22,11 +23,51 @@
 #include "AppStorageDataStructures.h"
 #include "AppSD_API.h"
 #include "AppFlash_API.h"
+#include "AppFlashRaw_API.h"
+#include "AppConfiguration.h"
+#include "AppProfiler.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static __attribute__ ((aligned (4))) uint8_t gRamBuf[48*1024] = {0}; 	/**< 48k Ram buffer chunks to read the file into, must be aligned to prevent alignment fault */
 
+static sAppStoragePipeline_t gPipeline;		/**< SD to flash copy pipeline, slots are carved out of @ref gRamBuf */
+
+static sAppStorageImageDigest_t gImageDigest;	/**< Digest of golden image being written */
+
+static sAppStorageInflate_t gInflate;			/**< Decompression stage in front of the golden image sink */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Golden image sinks, one per storage mode @ref eStorageMode_t
+ */
+static const sAppStorageGoldenImageSink_t gcGoldenImageSinkTable[eSTORAGE_MODE_MAX] =
+{
+		[eSTORAGE_MODE_LFS] =
+		{
+				.pfPrepare		= FlashFs_API_PrepareGoldenImageFile,
+				.pfOpen			= FlashFs_API_OpenGoldenImageFile,
+				.pfWrite		= FlashFs_API_WriteToGoldenImageFile,
+				.pfClose		= FlashFs_API_CloseGoldenImageFile,
+				.pfDelete		= FlashFs_API_DeleteGoldenImageFile,
+				.pfComputeCRC	= FlashFs_API_ComputeGoldenImageFileCRC,
+				.IsWriteVerified	= true,		/**< File data is flushed with validation, see lfs_bd_flush */
+		},
+		[eSTORAGE_MODE_RAW] =
+		{
+				.pfPrepare		= FlashRaw_API_PrepareGoldenImage,
+				.pfOpen			= FlashRaw_API_OpenGoldenImageFile,
+				.pfWrite		= FlashRaw_API_WriteToGoldenImageFile,
+				.pfClose		= FlashRaw_API_CloseGoldenImageFile,
+				.pfDelete		= FlashRaw_API_DeleteGoldenImageFile,
+				.pfComputeCRC	= FlashRaw_API_ComputeGoldenImageFileCRC,
+				.IsWriteVerified	= true,		/**< Each page is read back after programming */
+		},
+};
+
+static const sAppStorageGoldenImageSink_t* gpGoldenImageSink = &gcGoldenImageSinkTable[eSTORAGE_MODE_LFS];	/**< Sink of active profile, latched by @ref AppStorage_FlashInit */
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -59,6 +100,515 @@ void AppStorage_SetPower(bool IsEnable)
 	}
 }
 
+/**
+ * @brief Initialize external flash in the storage mode of the active programming profile
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_FlashInit()
+{
+	const sAppProfile_t* pProfile = AppConfiguration_GetActiveProfile();
+
+	assert(pProfile->StorageMode < eSTORAGE_MODE_MAX);
+
+	gpGoldenImageSink = &gcGoldenImageSinkTable[pProfile->StorageMode];
+	gImageDigest.IsImageOpen = false;	/**< An image left open by an earlier job does not survive the re-init*/
+
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	switch(pProfile->StorageMode)
+	{
+		case eSTORAGE_MODE_RAW:
+			status = FlashRaw_API_Init(pProfile->RawBaseAddress, pProfile->RawMaxLength);
+			break;
+
+		case eSTORAGE_MODE_LFS:
+		case eSTORAGE_MODE_MAX:
+		default:
+			status = FlashFs_API_Init();
+			break;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Get golden image digest instance
+ *
+ * @return sAppStorageImageDigest_t*
+ */
+static sAppStorageImageDigest_t* AppStorage_GetImageDigestInstance()
+{
+	return &gImageDigest;
+}
+
+/**
+ * @brief Get golden image decompression stage instance
+ *
+ * @return sAppStorageInflate_t*
+ */
+static sAppStorageInflate_t* AppStorage_GetInflateInstance()
+{
+	return &gInflate;
+}
+
+/**
+ * @brief Hand image bytes to the sink of active profile, digest covers exactly what is written
+ *
+ * @param pData bytes to be written
+ * @param Length number of bytes
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t AppStorage_SinkWrite(const uint8_t* pData, uint32_t Length)
+{
+	Digest_Update(&AppStorage_GetImageDigestInstance()->Context, pData, Length);
+
+	return gpGoldenImageSink->pfWrite((const char* const)pData, Length);
+}
+
+/**
+ * @brief Reset decompression stage for a new image, format is detected from its first bytes
+ *
+ * @param pMe decompression stage
+ */
+static void AppStorage_InflateInit(sAppStorageInflate_t* const pMe)
+{
+	assert(NULL != pMe);
+
+	pMe->State = eINFLATE_DETECT;
+	pMe->HeaderFill = 0;
+	pMe->OriginalSize = 0;
+	pMe->ExpectedDigest = 0;
+	pMe->Produced = 0;
+	pMe->Consumed = 0;
+}
+
+/**
+ * @brief Read a little endian word out of the container header
+ *
+ * @param pData first byte of word
+ * @return uint32_t
+ */
+static uint32_t AppStorage_InflateGetWord(const uint8_t* pData)
+{
+	return ((uint32_t)pData[0] | ((uint32_t)pData[1] << 8u) | ((uint32_t)pData[2] << 16u) | ((uint32_t)pData[3] << 24u));
+}
+
+/**
+ * @brief Pick the format of the image once its first bytes are in. Bytes held
+ * back for detection are written out as they are if there is no container header.
+ *
+ * @param pMe decompression stage
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t AppStorage_InflateDetect(sAppStorageInflate_t* const pMe)
+{
+	assert(NULL != pMe);
+
+	if((APPSTORAGE_LZ_HEADER_SIZE != pMe->HeaderFill) || (0 != memcmp(pMe->Header, APPSTORAGE_LZ_MAGIC, APPSTORAGE_LZ_MAGIC_SIZE)))
+	{
+		pMe->State = eINFLATE_PASSTHROUGH;
+
+		return (pMe->HeaderFill > 0)? AppStorage_SinkWrite(pMe->Header, pMe->HeaderFill): eFS_SUCCESS;
+	}
+
+	pMe->OriginalSize = AppStorage_InflateGetWord(&pMe->Header[8]);
+	pMe->ExpectedDigest = AppStorage_InflateGetWord(&pMe->Header[12]);
+
+	if(false == Lzss_Init(&pMe->Decoder, pMe->Header[4], pMe->Header[5]))
+	{
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Compressed image with window %u / lookahead %u bits not supported", (unsigned int)pMe->Header[4], (unsigned int)pMe->Header[5]);
+		pMe->State = eINFLATE_ERROR;
+
+		return eFS_ERROR;
+	}
+
+	Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Compressed image, %lu bytes once decompressed", (unsigned long)pMe->OriginalSize);
+	pMe->State = eINFLATE_DECODE;
+
+	return eFS_SUCCESS;
+}
+
+/**
+ * @brief Decode a chunk of compressed image and write the output a page at a time
+ *
+ * @note Output past the size in the header is dropped, so padding a transfer
+ * protocol adds to the last block does not reach flash
+ *
+ * @param pMe decompression stage
+ * @param pData compressed bytes
+ * @param Length number of bytes
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t AppStorage_InflateDecode(sAppStorageInflate_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	assert(NULL != pMe);
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+	uint32_t Decoded = 0;
+
+	pMe->Consumed += Length;
+
+	do
+	{
+		AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_DECOMPRESS);
+		Decoded = Lzss_Decode(&pMe->Decoder, &pData, &Length, pMe->OutBuf, sizeof(pMe->OutBuf));
+		AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_DECOMPRESS);
+
+		uint32_t ToWrite = Decoded;
+
+		if(ToWrite > (pMe->OriginalSize - pMe->Produced))
+		{
+			ToWrite = pMe->OriginalSize - pMe->Produced;
+		}
+
+		if(ToWrite > 0)
+		{
+			status |= AppStorage_SinkWrite(pMe->OutBuf, ToWrite);
+			pMe->Produced += ToWrite;
+		}
+	}while((sizeof(pMe->OutBuf) == Decoded) && (eFS_SUCCESS == status));
+
+	return status;
+}
+
+/**
+ * @brief Pass a chunk of golden image through the decompression stage to the sink
+ *
+ * @param pMe decompression stage
+ * @param pData image bytes as they come from the source
+ * @param Length number of bytes
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t AppStorage_InflateWrite(sAppStorageInflate_t* const pMe, const uint8_t* pData, uint32_t Length)
+{
+	assert(NULL != pMe);
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+
+	if(eINFLATE_DETECT == pMe->State)
+	{
+		uint32_t HeaderBytes = APPSTORAGE_LZ_HEADER_SIZE - pMe->HeaderFill;
+
+		if(HeaderBytes > Length)
+		{
+			HeaderBytes = Length;
+		}
+
+		memcpy(&pMe->Header[pMe->HeaderFill], pData, HeaderBytes);
+		pMe->HeaderFill += HeaderBytes;
+		pData += HeaderBytes;
+		Length -= HeaderBytes;
+
+		if(APPSTORAGE_LZ_HEADER_SIZE == pMe->HeaderFill)
+		{
+			status = AppStorage_InflateDetect(pMe);
+		}
+	}
+
+	if((0 == Length) || (eFS_SUCCESS != status))
+	{
+		return status;
+	}
+
+	switch(pMe->State)
+	{
+		case eINFLATE_PASSTHROUGH:
+			status = AppStorage_SinkWrite(pData, Length);
+			break;
+
+		case eINFLATE_DECODE:
+			status = AppStorage_InflateDecode(pMe, pData, Length);
+			break;
+
+		case eINFLATE_DETECT:
+		case eINFLATE_ERROR:
+		default:
+			status = eFS_ERROR;
+			break;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Flush decompression stage at end of image and check the decompressed
+ * image is complete. Digest is checked by the caller once it is final.
+ *
+ * @param pMe decompression stage
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t AppStorage_InflateFinish(sAppStorageInflate_t* const pMe)
+{
+	assert(NULL != pMe);
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+
+	switch(pMe->State)
+	{
+		case eINFLATE_DETECT:
+			/* Image shorter than a container header */
+			status = AppStorage_InflateDetect(pMe);
+			break;
+
+		case eINFLATE_DECODE:
+			if(pMe->Produced != pMe->OriginalSize)
+			{
+				Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Compressed image ended after %lu of %lu bytes", (unsigned long)pMe->Produced, (unsigned long)pMe->OriginalSize);
+				status = eFS_ERROR;
+			}
+			else
+			{
+				Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Decompressed %lu bytes into %lu bytes", (unsigned long)pMe->Consumed, (unsigned long)pMe->Produced);
+			}
+			break;
+
+		case eINFLATE_ERROR:
+			status = eFS_ERROR;
+			break;
+
+		case eINFLATE_PASSTHROUGH:
+		default:
+			break;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Erase flash for a golden image of known size, ahead of @ref AppStorage_OpenGoldenImage
+ *
+ * @note Covers the size the sender announced, inflated output past it erases as it is allocated
+ *
+ * @param ImageSize size of image in bytes
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_PrepareGoldenImage(uint32_t ImageSize)
+{
+	return gpGoldenImageSink->pfPrepare(ImageSize);
+}
+
+/**
+ * @brief Open Golden Image in flash of active profile, a new digest is started
+ *
+ * @note Compressed images are recognised by their container header, see @ref APPSTORAGE_LZ_MAGIC
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_OpenGoldenImage()
+{
+	sAppStorageImageDigest_t* pDigest = AppStorage_GetImageDigestInstance();
+
+	pDigest->IsValid = false;
+	Digest_Init(&pDigest->Context, eDIGEST_CRC32_HW);
+
+	AppStorage_InflateInit(AppStorage_GetInflateInstance());
+
+	eStorageFSStatus_t status = gpGoldenImageSink->pfOpen();
+
+	pDigest->IsImageOpen = (eFS_SUCCESS == status);
+
+	return status;
+}
+
+/**
+ * @brief Write to Golden Image in flash of active profile
+ *
+ * @note @ref AppStorage_OpenGoldenImage must be invoked prior to using this function
+ *
+ * @param pInWriteBuf Contents to be written are passed here
+ * @param bufSize write buffer size
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_WriteToGoldenImage(const char* const pInWriteBuf, size_t bufSize)
+{
+	return AppStorage_InflateWrite(AppStorage_GetInflateInstance(), (const uint8_t*)pInWriteBuf, bufSize);
+}
+
+/**
+ * @brief Close Golden Image in flash of active profile, digest of image is final from here on
+ *
+ * @note A compressed image fails to close if its decompressed digest does not
+ * match the one in its container header
+ *
+ * @return eStorageFSStatus_t error if no image was opened by @ref AppStorage_OpenGoldenImage
+ */
+eStorageFSStatus_t AppStorage_CloseGoldenImage()
+{
+	sAppStorageImageDigest_t* pDigest = AppStorage_GetImageDigestInstance();
+	sAppStorageInflate_t* pInflate = AppStorage_GetInflateInstance();
+
+	/* Contexts left from an earlier image must not be finished for this one */
+	if(false == pDigest->IsImageOpen)
+	{
+		return eFS_ERROR;
+	}
+
+	pDigest->IsImageOpen = false;
+
+	eStorageFSStatus_t status = AppStorage_InflateFinish(pInflate);
+
+	pDigest->Length = pDigest->Context.ByteCount;
+	pDigest->IsValid = Digest_Final(&pDigest->Context, &pDigest->Value);
+
+	if((eINFLATE_DECODE == pInflate->State) && (eFS_SUCCESS == status) &&
+		((false == pDigest->IsValid) || (pDigest->Value != pInflate->ExpectedDigest)))
+	{
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Decompressed image digest %08lX, expected %08lX", (unsigned long)pDigest->Value, (unsigned long)pInflate->ExpectedDigest);
+		status = eFS_ERROR;
+	}
+
+	status |= gpGoldenImageSink->pfClose();
+
+	return status;
+}
+
+/**
+ * @brief Delete Golden Image in flash of active profile, its digest goes with it
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_DeleteGoldenImage()
+{
+	AppStorage_GetImageDigestInstance()->IsValid = false;
+
+	return gpGoldenImageSink->pfDelete();
+}
+
+/**
+ * @brief Get digest of last golden image written
+ *
+ * @param pOutDigest digest is saved here
+ * @param pOutLength number of bytes covered by digest is saved here
+ * @return true if digest covers the whole image
+ */
+bool AppStorage_GetGoldenImageDigest(uint32_t* const pOutDigest, uint32_t* const pOutLength)
+{
+	assert(NULL != pOutDigest);
+	assert(NULL != pOutLength);
+
+	sAppStorageImageDigest_t* pDigest = AppStorage_GetImageDigestInstance();
+
+	*pOutDigest = pDigest->Value;
+	*pOutLength = pDigest->Length;
+
+	return pDigest->IsValid;
+}
+
+/**
+ * @brief Print digest of last golden image written
+ *
+ */
+void AppStorage_PrintGoldenImageDigest()
+{
+	sAppStorageImageDigest_t* pDigest = AppStorage_GetImageDigestInstance();
+
+	if(true == pDigest->IsValid)
+	{
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Golden Image %s: %08lX over %lu bytes", Digest_GetName(&pDigest->Context), (unsigned long)pDigest->Value, (unsigned long)pDigest->Length);
+	}
+}
+
+/**
+ * @brief Files other than golden image need a file system, raw partition profiles hold the golden image only
+ *
+ * @return true if active profile keeps a file system in flash
+ */
+static bool AppStorage_IsNamedFileSupported()
+{
+	return (eSTORAGE_MODE_LFS == AppConfiguration_GetActiveProfile()->StorageMode);
+}
+
+/**
+ * @brief Erase flash for a named file of known size, ahead of @ref AppStorage_OpenNamedFile
+ *
+ * @param Size file size in bytes
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_PrepareNamedFile(uint32_t Size)
+{
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	if(true == AppStorage_IsNamedFileSupported())
+	{
+		status = FlashFs_API_PrepareNamedFile(Size);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Create or truncate a file next to golden image, used for files that accompany the image
+ *
+ * @param pName file name
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_OpenNamedFile(const char* const pName)
+{
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	if(true == AppStorage_IsNamedFileSupported())
+	{
+		status = FlashFs_API_OpenNamedFile(pName);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Write to file opened by @ref AppStorage_OpenNamedFile
+ *
+ * @param pInWriteBuf Contents to be written are passed here
+ * @param bufSize write buffer size
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_WriteToNamedFile(const char* const pInWriteBuf, size_t bufSize)
+{
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	if(true == AppStorage_IsNamedFileSupported())
+	{
+		status = FlashFs_API_WriteToNamedFile(pInWriteBuf, bufSize);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Close file opened by @ref AppStorage_OpenNamedFile
+ *
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_CloseNamedFile()
+{
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	if(true == AppStorage_IsNamedFileSupported())
+	{
+		status = FlashFs_API_CloseNamedFile();
+	}
+
+	return status;
+}
+
+/**
+ * @brief Delete a file next to golden image
+ *
+ * @param pName file name
+ * @return eStorageFSStatus_t
+ */
+eStorageFSStatus_t AppStorage_DeleteNamedFile(const char* const pName)
+{
+	eStorageFSStatus_t status = eFS_ERROR;
+
+	if(true == AppStorage_IsNamedFileSupported())
+	{
+		status = FlashFs_API_DeleteNamedFile(pName);
+	}
+
+	return status;
+}
+
 /**
  * @brief Get current transfer mode setting
  *
@@ -73,54 +623,186 @@ eTransferMode_t AppStorage_GetCurrentTransferMode()
 }
 
 
+/**
+ * @brief Get SD to flash pipeline instance
+ *
+ * @return sAppStoragePipeline_t*
+ */
+static sAppStoragePipeline_t* AppStorage_GetPipelineInstance()
+{
+	return &gPipeline;
+}
+
+/**
+ * @brief Split the RAM buffer into pipeline slots and reset the pipeline state
+ *
+ * @param pMe pipeline instance
+ * @param fileSize size of the file to be transferred
+ */
+static void AppStorage_PipelineInit(sAppStoragePipeline_t* const pMe, uint32_t fileSize)
+{
+	assert(NULL != pMe);
+
+	/* Keep slot boundaries on SD sector multiples so FatFs reads straight into the slot */
+	pMe->SlotSize = ((sizeof(gRamBuf) / APPSTORAGE_PIPELINE_SLOT_COUNT) / APPSTORAGE_PIPELINE_READ_CHUNK) * APPSTORAGE_PIPELINE_READ_CHUNK;
+
+	for(uint8_t slot = 0; slot < APPSTORAGE_PIPELINE_SLOT_COUNT; slot++)
+	{
+		pMe->Slots[slot].pBuf = &gRamBuf[slot * pMe->SlotSize];
+		pMe->Slots[slot].FillLevel = 0;
+		pMe->Slots[slot].State = eSLOT_FREE;
+	}
+
+	pMe->BytesRemainingToRead = fileSize;
+	pMe->ProducerIndex = 0;
+	pMe->ConsumerIndex = 0;
+	pMe->ProducerStatus = eFS_SUCCESS;
+}
+
+/**
+ * @brief Read one chunk from SD into the current producer slot
+ *
+ * @param pMe pipeline instance
+ * @return true if a chunk was read, false if there was nothing to do
+ */
+static bool AppStorage_PipelineProduce(sAppStoragePipeline_t* const pMe)
+{
+	assert(NULL != pMe);
+
+	sAppStoragePipelineSlot_t* pSlot = &pMe->Slots[pMe->ProducerIndex];
+
+	if((0 == pMe->BytesRemainingToRead) || (eFS_SUCCESS != pMe->ProducerStatus) || (eSLOT_FULL == pSlot->State))
+	{
+		return false;
+	}
+
+	if(eSLOT_FREE == pSlot->State)
+	{
+		pSlot->FillLevel = 0;
+		pSlot->State = eSLOT_FILLING;
+	}
+
+	uint32_t bytesToRead = pMe->SlotSize - pSlot->FillLevel;
+
+	if(bytesToRead > APPSTORAGE_PIPELINE_READ_CHUNK)
+	{
+		bytesToRead = APPSTORAGE_PIPELINE_READ_CHUNK;
+	}
+
+	if(bytesToRead > pMe->BytesRemainingToRead)
+	{
+		bytesToRead = pMe->BytesRemainingToRead;
+	}
+
+	uint32_t bytesRead = 0;
+	AppProfiler_ScopeBegin(eAPPPROFILER_SCOPE_SD_READ);
+	pMe->ProducerStatus |= SDFs_API_ReadGoldenImageFile((char* const)&pSlot->pBuf[pSlot->FillLevel], bytesToRead, &bytesRead);
+	AppProfiler_ScopeEnd(eAPPPROFILER_SCOPE_SD_READ);
+
+	if(bytesRead != bytesToRead)
+	{
+		pMe->ProducerStatus |= eFS_ERROR;
+	}
+
+	pSlot->FillLevel += bytesRead;
+	pMe->BytesRemainingToRead -= bytesRead;
+
+	if((pSlot->FillLevel == pMe->SlotSize) || (0 == pMe->BytesRemainingToRead) || (eFS_SUCCESS != pMe->ProducerStatus))
+	{
+		pSlot->State = eSLOT_FULL;
+		pMe->ProducerIndex = (pMe->ProducerIndex + 1) % APPSTORAGE_PIPELINE_SLOT_COUNT;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Flash busy hook, keeps SPI1 reading the next slot while SPI2 programs
+ *
+ * @return true if a chunk was read
+ */
+static bool AppStorage_PipelineBusyHook(void)
+{
+	return AppStorage_PipelineProduce(AppStorage_GetPipelineInstance());
+}
+
 /**
  * @brief Transfer Golden Image from SD card to flash
  *
+ * @note SD reads are pipelined with flash programming. While the flash is busy
+ * programming or erasing one slot, the W25Qxx busy hook reads the next slot from SD.
+ *
  * @return eAppStorageStatus_t
  */
 eStorageFSStatus_t AppStorage_TransferGoldenImageFileFromSDToFlash()
 {
 	eStorageFSStatus_t fatFSStatus = SDFs_API_OpenGoldenImageFile();
 
-	eStorageFSStatus_t lFSStatus = FlashFs_API_OpenGoldenImageFile();
+	uint32_t goldenImageSizeInSDCard = 0;
+	fatFSStatus |= SDFs_API_GetGoldenImageFileSize(&goldenImageSizeInSDCard);
 
-	if((eFS_SUCCESS == fatFSStatus) && (eFS_SUCCESS == lFSStatus))
+	eStorageFSStatus_t lFSStatus = eFS_ERROR;
+
+	if(eFS_SUCCESS == fatFSStatus)
 	{
-		uint32_t goldenImageSizeInSDCard = 0;
-		fatFSStatus |= SDFs_API_GetGoldenImageFileSize(&goldenImageSizeInSDCard);
+		lFSStatus = gpGoldenImageSink->pfPrepare(goldenImageSizeInSDCard);
+	}
 
-		uint32_t fileSizeRemaining = goldenImageSizeInSDCard;
-		bool IsFileTransferComplete = false;
+	if(eFS_SUCCESS == lFSStatus)
+	{
+		lFSStatus = AppStorage_OpenGoldenImage();
+	}
 
-		do
-		{
-			memset(gRamBuf, 0x00, sizeof(gRamBuf));
-			uint32_t bytesRead = 0;
+	if((eFS_SUCCESS == fatFSStatus) && (eFS_SUCCESS == lFSStatus))
+	{
+		sAppStoragePipeline_t* pMe = AppStorage_GetPipelineInstance();
 
-			fatFSStatus |= SDFs_API_ReadGoldenImageFile((char* const)gRamBuf, sizeof(gRamBuf), &bytesRead);
+		AppStorage_PipelineInit(pMe, goldenImageSizeInSDCard);
 
-			lFSStatus |= FlashFs_API_WriteToGoldenImageFile((const char* const)gRamBuf, bytesRead);
+		W25qxx_RegisterBusyHook(AppStorage_PipelineBusyHook);
 
-			if(fileSizeRemaining < sizeof(gRamBuf))
+		while((eFS_SUCCESS == fatFSStatus) && (eFS_SUCCESS == lFSStatus))
+		{
+			sAppStoragePipelineSlot_t* pSlot = &pMe->Slots[pMe->ConsumerIndex];
+
+			/* Fill the slot directly if the flash did not leave enough busy time to do it */
+			while((eSLOT_FULL != pSlot->State) && (true == AppStorage_PipelineProduce(pMe)))
 			{
-				IsFileTransferComplete = true;
 			}
-			else
+
+			fatFSStatus |= pMe->ProducerStatus;
+
+			if((eFS_SUCCESS != fatFSStatus) || (eSLOT_FULL != pSlot->State))
 			{
-				fileSizeRemaining -= sizeof(gRamBuf);
+				break;
 			}
 
+			lFSStatus |= AppStorage_WriteToGoldenImage((const char* const)pSlot->pBuf, pSlot->FillLevel);
+
+			pSlot->State = eSLOT_FREE;
+			pMe->ConsumerIndex = (pMe->ConsumerIndex + 1) % APPSTORAGE_PIPELINE_SLOT_COUNT;
+
 			Console_PrintProgressBar();
+			Console_Sync();		/**< Status queries are answered while the job runs*/
+		}
 
-		}while(false == IsFileTransferComplete);
+		W25qxx_RegisterBusyHook(NULL);
 
 		SDFs_API_CloseGoldenImageFile();
-		FlashFs_API_CloseGoldenImageFile();
+		lFSStatus |= AppStorage_CloseGoldenImage();
+
+		/* Read back is tracked by the raw sink, a LittleFS profile leaves its state untouched */
+		uint32_t verifyFailAddress = 0;
+		if((&gcGoldenImageSinkTable[eSTORAGE_MODE_RAW] == gpGoldenImageSink) &&
+			(true == FlashRaw_API_GetVerifyFailAddress(&verifyFailAddress)))
+		{
+			Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Flash read back mismatch at address %08lX", (unsigned long)verifyFailAddress);
+		}
 	}
 	else
 	{
 		SDFs_API_CloseGoldenImageFile();
-		FlashFs_API_CloseGoldenImageFile();
+		(void)AppStorage_CloseGoldenImage();	/**< Only closes what was opened, an image that failed to open is left alone*/
 	}
 
 	eStorageFSStatus_t status = (fatFSStatus | lFSStatus) ;
@@ -128,9 +810,31 @@ eStorageFSStatus_t AppStorage_TransferGoldenImageFileFromSDToFlash()
 	return status;
 }
 
+/**
+ * @brief Check if source and flash copies still need to be compared after transfer
+ *
+ * @note When the active sink verifies each write against the source in RAM,
+ * a successful transfer already proves the flash copy matches what was read
+ *
+ * @return true if @ref AppStorage_CompareCRCOfGoldenImageFileInSDAndFlash must be run
+ */
+bool AppStorage_IsPostTransferCRCCheckNeeded()
+{
+#if defined(FORCE_DISABLE_FILE_CRC_CHECK)
+	return false;
+#elif defined(FORCE_ENABLE_FULL_FILE_CRC_CHECK)
+	return true;
+#else
+	return (false == gpGoldenImageSink->IsWriteVerified);
+#endif
+}
+
 /**
  * @brief Compute and compare CRC of golden Image file stored in CRC and Flash
  *
+ * @note Source side CRC is the digest accumulated while the image streamed in,
+ * after decompression, the SD card is only re-read if that digest is not available
+ *
  * @param pOutIsCRCMatching Set to true if CRC matches, False otherwise.
  * @return eAppStorageStatus_t
  */
@@ -143,13 +847,19 @@ eStorageFSStatus_t AppStorage_CompareCRCOfGoldenImageFileInSDAndFlash(bool* cons
 	uint32_t SDGoldenImageCRC = 0;
 	uint32_t FlashGoldenImageCRC = 0;
 
-	eStorageFSStatus_t SDFSStatus = SDFs_API_ComputeGoldenImageFileCRC(gRamBuf, sizeof(gRamBuf), &SDGoldenImageCRC);
+	uint32_t goldenImageLength = 0;
+	eStorageFSStatus_t SDFSStatus = eFS_SUCCESS;
+
+	if(false == AppStorage_GetGoldenImageDigest(&SDGoldenImageCRC, &goldenImageLength))
+	{
+		SDFSStatus = SDFs_API_ComputeGoldenImageFileCRC(gRamBuf, sizeof(gRamBuf), &SDGoldenImageCRC);
+	}
 
-	eStorageFSStatus_t lFSStatus = FlashFs_API_ComputeGoldenImageFileCRC(gRamBuf, sizeof(gRamBuf), &FlashGoldenImageCRC);
+	eStorageFSStatus_t lFSStatus = gpGoldenImageSink->pfComputeCRC(gRamBuf, sizeof(gRamBuf), &FlashGoldenImageCRC);
 
 	if((eFS_SUCCESS == SDFSStatus) && (eFS_SUCCESS == lFSStatus))
 	{
-		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> CRC of Golden Image file in SD : %X | Flash : %X", SDGoldenImageCRC, FlashGoldenImageCRC );
+		Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> CRC of Golden Image file in Source : %08lX | Flash : %08lX", (unsigned long)SDGoldenImageCRC, (unsigned long)FlashGoldenImageCRC );
 
 		if(SDGoldenImageCRC == FlashGoldenImageCRC)
 		{
@@ -16,7 +16,11 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "AppStorageDataStructures.h"
+#include "Digest.h"
+#include "Lzss.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -26,6 +30,24 @@
 #define TRANSFER_MODE_PORT	(TRANSFER_MODE_GPIO_Port)			/**< Port of GPIO that determines the transfer mode of operation*/
 #define TRANSFE_MODE_PIN	(TRANSFER_MODE_Pin)					/**< Pin of GPIO that determines the transfer mode of operation*/
 
+#define APPSTORAGE_PIPELINE_SLOT_COUNT	(2u)		/**< Number of RAM slots the SD to flash copy pipeline rotates through */
+#define APPSTORAGE_PIPELINE_READ_CHUNK	(512u)		/**< Bytes read from SD per producer step, sized to roughly match one page program time */
+
+/* Compressed golden image container, multi byte fields are little endian
+ * Bytes 0-3:   Magic "FLZ1"
+ * Byte  4:     LZSS window bits
+ * Byte  5:     LZSS lookahead bits
+ * Bytes 6-7:   Reserved, zero
+ * Bytes 8-11:  Size of decompressed image
+ * Bytes 12-15: CRC-32/MPEG-2 of decompressed image, zero padded to a word multiple
+ * Bytes 16-:   LZSS stream, see @ref Lzss.h
+ * Images without the magic are written as they are.
+ */
+#define APPSTORAGE_LZ_MAGIC				"FLZ1"
+#define APPSTORAGE_LZ_MAGIC_SIZE		(4u)
+#define APPSTORAGE_LZ_HEADER_SIZE		(16u)
+#define APPSTORAGE_LZ_OUT_CHUNK			(256u)		/**< Decompressed bytes handed to the sink per write, one flash page */
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -39,11 +61,121 @@ typedef enum
 	eTX_MODE_MAX
 }eTransferMode_t;
 
+/**
+ * @brief Golden image destination in external flash. One sink exists per
+ * storage mode, the active one is picked from the programming profile.
+ *
+ */
+typedef struct
+{
+	eStorageFSStatus_t (*pfPrepare)(uint32_t ImageSize);		/**< Called once before open when the image size is known up front */
+	eStorageFSStatus_t (*pfOpen)(void);
+	eStorageFSStatus_t (*pfWrite)(const char* const pInWriteBuf, size_t bufSize);
+	eStorageFSStatus_t (*pfClose)(void);
+	eStorageFSStatus_t (*pfDelete)(void);
+	eStorageFSStatus_t (*pfComputeCRC)(uint8_t* const pInOutRamBuf, uint32_t RamBufSize, uint32_t* const pOutCRC);
+	bool IsWriteVerified;		/**< Every write is read back from flash and compared against the source before it succeeds */
+}sAppStorageGoldenImageSink_t;
+
+/**
+ * @brief Digest of golden image accumulated while it streams into flash
+ *
+ */
+typedef struct
+{
+	sDigestContext_t Context;					/**< Running digest, fed as data goes to the sink, after decompression */
+	uint32_t Value;								/**< Final digest, valid once image is closed */
+	uint32_t Length;							/**< Bytes covered by digest */
+	bool IsValid;
+	bool IsImageOpen;							/**< Digest and decompression stage were started for the image being written */
+}sAppStorageImageDigest_t;
+
+/**
+ * @brief States of the golden image decompression stage
+ *
+ */
+typedef enum
+{
+	eINFLATE_DETECT,			/**< Collecting the first bytes to look for the container header */
+	eINFLATE_PASSTHROUGH,		/**< Image is not compressed, bytes go to the sink as they are */
+	eINFLATE_DECODE,			/**< Image is compressed, bytes are decoded before they go to the sink */
+	eINFLATE_ERROR,				/**< Container header was refused, every further write fails */
+}eAppStorageInflateState_t;
+
+/**
+ * @brief Decompression stage between image source and sink, RAM use is bounded
+ * by the LZSS window and one output chunk
+ *
+ */
+typedef struct
+{
+	eAppStorageInflateState_t State;
+	uint8_t Header[APPSTORAGE_LZ_HEADER_SIZE];		/**< First bytes of image, held back until the format is known */
+	uint32_t HeaderFill;
+	uint32_t OriginalSize;							/**< Decompressed size from the container header */
+	uint32_t ExpectedDigest;						/**< Decompressed digest from the container header */
+	uint32_t Produced;								/**< Decompressed bytes handed to the sink */
+	uint32_t Consumed;								/**< Compressed bytes taken from the source, header excluded */
+	sLzssDecoder_t Decoder;
+	__attribute__ ((aligned (4))) uint8_t OutBuf[APPSTORAGE_LZ_OUT_CHUNK];
+}sAppStorageInflate_t;
+
+/**
+ * @brief States of a SD to flash pipeline slot
+ *
+ */
+typedef enum
+{
+	eSLOT_FREE,				/**< Slot holds no data, producer may claim it */
+	eSLOT_FILLING,			/**< Producer is reading SD data into the slot */
+	eSLOT_FULL,				/**< Slot holds data waiting to be written to flash */
+}eAppStoragePipelineSlotState_t;
+
+/**
+ * @brief Single RAM slot of the SD to flash pipeline
+ *
+ */
+typedef struct
+{
+	uint8_t* pBuf;									/**< Start of slot inside the shared RAM buffer */
+	uint32_t FillLevel;								/**< Bytes of valid data in slot */
+	eAppStoragePipelineSlotState_t State;			/**< Slot ownership */
+}sAppStoragePipelineSlot_t;
+
+/**
+ * @brief SD to flash copy pipeline. SD reads (producer) run from the flash
+ * busy hook while the consumer programs the previous slot.
+ *
+ */
+typedef struct
+{
+	sAppStoragePipelineSlot_t Slots[APPSTORAGE_PIPELINE_SLOT_COUNT];
+	uint32_t SlotSize;								/**< Size of each slot in bytes */
+	uint32_t BytesRemainingToRead;					/**< Bytes of source file not yet read */
+	uint8_t ProducerIndex;							/**< Slot being filled from SD */
+	uint8_t ConsumerIndex;							/**< Slot being written to flash */
+	eStorageFSStatus_t ProducerStatus;				/**< Accumulated SD read status */
+}sAppStoragePipeline_t;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void AppStorage_SetPower(bool IsEnable);
+eStorageFSStatus_t AppStorage_FlashInit();
+eStorageFSStatus_t AppStorage_PrepareGoldenImage(uint32_t ImageSize);
+eStorageFSStatus_t AppStorage_OpenGoldenImage();
+eStorageFSStatus_t AppStorage_WriteToGoldenImage(const char* const pInWriteBuf, size_t bufSize);
+eStorageFSStatus_t AppStorage_CloseGoldenImage();
+eStorageFSStatus_t AppStorage_DeleteGoldenImage();
+bool AppStorage_GetGoldenImageDigest(uint32_t* const pOutDigest, uint32_t* const pOutLength);
+void AppStorage_PrintGoldenImageDigest();
+eStorageFSStatus_t AppStorage_PrepareNamedFile(uint32_t Size);
+eStorageFSStatus_t AppStorage_OpenNamedFile(const char* const pName);
+eStorageFSStatus_t AppStorage_WriteToNamedFile(const char* const pInWriteBuf, size_t bufSize);
+eStorageFSStatus_t AppStorage_CloseNamedFile();
+eStorageFSStatus_t AppStorage_DeleteNamedFile(const char* const pName);
 eStorageFSStatus_t AppStorage_TransferGoldenImageFileFromSDToFlash();
 eStorageFSStatus_t AppStorage_CompareCRCOfGoldenImageFileInSDAndFlash(bool* const pOutIsCRCMatching);
+bool AppStorage_IsPostTransferCRCCheckNeeded();
 eTransferMode_t AppStorage_GetCurrentTransferMode();
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,550 @@
+/**
+ * @file FrameLink.c
+ * @author Vishal Keshava Murthy
+ * @brief Framed serial transfer of golden image, see @ref FrameLink.h for the frame layout
+ * @version 0.1
+ * @date 2024-06-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+
+#include "FrameLink.h"
+#include "Console.h"
+#include "AppStorage.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define FRAMELINK_CRC32_INIT		(0xFFFFFFFFu)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief CRC-32 (reflected polynomial 0xEDB88320) of every nibble value
+ */
+static const uint32_t gcFrameLinkCrc32NibbleTable[16] =
+{
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static sFrameLink_t gFrameLink;		/**< Frame link session instance */
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get frame link instance
+ *
+ * @return sFrameLink_t*
+ */
+static sFrameLink_t* FrameLink_GetInstance()
+{
+	return &gFrameLink;
+}
+
+/**
+ * @brief Read little endian word
+ *
+ * @param pBuf 4 bytes
+ * @return uint32_t
+ */
+static uint32_t FrameLink_GetU32(const uint8_t* pBuf)
+{
+	return ((uint32_t)pBuf[0]) | ((uint32_t)pBuf[1] << 8u) | ((uint32_t)pBuf[2] << 16u) | ((uint32_t)pBuf[3] << 24u);
+}
+
+/**
+ * @brief Write little endian word
+ *
+ * @param pBuf 4 bytes
+ * @param Value word to be written
+ */
+static void FrameLink_PutU32(uint8_t* pBuf, uint32_t Value)
+{
+	pBuf[0] = (uint8_t)(Value);
+	pBuf[1] = (uint8_t)(Value >> 8u);
+	pBuf[2] = (uint8_t)(Value >> 16u);
+	pBuf[3] = (uint8_t)(Value >> 24u);
+}
+
+/**
+ * @brief Continue CRC-32 over a run of bytes, start from @ref FRAMELINK_CRC32_INIT and invert the result
+ *
+ * @param Crc running value
+ * @param pData bytes
+ * @param Length number of bytes
+ * @return uint32_t running value
+ */
+static uint32_t FrameLink_Crc32Update(uint32_t Crc, const uint8_t* pData, uint32_t Length)
+{
+	while(Length > 0)
+	{
+		Crc ^= *pData++;
+		Crc = (Crc >> 4u) ^ gcFrameLinkCrc32NibbleTable[Crc & 0x0Fu];
+		Crc = (Crc >> 4u) ^ gcFrameLinkCrc32NibbleTable[Crc & 0x0Fu];
+		Length--;
+	}
+
+	return Crc;
+}
+
+/**
+ * @brief COBS encode a frame, delimiter is not appended
+ *
+ * @param pIn frame
+ * @param Length frame length
+ * @param pOut encoded frame, at least Length + Length / 254 + 1 bytes
+ * @return uint16_t encoded length
+ */
+static uint16_t FrameLink_CobsEncode(const uint8_t* pIn, uint16_t Length, uint8_t* pOut)
+{
+	uint16_t CodeIndex = 0;
+	uint16_t OutIndex = 1;
+	uint8_t Code = 1;
+
+	for(uint16_t i = 0; i < Length; i++)
+	{
+		if(FRAMELINK_DELIMITER != pIn[i])
+		{
+			pOut[OutIndex++] = pIn[i];
+			Code++;
+		}
+
+		if((FRAMELINK_DELIMITER == pIn[i]) || (0xFFu == Code))
+		{
+			pOut[CodeIndex] = Code;
+			CodeIndex = OutIndex++;
+			Code = 1;
+		}
+	}
+
+	pOut[CodeIndex] = Code;
+
+	return OutIndex;
+}
+
+/**
+ * @brief COBS decode a frame, delimiter excluded
+ *
+ * @param pIn encoded frame
+ * @param Length encoded length
+ * @param pOut decoded frame
+ * @param OutSize size of pOut
+ * @return uint16_t decoded length, 0 if the frame is malformed or too long
+ */
+static uint16_t FrameLink_CobsDecode(const uint8_t* pIn, uint16_t Length, uint8_t* pOut, uint16_t OutSize)
+{
+	uint16_t InIndex = 0;
+	uint16_t OutIndex = 0;
+
+	while(InIndex < Length)
+	{
+		uint8_t Code = pIn[InIndex++];
+
+		if((0 == Code) || ((InIndex + Code - 1u) > Length))
+		{
+			return 0;
+		}
+
+		for(uint8_t i = 1; i < Code; i++)
+		{
+			if(OutIndex >= OutSize)
+			{
+				return 0;
+			}
+			pOut[OutIndex++] = pIn[InIndex++];
+		}
+
+		/* A group shorter than 255 stands for a zero, except at the end of the frame */
+		if((0xFFu != Code) && (InIndex < Length))
+		{
+			if(OutIndex >= OutSize)
+			{
+				return 0;
+			}
+			pOut[OutIndex++] = 0;
+		}
+	}
+
+	return OutIndex;
+}
+
+/**
+ * @brief UART receive hook, runs in interrupt context. Splits the byte stream
+ * at delimiters, each frame in its own slot. Frames arriving while every slot
+ * is full are dropped, the host retransmits them.
+ *
+ * @param data received byte
+ */
+static void FrameLink_cbByteReceived(uint8_t data)
+{
+	sFrameLink_t* pMe = FrameLink_GetInstance();
+	sFrameLinkRxSlot_t* pSlot = &pMe->RxSlots[pMe->RxWriteIndex];
+
+	/* A slot freed halfway through a dropped frame must not take its tail as a frame of its own */
+	if((true == pSlot->IsComplete) || (true == pMe->IsRxDiscarding))
+	{
+		pMe->IsRxDiscarding = (FRAMELINK_DELIMITER != data);
+		if(FRAMELINK_DELIMITER == data)
+		{
+			pMe->DroppedFrames++;
+		}
+		return;
+	}
+
+	if(FRAMELINK_DELIMITER == data)
+	{
+		if(true == pSlot->IsOversize)
+		{
+			pSlot->IsOversize = false;
+			pSlot->Length = 0;
+		}
+		else if(pSlot->Length > 0)
+		{
+			pSlot->IsComplete = true;
+			pMe->RxWriteIndex = (pMe->RxWriteIndex + 1u) % FRAMELINK_RX_SLOT_COUNT;
+		}
+		return;
+	}
+
+	if(pSlot->Length < FRAMELINK_ENCODED_MAX)
+	{
+		pSlot->Buf[pSlot->Length++] = data;
+	}
+	else
+	{
+		pSlot->IsOversize = true;
+	}
+}
+
+/**
+ * @brief Decode next complete frame into @ref sFrameLink_t::Frame and give its slot back
+ *
+ * @param pMe frame link instance
+ * @param pOutLength decoded length, 0 if the frame failed COBS or CRC check
+ * @return true if a frame was taken from the ring
+ */
+static bool FrameLink_TakeFrame(sFrameLink_t* const pMe, uint16_t* const pOutLength)
+{
+	assert(NULL != pMe);
+	assert(NULL != pOutLength);
+
+	sFrameLinkRxSlot_t* pSlot = &pMe->RxSlots[pMe->RxReadIndex];
+
+	if(false == pSlot->IsComplete)
+	{
+		return false;
+	}
+
+	uint16_t Length = FrameLink_CobsDecode(pSlot->Buf, pSlot->Length, pMe->Frame, sizeof(pMe->Frame));
+
+	pSlot->Length = 0;
+	pSlot->IsComplete = false;
+	pMe->RxReadIndex = (pMe->RxReadIndex + 1u) % FRAMELINK_RX_SLOT_COUNT;
+
+	if(Length < (FRAMELINK_HEADER_SIZE + FRAMELINK_CRC_SIZE))
+	{
+		Length = 0;
+	}
+	else
+	{
+		uint16_t CrcIndex = Length - FRAMELINK_CRC_SIZE;
+		uint32_t Crc = ~FrameLink_Crc32Update(FRAMELINK_CRC32_INIT, pMe->Frame, CrcIndex);
+
+		if(Crc != FrameLink_GetU32(&pMe->Frame[CrcIndex]))
+		{
+			Length = 0;
+		}
+	}
+
+	*pOutLength = Length;
+
+	return true;
+}
+
+/**
+ * @brief Report session state to host
+ *
+ * @param pMe frame link instance
+ * @param Sequence sequence of the frame being answered
+ */
+static void FrameLink_SendStatus(const sFrameLink_t* const pMe, uint8_t Sequence)
+{
+	assert(NULL != pMe);
+
+	uint8_t Frame[FRAMELINK_HEADER_SIZE + FRAMELINK_STATUS_PAYLOAD_SIZE + FRAMELINK_CRC_SIZE];
+	uint8_t Encoded[sizeof(Frame) + 2u];
+	uint8_t* pPayload = &Frame[FRAMELINK_HEADER_SIZE];
+
+	Frame[0] = eFRAMELINK_RSP_STATUS;
+	Frame[1] = Sequence;
+	FrameLink_PutU32(&Frame[2], pMe->CommittedOffset);
+
+	pPayload[0] = (uint8_t)pMe->State;
+	pPayload[1] = pMe->WindowMap;
+	pPayload[2] = FRAMELINK_WINDOW_SLOTS;
+	pPayload[3] = (uint8_t)(FRAMELINK_PAYLOAD_SIZE);
+	pPayload[4] = (uint8_t)(FRAMELINK_PAYLOAD_SIZE >> 8u);
+	FrameLink_PutU32(&pPayload[5], pMe->ImageSize);
+
+	uint16_t CrcIndex = FRAMELINK_HEADER_SIZE + FRAMELINK_STATUS_PAYLOAD_SIZE;
+	FrameLink_PutU32(&Frame[CrcIndex], ~FrameLink_Crc32Update(FRAMELINK_CRC32_INIT, Frame, CrcIndex));
+
+	uint16_t Length = FrameLink_CobsEncode(Frame, sizeof(Frame), Encoded);
+	Encoded[Length++] = FRAMELINK_DELIMITER;
+
+	(void)Console_Transmit(Encoded, Length);
+}
+
+/**
+ * @brief Discard image in progress
+ *
+ * @param pMe frame link instance
+ */
+static void FrameLink_DiscardImage(sFrameLink_t* const pMe)
+{
+	assert(NULL != pMe);
+
+	if(eFRAMELINK_STATE_RECEIVING == pMe->State)
+	{
+		(void)AppStorage_CloseGoldenImage();
+		(void)AppStorage_DeleteGoldenImage();
+	}
+
+	pMe->State = eFRAMELINK_STATE_IDLE;
+	pMe->ImageSize = 0;
+	pMe->CommittedOffset = 0;
+	pMe->WindowMap = 0;
+}
+
+/**
+ * @brief Start a new image, flash for it is reserved up front
+ *
+ * @param pMe frame link instance
+ * @param ImageSize size of image in bytes
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FrameLink_StartImage(sFrameLink_t* const pMe, uint32_t ImageSize)
+{
+	assert(NULL != pMe);
+
+	FrameLink_DiscardImage(pMe);
+	(void)AppStorage_DeleteGoldenImage();
+
+	eStorageFSStatus_t status = AppStorage_PrepareGoldenImage(ImageSize);
+
+	if(eFS_SUCCESS == status)
+	{
+		status = AppStorage_OpenGoldenImage();
+	}
+
+	if(eFS_SUCCESS == status)
+	{
+		pMe->State = eFRAMELINK_STATE_RECEIVING;
+		pMe->ImageSize = ImageSize;
+		pMe->ImageCRC = FRAMELINK_CRC32_INIT;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Take a DATA frame into the window, then hand every frame that is
+ * contiguous with the committed offset to storage
+ *
+ * @note Frames behind the committed offset are repeats and frames past the
+ * window are dropped, both are answered with the current STATUS only
+ *
+ * @param pMe frame link instance
+ * @param Offset image offset of frame
+ * @param pData frame payload
+ * @param Length payload length
+ * @return eStorageFSStatus_t
+ */
+static eStorageFSStatus_t FrameLink_AcceptData(sFrameLink_t* const pMe, uint32_t Offset, const uint8_t* pData, uint16_t Length)
+{
+	assert(NULL != pMe);
+
+	uint32_t ExpectedLength = pMe->ImageSize - Offset;
+	ExpectedLength = (ExpectedLength < FRAMELINK_PAYLOAD_SIZE)? ExpectedLength: FRAMELINK_PAYLOAD_SIZE;
+
+	bool IsValid = (0 == (Offset % FRAMELINK_PAYLOAD_SIZE)) &&
+			(Offset >= pMe->CommittedOffset) &&
+			(Offset < pMe->ImageSize) &&
+			(Length == ExpectedLength);
+
+	uint32_t WindowIndex = (Offset - pMe->CommittedOffset) / FRAMELINK_PAYLOAD_SIZE;
+
+	if((false == IsValid) || (WindowIndex >= FRAMELINK_WINDOW_SLOTS))
+	{
+		return eFS_SUCCESS;
+	}
+
+	uint32_t Slot = (Offset / FRAMELINK_PAYLOAD_SIZE) % FRAMELINK_WINDOW_SLOTS;
+	memcpy(pMe->Window[Slot], pData, Length);
+	pMe->WindowLength[Slot] = Length;
+	pMe->WindowMap |= (uint8_t)(1u << WindowIndex);
+
+	eStorageFSStatus_t status = eFS_SUCCESS;
+
+	while((eFS_SUCCESS == status) && (0 != (pMe->WindowMap & 1u)))
+	{
+		Slot = (pMe->CommittedOffset / FRAMELINK_PAYLOAD_SIZE) % FRAMELINK_WINDOW_SLOTS;
+
+		status = AppStorage_WriteToGoldenImage((const char*)pMe->Window[Slot], pMe->WindowLength[Slot]);
+		if(eFS_SUCCESS == status)
+		{
+			pMe->ImageCRC = FrameLink_Crc32Update(pMe->ImageCRC, pMe->Window[Slot], pMe->WindowLength[Slot]);
+			pMe->CommittedOffset += pMe->WindowLength[Slot];
+			pMe->WindowMap >>= 1u;
+		}
+	}
+
+	return status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Receive golden image over the framed link. Runs until the image is
+ * complete, the host aborts, or the host is silent for @ref FRAMELINK_IDLE_TIMEOUT_MS.
+ *
+ * @note Link errors never discard the image. A host that lost its connection
+ * sends QUERY and continues from the committed offset in STATUS, as long as it
+ * is back before the idle time-out. The image is discarded when the session
+ * times out, a later session starts from offset 0.
+ *
+ * @return eFrameLinkStatus_t
+ */
+eFrameLinkStatus_t FrameLink_API_Receive()
+{
+	sFrameLink_t* pMe = FrameLink_GetInstance();
+
+	memset(pMe, 0, sizeof(sFrameLink_t));
+	pMe->State = eFRAMELINK_STATE_IDLE;
+
+	Console_StartRxCapture(FrameLink_cbByteReceived);
+
+	eFrameLinkStatus_t status = eFRAMELINK_TIMEOUT;
+	bool IsSessionOver = false;
+	uint32_t LastFrameTick = HAL_GetTick();
+
+	while(false == IsSessionOver)
+	{
+		uint16_t Length = 0;
+
+		if(false == FrameLink_TakeFrame(pMe, &Length))
+		{
+			IsSessionOver = ((HAL_GetTick() - LastFrameTick) > FRAMELINK_IDLE_TIMEOUT_MS);
+			continue;
+		}
+
+		LastFrameTick = HAL_GetTick();
+
+		if(0 == Length)
+		{
+			/* Corrupted frame, STATUS tells the host what is still missing */
+			pMe->BadFrames++;
+			FrameLink_SendStatus(pMe, 0);
+			continue;
+		}
+
+		uint8_t Type = pMe->Frame[0];
+		uint8_t Sequence = pMe->Frame[1];
+		uint32_t Offset = FrameLink_GetU32(&pMe->Frame[2]);
+		const uint8_t* pPayload = &pMe->Frame[FRAMELINK_HEADER_SIZE];
+		uint16_t PayloadLength = Length - FRAMELINK_HEADER_SIZE - FRAMELINK_CRC_SIZE;
+
+		switch(Type)
+		{
+			case eFRAMELINK_CMD_START:
+				if((sizeof(uint32_t) == PayloadLength) &&
+					(eFS_SUCCESS != FrameLink_StartImage(pMe, FrameLink_GetU32(pPayload))))
+				{
+					FrameLink_DiscardImage(pMe);
+					pMe->State = eFRAMELINK_STATE_ERROR;
+					status = eFRAMELINK_FLASH_ERROR;
+					IsSessionOver = true;
+				}
+				break;
+
+			case eFRAMELINK_CMD_DATA:
+				if((eFRAMELINK_STATE_RECEIVING == pMe->State) &&
+					(eFS_SUCCESS != FrameLink_AcceptData(pMe, Offset, pPayload, PayloadLength)))
+				{
+					FrameLink_DiscardImage(pMe);
+					pMe->State = eFRAMELINK_STATE_ERROR;
+					status = eFRAMELINK_FLASH_ERROR;
+					IsSessionOver = true;
+				}
+				break;
+
+			case eFRAMELINK_CMD_END:
+				if((eFRAMELINK_STATE_RECEIVING == pMe->State) &&
+					(sizeof(uint32_t) == PayloadLength) &&
+					(pMe->CommittedOffset == pMe->ImageSize))
+				{
+					bool IsCRCMatching = ((~pMe->ImageCRC) == FrameLink_GetU32(pPayload));
+					bool IsClosed = (eFS_SUCCESS == AppStorage_CloseGoldenImage());
+
+					if((true == IsCRCMatching) && (true == IsClosed))
+					{
+						pMe->State = eFRAMELINK_STATE_COMPLETE;
+						status = eFRAMELINK_SUCCESS;
+					}
+					else
+					{
+						(void)AppStorage_DeleteGoldenImage();
+						pMe->State = eFRAMELINK_STATE_ERROR;
+						status = (true == IsClosed)? eFRAMELINK_CRC_MISMATCH: eFRAMELINK_FLASH_ERROR;
+					}
+					IsSessionOver = true;
+				}
+				break;
+
+			case eFRAMELINK_CMD_ABORT:
+				FrameLink_DiscardImage(pMe);
+				status = eFRAMELINK_ABORTED;
+				IsSessionOver = true;
+				break;
+
+			case eFRAMELINK_CMD_QUERY:
+			default:
+				break;
+		}
+
+		FrameLink_SendStatus(pMe, Sequence);
+	}
+
+	if(eFRAMELINK_TIMEOUT == status)
+	{
+		FrameLink_DiscardImage(pMe);
+	}
+
+	Console_StopRxCapture();
+
+	return status;
+}
+
+/**
+ * @brief Print link statistics of last session
+ *
+ */
+void FrameLink_API_PrintStatistics()
+{
+	sFrameLink_t* pMe = FrameLink_GetInstance();
+
+	Console_Print(eCONSOLE_PRINT_LVL0, "\r\n>> Frame link: %lu bytes committed, %lu bad frames, %lu frames dropped",
+			(unsigned long)pMe->CommittedOffset, (unsigned long)pMe->BadFrames, (unsigned long)pMe->DroppedFrames);
+}
+
+///////////////////////////////////////////////////////////////////////////////
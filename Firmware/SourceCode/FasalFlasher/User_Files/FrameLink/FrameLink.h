@@ -0,0 +1,137 @@
+/**
+ * @file FrameLink.h
+ * @author Vishal Keshava Murthy
+ * @brief Framed serial transfer of golden image. COBS framed packets with a
+ * CRC32 each, a window of outstanding data frames that are retransmitted
+ * selectively, and a session that survives link drops so the host can resume
+ * from the committed offset.
+ *
+ * Resume is held in RAM by the live session only. A host that reconnects within
+ * @ref FRAMELINK_IDLE_TIMEOUT_MS continues from the committed offset. Once the
+ * session times out, or the flasher is reset or powered off, the partial image
+ * is deleted and the host starts over with START. Nothing about the transfer
+ * is kept in flash.
+ * @version 0.1
+ * @date 2024-06-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAMELINK_FRAMELINK_H_
+#define FRAMELINK_FRAMELINK_H_
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Frame, before COBS encoding. Multi byte fields are little endian.
+ * Byte  0:          Type, see @ref eFrameLinkFrameType_t
+ * Byte  1:          Sequence, echoed in the reply
+ * Bytes 2-5:        Offset, image offset of DATA, committed offset of STATUS
+ * Bytes 6-(n-5):    Payload
+ * Bytes (n-4)-(n-1): CRC-32 (ISO-HDLC, as zlib crc32) of bytes 0 to n-5
+ *
+ * Encoded frames are terminated by a 0x00 delimiter. Every frame from the host,
+ * good or not, is answered with a STATUS frame.
+ */
+
+#define FRAMELINK_PAYLOAD_SIZE			(256u)		/**< Data bytes per DATA frame, every DATA frame but the last one is full */
+#define FRAMELINK_WINDOW_SLOTS			(8u)		/**< DATA frames the host may have in flight past the committed offset, received map is a byte */
+#define FRAMELINK_HEADER_SIZE			(6u)
+#define FRAMELINK_CRC_SIZE				(4u)
+#define FRAMELINK_FRAME_MAX				(FRAMELINK_HEADER_SIZE + FRAMELINK_PAYLOAD_SIZE + FRAMELINK_CRC_SIZE)
+#define FRAMELINK_ENCODED_MAX			(FRAMELINK_FRAME_MAX + (FRAMELINK_FRAME_MAX / 254u) + 1u)	/**< COBS worst case, delimiter excluded */
+#define FRAMELINK_STATUS_PAYLOAD_SIZE	(9u)		/**< State, received map, window slots, payload size (2), image size (4) */
+#define FRAMELINK_RX_SLOT_COUNT			(3u)		/**< Encoded frames buffered between UART interrupt and receiver, a half ring of console DMA hands over two whole frames and the head of a third at once */
+#define FRAMELINK_IDLE_TIMEOUT_MS		(60000u)	/**< Session ends if the host is silent this long, it can resume any time before, the partial image is deleted after */
+#define FRAMELINK_DELIMITER				(0x00u)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Frame types
+ *
+ */
+typedef enum
+{
+	eFRAMELINK_CMD_QUERY		= 0x01,		/**< Ask for STATUS, used to resume after a link drop within the same session */
+	eFRAMELINK_CMD_START		= 0x02,		/**< Payload: image size (4). Discards any image in progress and starts a new one */
+	eFRAMELINK_CMD_DATA			= 0x03,		/**< Payload: image data at offset */
+	eFRAMELINK_CMD_END			= 0x04,		/**< Payload: CRC-32 of whole image (4). Accepted once all data is committed */
+	eFRAMELINK_CMD_ABORT		= 0x05,		/**< Discard image in progress and end session */
+	eFRAMELINK_RSP_STATUS		= 0x81,		/**< Payload: @ref FRAMELINK_STATUS_PAYLOAD_SIZE bytes */
+}eFrameLinkFrameType_t;
+
+/**
+ * @brief Session state reported in STATUS
+ *
+ */
+typedef enum
+{
+	eFRAMELINK_STATE_IDLE,			/**< No image in progress, host has to send START */
+	eFRAMELINK_STATE_RECEIVING,		/**< Image open, DATA accepted from committed offset on */
+	eFRAMELINK_STATE_COMPLETE,		/**< Image closed and CRC matched */
+	eFRAMELINK_STATE_ERROR,			/**< Image discarded after a flash or CRC error */
+}eFrameLinkState_t;
+
+/**
+ * @brief Outcome of a session
+ *
+ */
+typedef enum
+{
+	eFRAMELINK_SUCCESS,
+	eFRAMELINK_ABORTED,
+	eFRAMELINK_TIMEOUT,
+	eFRAMELINK_FLASH_ERROR,
+	eFRAMELINK_CRC_MISMATCH,
+}eFrameLinkStatus_t;
+
+/**
+ * @brief Encoded frame filled from UART interrupt
+ *
+ */
+typedef struct
+{
+	uint8_t Buf[FRAMELINK_ENCODED_MAX];
+	volatile uint16_t Length;
+	volatile bool IsOversize;			/**< Frame did not fit, dropped at its delimiter */
+	volatile bool IsComplete;			/**< Delimiter seen, the interrupt moved on to the next slot */
+}sFrameLinkRxSlot_t;
+
+/**
+ * @brief Frame link session
+ *
+ */
+typedef struct
+{
+	sFrameLinkRxSlot_t RxSlots[FRAMELINK_RX_SLOT_COUNT];
+	volatile uint8_t RxWriteIndex;					/**< Slot being filled by the UART interrupt */
+	uint8_t RxReadIndex;							/**< Slot being handled by the receiver */
+	volatile uint32_t DroppedFrames;				/**< Frames that arrived while every slot was full */
+	volatile bool IsRxDiscarding;					/**< Head of the frame arriving was dropped, the rest of it goes up to its delimiter */
+	uint8_t Frame[FRAMELINK_FRAME_MAX];				/**< Decoded frame */
+	uint8_t Window[FRAMELINK_WINDOW_SLOTS][FRAMELINK_PAYLOAD_SIZE];	/**< DATA received ahead of committed offset, slot picked by offset */
+	uint16_t WindowLength[FRAMELINK_WINDOW_SLOTS];
+	uint8_t WindowMap;								/**< Bit n set if DATA at committed offset + n frames is held */
+	eFrameLinkState_t State;
+	uint32_t ImageSize;
+	uint32_t CommittedOffset;						/**< Image bytes handed to storage, resume point of the host */
+	uint32_t ImageCRC;								/**< Running CRC-32 of committed bytes */
+	uint32_t BadFrames;								/**< Frames dropped on COBS or CRC error */
+}sFrameLink_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+eFrameLinkStatus_t FrameLink_API_Receive();
+void FrameLink_API_PrintStatistics();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* FRAMELINK_FRAMELINK_H_ */
@@ -14,15 +14,66 @@
 
 #include <string.h>
 
+#include "stm32f1xx_hal.h"
+
 #include "xmodem.h"
 #include "Console.h"
-#include "AppFlash_API.h"
+#include "AppStorage.h"
+#include "AppTrace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief CRC-16/XMODEM (polynomial 0x1021) of every byte value, one lookup per byte
+ *
+ */
+static const uint16_t gcxModemCRCTable[256] =
+{
+    0x0000u, 0x1021u, 0x2042u, 0x3063u, 0x4084u, 0x50A5u, 0x60C6u, 0x70E7u,
+    0x8108u, 0x9129u, 0xA14Au, 0xB16Bu, 0xC18Cu, 0xD1ADu, 0xE1CEu, 0xF1EFu,
+    0x1231u, 0x0210u, 0x3273u, 0x2252u, 0x52B5u, 0x4294u, 0x72F7u, 0x62D6u,
+    0x9339u, 0x8318u, 0xB37Bu, 0xA35Au, 0xD3BDu, 0xC39Cu, 0xF3FFu, 0xE3DEu,
+    0x2462u, 0x3443u, 0x0420u, 0x1401u, 0x64E6u, 0x74C7u, 0x44A4u, 0x5485u,
+    0xA56Au, 0xB54Bu, 0x8528u, 0x9509u, 0xE5EEu, 0xF5CFu, 0xC5ACu, 0xD58Du,
+    0x3653u, 0x2672u, 0x1611u, 0x0630u, 0x76D7u, 0x66F6u, 0x5695u, 0x46B4u,
+    0xB75Bu, 0xA77Au, 0x9719u, 0x8738u, 0xF7DFu, 0xE7FEu, 0xD79Du, 0xC7BCu,
+    0x48C4u, 0x58E5u, 0x6886u, 0x78A7u, 0x0840u, 0x1861u, 0x2802u, 0x3823u,
+    0xC9CCu, 0xD9EDu, 0xE98Eu, 0xF9AFu, 0x8948u, 0x9969u, 0xA90Au, 0xB92Bu,
+    0x5AF5u, 0x4AD4u, 0x7AB7u, 0x6A96u, 0x1A71u, 0x0A50u, 0x3A33u, 0x2A12u,
+    0xDBFDu, 0xCBDCu, 0xFBBFu, 0xEB9Eu, 0x9B79u, 0x8B58u, 0xBB3Bu, 0xAB1Au,
+    0x6CA6u, 0x7C87u, 0x4CE4u, 0x5CC5u, 0x2C22u, 0x3C03u, 0x0C60u, 0x1C41u,
+    0xEDAEu, 0xFD8Fu, 0xCDECu, 0xDDCDu, 0xAD2Au, 0xBD0Bu, 0x8D68u, 0x9D49u,
+    0x7E97u, 0x6EB6u, 0x5ED5u, 0x4EF4u, 0x3E13u, 0x2E32u, 0x1E51u, 0x0E70u,
+    0xFF9Fu, 0xEFBEu, 0xDFDDu, 0xCFFCu, 0xBF1Bu, 0xAF3Au, 0x9F59u, 0x8F78u,
+    0x9188u, 0x81A9u, 0xB1CAu, 0xA1EBu, 0xD10Cu, 0xC12Du, 0xF14Eu, 0xE16Fu,
+    0x1080u, 0x00A1u, 0x30C2u, 0x20E3u, 0x5004u, 0x4025u, 0x7046u, 0x6067u,
+    0x83B9u, 0x9398u, 0xA3FBu, 0xB3DAu, 0xC33Du, 0xD31Cu, 0xE37Fu, 0xF35Eu,
+    0x02B1u, 0x1290u, 0x22F3u, 0x32D2u, 0x4235u, 0x5214u, 0x6277u, 0x7256u,
+    0xB5EAu, 0xA5CBu, 0x95A8u, 0x8589u, 0xF56Eu, 0xE54Fu, 0xD52Cu, 0xC50Du,
+    0x34E2u, 0x24C3u, 0x14A0u, 0x0481u, 0x7466u, 0x6447u, 0x5424u, 0x4405u,
+    0xA7DBu, 0xB7FAu, 0x8799u, 0x97B8u, 0xE75Fu, 0xF77Eu, 0xC71Du, 0xD73Cu,
+    0x26D3u, 0x36F2u, 0x0691u, 0x16B0u, 0x6657u, 0x7676u, 0x4615u, 0x5634u,
+    0xD94Cu, 0xC96Du, 0xF90Eu, 0xE92Fu, 0x99C8u, 0x89E9u, 0xB98Au, 0xA9ABu,
+    0x5844u, 0x4865u, 0x7806u, 0x6827u, 0x18C0u, 0x08E1u, 0x3882u, 0x28A3u,
+    0xCB7Du, 0xDB5Cu, 0xEB3Fu, 0xFB1Eu, 0x8BF9u, 0x9BD8u, 0xABBBu, 0xBB9Au,
+    0x4A75u, 0x5A54u, 0x6A37u, 0x7A16u, 0x0AF1u, 0x1AD0u, 0x2AB3u, 0x3A92u,
+    0xFD2Eu, 0xED0Fu, 0xDD6Cu, 0xCD4Du, 0xBDAAu, 0xAD8Bu, 0x9DE8u, 0x8DC9u,
+    0x7C26u, 0x6C07u, 0x5C64u, 0x4C45u, 0x3CA2u, 0x2C83u, 0x1CE0u, 0x0CC1u,
+    0xEF1Fu, 0xFF3Eu, 0xCF5Du, 0xDF7Cu, 0xAF9Bu, 0xBFBAu, 0x8FD9u, 0x9FF8u,
+    0x6E17u, 0x7E36u, 0x4E55u, 0x5E74u, 0x2E93u, 0x3EB2u, 0x0ED1u, 0x1EF0u,
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 
 /* Global variables. */
 static uint8_t gxModemPacketNumber = 1u;          /**< Packet number counter. */
-static uint8_t gxModemIsFirstPacket = false;      /**< First packet or not. */
+static bool gxModemIsAwaitingStart = true;        /**< Waiting for the first packet of a file, block 0 in YMODEM. */
+static bool gxModemIsBatch = false;               /**< Host opened with a YMODEM block 0. */
+static bool gxModemIsEOTPending = false;          /**< First EOT of a YMODEM file was answered with a NAK. */
+static uint8_t gxModemFileCount = 0u;             /**< Files received completely. */
+static xmodem_mode gxModemMode = X_MODE_CRC;      /**< Protocol asked from the host. */
+static sXmodemFile_t gxModemFile;                 /**< File being received. */
+static sXmodemRx_t gxModemRx;                     /**< Frames received over UART. */
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -32,44 +83,144 @@ static uint8_t gxModemIsFirstPacket = false;      /**< First packet or not. */
  * @param   length: Size of the data, either 128 or 1024 bytes.
  * @return  status: The calculated CRC.
  */
-static uint16_t xmodem_computeCRC(uint8_t *data, uint16_t length)
+static uint16_t xmodem_computeCRC(const uint8_t *data, uint16_t length)
 {
     uint16_t crc = 0u;
     while (length)
     {
         length--;
-        crc = crc ^ ((uint16_t)*data++ << 8u);
-        for (uint8_t i = 0u; i < 8u; i++)
-        {
-            if (crc & 0x8000u)
-            {
-                crc = (crc << 1u) ^ 0x1021u;
-            }
-            else
-            {
-                crc = crc << 1u;
-            }
-        }
+        crc = (uint16_t)(crc << 8u) ^ gcxModemCRCTable[(uint8_t)(crc >> 8u) ^ *data++];
     }
     return crc;
 }
 
 /**
- * @brief   This function handles the data packet we get from the xmodem protocol.
- * @param   header: SOH or STX.
- * @return  status: Report about the packet.
+ * @brief   Length of the frame started by a header byte.
+ * @param   header: First byte of the frame.
+ * @return  Frame length in bytes, header included.
  */
-static xmodem_status xmodem_handlePacket(uint8_t header)
+static uint16_t xmodem_getFrameLength(uint8_t header)
 {
-  xmodem_status status = X_OK;
-  uint16_t size = 0u;
+  uint16_t length = X_PACKET_HEADER_SIZE;
+
+  if (X_SOH == header)
+  {
+    length += X_PACKET_NUMBER_SIZE + X_PACKET_128_SIZE + X_PACKET_CRC_SIZE;
+  }
+  else if (X_STX == header)
+  {
+    length += X_PACKET_NUMBER_SIZE + X_PACKET_1024_SIZE + X_PACKET_CRC_SIZE;
+  }
+  else
+  {
+    /* EOT, CAN or a stray byte, handled on its own. */
+  }
+
+  return length;
+}
+
+/**
+ * @brief   UART receive hook, runs in interrupt context.
+ *          Splits the byte stream into frames, each one in its own slot.
+ * @param   data: Received byte.
+ */
+static void xmodem_cbByteReceived(uint8_t data)
+{
+  sXmodemRx_t* pRx = &gxModemRx;
+  sXmodemRxSlot_t* pSlot = &pRx->Slots[pRx->WriteIndex];
+
+  pRx->LastByteTick = HAL_GetTick();
+
+  if (true == pSlot->IsComplete)
+  {
+    /* Every slot holds a frame, the sender did not wait for our reply. */
+    pRx->IsOverflow = true;
+    return;
+  }
+
+  if (0u == pSlot->Length)
+  {
+    pSlot->ExpectedLength = xmodem_getFrameLength(data);
+    AppTrace_Record(eAPPTRACE_EVENT_XMODEM_FRAME, eAPPTRACE_PHASE_BEGIN, data, pRx->WriteIndex);
+  }
+
+  pSlot->Buf[pSlot->Length] = data;
+  pSlot->Length++;
+
+  if (pSlot->Length >= pSlot->ExpectedLength)
+  {
+    AppTrace_Record(eAPPTRACE_EVENT_XMODEM_FRAME, eAPPTRACE_PHASE_END, pSlot->Length, pRx->WriteIndex);
+    pSlot->IsComplete = true;
+    pRx->WriteIndex = (pRx->WriteIndex + 1u) % X_RX_SLOT_COUNT;
+  }
+}
+
+/**
+ * @brief   Reset the frame ring and hand UART reception to it.
+ */
+static void xmodem_startReception(void)
+{
+  memset(&gxModemRx, 0, sizeof(gxModemRx));
+  Console_StartRxCapture(xmodem_cbByteReceived);
+}
+
+/**
+ * @brief   Wait for the next complete frame.
+ *          A frame that stops arriving for @ref X_RX_TIMEOUT_MS is dropped, the sender repeats it after a NAK.
+ * @return  Slot holding the frame, NULL on timeout.
+ */
+static sXmodemRxSlot_t* xmodem_waitForFrame(void)
+{
+  sXmodemRx_t* pRx = &gxModemRx;
+  sXmodemRxSlot_t* pSlot = &pRx->Slots[pRx->ReadIndex];
+  uint32_t tickStart = HAL_GetTick();
+
+  while (false == pSlot->IsComplete)
+  {
+    uint32_t lastActivityTick = (0u == pSlot->Length) ? tickStart : pRx->LastByteTick;
+
+    if ((HAL_GetTick() - lastActivityTick) > X_RX_TIMEOUT_MS)
+    {
+      bool isDropped = false;
 
-  /* 2 bytes for packet number, 1024 for data, 2 for CRC*/
-  uint8_t received_packet_number[X_PACKET_NUMBER_SIZE];
+      __disable_irq();
+      if (false == pSlot->IsComplete)
+      {
+        pSlot->Length = 0u;
+        isDropped = true;
+      }
+      __enable_irq();
 
-  uint8_t received_packet_data[X_PACKET_1024_SIZE];
+      return (true == isDropped) ? NULL : pSlot;
+    }
+  }
 
-  uint8_t received_packet_crc[X_PACKET_CRC_SIZE];
+  return pSlot;
+}
+
+/**
+ * @brief   Give a handled frame's slot back to the UART interrupt.
+ * @param   *pSlot: Slot returned by @ref xmodem_waitForFrame.
+ */
+static void xmodem_releaseFrame(sXmodemRxSlot_t* pSlot)
+{
+  pSlot->Length = 0u;
+  pSlot->IsComplete = false;
+  gxModemRx.ReadIndex = (gxModemRx.ReadIndex + 1u) % X_RX_SLOT_COUNT;
+}
+
+/**
+ * @brief   This function checks the data packet we get from the xmodem protocol.
+ *          Opening and programming the file is left to the caller, so the packet can be acknowledged first.
+ * @param   *pSlot: Slot holding an SOH or STX frame.
+ * @param   *pOutSize: Size of the data in the packet.
+ * @return  status: Report about the packet.
+ */
+static xmodem_status xmodem_handlePacket(const sXmodemRxSlot_t* pSlot, uint16_t* pOutSize)
+{
+  xmodem_status status = X_OK;
+  uint16_t size = 0u;
+  uint8_t header = pSlot->Buf[X_FRAME_HEADER_INDEX];
 
   /* Get the size of the data. */
   if (X_SOH == header)
@@ -86,36 +237,17 @@ static xmodem_status xmodem_handlePacket(uint8_t header)
     status |= X_ERROR;
   }
 
-  eConsolePrintStatus_t comm_status = eCONSOLE_SUCCESS;
-  /* Get the packet number, data and CRC from UART. */
-  comm_status |= Console_receive(&received_packet_number[0u], X_PACKET_NUMBER_SIZE);
-  comm_status |= Console_receive(&received_packet_data[0u], size);
-  comm_status |= Console_receive(&received_packet_crc[0u], X_PACKET_CRC_SIZE);
+  /* Packet number, data and CRC follow the header in the frame. */
+  const uint8_t* received_packet_number = &pSlot->Buf[X_FRAME_NUMBER_INDEX];
+  const uint8_t* received_packet_data = &pSlot->Buf[X_FRAME_DATA_INDEX];
+  const uint8_t* received_packet_crc = &pSlot->Buf[X_FRAME_DATA_INDEX + size];
+
   /* Merge the two bytes of CRC. */
   uint16_t crc_received = ((uint16_t)received_packet_crc[X_PACKET_CRC_HIGH_INDEX] << 8u) | ((uint16_t)received_packet_crc[X_PACKET_CRC_LOW_INDEX]);
   /* We calculate it too. */
-  uint16_t crc_calculated = xmodem_computeCRC(&received_packet_data[0u], size);
-
-  /* Communication error. */
-  if (eCONSOLE_SUCCESS != comm_status)
-  {
-    status |= X_ERROR_UART;
-  }
-
-  /* If it is the first packet, then erase the memory. */
-  if ((X_OK == status) && (false == gxModemIsFirstPacket))
-  {
-	if (eFS_SUCCESS == FlashFs_API_OpenGoldenImageFile())
-	{
-	  gxModemIsFirstPacket = true;
-	}
-    else
-    {
-      status |= X_ERROR_FLASH;
-    }
-  }
+  uint16_t crc_calculated = xmodem_computeCRC(received_packet_data, size);
 
-  /* Error handling and flashing. */
+  /* Error handling. */
   if (X_OK == status)
   {
     if (gxModemPacketNumber != received_packet_number[0u])
@@ -136,20 +268,201 @@ static xmodem_status xmodem_handlePacket(uint8_t header)
     }
   }
 
-  if ((X_OK == status) && (eFS_SUCCESS != FlashFs_API_WriteToGoldenImageFile((char*)&received_packet_data[0u], (uint32_t)size)))
+  /* Raise the packet number (if there weren't any errors). */
+  if (X_OK == status)
   {
-    /* Flashing error. */
-    status |= X_ERROR_FLASH;
+    gxModemPacketNumber++;
   }
 
+  (*pOutSize) = size;
 
-  /* Raise the packet number and the address counters (if there weren't any errors). */
-  if (X_OK == status)
+  AppTrace_Record(eAPPTRACE_EVENT_XMODEM_PACKET, eAPPTRACE_PHASE_INSTANT, received_packet_number[0u], status);
+
+  return status;
+}
+
+/**
+ * @brief   Character that asks the host to start (or restart) a file.
+ * @return  "G" for YMODEM-G, "C" otherwise.
+ */
+static uint8_t xmodem_getStartChar(void)
+{
+  return (X_MODE_G == gxModemMode) ? X_G : X_C;
+}
+
+/**
+ * @brief   Acknowledge a packet. YMODEM-G streams without acknowledgment.
+ */
+static void xmodem_acknowledge(void)
+{
+  if (X_MODE_G != gxModemMode)
   {
-    gxModemPacketNumber++;
+    (void)Console_TransmitChar(X_ACK);
+  }
+}
+
+/**
+ * @brief   Packet number the first packet of a file must carry.
+ *          YMODEM opens every file with block 0, plain XMODEM starts at 1 and carries a single file.
+ * @param   received: Packet number of the first packet.
+ * @return  Expected packet number.
+ */
+static uint8_t xmodem_getStartPacketNumber(uint8_t received)
+{
+  uint8_t number = X_Y_HEADER_PACKET_NUMBER;
+
+  if ((X_MODE_CRC == gxModemMode) && (0u == gxModemFileCount) && (X_Y_HEADER_PACKET_NUMBER != received))
+  {
+    number = 1u;
   }
 
-  return status;
+  return number;
+}
+
+/**
+ * @brief   Parse YMODEM block 0 into @ref gxModemFile.
+ * @param   *data: Packet data.
+ * @param   size:  Size of packet data.
+ * @return  status: X_OK for a file, X_COMPLETE for the empty name closing the batch, X_ERROR for a malformed header.
+ */
+static xmodem_status xmodem_parseHeader(const uint8_t *data, uint16_t size)
+{
+  sXmodemFile_t* pFile = &gxModemFile;
+  const uint8_t* name_end = memchr(data, '\0', size);
+
+  memset(pFile, 0, sizeof(sXmodemFile_t));
+
+  if (NULL == name_end)
+  {
+    return X_ERROR;
+  }
+
+  if (data == name_end)
+  {
+    return X_COMPLETE;
+  }
+
+  /* Senders may include a path, only the base name is kept. */
+  const char* name = strrchr((const char*)data, '/');
+  name = (NULL == name) ? (const char*)data : (name + 1u);
+
+  size_t name_length = strlen(name);
+  if ((0u == name_length) || (name_length > X_Y_FILE_NAME_MAX))
+  {
+    return X_ERROR;
+  }
+  memcpy(pFile->Name, name, name_length + 1u);
+
+  /* Size follows the name, terminated by a space or NUL. */
+  const uint8_t* field = name_end + 1u;
+  const uint8_t* data_end = data + size;
+  while ((field < data_end) && (*field >= (uint8_t)'0') && (*field <= (uint8_t)'9'))
+  {
+    pFile->Size = (pFile->Size * 10u) + (uint32_t)(*field - (uint8_t)'0');
+    pFile->IsSizeKnown = true;
+    field++;
+  }
+  pFile->BytesLeft = pFile->Size;
+
+  return X_OK;
+}
+
+/**
+ * @brief   Open the file described by @ref gxModemFile. The first file of a
+ *          session is the golden image, flash for it is reserved up front when its size is known.
+ * @return  status: X_OK or X_ERROR_FLASH.
+ */
+static xmodem_status xmodem_openFile(void)
+{
+  sXmodemFile_t* pFile = &gxModemFile;
+  eStorageFSStatus_t fs_status = eFS_SUCCESS;
+
+  pFile->IsGoldenImage = (0u == gxModemFileCount);
+
+  if (true == pFile->IsGoldenImage)
+  {
+    if (true == pFile->IsSizeKnown)
+    {
+      fs_status = AppStorage_PrepareGoldenImage(pFile->Size);
+    }
+    if (eFS_SUCCESS == fs_status)
+    {
+      fs_status = AppStorage_OpenGoldenImage();
+    }
+  }
+  else
+  {
+    if (true == pFile->IsSizeKnown)
+    {
+      fs_status = AppStorage_PrepareNamedFile(pFile->Size);
+    }
+    if (eFS_SUCCESS == fs_status)
+    {
+      fs_status = AppStorage_OpenNamedFile(pFile->Name);
+    }
+  }
+
+  pFile->IsOpen = (eFS_SUCCESS == fs_status);
+
+  return (true == pFile->IsOpen) ? X_OK : X_ERROR_FLASH;
+}
+
+/**
+ * @brief   Program packet data into the open file.
+ * @param   *data: Packet data.
+ * @param   size:  Size of packet data.
+ * @return  status: X_OK or X_ERROR_FLASH.
+ */
+static xmodem_status xmodem_writeFile(const uint8_t *data, uint16_t size)
+{
+  sXmodemFile_t* pFile = &gxModemFile;
+  uint32_t length = size;
+  eStorageFSStatus_t fs_status = eFS_SUCCESS;
+
+  /* The last packet is padded to the packet size, only the size from block 0 is kept. */
+  if (true == pFile->IsSizeKnown)
+  {
+    length = (length < pFile->BytesLeft) ? length : pFile->BytesLeft;
+    pFile->BytesLeft -= length;
+  }
+
+  if (0u < length)
+  {
+    fs_status = (true == pFile->IsGoldenImage) ? AppStorage_WriteToGoldenImage((const char*)data, length)
+                                               : AppStorage_WriteToNamedFile((const char*)data, length);
+  }
+
+  return (eFS_SUCCESS == fs_status) ? X_OK : X_ERROR_FLASH;
+}
+
+/**
+ * @brief   Close the open file.
+ * @return  status: X_OK or X_ERROR_FLASH.
+ */
+static xmodem_status xmodem_closeFile(void)
+{
+  sXmodemFile_t* pFile = &gxModemFile;
+  eStorageFSStatus_t fs_status = (true == pFile->IsGoldenImage) ? AppStorage_CloseGoldenImage() : AppStorage_CloseNamedFile();
+
+  pFile->IsOpen = false;
+
+  return (eFS_SUCCESS == fs_status) ? X_OK : X_ERROR_FLASH;
+}
+
+/**
+ * @brief   Drop a partially received file that accompanies the golden image.
+ */
+static void xmodem_abortFile(void)
+{
+  sXmodemFile_t* pFile = &gxModemFile;
+
+  if ((true == pFile->IsOpen) && (false == pFile->IsGoldenImage))
+  {
+    (void)AppStorage_CloseNamedFile();
+    (void)AppStorage_DeleteNamedFile(pFile->Name);
+  }
+
+  pFile->IsOpen = false;
 }
 
 /**
@@ -164,13 +477,19 @@ static xmodem_status xmodem_errorHandler(uint8_t *error_number, uint8_t max_erro
   xmodem_status status = X_OK;
   /* Raise the error counter. */
   (*error_number)++;
+  /* YMODEM-G has no retransmission, any error is fatal. */
+  if (X_MODE_G == gxModemMode)
+  {
+    (*error_number) = max_error_number;
+  }
   /* If the counter reached the max value, then abort. */
   if ((*error_number) >= max_error_number)
   {
     /* Graceful abort. */
     (void)Console_TransmitChar(X_CAN);
     (void)Console_TransmitChar(X_CAN);
-    FlashFs_API_DeleteGoldenImageFile();
+    xmodem_abortFile();
+    AppStorage_DeleteGoldenImage();
     status = X_ERROR;
   }
   /* Otherwise send a NAK for a repeat. */
@@ -187,87 +506,230 @@ static xmodem_status xmodem_errorHandler(uint8_t *error_number, uint8_t max_erro
 /**
  * @brief   This function is the base of the Xmodem protocol.
  *          When we receive a header from UART, it decides what action it shall take.
- * @param   void
+ * @note    A good packet is acknowledged before it is programmed, so the next
+ *          packet streams into the other slot while flash is busy. A flash
+ *          error therefore surfaces one packet late and aborts the transfer.
+ * @note    A host opening with YMODEM block 0 may send several files in one
+ *          session. The first one is the golden image, the others are stored
+ *          by name next to it, which needs a file system in flash.
+ * @param   mode: Protocol asked from the host, see @ref xmodem_mode.
  * @return  xmodem_status
  */
-xmodem_status xmodem_API_receive(void)
+xmodem_status xmodem_API_receive(xmodem_mode mode)
 {
   volatile xmodem_status status = X_OK;
   uint8_t error_number = 0u;
+  uint8_t idle_number = 0u;
 
-  gxModemIsFirstPacket = false;
+  gxModemMode = mode;
+  gxModemIsAwaitingStart = true;
+  gxModemIsBatch = false;
+  gxModemIsEOTPending = false;
+  gxModemFileCount = 0u;
   gxModemPacketNumber = 1u;
+  memset(&gxModemFile, 0, sizeof(gxModemFile));
+
+  xmodem_startReception();
 
   /* Loop until there isn't any error (or until we jump to the user application). */
   while (X_OK == status)
   {
     uint8_t header = 0x00u;
 
-    /* Get the header from UART. */
-    eConsolePrintStatus_t comm_status = Console_receive(&header, 1u);
+    /* Get the next frame from the ring. */
+    sXmodemRxSlot_t* pSlot = xmodem_waitForFrame();
+    eConsolePrintStatus_t comm_status = (NULL != pSlot) ? eCONSOLE_SUCCESS : eCONSOLE_FAIL;
 
-    /* Spam the host (until we receive something) with ACSII "C", to notify it, we want to use CRC-16. */
-    if ((eCONSOLE_SUCCESS != comm_status) && (false == gxModemIsFirstPacket))
+    if (NULL != pSlot)
     {
-      (void)Console_TransmitChar(X_C);
+      header = pSlot->Buf[X_FRAME_HEADER_INDEX];
+    }
+
+    /* Spam the host (until we receive something) with ACSII "C" (or "G"), to notify it, we want to use CRC-16. */
+    if ((eCONSOLE_SUCCESS != comm_status) && (true == gxModemIsAwaitingStart))
+    {
+      (void)Console_TransmitChar(xmodem_getStartChar());
+
+      /* A host that never closes the batch leaves the files it completed in place. */
+      if ((0u < gxModemFileCount) && (++idle_number >= X_MAX_ERRORS))
+      {
+        status = X_COMPLETE;
+      }
     }
     /* Uart timeout or any other errors. */
-    else if ((eCONSOLE_SUCCESS != comm_status) && (true == gxModemIsFirstPacket))
+    else if ((eCONSOLE_SUCCESS != comm_status) && (false == gxModemIsAwaitingStart))
     {
       status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
     }
+    /* Streamed packets were lost while flash was busy. */
+    else if ((X_MODE_G == gxModemMode) && (true == gxModemRx.IsOverflow))
+    {
+      status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
+      header = 0x00u;
+    }
     else
     {
       /* Do nothing. */
     }
 
     xmodem_status packet_status = X_ERROR;
+    uint16_t size = 0u;
+    bool is_header_block = false;
     /* The header can be: SOH, STX, EOT and CAN. */
     switch(header)
     {
       /* 128 or 1024 bytes of data. */
       case X_SOH:
       case X_STX:
-        /* If the handling was successful, then send an ACK. */
-        packet_status = xmodem_handlePacket(header);
+        if (true == gxModemIsAwaitingStart)
+        {
+          gxModemPacketNumber = xmodem_getStartPacketNumber(pSlot->Buf[X_FRAME_NUMBER_INDEX]);
+          is_header_block = (X_Y_HEADER_PACKET_NUMBER == gxModemPacketNumber);
+        }
+
+        packet_status = xmodem_handlePacket(pSlot, &size);
+        /* If the packet is good, send an ACK and program it while the next one arrives. */
         if (X_OK == packet_status)
         {
-          (void)Console_TransmitChar(X_ACK);
+          const uint8_t* data = &pSlot->Buf[X_FRAME_DATA_INDEX];
+
+          xmodem_acknowledge();
+
+          if (true == is_header_block)
+          {
+            gxModemIsBatch = true;
+            packet_status = xmodem_parseHeader(data, size);
+            if (X_COMPLETE == packet_status)
+            {
+              /* Empty block 0, the batch is over. It has to carry a golden image at least. */
+              status = (0u < gxModemFileCount) ? X_COMPLETE : X_ERROR;
+              packet_status = X_OK;
+            }
+            else if (X_OK == packet_status)
+            {
+              /* Flash is reserved before the host is asked for data, nothing streams in meanwhile. */
+              packet_status = xmodem_openFile();
+              if (X_OK == packet_status)
+              {
+                gxModemIsAwaitingStart = false;
+                (void)Console_TransmitChar(xmodem_getStartChar());
+              }
+            }
+            else
+            {
+              /* Malformed header. */
+            }
+          }
+          else
+          {
+            if (true == gxModemIsAwaitingStart)
+            {
+              packet_status = xmodem_openFile();
+              gxModemIsAwaitingStart = false;
+            }
+            if (X_OK == packet_status)
+            {
+              packet_status = xmodem_writeFile(data, size);
+            }
+          }
+
+          /* The packet is acknowledged already, it cannot be repeated. */
+          if (X_OK != packet_status)
+          {
+            packet_status = X_ERROR_FLASH;
+          }
         }
+
         /* If the error was flash related, then immediately set the error counter to max (graceful abort). */
-        else if (X_ERROR_FLASH == packet_status)
+        if (X_ERROR_FLASH == packet_status)
         {
           error_number = X_MAX_ERRORS;
           status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
         }
         /* Error while processing the packet, either send a NAK or do graceful abort. */
-        else
+        else if (X_OK != packet_status)
         {
           status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
         }
         break;
       /* End of Transmission. */
       case X_EOT:
-        /* ACK, feedback to user (as a text), then jump to user application. */
-        (void)Console_TransmitChar(X_ACK);
-        status = X_COMPLETE;
-        FlashFs_API_CloseGoldenImageFile();
+        if (true == gxModemIsAwaitingStart)
+        {
+          /* Our ACK of the last EOT was lost, answer it again. */
+          if (0u < gxModemFileCount)
+          {
+            (void)Console_TransmitChar(X_ACK);
+            (void)Console_TransmitChar(xmodem_getStartChar());
+          }
+          else
+          {
+            status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
+          }
+        }
+        /* YMODEM sends EOT twice, the first one is refused so a line glitch cannot end a file. */
+        else if ((true == gxModemIsBatch) && (X_MODE_CRC == gxModemMode) && (false == gxModemIsEOTPending))
+        {
+          (void)Console_TransmitChar(X_NAK);
+          gxModemIsEOTPending = true;
+        }
+        else
+        {
+          /* ACK, feedback to user (as a text), then jump to user application. */
+          (void)Console_TransmitChar(X_ACK);
+
+          if (X_OK != xmodem_closeFile())
+          {
+            error_number = X_MAX_ERRORS;
+            status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
+          }
+          else if (true == gxModemIsBatch)
+          {
+            /* Ask for block 0 of the next file. */
+            gxModemFileCount++;
+            gxModemIsAwaitingStart = true;
+            gxModemIsEOTPending = false;
+            (void)Console_TransmitChar(xmodem_getStartChar());
+          }
+          else
+          {
+            gxModemFileCount++;
+            status = X_COMPLETE;
+          }
+        }
         break;
       /* Abort from host. */
       case X_CAN:
+        xmodem_abortFile();
         status = X_ERROR;
         break;
       default:
         /* Wrong header. */
-        if (eCONSOLE_SUCCESS == comm_status)
+        if ((eCONSOLE_SUCCESS == comm_status) && (X_OK == status))
         {
           status = xmodem_errorHandler(&error_number, X_MAX_ERRORS);
         }
         break;
     }
+
+    if (NULL != pSlot)
+    {
+      xmodem_releaseFrame(pSlot);
+    }
   }
 
+  Console_StopRxCapture();
+
   return status;
 }
 
+/**
+ * @brief   Number of files received completely in the last session.
+ * @return  File count, the golden image included.
+ */
+uint8_t xmodem_API_getFileCount(void)
+{
+  return gxModemFileCount;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
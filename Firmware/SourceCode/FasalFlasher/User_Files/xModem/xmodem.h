@@ -15,6 +15,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "stdbool.h"
+#include "stdint.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -38,6 +39,7 @@
 #define X_MAX_ERRORS ((uint8_t)3u)
 
 /* Sizes of the packets. */
+#define X_PACKET_HEADER_SIZE  ((uint16_t)1u)
 #define X_PACKET_NUMBER_SIZE  ((uint16_t)2u)
 #define X_PACKET_128_SIZE     ((uint16_t)128u)
 #define X_PACKET_1024_SIZE    ((uint16_t)1024u)
@@ -49,6 +51,16 @@
 #define X_PACKET_CRC_HIGH_INDEX           ((uint16_t)0u)
 #define X_PACKET_CRC_LOW_INDEX            ((uint16_t)1u)
 
+/* Indexes inside a received frame (header included). */
+#define X_FRAME_HEADER_INDEX              ((uint16_t)0u)
+#define X_FRAME_NUMBER_INDEX              ((uint16_t)1u)
+#define X_FRAME_DATA_INDEX                ((uint16_t)3u)
+
+/* Reception. */
+#define X_RX_SLOT_COUNT       ((uint8_t)3u)       /**< Frame buffers, one is programmed while the next one streams in, one spare absorbs a slow page program. A file of known size is erased before its first 'C' or 'G', a block erase mid-stream overflows the slots and is fatal in YMODEM-G */
+#define X_RX_SLOT_SIZE        (X_PACKET_HEADER_SIZE + X_PACKET_NUMBER_SIZE + X_PACKET_1024_SIZE + X_PACKET_CRC_SIZE)
+#define X_RX_TIMEOUT_MS       ((uint32_t)1000u)   /**< Line idle time after which a frame (or its absence) times out */
+
 
 /* Bytes defined by the protocol. */
 #define X_SOH ((uint8_t)0x01u)  /**< Start Of Header (128 bytes). */
@@ -58,6 +70,11 @@
 #define X_NAK ((uint8_t)0x15u)  /**< Not Acknowledge. */
 #define X_CAN ((uint8_t)0x18u)  /**< Cancel. */
 #define X_C   ((uint8_t)0x43u)  /**< ASCII "C" to notify the host we want to use CRC16. */
+#define X_G   ((uint8_t)0x47u)  /**< ASCII "G" to ask the host for YMODEM-G streaming. */
+
+/* YMODEM block 0: file name, NUL, size in decimal ASCII, then optional fields separated by spaces. */
+#define X_Y_HEADER_PACKET_NUMBER  ((uint8_t)0u)
+#define X_Y_FILE_NAME_MAX         ((uint16_t)64u)     /**< Longest base name accepted, path is dropped */
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -75,9 +92,59 @@ typedef enum {
   X_ERROR         = 0xFFu  /**< Generic error. */
 } xmodem_status;
 
+/**
+ * @brief Flavour of the protocol the receiver asks for
+ *
+ */
+typedef enum {
+  X_MODE_CRC,           /**< XMODEM-CRC/1K, or YMODEM batch if the host opens with block 0. Every packet is acknowledged. */
+  X_MODE_G,             /**< YMODEM-G batch, packets stream without acknowledgment and any error aborts. */
+} xmodem_mode;
+
+/**
+ * @brief File being received, the first file of a session is the golden image
+ *
+ */
+typedef struct
+{
+  char Name[X_Y_FILE_NAME_MAX + 1u];  /**< Name from YMODEM block 0, empty for XMODEM */
+  uint32_t Size;                      /**< Size from YMODEM block 0 */
+  uint32_t BytesLeft;                 /**< Bytes still expected, padding beyond them is dropped */
+  bool IsSizeKnown;                   /**< Block 0 carried a size */
+  bool IsGoldenImage;
+  bool IsOpen;
+} sXmodemFile_t;
+
+/**
+ * @brief Buffer holding one received frame, filled from UART interrupt
+ *
+ */
+typedef struct
+{
+  uint8_t Buf[X_RX_SLOT_SIZE];
+  volatile uint16_t Length;           /**< Bytes received so far */
+  uint16_t ExpectedLength;            /**< Frame length implied by the header byte */
+  volatile bool IsComplete;           /**< Frame is whole, the interrupt moved on to the next slot */
+} sXmodemRxSlot_t;
+
+/**
+ * @brief Ring of frame buffers, the UART interrupt fills the write slot while
+ * the receiver checks and programs the read slot
+ *
+ */
+typedef struct
+{
+  sXmodemRxSlot_t Slots[X_RX_SLOT_COUNT];
+  volatile uint8_t WriteIndex;        /**< Slot being filled by the UART interrupt */
+  uint8_t ReadIndex;                  /**< Slot being handled by the receiver */
+  volatile uint32_t LastByteTick;     /**< Tick of most recent byte */
+  volatile bool IsOverflow;           /**< A byte arrived while every slot was full */
+} sXmodemRx_t;
+
 ///////////////////////////////////////////////////////////////////////////////
 
-xmodem_status xmodem_API_receive(void);
+xmodem_status xmodem_API_receive(xmodem_mode mode);
+uint8_t xmodem_API_getFileCount(void);
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+Decode the console output of FasalFlasher built with ENABLE_BINARY_CONSOLE_LOG,
+or of the host simulation run with --binary-log, back into text.
+
+In binary log mode Console_Print sends the address of its format string and
+the raw arguments instead of formatting on target. The format strings are read
+back from the ELF image the device runs, the firmware .elf or the FasalSim
+binary. Bytes outside log frames, as XMODEM or a trace dump, pass through.
+
+Frame, multi byte fields little endian:
+    0      0x1F, ASCII unit separator
+    1      payload length
+    2-5    format string address
+    6-     arguments in format order:
+               integers, characters, pointers   4 bytes, ll and j 8 bytes
+               floating point                   8 byte double
+               strings                          length byte and characters
+               '*' width or precision           4 bytes
+
+Usage:
+    consolelog.py FasalFlasher.elf capture.bin [-o capture.txt]
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0x1F
+
+ELF_MAGIC = b"\x7fELF"
+SHT_NOBITS = 8
+
+# Flags, width, precision, length modifier and conversion, as Console_BuildBinaryLog scans them
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?([hlLzjt]*)([a-zA-Z%])")
+
+
+class Image:
+    """Loadable sections of an ELF image, looked up by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as source:
+            blob = source.read()
+
+        if blob[:4] != ELF_MAGIC:
+            raise ValueError("%s is not an ELF image" % path)
+
+        is_64 = blob[4] == 2
+        if is_64:
+            shoff, = struct.unpack_from("<Q", blob, 0x28)
+            shentsize, shnum = struct.unpack_from("<HH", blob, 0x3A)
+        else:
+            shoff, = struct.unpack_from("<I", blob, 0x20)
+            shentsize, shnum = struct.unpack_from("<HH", blob, 0x2E)
+
+        self.sections = []
+        for index in range(shnum):
+            entry = shoff + index * shentsize
+            if is_64:
+                _, kind, _, address, offset, size = struct.unpack_from("<IIQQQQ", blob, entry)
+            else:
+                _, kind, _, address, offset, size = struct.unpack_from("<IIIIII", blob, entry)
+            if address != 0 and kind != SHT_NOBITS:
+                self.sections.append((address, size, blob[offset:offset + size]))
+
+        self.cache = {}
+
+    def string(self, address):
+        """NUL terminated string at address, None if no section holds it."""
+        if address not in self.cache:
+            self.cache[address] = None
+            for start, size, data in self.sections:
+                if start <= address < start + size:
+                    end = data.find(b"\0", address - start)
+                    if end >= 0:
+                        self.cache[address] = data[address - start:end].decode("latin-1")
+                    break
+        return self.cache[address]
+
+
+def take(payload, offset, size):
+    if offset + size > len(payload):
+        raise IndexError
+    return payload[offset:offset + size], offset + size
+
+
+def render(format_string, payload):
+    """Format string with the arguments packed in payload, missing arguments show as '?'."""
+    out = []
+    offset = 0
+    position = 0
+
+    for match in CONVERSION.finditer(format_string):
+        out.append(format_string[position:match.start()])
+        position = match.end()
+        flags, width, precision, length, conversion = match.groups()
+
+        if conversion == "%":
+            out.append("%")
+            continue
+
+        try:
+            if width == "*":
+                raw, offset = take(payload, offset, 4)
+                width = str(struct.unpack("<i", raw)[0])
+            if precision == "*":
+                raw, offset = take(payload, offset, 4)
+                precision = str(struct.unpack("<i", raw)[0])
+
+            spec = "%" + flags + (width or "") + ("." + precision if precision is not None else "")
+            is_long_long = length.count("l") >= 2 or "j" in length
+
+            if conversion in "diuxXoc":
+                raw, offset = take(payload, offset, 8 if is_long_long else 4)
+                signed = conversion in "di"
+                value = int.from_bytes(raw, "little", signed=signed)
+                if conversion == "c":
+                    out.append((spec + "c") % chr(value & 0xFF))
+                else:
+                    out.append((spec + ("d" if conversion == "u" else conversion)) % value)
+            elif conversion == "p":
+                raw, offset = take(payload, offset, 4)
+                out.append("0x%x" % struct.unpack("<I", raw)[0])
+            elif conversion == "s":
+                raw, offset = take(payload, offset, 1)
+                text, offset = take(payload, offset, raw[0])
+                out.append((spec + "s") % text.decode("latin-1"))
+            elif conversion in "fFeEgGaA":
+                raw, offset = take(payload, offset, 8)
+                out.append((spec + conversion.replace("a", "e").replace("A", "E")) % struct.unpack("<d", raw)[0])
+            else:
+                out.append(match.group(0))
+        except IndexError:
+            out.append("?")
+
+    out.append(format_string[position:])
+    return "".join(out)
+
+
+def decode(image, blob):
+    """Text of a capture, and the number of frames decoded."""
+    out = bytearray()
+    frames = 0
+    index = 0
+
+    while index < len(blob):
+        byte = blob[index]
+        if byte == SYNC and index + 6 <= len(blob):
+            length = blob[index + 1]
+            payload = blob[index + 2:index + 2 + length]
+            format_string = image.string(struct.unpack_from("<I", payload)[0]) if len(payload) >= 4 else None
+            if len(payload) == length and format_string is not None:
+                out += render(format_string, payload[4:]).encode("latin-1")
+                frames += 1
+                index += 2 + length
+                continue
+        out.append(byte)
+        index += 1
+
+    return bytes(out), frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="ELF image the device runs")
+    parser.add_argument("capture", help="console capture")
+    parser.add_argument("-o", "--output", help="text file, standard output if omitted")
+    args = parser.parse_args()
+
+    try:
+        image = Image(args.image)
+    except (OSError, ValueError) as error:
+        sys.exit(str(error))
+
+    with open(args.capture, "rb") as source:
+        blob = source.read()
+
+    text, frames = decode(image, blob)
+
+    if args.output:
+        with open(args.output, "wb") as sink:
+            sink.write(text)
+    else:
+        sys.stdout.buffer.write(text)
+        sys.stdout.flush()
+
+    print("%d frames, %d bytes of capture, %d bytes of text" % (frames, len(blob), len(text)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
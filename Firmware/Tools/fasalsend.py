@@ -0,0 +1,509 @@
+#!/usr/bin/env python3
+"""
+Send golden images to FasalFlasher in X-Modem transfer mode, as the PC side of
+the serial link would, and check what the device reports at the end.
+
+Works on a serial port of the board or on the pseudo terminal of the host
+simulation. With -- and a FasalSim command line the simulator is started with
+--pty added, its console is opened and its exit status is checked too.
+
+Protocols, as the storage profile jumpers select them on the device:
+    xmodem      XMODEM-1K, a single image, 1024 byte packets padded with SUB
+    ymodem      YMODEM batch, the first file is the golden image
+    ymodem-g    YMODEM-G batch, packets stream without acknowledgment
+    framelink   FrameLink, COBS framed DATA with CRC-32 and a window of 8 (see FrameLink.h)
+
+Faults the device has to recover from:
+    --corrupt N   packet N (XMODEM, YMODEM) goes out once with a bad CRC
+    --drop N      DATA frame N (FrameLink) is left out of its window once
+
+The run passes if "Application Error Code: 0000" is printed and the golden
+image digest the device prints matches the first file.
+
+Usage:
+    fasalsend.py [options] image.bin [more files] --port /dev/ttyUSB0
+    fasalsend.py [options] image.bin -- FasalSim --xmodem --profile 1
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+import termios
+import threading
+import time
+import tty
+import zlib
+
+from flzpack import crc32_mpeg2
+
+SOH = 0x01
+STX = 0x02
+EOT = 0x04
+ACK = 0x06
+NAK = 0x15
+CAN = 0x18
+SUB = 0x1A
+START_CRC = ord("C")
+START_G = ord("G")
+
+BAUD_DEFAULT = 115200
+BAUD_OFFER_TIMEOUT = 1.5        # Device listens for BAUD this long once it asks for the image
+
+FRAMELINK_QUERY = 0x01
+FRAMELINK_START = 0x02
+FRAMELINK_DATA = 0x03
+FRAMELINK_END = 0x04
+FRAMELINK_STATUS = 0x81
+FRAMELINK_STATE_COMPLETE = 2
+FRAMELINK_HEADER = struct.Struct("<BBI")
+FRAMELINK_STATUS_PAYLOAD = struct.Struct("<BBBHI")
+
+PROMPT = b"Send Golden Image over"
+RESULT = re.compile(rb"Application Error Code: ([0-9A-F]{4})")
+DIGEST = re.compile(rb"Golden Image [^:\r\n]+: ([0-9A-F]{8}) over (\d+) bytes")
+FILE_COUNT = re.compile(rb"(\d+) file\(s\) received")
+BAUD_RAN = re.compile(rb"Transfer ran at (\d+) baud")
+
+
+class TransferError(Exception):
+    pass
+
+
+class Link:
+    """Serial line, a reader thread keeps everything the device sends."""
+
+    def __init__(self, path, baud, pace):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        self.set_baud(baud)
+        self.pace = pace
+        self.received = bytearray()
+        self.position = 0
+        self.is_open = True
+        self.condition = threading.Condition()
+        self.reader = threading.Thread(target=self._read, daemon=True)
+        self.reader.start()
+
+    def set_baud(self, baud):
+        self.baud = baud
+        speed = getattr(termios, "B%d" % baud, None)
+        if speed is not None:
+            attributes = termios.tcgetattr(self.fd)
+            attributes[4] = attributes[5] = speed
+            termios.tcsetattr(self.fd, termios.TCSADRAIN, attributes)
+
+    def _read(self):
+        while True:
+            try:
+                data = os.read(self.fd, 4096)
+            except OSError:
+                data = b""
+            with self.condition:
+                if not data:
+                    self.is_open = False
+                else:
+                    self.received += data
+                self.condition.notify_all()
+            if not data:
+                return
+
+    def write(self, data):
+        # Paced at the line rate when asked, a PC serial port would not be
+        chunk = max(self.baud // 10 // 100, 1) if self.pace else len(data)
+        for start in range(0, len(data), chunk):
+            os.write(self.fd, data[start:start + chunk])
+            if self.pace:
+                time.sleep(chunk * 10 / self.baud)
+
+    def wait_for(self, predicate, timeout):
+        """Wait until predicate finds what it needs in the bytes not consumed yet, returns its result or None."""
+        deadline = time.monotonic() + timeout
+        with self.condition:
+            while True:
+                result = predicate(self.received, self.position)
+                if result is not None:
+                    return result
+                remaining = deadline - time.monotonic()
+                if remaining <= 0 or not self.is_open:
+                    return None
+                self.condition.wait(remaining)
+
+    def expect(self, text, timeout):
+        def find(buffer, position):
+            index = buffer.find(text, position)
+            if index < 0:
+                return None
+            self.position = index + len(text)
+            return True
+        if self.wait_for(find, timeout) is None:
+            raise TransferError("no %r from device" % text)
+
+    def get_byte(self, timeout):
+        def take(buffer, position):
+            if position >= len(buffer):
+                return None
+            self.position = position + 1
+            return buffer[position]
+        return self.wait_for(take, timeout)
+
+    def get_frame(self, timeout):
+        """Next FrameLink frame, decoded and CRC checked, or None."""
+        def take(buffer, position):
+            end = buffer.find(0, position)
+            if end < 0:
+                return None
+            self.position = end + 1
+            return bytes(buffer[position:end])
+        while True:
+            encoded = self.wait_for(take, timeout)
+            if encoded is None:
+                return None
+            frame = cobs_decode(encoded)
+            if frame is not None and len(frame) >= FRAMELINK_HEADER.size + 4 and \
+                    zlib.crc32(frame[:-4]) == struct.unpack_from("<I", frame, len(frame) - 4)[0]:
+                return frame[:-4]
+
+    def wait_closed(self, timeout):
+        self.wait_for(lambda buffer, position: None if self.is_open else True, timeout)
+
+    def close(self):
+        os.close(self.fd)
+
+
+def xmodem_crc(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def xmodem_packet(number, data, size, is_corrupt=False, padding=SUB):
+    data = data.ljust(size, bytes([padding]))
+    crc = xmodem_crc(data) ^ (0x0001 if is_corrupt else 0)
+    return bytes([SOH if size == 128 else STX, number & 0xFF, 0xFF - (number & 0xFF)]) + data + struct.pack(">H", crc)
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(byte)
+            if len(block) == 254:
+                out += bytes([255]) + block
+                block = bytearray()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out) + b"\x00"
+
+
+def cobs_decode(data):
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            return None
+        out += data[index + 1:index + code]
+        index += code
+        if code < 255 and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def framelink_frame(kind, sequence, offset, payload=b""):
+    frame = FRAMELINK_HEADER.pack(kind, sequence, offset) + payload
+    return cobs_encode(frame + struct.pack("<I", zlib.crc32(frame)))
+
+
+def wait_start(link, start, timeout=10.0):
+    """Wait for the receiver to ask for a file, anything else it sends in between is dropped."""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        byte = link.get_byte(deadline - time.monotonic())
+        if byte == start:
+            return
+        if byte == CAN:
+            raise TransferError("device cancelled")
+    raise TransferError("device did not ask for a file")
+
+
+def send_packet(link, number, data, size, args, stats, padding=SUB):
+    """Send one packet until it is acknowledged, the first copy is corrupted when asked for."""
+    is_corrupt = (number == args.corrupt and not stats.get("corrupted"))
+    for _ in range(10):
+        link.write(xmodem_packet(number, data, size, is_corrupt, padding))
+        reply = link.get_byte(5.0)
+        if reply == ACK:
+            return
+        if reply == CAN:
+            raise TransferError("device cancelled at packet %d" % number)
+        if is_corrupt:
+            stats["corrupted"] = True
+            is_corrupt = False
+        stats["repeats"] = stats.get("repeats", 0) + 1
+    raise TransferError("packet %d not acknowledged" % number)
+
+
+def send_xmodem(link, files, args):
+    stats = {}
+    data = files[0][1]
+    wait_start(link, START_CRC)
+    for number, start in enumerate(range(0, len(data), 1024), 1):
+        send_packet(link, number, data[start:start + 1024], 1024, args, stats)
+    link.write(bytes([EOT]))
+    if link.get_byte(5.0) != ACK:
+        raise TransferError("EOT not acknowledged")
+    print("xmodem: %d bytes, %d packets repeated" % (len(data), stats.get("repeats", 0)))
+
+
+def send_ymodem(link, files, args, is_streaming):
+    stats = {}
+    start_char = START_G if is_streaming else START_CRC
+    for name, data in files:
+        wait_start(link, start_char)
+        # Block 0 is padded with NUL, the name and size are NUL terminated
+        header = name.encode() + b"\x00" + str(len(data)).encode() + b"\x00"
+        if is_streaming:
+            link.write(xmodem_packet(0, header, 128, padding=0))
+        else:
+            send_packet(link, 0, header, 128, args, stats, padding=0)
+        wait_start(link, start_char)
+
+        packets = [data[start:start + 1024] for start in range(0, len(data), 1024)]
+        if is_streaming:
+            link.write(b"".join(xmodem_packet(number, packet, 1024) for number, packet in enumerate(packets, 1)))
+        else:
+            for number, packet in enumerate(packets, 1):
+                send_packet(link, number, packet, 1024, args, stats)
+
+        # YMODEM refuses the first EOT, YMODEM-G takes it
+        link.write(bytes([EOT]))
+        reply = link.get_byte(10.0)
+        if reply == NAK and not is_streaming:
+            link.write(bytes([EOT]))
+            reply = link.get_byte(5.0)
+        if reply != ACK:
+            raise TransferError("EOT of %s answered with %r" % (name, reply))
+        print("%s: %s, %d bytes" % (args.protocol, name, len(data)))
+
+    # Empty block 0 ends the batch
+    wait_start(link, start_char)
+    link.write(xmodem_packet(0, b"", 128, padding=0))
+    if not is_streaming and link.get_byte(5.0) != ACK:
+        raise TransferError("end of batch not acknowledged")
+    print("%s: %d packets repeated" % (args.protocol, stats.get("repeats", 0)))
+
+
+def send_framelink(link, files, args):
+    data = files[0][1]
+    payload_size = 256
+    window = 8
+    frame_count = (len(data) + payload_size - 1) // payload_size
+    sequence = 0
+    status = None
+
+    def exchange(frames):
+        """Send frames back to back, returns the STATUS answering the last one, or the latest one seen."""
+        nonlocal sequence
+        for kind, offset, payload in frames:
+            # Sequence 0 is left to the STATUS answering a corrupted frame
+            sequence = sequence % 255 + 1
+            link.write(framelink_frame(kind, sequence, offset, payload))
+        latest = None
+        while True:
+            frame = link.get_frame(2.0)
+            if frame is None:
+                return latest
+            if frame[0] == FRAMELINK_STATUS:
+                latest = frame
+                if frame[1] == sequence:
+                    return frame
+
+    # Receiver listens once the baud rate offer has run out, ask until it answers
+    deadline = time.monotonic() + 10.0
+    while status is None and time.monotonic() < deadline:
+        status = exchange([(FRAMELINK_QUERY, 0, b"")])
+    if status is None:
+        raise TransferError("no STATUS from device")
+
+    status = exchange([(FRAMELINK_START, 0, struct.pack("<I", len(data)))])
+    is_dropped = False
+    retransmits = 0
+    committed = 0
+    next_frame = 0
+
+    while committed < len(data):
+        frames = []
+        held = 0
+        if status is not None:
+            committed = FRAMELINK_HEADER.unpack_from(status)[2]
+            held = FRAMELINK_STATUS_PAYLOAD.unpack_from(status, FRAMELINK_HEADER.size)[1]
+        first = committed // payload_size
+        next_frame = max(next_frame, first)
+
+        # Gaps the device reports are sent again, then the window is filled up
+        for index in range(first, next_frame):
+            if not (held >> (index - first)) & 1:
+                frames.append(index)
+                retransmits += 1
+        while next_frame < min(first + window, frame_count):
+            frames.append(next_frame)
+            next_frame += 1
+
+        if args.drop is not None and not is_dropped and args.drop in frames:
+            frames.remove(args.drop)
+            is_dropped = True
+
+        if not frames:
+            status = exchange([(FRAMELINK_QUERY, 0, b"")])
+            continue
+
+        status = exchange([(FRAMELINK_DATA, index * payload_size, data[index * payload_size:(index + 1) * payload_size])
+                           for index in frames])
+
+    status = exchange([(FRAMELINK_END, 0, struct.pack("<I", zlib.crc32(data)))])
+    if status is None or FRAMELINK_STATUS_PAYLOAD.unpack_from(status, FRAMELINK_HEADER.size)[0] != FRAMELINK_STATE_COMPLETE:
+        raise TransferError("image not complete after END")
+    print("framelink: %d bytes, %d frames retransmitted" % (len(data), retransmits))
+
+
+def offer_baud(link, baud):
+    link.write(b"BAUD %d\r\n" % baud)
+    link.expect(b"OK %d\r\n" % baud, BAUD_OFFER_TIMEOUT)
+    link.set_baud(baud)
+    link.write(b"SYNC\r\n")
+    link.expect(b"OK\r\n", 1.0)
+    print("baud: switched to %d" % baud)
+
+
+def check_result(console, files, args):
+    """Check the result the device printed, returns a list of what is wrong."""
+    problems = []
+    result = RESULT.search(console)
+    if result is None or result.group(1) != b"0000":
+        problems.append("application error code %s" % (result.group(1).decode() if result else "missing"))
+
+    # XMODEM carries no size, the padding of the last packet is part of the image
+    golden = files[0][1]
+    if args.protocol == "xmodem":
+        golden = golden.ljust((len(golden) + 1023) // 1024 * 1024, bytes([SUB]))
+    digest = DIGEST.search(console)
+    expected = b"%08X over %d bytes" % (crc32_mpeg2(golden), len(golden))
+    if digest is None or digest.group(0).split(b": ")[1] != expected:
+        problems.append("golden image digest %s, expected %s" % (digest.group(0).decode() if digest else "missing", expected.decode()))
+
+    if args.protocol in ("ymodem", "ymodem-g"):
+        count = FILE_COUNT.search(console)
+        if count is None or int(count.group(1)) != len(files):
+            problems.append("file count %s, expected %d" % (count.group(1).decode() if count else "missing", len(files)))
+
+    ran = BAUD_RAN.search(console)
+    if ran is None or int(ran.group(1)) != (args.baud or BAUD_DEFAULT):
+        problems.append("transfer rate %s, expected %d" % (ran.group(1).decode() if ran else "missing", args.baud or BAUD_DEFAULT))
+    return problems
+
+
+def start_simulator(command):
+    """Start FasalSim on a pseudo terminal, returns the process and the terminal name."""
+    process = subprocess.Popen(command + ["--pty"], stderr=subprocess.PIPE)
+    line = process.stderr.readline().decode()
+    match = re.match(r"console on (\S+), waiting", line)
+    if match is None:
+        process.kill()
+        sys.exit("simulator did not open a console: %s" % line.strip())
+
+    def forward():
+        for line in process.stderr:
+            sys.stderr.write(line.decode())
+    threading.Thread(target=forward, daemon=True).start()
+    return process, match.group(1)
+
+
+def main():
+    argv = sys.argv[1:]
+    command = None
+    if "--" in argv:
+        command = argv[argv.index("--") + 1:]
+        argv = argv[:argv.index("--")]
+
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("files", nargs="+", help="golden image first, more files for a YMODEM batch")
+    parser.add_argument("--port", help="serial port of the board, instead of a simulator command line after --")
+    parser.add_argument("--protocol", choices=("xmodem", "ymodem", "ymodem-g", "framelink"), default="ymodem")
+    parser.add_argument("--baud", type=int, help="ask the device for this rate before the transfer")
+    parser.add_argument("--pace", action="store_true", help="send no faster than the line rate")
+    parser.add_argument("--corrupt", type=int, help="send packet N once with a bad CRC")
+    parser.add_argument("--drop", type=int, help="leave FrameLink DATA frame N out once")
+    parser.add_argument("--timeout", type=float, default=60.0, help="seconds to wait for the device to ask for the image")
+    args = parser.parse_args(argv)
+
+    if (args.port is None) == (command is None):
+        parser.error("give either --port or a simulator command line after --")
+    if len(args.files) > 1 and args.protocol not in ("ymodem", "ymodem-g"):
+        parser.error("only YMODEM sends more than one file")
+
+    files = []
+    for path in args.files:
+        with open(path, "rb") as f:
+            files.append((os.path.basename(path), f.read()))
+
+    process = None
+    port = args.port
+    if command is not None:
+        process, port = start_simulator(command)
+
+    link = Link(port, BAUD_DEFAULT, args.pace)
+    problems = []
+    try:
+        link.expect(PROMPT, args.timeout)
+        link.expect(b"\r\n", 1.0)
+        if args.baud:
+            offer_baud(link, args.baud)
+        if args.protocol == "xmodem":
+            send_xmodem(link, files, args)
+        elif args.protocol == "framelink":
+            send_framelink(link, files, args)
+        else:
+            send_ymodem(link, files, args, args.protocol == "ymodem-g")
+        link.set_baud(BAUD_DEFAULT)
+        link.expect(b"Application Error Code", 30.0)
+        # The rest of the result display
+        if process is not None:
+            link.wait_closed(30.0)
+        else:
+            time.sleep(1.0)
+    except TransferError as error:
+        problems.append(str(error))
+        link.wait_closed(5.0)
+
+    console = bytes(link.received)
+    sys.stdout.write(console.decode("ascii", "replace"))
+    sys.stdout.write("\n")
+    link.close()
+
+    problems += check_result(console, files, args)
+    if process is not None:
+        try:
+            code = process.wait(30.0)
+        except subprocess.TimeoutExpired:
+            process.kill()
+            code = process.wait()
+        if code != 0:
+            problems.append("simulator exit status %d" % code)
+
+    for problem in problems:
+        print("FAIL: %s" % problem, file=sys.stderr)
+    sys.exit(1 if problems else 0)
+
+
+if __name__ == "__main__":
+    main()
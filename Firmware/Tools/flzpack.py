@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""
+Pack a golden image into the compressed container FasalFlasher decompresses
+on the fly (see AppStorage.h and Lzss.h).
+
+Container, multi byte fields little endian:
+    0-3    "FLZ1"
+    4      LZSS window bits
+    5      LZSS lookahead bits
+    6-7    reserved, zero
+    8-11   size of original image
+    12-15  CRC-32/MPEG-2 of original image, zero padded to a word multiple
+    16-    LZSS stream, heatshrink compatible
+
+Usage:
+    flzpack.py image.bin image.flz [-w 10] [-l 5]
+    flzpack.py -d image.flz image.bin
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"FLZ1"
+HEADER = struct.Struct("<4sBBHII")
+WINDOW_BITS_MIN = 4
+WINDOW_BITS_MAX = 10            # Decoder window on target is 1 KB
+LOOKAHEAD_BITS_MIN = 3
+CHAIN_DEPTH = 64                # Match candidates tried per position
+
+
+def crc32_mpeg2(data):
+    """CRC-32/MPEG-2 as the STM32 CRC unit computes it over zero padded words."""
+    data = bytes(data) + bytes((-len(data)) % 4)
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if (crc & 0x80000000) else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.count = 0
+
+    def put(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.count += bits
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.acc >> self.count) & 0xFF)
+        self.acc &= (1 << self.count) - 1
+
+    def flush(self):
+        if self.count:
+            self.out.append((self.acc << (8 - self.count)) & 0xFF)
+            self.acc = 0
+            self.count = 0
+        return bytes(self.out)
+
+
+def compress(data, window_bits, lookahead_bits):
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    # A back reference must beat the literals it replaces
+    min_len = (1 + window_bits + lookahead_bits) // 9 + 1
+    heads = {}
+    chain = [-1] * len(data)
+    bits = BitWriter()
+
+    def insert(pos):
+        if pos + 2 < len(data):
+            key = data[pos:pos + 3]
+            chain[pos] = heads.get(key, -1)
+            heads[key] = pos
+
+    pos = 0
+    while pos < len(data):
+        best_len = 0
+        best_dist = 0
+        limit = min(max_len, len(data) - pos)
+
+        if limit >= 3:
+            cand = heads.get(data[pos:pos + 3], -1)
+            depth = CHAIN_DEPTH
+            while cand >= 0 and (pos - cand) <= window and depth:
+                length = 0
+                while length < limit and data[cand + length] == data[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len = length
+                    best_dist = pos - cand
+                    if length == limit:
+                        break
+                cand = chain[cand]
+                depth -= 1
+
+        # Runs shorter than the hash key, mostly fill bytes, from the previous bytes
+        for dist in (1, 2, 4):
+            if best_len >= min(limit, 3) or dist > pos:
+                continue
+            length = 0
+            while length < limit and data[pos - dist + length] == data[pos + length]:
+                length += 1
+            if length > best_len:
+                best_len = length
+                best_dist = dist
+
+        if best_len >= max(min_len, 2):
+            bits.put(0, 1)
+            bits.put(best_dist - 1, window_bits)
+            bits.put(best_len - 1, lookahead_bits)
+            for i in range(best_len):
+                insert(pos + i)
+            pos += best_len
+        else:
+            bits.put(1, 1)
+            bits.put(data[pos], 8)
+            insert(pos)
+            pos += 1
+
+    return bits.flush()
+
+
+def decompress(stream, window_bits, lookahead_bits, size):
+    out = bytearray()
+    acc = 0
+    count = 0
+    it = iter(stream)
+
+    def get(n):
+        nonlocal acc, count
+        while count < n:
+            acc = (acc << 8) | next(it)
+            count += 8
+        count -= n
+        return (acc >> count) & ((1 << n) - 1)
+
+    try:
+        while len(out) < size:
+            if get(1):
+                out.append(get(8))
+            else:
+                dist = get(window_bits) + 1
+                length = get(lookahead_bits) + 1
+                for _ in range(length):
+                    # History before the first byte reads as zero
+                    out.append(out[-dist] if dist <= len(out) else 0)
+    except StopIteration:
+        pass
+    return bytes(out[:size])
+
+
+def pack(data, window_bits, lookahead_bits):
+    header = HEADER.pack(MAGIC, window_bits, lookahead_bits, 0, len(data), crc32_mpeg2(data))
+    return header + compress(data, window_bits, lookahead_bits)
+
+
+def unpack(blob):
+    magic, window_bits, lookahead_bits, _, size, digest = HEADER.unpack_from(blob)
+    if magic != MAGIC:
+        raise ValueError("not a compressed image")
+    data = decompress(blob[HEADER.size:], window_bits, lookahead_bits, size)
+    if len(data) != size or crc32_mpeg2(data) != digest:
+        raise ValueError("image does not match its header")
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("-w", "--window-bits", type=int, default=WINDOW_BITS_MAX)
+    parser.add_argument("-l", "--lookahead-bits", type=int, default=5)
+    parser.add_argument("-d", "--decompress", action="store_true", help="unpack a container instead")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    if args.decompress:
+        result = unpack(data)
+    else:
+        if not (WINDOW_BITS_MIN <= args.window_bits <= WINDOW_BITS_MAX):
+            parser.error("window bits must be %d to %d" % (WINDOW_BITS_MIN, WINDOW_BITS_MAX))
+        if not (LOOKAHEAD_BITS_MIN <= args.lookahead_bits < args.window_bits):
+            parser.error("lookahead bits must be %d to window bits - 1" % LOOKAHEAD_BITS_MIN)
+        result = pack(data, args.window_bits, args.lookahead_bits)
+        if unpack(result) != data:
+            sys.exit("round trip failed")
+        print("%s: %u -> %u bytes (%.2fx), CRC %08X" % (args.input, len(data), len(result),
+              len(data) / max(len(result), 1), crc32_mpeg2(data)))
+
+    with open(args.output, "wb") as f:
+        f.write(result)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""
+Convert an event trace dump of FasalFlasher (see AppTrace.h) into Chrome trace
+JSON, to be opened in chrome://tracing or https://ui.perfetto.dev.
+
+The dump is what the "TRC" console command streams, or what the host
+simulation writes with --trace. A raw console capture holding text around the
+dump is fine, the last dump in the file is converted.
+
+Dump, multi byte fields little endian:
+    0-3    "FTRC"
+    4-5    version
+    6-7    record size
+    8-11   cycle clock in Hz
+    12-15  record count
+    16-19  records lost to the ring before the oldest one
+    20-    records, oldest first:
+               0-3    cycle clock, bits 0-31
+               4-5    cycle clock, bits 32-47
+               6      event
+               7      phase, 0 instant, 1 begin, 2 end
+               8-11   argument 0
+               12-15  argument 1
+
+Each bus gets a track, so gaps where SPI1, SPI2 and the UART all wait on
+each other show up on the timeline.
+
+Usage:
+    trace2chrome.py capture.bin [-o trace.json]
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"FTRC"
+VERSION = 1
+HEADER = struct.Struct("<4sHHIII")
+RECORD = struct.Struct("<IHBBII")
+
+PHASE_INSTANT, PHASE_BEGIN, PHASE_END = range(3)
+
+# Same order as eAppTraceEvent_t
+EVENT_FASAL_STATE, EVENT_FLASH_COMMAND, EVENT_FLASH_DATA_DONE, EVENT_SD_READ, \
+    EVENT_XMODEM_FRAME, EVENT_XMODEM_PACKET = range(6)
+
+# Same order as eAppFasalStates_t
+FASAL_STATES = [
+    "Init", "Startup message", "Button wait", "SD init", "SD check", "Flash init",
+    "Mode selection", "SD to flash transfer", "XMODEM transfer", "CRC compare",
+    "Transfer success", "SD fail", "SD file fail", "Flash fail", "Transfer fail",
+    "CRC fail", "End",
+]
+
+# Same order as eW25qxxOperation_t
+FLASH_OPERATIONS = ["None", "Page program", "Sector erase", "Block 32K erase", "Block erase", "Chip erase"]
+
+TRACK_STATE, TRACK_FLASH, TRACK_SD, TRACK_UART = range(1, 5)
+TRACK_NAMES = {
+    TRACK_STATE: "AppFasal state",
+    TRACK_FLASH: "SPI2 W25Qxx",
+    TRACK_SD: "SPI1 SD card",
+    TRACK_UART: "USART1 XMODEM",
+}
+EVENT_TRACKS = {
+    EVENT_FASAL_STATE: TRACK_STATE,
+    EVENT_FLASH_COMMAND: TRACK_FLASH,
+    EVENT_FLASH_DATA_DONE: TRACK_FLASH,
+    EVENT_SD_READ: TRACK_SD,
+    EVENT_XMODEM_FRAME: TRACK_UART,
+    EVENT_XMODEM_PACKET: TRACK_UART,
+}
+
+
+def name_of(table, index):
+    return table[index] if index < len(table) else "#%d" % index
+
+
+def parse(blob):
+    """Header and records of the last dump in blob."""
+    start = blob.rfind(MAGIC)
+    if start < 0:
+        raise ValueError("no trace dump found")
+
+    magic, version, record_size, clock_hz, count, lost = HEADER.unpack_from(blob, start)
+    if version != VERSION or record_size != RECORD.size:
+        raise ValueError("unsupported dump, version %d record size %d" % (version, record_size))
+
+    offset = start + HEADER.size
+    count = min(count, (len(blob) - offset) // RECORD.size)
+    records = []
+    for index in range(count):
+        low, high, event, phase, arg0, arg1 = RECORD.unpack_from(blob, offset + index * RECORD.size)
+        records.append(((high << 32) | low, event, phase, arg0, arg1))
+
+    return clock_hz, lost, records
+
+
+def describe(event, phase, arg0, arg1):
+    """Name and arguments of a record."""
+    if event == EVENT_FLASH_COMMAND:
+        if phase == PHASE_BEGIN:
+            return name_of(FLASH_OPERATIONS, arg0), {"address": "0x%08X" % arg1}
+        return name_of(FLASH_OPERATIONS, arg0), {"status": struct.unpack("<i", struct.pack("<I", arg1))[0]}
+    if event == EVENT_FLASH_DATA_DONE:
+        return "Data phase done", {"operation": name_of(FLASH_OPERATIONS, arg0)}
+    if event == EVENT_SD_READ:
+        if phase == PHASE_BEGIN:
+            return "disk_read", {"sector": arg0, "count": arg1}
+        return "disk_read", {"result": arg1}
+    if event == EVENT_XMODEM_FRAME:
+        if phase == PHASE_BEGIN:
+            return "Frame", {"header": "0x%02X" % arg0, "slot": arg1}
+        return "Frame", {"length": arg0}
+    if event == EVENT_XMODEM_PACKET:
+        return "Packet %d" % arg0, {"status": arg1}
+    return "Event %d" % event, {"arg0": arg0, "arg1": arg1}
+
+
+def convert(clock_hz, lost, records):
+    """Chrome trace events of the records, plus busy time per track."""
+    events = [{"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "FasalFlasher"}}]
+    for tid, name in TRACK_NAMES.items():
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": name}})
+        events.append({"name": "thread_sort_index", "ph": "M", "pid": 1, "tid": tid, "args": {"sort_index": tid}})
+
+    if not records:
+        return events, {}, 0.0
+
+    origin = records[0][0]
+    end_us = (records[-1][0] - origin) * 1e6 / clock_hz
+    open_spans = {}
+    busy_us = {tid: 0.0 for tid in TRACK_NAMES}
+    state = None
+
+    def complete(tid, name, begin_us, until_us, args):
+        events.append({"name": name, "ph": "X", "pid": 1, "tid": tid, "ts": begin_us,
+                       "dur": until_us - begin_us, "args": args})
+        busy_us[tid] += until_us - begin_us
+
+    for cycles, event, phase, arg0, arg1 in records:
+        ts = (cycles - origin) * 1e6 / clock_hz
+        tid = EVENT_TRACKS.get(event, TRACK_STATE)
+
+        if event == EVENT_FASAL_STATE:
+            if state is not None:
+                complete(TRACK_STATE, state[0], state[1], ts, {})
+            state = (name_of(FASAL_STATES, arg0), ts)
+            continue
+
+        name, args = describe(event, phase, arg0, arg1)
+
+        if phase == PHASE_BEGIN:
+            # A begin without end, as an XMODEM frame dropped on timeout, ends where the next one starts
+            if tid in open_spans:
+                previous = open_spans.pop(tid)
+                complete(tid, previous[0], previous[1], ts, dict(previous[2], dropped=True))
+            open_spans[tid] = (name, ts, args)
+        elif phase == PHASE_END:
+            # The ring may have overwritten the begin
+            if tid in open_spans:
+                begin_name, begin_us, begin_args = open_spans.pop(tid)
+                complete(tid, begin_name, begin_us, ts, dict(begin_args, **args))
+        else:
+            events.append({"name": name, "ph": "i", "s": "t", "pid": 1, "tid": tid, "ts": ts, "args": args})
+
+    if state is not None:
+        complete(TRACK_STATE, state[0], state[1], end_us, {})
+    for tid, (name, begin_us, args) in open_spans.items():
+        complete(tid, name, begin_us, end_us, dict(args, unfinished=True))
+
+    return events, busy_us, end_us
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="trace dump or console capture holding one")
+    parser.add_argument("-o", "--output", help="JSON file, standard output if omitted")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as source:
+        blob = source.read()
+
+    try:
+        clock_hz, lost, records = parse(blob)
+    except ValueError as error:
+        sys.exit("%s: %s" % (args.dump, error))
+
+    events, busy_us, end_us = convert(clock_hz, lost, records)
+    trace = {
+        "traceEvents": events,
+        "displayTimeUnit": "ms",
+        "otherData": {"clock_hz": clock_hz, "records": len(records), "lost_records": lost},
+    }
+
+    if args.output:
+        with open(args.output, "w") as sink:
+            json.dump(trace, sink)
+    else:
+        json.dump(trace, sys.stdout)
+
+    print("%d records, %d lost, %.3f ms" % (len(records), lost, end_us / 1000.0), file=sys.stderr)
+    for tid, name in TRACK_NAMES.items():
+        if tid != TRACK_STATE and end_us > 0:
+            print("  %-16s busy %8.3f ms, %5.1f %%" % (name, busy_us[tid] / 1000.0, 100.0 * busy_us[tid] / end_us),
+                  file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()